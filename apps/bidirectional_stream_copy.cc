@@ -5,12 +5,13 @@
 
 #include <algorithm>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <unistd.h>
 
 using namespace std;
 
 void bidirectional_stream_copy(Socket &socket) {
-    constexpr size_t max_copy_length = 65536;
     constexpr size_t buffer_size = 1048576;
 
     EventLoop _eventloop{};
@@ -30,7 +31,7 @@ void bidirectional_stream_copy(Socket &socket) {
         _input,
         Direction::In,
         [&] {
-            _outbound.write(_input.read(_outbound.remaining_capacity()));
+            _outbound.read_from(_input);
             if (_input.eof()) {
                 _outbound.end_input();
             }
@@ -42,9 +43,7 @@ void bidirectional_stream_copy(Socket &socket) {
     _eventloop.add_rule(socket,
                         Direction::Out,
                         [&] {
-                            const size_t bytes_to_write = min(max_copy_length, _outbound.buffer_size());
-                            const size_t bytes_written = socket.write(_outbound.peek_output(bytes_to_write), false);
-                            _outbound.pop_output(bytes_written);
+                            _outbound.write_to(socket);
                             if (_outbound.eof()) {
                                 socket.shutdown(SHUT_WR);
                                 _outbound_shutdown = true;
@@ -58,7 +57,7 @@ void bidirectional_stream_copy(Socket &socket) {
         socket,
         Direction::In,
         [&] {
-            _inbound.write(socket.read(_inbound.remaining_capacity()));
+            _inbound.read_from(socket);
             if (socket.eof()) {
                 _inbound.end_input();
             }
@@ -70,9 +69,7 @@ void bidirectional_stream_copy(Socket &socket) {
     _eventloop.add_rule(_output,
                         Direction::Out,
                         [&] {
-                            const size_t bytes_to_write = min(max_copy_length, _inbound.buffer_size());
-                            const size_t bytes_written = _output.write(_inbound.peek_output(bytes_to_write), false);
-                            _inbound.pop_output(bytes_written);
+                            _inbound.write_to(_output);
 
                             if (_inbound.eof()) {
                                 _output.close();
@@ -89,3 +86,95 @@ void bidirectional_stream_copy(Socket &socket) {
         }
     }
 }
+
+//! \details Bytes move between the ByteStreams and the rings without system calls; the loop only waits on
+//! the rings' events when a ring is full (or empty) and nothing else is ready.
+void bidirectional_stream_copy(SPSCByteRing &outbound, SPSCByteRing &inbound) {
+    constexpr size_t buffer_size = 1048576;
+
+    EventLoop _eventloop{};
+    FileDescriptor _input{STDIN_FILENO};
+    FileDescriptor _output{STDOUT_FILENO};
+    ByteStream _outbound{buffer_size};
+    ByteStream _inbound{buffer_size};
+    bool _outbound_shutdown{false};
+    bool _inbound_shutdown{false};
+
+    _input.set_blocking(false);
+    _output.set_blocking(false);
+
+    // rule 1: read from stdin into outbound byte stream
+    _eventloop.add_rule(
+        _input,
+        Direction::In,
+        [&] {
+            _outbound.read_from(_input);
+            if (_input.eof()) {
+                _outbound.end_input();
+            }
+        },
+        [&] { return (not _outbound.error()) and (_outbound.remaining_capacity() > 0) and (not _inbound.error()); },
+        [&] { _outbound.end_input(); });
+
+    // rule 2: the outbound ring has room again
+    _eventloop.add_rule(outbound.writable_event(),
+                        Direction::In,
+                        [&] { outbound.writable_event().clear(); },
+                        [&] { return not _outbound_shutdown; });
+
+    // rule 3: the inbound ring has bytes again (or has ended)
+    _eventloop.add_rule(inbound.readable_event(),
+                        Direction::In,
+                        [&] { inbound.readable_event().clear(); },
+                        [&] { return not _inbound.input_ended(); });
+
+    // rule 4: read from inbound byte stream into stdout
+    _eventloop.add_rule(_output,
+                        Direction::Out,
+                        [&] {
+                            _inbound.write_to(_output);
+
+                            if (_inbound.eof()) {
+                                _output.close();
+                                _inbound_shutdown = true;
+                            }
+                        },
+                        [&] { return (not _inbound.buffer_empty()) or (_inbound.eof() and not _inbound_shutdown); });
+
+    // loop until completion
+    while (true) {
+        // from the outbound byte stream into the ring
+        if (not _outbound_shutdown) {
+            const BufferViewList views = _outbound.peek_views(outbound.remaining_capacity());
+            size_t bytes_written = 0;
+            for (const auto &view : views.views()) {
+                bytes_written += outbound.write(view);
+            }
+            _outbound.pop_output(bytes_written);
+            if (_outbound.eof() or outbound.reader_closed()) {
+                outbound.close();
+                _outbound_shutdown = true;
+            }
+        }
+
+        // from the ring into the inbound byte stream
+        while (_inbound.remaining_capacity() > 0) {
+            const string_view front = inbound.peek();
+            if (front.empty()) {
+                break;
+            }
+            inbound.pop(_inbound.write(string(front.substr(0, _inbound.remaining_capacity()))));
+        }
+        if (inbound.eof() and not _inbound.input_ended()) {
+            _inbound.end_input();
+        }
+
+        // sleep only if a ring is what there is to wait for, and it is still full (or empty)
+        const bool outbound_idle = _outbound_shutdown or _outbound.buffer_empty() or outbound.arm_writable_wakeup();
+        const bool inbound_idle =
+            _inbound.input_ended() or _inbound.remaining_capacity() == 0 or inbound.arm_readable_wakeup();
+        if (EventLoop::Result::Exit == _eventloop.wait_next_event(outbound_idle and inbound_idle ? -1 : 0)) {
+            return;
+        }
+    }
+}
@@ -2,8 +2,12 @@
 #define SPONGE_APPS_BIDIRECTIONAL_STREAM_COPY_HH
 
 #include "socket.hh"
+#include "spsc_ring.hh"
 
 //! Copy socket input/output to stdin/stdout until finished
 void bidirectional_stream_copy(Socket &socket);
 
+//! Copy stdin into `outbound` and `inbound` to stdout until finished (for TCPSpongeSocket's rings)
+void bidirectional_stream_copy(SPSCByteRing &outbound, SPSCByteRing &inbound);
+
 #endif  // SPONGE_APPS_BIDIRECTIONAL_STREAM_COPY_HH
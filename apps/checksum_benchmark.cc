@@ -0,0 +1,64 @@
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Bytes summed per measurement, regardless of input size
+constexpr size_t total_bytes = 1024 * 1024 * 1024;
+
+void checksum_loop(const InternetChecksum::Kernel k, const size_t input_size) {
+    InternetChecksum::set_kernel(k);
+
+    string input(input_size, 0);
+    for (auto &ch : input) {
+        ch = rand();
+    }
+
+    const size_t iterations = total_bytes / input_size;
+    uint32_t sink = 0;
+
+    const auto first_time = high_resolution_clock::now();
+
+    for (size_t i = 0; i < iterations; i++) {
+        InternetChecksum check;
+        check.add(input);
+        sink += check.value();
+        input[i % input_size]++;
+    }
+
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    const auto gigabits_per_second = iterations * input_size * 8.0 / double(duration);
+
+    cout << fixed << setprecision(2);
+    cout << "InternetChecksum " << setw(8) << left << InternetChecksum::kernel_name(k) << " " << setw(6) << right
+         << input_size << " bytes: " << setw(8) << gigabits_per_second << " Gbit/s"
+         << " (" << sink % 10 << ")\n";
+}
+
+int main() {
+    try {
+        using Kernel = InternetChecksum::Kernel;
+        for (const auto k : {Kernel::Portable, Kernel::SSE2, Kernel::AVX2}) {
+            if (not InternetChecksum::kernel_supported(k)) {
+                cout << "InternetChecksum " << InternetChecksum::kernel_name(k) << ": not supported by this CPU\n";
+                continue;
+            }
+            for (const size_t input_size : {64, 256, 1024, 1500, 4096, 16384, 65536}) {
+                checksum_loop(k, input_size);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
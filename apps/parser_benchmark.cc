@@ -0,0 +1,145 @@
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Packets parsed per measurement (the capture is parsed over and over)
+constexpr size_t total_packets = 20 * 1000 * 1000;
+
+//! \brief The IPv4 datagrams in the Ethernet frames of a capture file
+//! \details Reads the classic pcap format (both byte orders) directly, so the benchmark does not need libpcap.
+vector<Buffer> read_capture(const string &filename) {
+    ifstream file{filename, ios::binary};
+    if (not file) {
+        throw runtime_error("cannot open " + filename);
+    }
+    const string data{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+
+    constexpr size_t file_header_length = 24;
+    constexpr size_t record_header_length = 16;
+    constexpr size_t ethernet_header_length = 14;
+    const auto u32 = [&](const size_t offset, const bool swapped) {
+        uint32_t value = 0;
+        memcpy(&value, data.data() + offset, sizeof(value));
+        return swapped ? __builtin_bswap32(value) : value;
+    };
+
+    if (data.size() < file_header_length) {
+        throw runtime_error(filename + ": not a capture file");
+    }
+    const bool swapped = u32(0, false) == 0xd4c3b2a1;
+    if (not swapped and u32(0, false) != 0xa1b2c3d4) {
+        throw runtime_error(filename + ": not a capture file");
+    }
+    if (u32(20, swapped) != 1) {
+        throw runtime_error(filename + ": expected Ethernet link type");
+    }
+
+    vector<Buffer> datagrams;
+    for (size_t offset = file_header_length; offset + record_header_length <= data.size();) {
+        const size_t length = u32(offset + 8, swapped);
+        const size_t frame = offset + record_header_length;
+        offset = frame + length;
+        if (offset > data.size()) {
+            break;
+        }
+        const bool ipv4 = length > ethernet_header_length and data[frame + 12] == 0x08 and data[frame + 13] == 0x00;
+        if (ipv4) {
+            datagrams.emplace_back(data.substr(frame + ethernet_header_length, length - ethernet_header_length));
+        }
+    }
+    return datagrams;
+}
+
+//! Parse every datagram with `parse` until total_packets have been parsed; `parse` returns whether it succeeded
+template <typename Parse>
+void parse_loop(const string &what, const vector<Buffer> &datagrams, const Parse &parse) {
+    const size_t rounds = total_packets / datagrams.size();
+    size_t parsed = 0;
+
+    const auto first_time = high_resolution_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (const auto &datagram : datagrams) {
+            parsed += parse(datagram);
+        }
+    }
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    const size_t packets = rounds * datagrams.size();
+    cout << fixed << setprecision(1);
+    cout << setw(34) << left << what << setw(8) << right << double(duration) / packets << " ns/packet, " << setw(7)
+         << packets * 1000.0 / double(duration) << " Mpps (" << parsed / rounds << " of " << datagrams.size()
+         << " parsed)\n";
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        if (argc != 2) {
+            cerr << "Usage: " << argv[0] << " CAPTURE\n\n"
+                 << "   Measures how fast the headers in CAPTURE (a pcap file of Ethernet frames,\n"
+                 << "   such as tests/ipv4_parser.data) are parsed.\n";
+            return EXIT_FAILURE;
+        }
+
+        const vector<Buffer> datagrams = read_capture(argv[1]);
+        if (datagrams.empty()) {
+            throw runtime_error("no IPv4 datagrams in the capture");
+        }
+
+        // the TCP headers, on their own, to time TCPHeader::parse without the IPv4 header
+        vector<Buffer> tcp_segments;
+        for (const auto &datagram : datagrams) {
+            InternetDatagram ip_dgram;
+            if (ip_dgram.parse(datagram) == ParseResult::NoError and
+                ip_dgram.header().proto == IPv4Header::PROTO_TCP) {
+                tcp_segments.push_back(ip_dgram.payload());
+            }
+        }
+
+        parse_loop("IPv4Header::parse", datagrams, [](const Buffer &datagram) {
+            IPv4Header header;
+            NetParser p{datagram};
+            return header.parse(p) == ParseResult::NoError;
+        });
+        parse_loop("TCPHeader::parse", tcp_segments, [](const Buffer &segment) {
+            TCPHeader header;
+            NetParser p{segment};
+            return header.parse(p) == ParseResult::NoError;
+        });
+        parse_loop("datagram + segment, no checksum", datagrams, [](const Buffer &datagram) {
+            InternetDatagram ip_dgram;
+            TCPSegment seg;
+            return ip_dgram.parse(datagram) == ParseResult::NoError and
+                   seg.parse(ip_dgram.payload(), 0, false) == ParseResult::NoError;
+        });
+        parse_loop("datagram + segment, checksums", datagrams, [](const Buffer &datagram) {
+            InternetDatagram ip_dgram;
+            TCPSegment seg;
+            return ip_dgram.parse(datagram) == ParseResult::NoError and
+                   seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum()) == ParseResult::NoError;
+        });
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
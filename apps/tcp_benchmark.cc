@@ -1,17 +1,26 @@
+#include "byte_stream.hh"
+#include "file_descriptor.hh"
+#include "link_emulator.hh"
 #include "tcp_connection.hh"
+#include "util.hh"
 
 #include <chrono>
 #include <cstdlib>
+#include <deque>
+#include <fcntl.h>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <string>
+#include <utility>
 
 using namespace std;
 using namespace std::chrono;
 
 constexpr size_t len = 100 * 1024 * 1024;
 
-void move_segments(TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segments, const bool reorder) {
+//! Deliver x's segments to y; returns how many there were
+size_t move_segments(TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segments, const bool reorder) {
     while (not x.segments_out().empty()) {
         segments.emplace_back(move(x.segments_out().front()));
         x.segments_out().pop();
@@ -25,11 +34,14 @@ void move_segments(TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segme
             y.segment_received(move(*it));
         }
     }
+    const size_t count = segments.size();
     segments.clear();
+    return count;
 }
 
-void main_loop(const bool reorder) {
+void main_loop(const bool reorder, const bool delayed_ack) {
     TCPConfig config;
+    config.delayed_ack = delayed_ack;
     TCPConnection x{config}, y{config};
 
     string string_to_send(len, 'x');
@@ -42,6 +54,8 @@ void main_loop(const bool reorder) {
     y.end_input_stream();
 
     bool x_closed = false;
+    size_t x_segments = 0;
+    size_t y_segments = 0;
 
     string string_received;
     string_received.reserve(len);
@@ -66,8 +80,8 @@ void main_loop(const bool reorder) {
 
         // exchange segments between x and y but in reverse order
         vector<TCPSegment> segments;
-        move_segments(x, y, segments, reorder);
-        move_segments(y, x, segments, false);
+        x_segments += move_segments(x, y, segments, reorder);
+        y_segments += move_segments(y, x, segments, false);
 
         // read output from y
         const auto available_output = y.inbound_stream().buffer_size();
@@ -95,18 +109,348 @@ void main_loop(const bool reorder) {
     const auto gigabits_per_second = len * 8.0 / double(duration);
 
     cout << fixed << setprecision(2);
-    cout << "CPU-limited throughput" << (reorder ? " with reordering: " : "                : ") << gigabits_per_second
-         << " Gbit/s\n";
+    const char *variant = reorder       ? " with reordering  : "
+                          : delayed_ack ? " with delayed ACKs: "
+                                        : "                  : ";
+    cout << "CPU-limited throughput" << variant << gigabits_per_second << " Gbit/s\n";
+    cout << "    segments: " << x_segments << " sent, " << y_segments << " ACKs returned ("
+         << setprecision(2) << double(y_segments) / double(x_segments) << " per segment)\n";
+
+    const auto &pool = x.buffer_pool_stats();
+    cout << "    payload buffers: " << pool.acquired << " acquired, " << pool.reused << " recycled, "
+         << pool.allocated << " slots allocated, " << pool.unpooled << " unpooled\n";
 
     while (x.active() or y.active()) {
         loop();
     }
 }
 
+//! \brief Time the receive side alone: segments into the receiver, and the inbound stream out to a descriptor
+//! \details The data goes to /dev/null, either with write_to() (writev from the stream's storage) or by reading
+//! it into a string first, as TCPSpongeSocket used to. A payload counts as delivered in place if the inbound
+//! stream holds its bytes at the address the segment had them.
+void receive_path(const bool write_to) {
+    constexpr size_t transfer_len = 64 * 1024 * 1024;
+
+    TCPConfig config;
+    TCPConnection x{config}, y{config};
+    FileDescriptor devnull{SystemCall("open", ::open("/dev/null", O_WRONLY | O_CLOEXEC))};
+
+    const string data(TCPConfig::DEFAULT_CAPACITY, 'x');
+    size_t written = 0;
+    size_t received = 0;
+    size_t payloads = 0;
+    size_t in_place = 0;
+    bool x_closed = false;
+    x.connect();
+    y.end_input_stream();
+
+    vector<TCPSegment> segments;
+    set<const char *> stream_chunks;
+    nanoseconds duration{0};
+
+    while (not y.inbound_stream().eof()) {
+        while (written < transfer_len and x.remaining_outbound_capacity()) {
+            written += x.write(data.substr(0, min(x.remaining_outbound_capacity(), transfer_len - written)));
+        }
+        if (written == transfer_len and not x_closed) {
+            x.end_input_stream();
+            x_closed = true;
+        }
+        while (not x.segments_out().empty()) {
+            segments.emplace_back(move(x.segments_out().front()));
+            x.segments_out().pop();
+        }
+
+        auto first_time = high_resolution_clock::now();
+        for (const auto &seg : segments) {
+            y.segment_received(seg);
+        }
+        duration += high_resolution_clock::now() - first_time;
+
+        // (not timed) which payloads the stream holds where the segments had them
+        stream_chunks.clear();
+        const BufferViewList views = y.inbound_stream().peek_views(y.inbound_stream().buffer_size());
+        for (const auto &view : views.views()) {
+            stream_chunks.insert(view.data());
+        }
+        for (const auto &seg : segments) {
+            if (seg.payload().size()) {
+                payloads++;
+                in_place += stream_chunks.count(seg.payload().str().data());
+            }
+        }
+        segments.clear();
+
+        first_time = high_resolution_clock::now();
+        if (write_to) {
+            received += y.inbound_stream().write_to(devnull);
+        } else {
+            const string copy = y.inbound_stream().read(y.inbound_stream().buffer_size());
+            received += devnull.write(copy);
+        }
+        y.inbound_stream_read();
+        duration += high_resolution_clock::now() - first_time;
+
+        while (not y.segments_out().empty()) {
+            x.segment_received(y.segments_out().front());
+            y.segments_out().pop();
+        }
+        x.tick(1);
+        y.tick(1);
+    }
+
+    const double copies = double(payloads - in_place) / double(payloads) + (write_to ? 0 : 1);
+    cout << fixed << setprecision(2);
+    cout << "Receive path" << (write_to ? " (write_to)                 : " : " (read + write)             : ")
+         << received * 8.0 / double(duration.count()) << " Gbit/s, " << in_place << " of " << payloads
+         << " payloads delivered in place, " << copies << " user-space copies per byte\n";
+
+    while (x.active() or y.active()) {
+        while (not x.segments_out().empty()) {
+            y.segment_received(x.segments_out().front());
+            x.segments_out().pop();
+        }
+        while (not y.segments_out().empty()) {
+            x.segment_received(y.segments_out().front());
+            y.segments_out().pop();
+        }
+        x.tick(1000);
+        y.tick(1000);
+    }
+}
+
+void byte_stream_loop(const bool zero_copy) {
+    constexpr size_t chunk_size = TCPConfig::MAX_PAYLOAD_SIZE;
+    ByteStream stream{TCPConfig::DEFAULT_CAPACITY};
+
+    const string chunk(chunk_size, 'x');
+    const Buffer chunk_buffer{string(chunk)};
+    size_t bytes_moved = 0;
+
+    const auto first_time = high_resolution_clock::now();
+
+    // fill the stream, then drain it in chunk-sized pieces, as TCPSender and TCPSpongeSocket do
+    while (bytes_moved < len) {
+        while (stream.remaining_capacity() >= chunk_size) {
+            if (zero_copy) {
+                stream.write(Buffer{chunk_buffer});
+            } else {
+                stream.write(chunk);
+            }
+        }
+        while (not stream.buffer_empty()) {
+            const size_t available = zero_copy ? stream.peek_views(chunk_size).size()
+                                               : stream.peek_output(chunk_size).size();
+            stream.pop_output(available);
+            bytes_moved += available;
+        }
+    }
+
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+
+    cout << fixed << setprecision(2);
+    cout << "ByteStream throughput" << (zero_copy ? " (Buffer/views)    : " : "                   : ")
+         << bytes_moved * 8.0 / double(duration) << " Gbit/s\n";
+}
+
+//! How a request/response exchange writes its small pieces
+enum class Coalescing { NoDelay, Nagle, Cork };
+
+//! Segments and (virtual) time per exchange when each request and response is written in several small pieces,
+//! as webget writes its request, with delayed ACKs on both sides
+void request_response(const Coalescing coalescing) {
+    constexpr size_t exchanges = 1000;
+    const vector<string> request{"GET ", "/index.html", " HTTP/1.1\r\n", "Host: ", "example.com", "\r\n", "\r\n"};
+    const vector<string> response{"HTTP/1.1 200 OK\r\n", "Content-Length: 5\r\n\r\n", "hello"};
+    size_t request_len = 0;
+    size_t response_len = 0;
+    for (const auto &piece : request) {
+        request_len += piece.size();
+    }
+    for (const auto &piece : response) {
+        response_len += piece.size();
+    }
+
+    TCPConfig config;
+    config.delayed_ack = true;
+    config.nagle = coalescing == Coalescing::Nagle;
+    TCPConnection client{config}, server{config};
+
+    vector<TCPSegment> segments;
+    const auto exchange = [&](TCPConnection &from, TCPConnection &to, size_t &sent) {
+        sent += move_segments(from, to, segments, false);
+    };
+
+    size_t client_segments = 0;
+    size_t server_segments = 0;
+    client.connect();
+    exchange(client, server, client_segments);
+    exchange(server, client, server_segments);
+    exchange(client, server, client_segments);
+    client_segments = server_segments = 0;
+
+    // write `pieces`, corked if asked, and exchange segments (ticking 1 ms at a time) until `to` has `size` bytes
+    uint64_t elapsed_ms = 0;
+    const auto send = [&](TCPConnection &from, TCPConnection &to, const vector<string> &pieces, const size_t size) {
+        if (coalescing == Coalescing::Cork) {
+            from.cork();
+        }
+        for (const auto &piece : pieces) {
+            from.write(piece);
+        }
+        if (coalescing == Coalescing::Cork) {
+            from.uncork();
+        }
+        while (true) {
+            exchange(client, server, client_segments);
+            exchange(server, client, server_segments);
+            if (to.inbound_stream().buffer_size() == size) {
+                break;
+            }
+            client.tick(1);
+            server.tick(1);
+            elapsed_ms++;
+        }
+        to.inbound_stream().pop_output(size);
+    };
+
+    for (size_t i = 0; i < exchanges; i++) {
+        send(client, server, request, request_len);
+        send(server, client, response, response_len);
+    }
+
+    const char *name = coalescing == Coalescing::Cork ? "cork    " : coalescing == Coalescing::Nagle ? "Nagle   " : "no delay";
+    cout << fixed << setprecision(2);
+    cout << "Request/response, " << name << ": " << double(client_segments + server_segments) / exchanges
+         << " segments per exchange (" << double(client_segments) / exchanges << " from the client), "
+         << double(elapsed_ms) / exchanges << " ms per exchange\n";
+
+    client.end_input_stream();
+    server.end_input_stream();
+    while (client.active() or server.active()) {
+        exchange(client, server, client_segments);
+        exchange(server, client, server_segments);
+        client.tick(1000);
+        server.tick(1000);
+    }
+}
+
+//! Hand `to` every segment that has crossed `link`
+void deliver(LinkEmulator &link, TCPConnection &to) {
+    while (auto seg = link.receive()) {
+        to.segment_received(move(seg.value()));
+    }
+}
+
+//! Goodput of a 16 MB transfer over a 100 Mbit/s path with a 20 ms round trip, random loss and reordering
+void goodput_under_loss(const TCPConfig::CongestionControl algorithm,
+                        const double loss_rate,
+                        const double reorder_rate,
+                        const bool adaptive_rto,
+                        const bool sack) {
+    constexpr size_t transfer_len = 16 * 1024 * 1024;
+    constexpr uint64_t time_limit_ms = 300 * 1000;
+
+    TCPConfig config;
+    config.recv_capacity = config.send_capacity = 1024 * 1024;
+    config.window_scaling = true;
+    config.congestion_control = algorithm;
+    config.adaptive_rto = adaptive_rto;
+    config.sack = sack;
+    TCPConnection x{config}, y{config};
+
+    LinkConfig forward_path;
+    forward_path.rate_bps = 100 * 1000 * 1000;
+    forward_path.queue_limit = 100 * (TCPConfig::MAX_PAYLOAD_SIZE + 40);
+    forward_path.delay_ms = 10;
+    forward_path.loss_rate = loss_rate;
+    forward_path.reorder_rate = reorder_rate;
+    LinkEmulator forward{forward_path};
+    LinkConfig reverse_path;
+    reverse_path.delay_ms = 10;
+    LinkEmulator reverse{reverse_path};
+
+    const string data(TCPConfig::DEFAULT_CAPACITY, 'x');
+    size_t written = 0;
+    size_t received = 0;
+    bool x_closed = false;
+    x.connect();
+    y.end_input_stream();
+
+    uint64_t now = 0;
+    uint64_t finished_at = 0;
+    for (; (x.active() or y.active()) and now < time_limit_ms; now++) {
+        while (written < transfer_len and x.remaining_outbound_capacity()) {
+            const size_t want = min({x.remaining_outbound_capacity(), data.size(), transfer_len - written});
+            written += x.write(data.substr(0, want));
+        }
+        if (written == transfer_len and not x_closed) {
+            x.end_input_stream();
+            x_closed = true;
+        }
+
+        while (not x.segments_out().empty()) {
+            forward.send(move(x.segments_out().front()));
+            x.segments_out().pop();
+        }
+        while (not y.segments_out().empty()) {
+            reverse.send(move(y.segments_out().front()));
+            y.segments_out().pop();
+        }
+        deliver(forward, y);
+        deliver(reverse, x);
+
+        received += y.inbound_stream().read(y.inbound_stream().buffer_size()).size();
+        if (y.inbound_stream().eof() and finished_at == 0) {
+            finished_at = now;
+        }
+        x.tick(1);
+        y.tick(1);
+        forward.advance(1);
+        reverse.advance(1);
+    }
+
+    const char *name = algorithm == TCPConfig::CongestionControl::Cubic  ? "cubic"
+                       : algorithm == TCPConfig::CongestionControl::Reno ? "reno "
+                                                                         : "none ";
+    const char *variant = sack           ? "adaptive RTO + SACK: "
+                          : adaptive_rto ? "adaptive RTO       : "
+                                         : "fixed RTO          : ";
+    cout << fixed << setprecision(1);
+    cout << "Goodput at " << loss_rate * 100 << "% loss, " << reorder_rate * 100 << "% reordered, " << name << ", "
+         << variant;
+    if (finished_at == 0) {
+        cout << "did not finish in " << time_limit_ms / 1000 << " s";
+    } else {
+        cout << setprecision(2) << received * 8.0 / double(finished_at) / 1000 << " Mbit/s";
+    }
+    cout << " (" << forward.stats().random_drops + forward.stats().queue_drops << " segments dropped)\n";
+}
+
 int main() {
     try {
-        main_loop(false);
-        main_loop(true);
+        byte_stream_loop(false);
+        byte_stream_loop(true);
+        main_loop(false, false);
+        main_loop(true, false);
+        main_loop(false, true);
+        receive_path(false);
+        receive_path(true);
+        for (const auto coalescing : {Coalescing::NoDelay, Coalescing::Nagle, Coalescing::Cork}) {
+            request_response(coalescing);
+        }
+        for (const auto &[loss_rate, reorder_rate] : {pair{0.0, 0.0}, {0.001, 0.0}, {0.01, 0.0}, {0.0, 0.01}}) {
+            for (const auto algorithm : {TCPConfig::CongestionControl::None,
+                                         TCPConfig::CongestionControl::Reno,
+                                         TCPConfig::CongestionControl::Cubic}) {
+                goodput_under_loss(algorithm, loss_rate, reorder_rate, false, false);
+                goodput_under_loss(algorithm, loss_rate, reorder_rate, true, false);
+                goodput_under_loss(algorithm, loss_rate, reorder_rate, true, true);
+            }
+        }
     } catch (const exception &e) {
         cerr << e.what() << "\n";
         return EXIT_FAILURE;
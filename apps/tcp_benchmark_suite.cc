@@ -0,0 +1,478 @@
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! \name Allocation counting: every operator new in this program is counted
+//!@{
+static atomic<uint64_t> allocation_count{0};
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void *ret = malloc(size == 0 ? 1 : size)) {
+        return ret;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+//!@}
+
+//! What a scenario sends, and what the wire between the two ends does to it
+struct Scenario {
+    string name{};
+
+    //! \name The exchange
+    //!@{
+    size_t connections{1};     //!< Connections running side by side
+    size_t transfer_bytes{0};  //!< Bulk: bytes sent on each connection
+    size_t message_size{0};    //!< Request/response: bytes in each request and in each response
+    size_t messages{0};        //!< Request/response: exchanges on each connection
+    //!@}
+
+    //! \name The connections
+    //!@{
+    size_t mss{TCPConfig::MAX_PAYLOAD_SIZE};
+    size_t window{TCPConfig::DEFAULT_CAPACITY};  //!< Receive (and send) capacity
+    //!@}
+
+    //! \name The wire, in each direction
+    //!@{
+    double loss_rate{0};       //!< Probability that a segment is dropped
+    double duplicate_rate{0};  //!< Probability that a segment is delivered twice
+    size_t reorder_depth{0};   //!< Most later segments (of the same round) that a segment can be overtaken by
+    //!@}
+
+    bool request_response() const { return message_size > 0; }
+};
+
+//! What a scenario measured
+struct Result {
+    uint64_t bytes{0};              //!< Payload bytes delivered to the applications
+    uint64_t segments{0};           //!< Segments sent by either end (before the wire drops or duplicates any)
+    uint64_t allocations{0};        //!< Calls to operator new while the scenario ran
+    uint64_t wall_ns{0};            //!< Wall-clock time the scenario ran for
+    uint64_t virtual_ms{0};         //!< Time that passed for the connections
+    vector<uint64_t> latency_ns{};  //!< Request/response: wall-clock time of each exchange
+    vector<uint64_t> latency_ms{};  //!< Request/response: virtual time of each exchange
+
+    double gigabits_per_second() const { return wall_ns ? bytes * 8.0 / double(wall_ns) : 0; }
+    double segments_per_byte() const { return bytes ? double(segments) / double(bytes) : 0; }
+    double allocations_per_segment() const { return segments ? double(allocations) / double(segments) : 0; }
+};
+
+//! The `p`th percentile of `samples` (0 if there are none)
+static uint64_t percentile(vector<uint64_t> samples, const double p) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const size_t index = min(samples.size() - 1, size_t(p / 100 * double(samples.size())));
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+//! One direction of the path between the ends: drops, duplicates, and reorders each round's segments
+class Wire {
+    const Scenario &_scenario;
+    mt19937 _rng;
+    vector<TCPSegment> _batch{};
+
+  public:
+    Wire(const Scenario &scenario, const unsigned int seed) : _scenario(scenario), _rng(seed) {}
+
+    //! Take the segments `from` has sent and deliver what survives to `to`
+    //! \returns the number of segments `from` sent
+    size_t carry(TCPConnection &from, TCPConnection &to) {
+        auto &segments = from.segments_out();
+        const size_t sent = segments.size();
+        for (; not segments.empty(); segments.pop()) {
+            if (_scenario.loss_rate > 0 and bernoulli_distribution{_scenario.loss_rate}(_rng)) {
+                continue;
+            }
+            const size_t copies =
+                _scenario.duplicate_rate > 0 and bernoulli_distribution{_scenario.duplicate_rate}(_rng) ? 2 : 1;
+            for (size_t i = 0; i < copies; i++) {
+                // overtaken by up to reorder_depth of the segments after it
+                const size_t back =
+                    min(_batch.size(), uniform_int_distribution<size_t>{0, _scenario.reorder_depth}(_rng));
+                _batch.insert(_batch.end() - back, segments.front());
+            }
+        }
+        for (auto &seg : _batch) {
+            to.segment_received(move(seg));
+        }
+        _batch.clear();
+        return sent;
+    }
+};
+
+static TCPConfig scenario_config(const Scenario &scenario) {
+    TCPConfig config;
+    config.mss = scenario.mss;
+    config.recv_capacity = config.send_capacity = scenario.window;
+    config.window_scaling = scenario.window > numeric_limits<uint16_t>::max();
+    config.congestion_control = TCPConfig::CongestionControl::Reno;
+    config.adaptive_rto = true;
+    config.sack = true;
+    config.rt_timeout = 10;
+    return config;
+}
+
+//! A connection: x connects to y, and both ends of the wire between them
+struct Flow {
+    TCPConnection x;
+    TCPConnection y;
+    Wire forward;
+    Wire reverse;
+    size_t written{0};
+    size_t received{0};
+
+    Flow(const Scenario &scenario, const unsigned int seed)
+        : x(scenario_config(scenario))
+        , y(scenario_config(scenario))
+        , forward(scenario, seed)
+        , reverse(scenario, seed + 1) {
+        x.connect();
+    }
+
+    //! Exchange segments, and let one millisecond pass
+    size_t round() {
+        const size_t segments = forward.carry(x, y) + reverse.carry(y, x);
+        x.tick(1);
+        y.tick(1);
+        return segments;
+    }
+};
+
+//! The bytes a bulk transfer sends, repeated; each position's byte is checked on arrival
+static const string &pattern() {
+    static const string ret = [] {
+        auto rd = mt19937{42};
+        string s(65521, 0);  // a prime, so that chunk boundaries drift through it
+        for (auto &ch : s) {
+            ch = static_cast<char>(rd());
+        }
+        return s;
+    }();
+    return ret;
+}
+
+//! Once every stream has been ended, run the connections (outside the measurement) until they have all closed
+static void shut_down(vector<unique_ptr<Flow>> &flows) {
+    for (bool active = true; active;) {
+        active = false;
+        for (auto &flow : flows) {
+            flow->round();
+            for (TCPConnection *end : {&flow->x, &flow->y}) {
+                end->inbound_stream().pop_output(end->inbound_stream().buffer_size());
+                active |= end->active();
+            }
+        }
+    }
+}
+
+//! \details Each connection sends transfer_bytes from x to y; every round, each connection writes what
+//! fits, exchanges segments, and the receiver checks and drains what arrived.
+static Result run_bulk(const Scenario &scenario) {
+    vector<unique_ptr<Flow>> flows;
+    for (size_t i = 0; i < scenario.connections; i++) {
+        flows.push_back(make_unique<Flow>(scenario, 2 * i + 1));
+        flows.back()->y.end_input_stream();
+    }
+    const string &data = pattern();
+
+    Result result;
+    const uint64_t first_allocations = allocation_count.load();
+    const auto first_time = steady_clock::now();
+    size_t finished = 0;
+    while (finished < flows.size()) {
+        finished = 0;
+        for (auto &flow : flows) {
+            while (flow->written < scenario.transfer_bytes and flow->x.remaining_outbound_capacity() > 0) {
+                const size_t offset = flow->written % data.size();
+                const size_t size = min({flow->x.remaining_outbound_capacity(),
+                                         scenario.transfer_bytes - flow->written,
+                                         data.size() - offset});
+                flow->written += flow->x.write(data.substr(offset, size));
+                if (flow->written == scenario.transfer_bytes) {
+                    flow->x.end_input_stream();
+                }
+            }
+
+            result.segments += flow->round();
+
+            ByteStream &inbound = flow->y.inbound_stream();
+            const BufferViewList views = inbound.peek_views(inbound.buffer_size());
+            for (const auto &view : views.views()) {
+                for (size_t done = 0; done < view.size();) {
+                    const size_t offset = (flow->received + done) % data.size();
+                    const size_t size = min(view.size() - done, data.size() - offset);
+                    if (memcmp(view.data() + done, data.data() + offset, size) != 0) {
+                        throw runtime_error(scenario.name + ": received the wrong bytes");
+                    }
+                    done += size;
+                }
+                flow->received += view.size();
+            }
+            inbound.pop_output(views.size());
+            finished += inbound.eof();
+        }
+        result.virtual_ms++;
+    }
+    result.wall_ns = duration_cast<nanoseconds>(steady_clock::now() - first_time).count();
+    result.allocations = allocation_count.load() - first_allocations;
+
+    for (const auto &flow : flows) {
+        if (flow->received != scenario.transfer_bytes) {
+            throw runtime_error(scenario.name + ": received " + to_string(flow->received) + " bytes");
+        }
+        result.bytes += flow->received;
+    }
+    shut_down(flows);
+    return result;
+}
+
+//! \details On each connection, x sends a request of message_size bytes; once y has taken all of it, y sends
+//! a response of the same size; once x has taken that, the exchange is over and the next begins. Messages are
+//! written as the send window allows and taken as they arrive, so they can be larger than the window. The
+//! connections' exchanges are interleaved round by round.
+static Result run_request_response(const Scenario &scenario) {
+    vector<unique_ptr<Flow>> flows;
+    for (size_t i = 0; i < scenario.connections; i++) {
+        flows.push_back(make_unique<Flow>(scenario, 2 * i + 1));
+    }
+    const string message(scenario.message_size, 'm');
+
+    struct Exchange {
+        size_t done{0};          //!< Exchanges finished
+        bool responding{false};  //!< Has y taken the whole request?
+        size_t written{0};       //!< Bytes of the current message written by its sender
+        size_t taken{0};         //!< Bytes of the current message taken by its receiver
+        steady_clock::time_point started{};
+        uint64_t started_ms{0};
+    };
+    vector<Exchange> exchanges(flows.size());
+
+    Result result;
+    const uint64_t first_allocations = allocation_count.load();
+    const auto first_time = steady_clock::now();
+    for (auto &exchange : exchanges) {
+        exchange.started = first_time;
+    }
+    size_t finished = 0;
+    while (finished < flows.size()) {
+        for (size_t i = 0; i < flows.size(); i++) {
+            Flow &flow = *flows[i];
+            Exchange &exchange = exchanges[i];
+            if (exchange.done == scenario.messages) {
+                continue;
+            }
+            TCPConnection &sender = exchange.responding ? flow.y : flow.x;
+            if (exchange.written < scenario.message_size) {
+                exchange.written += sender.write(message.substr(exchange.written));
+            }
+
+            result.segments += flow.round();
+
+            ByteStream &inbound = (exchange.responding ? flow.x : flow.y).inbound_stream();
+            const size_t size = min(inbound.buffer_size(), scenario.message_size - exchange.taken);
+            inbound.pop_output(size);
+            exchange.taken += size;
+            if (exchange.taken < scenario.message_size) {
+                continue;
+            }
+            result.bytes += scenario.message_size;
+            exchange.written = exchange.taken = 0;
+            if (not exchange.responding) {
+                exchange.responding = true;
+                continue;
+            }
+            result.latency_ns.push_back(duration_cast<nanoseconds>(steady_clock::now() - exchange.started).count());
+            result.latency_ms.push_back(result.virtual_ms + 1 - exchange.started_ms);
+            exchange.responding = false;
+            exchange.started = steady_clock::now();
+            exchange.started_ms = result.virtual_ms + 1;
+            finished += ++exchange.done == scenario.messages;
+        }
+        result.virtual_ms++;
+    }
+    result.wall_ns = duration_cast<nanoseconds>(steady_clock::now() - first_time).count();
+    result.allocations = allocation_count.load() - first_allocations;
+
+    for (auto &flow : flows) {
+        flow->x.end_input_stream();
+        flow->y.end_input_stream();
+    }
+    shut_down(flows);
+    return result;
+}
+
+static vector<Scenario> default_scenarios() {
+    constexpr size_t MB = 1024 * 1024;
+    vector<Scenario> ret;
+    const auto bulk = [&](const string &name, const size_t transfer_bytes) -> Scenario & {
+        ret.push_back({});
+        ret.back().name = name;
+        ret.back().transfer_bytes = transfer_bytes;
+        return ret.back();
+    };
+    const auto request_response = [&](const string &name, const size_t message_size) -> Scenario & {
+        ret.push_back({});
+        ret.back().name = name;
+        ret.back().message_size = message_size;
+        ret.back().messages = 5000;
+        return ret.back();
+    };
+
+    bulk("bulk", 256 * MB);
+    bulk("bulk_loss_0.1pct", 64 * MB).loss_rate = 0.001;
+    bulk("bulk_loss_1pct", 64 * MB).loss_rate = 0.01;
+    bulk("bulk_reorder_depth_3", 64 * MB).reorder_depth = 3;
+    bulk("bulk_reorder_depth_20", 64 * MB).reorder_depth = 20;
+    bulk("bulk_duplicate_1pct", 64 * MB).duplicate_rate = 0.01;
+    bulk("bulk_mss_536", 64 * MB).mss = 536;
+    bulk("bulk_mss_1460", 64 * MB).mss = 1460;
+    bulk("bulk_window_16k", 64 * MB).window = 16 * 1024;
+    bulk("bulk_window_1m", 256 * MB).window = MB;
+    bulk("bulk_64_connections", 4 * MB).connections = 64;
+    bulk("bulk_1024_connections", 256 * 1024).connections = 1024;
+    request_response("rr_64b", 64);
+    request_response("rr_4k", 4096);
+    request_response("rr_64k", 64 * 1024).messages = 500;
+    request_response("rr_64b_loss_1pct", 64).loss_rate = 0.01;
+    request_response("rr_64b_64_connections", 64).connections = 64;
+    ret.back().messages = 200;
+    return ret;
+}
+
+static void print_table_header() {
+    cout << left << setw(24) << "scenario" << right << setw(10) << "Gbit/s" << setw(12) << "virtual ms" << setw(12)
+         << "seg/KB" << setw(12) << "alloc/seg" << setw(12) << "p50 us" << setw(12) << "p99 us" << setw(12)
+         << "p99 ms (v)"
+         << "\n";
+}
+
+static void print_table_row(const Scenario &scenario, const Result &result) {
+    cout << fixed << left << setw(24) << scenario.name << right << setprecision(3) << setw(10)
+         << result.gigabits_per_second() << setw(12) << result.virtual_ms << setprecision(3) << setw(12)
+         << result.segments_per_byte() * 1024 << setprecision(2) << setw(12) << result.allocations_per_segment();
+    if (scenario.request_response()) {
+        cout << setprecision(2) << setw(12) << percentile(result.latency_ns, 50) / 1000.0 << setw(12)
+             << percentile(result.latency_ns, 99) / 1000.0 << setw(12) << percentile(result.latency_ms, 99);
+    }
+    cout << "\n";
+}
+
+//! One JSON object per scenario, with its parameters and results
+static void print_json(const vector<pair<Scenario, Result>> &results) {
+    cout << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &[scenario, result] = results[i];
+        cout << setprecision(6) << defaultfloat;
+        cout << "  {\"scenario\": \"" << scenario.name << "\", \"connections\": " << scenario.connections
+             << ", \"transfer_bytes\": " << scenario.transfer_bytes << ", \"message_size\": " << scenario.message_size
+             << ", \"messages\": " << scenario.messages << ", \"mss\": " << scenario.mss
+             << ", \"window\": " << scenario.window << ", \"loss_rate\": " << scenario.loss_rate
+             << ", \"duplicate_rate\": " << scenario.duplicate_rate << ", \"reorder_depth\": " << scenario.reorder_depth
+             << ",\n   \"bytes\": " << result.bytes << ", \"segments\": " << result.segments
+             << ", \"allocations\": " << result.allocations << ", \"wall_ns\": " << result.wall_ns
+             << ", \"virtual_ms\": " << result.virtual_ms << ", \"throughput_gbps\": " << result.gigabits_per_second()
+             << ", \"segments_per_byte\": " << result.segments_per_byte()
+             << ", \"allocations_per_segment\": " << result.allocations_per_segment();
+        if (scenario.request_response()) {
+            cout << ",\n   \"latency_ns_p50\": " << percentile(result.latency_ns, 50)
+                 << ", \"latency_ns_p99\": " << percentile(result.latency_ns, 99)
+                 << ", \"latency_ms_p50\": " << percentile(result.latency_ms, 50)
+                 << ", \"latency_ms_p99\": " << percentile(result.latency_ms, 99);
+        }
+        cout << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "]\n";
+}
+
+static void show_usage(const char *argv0) {
+    cerr << "Usage: " << argv0 << " [--json] [--list] [scenario...]\n\n"
+         << "   Runs the named scenarios (default: all) between pairs of in-process TCPConnections, and reports\n"
+         << "   throughput (CPU-limited, wall clock), virtual time, segments per KB delivered, operator new calls\n"
+         << "   per segment, and for request/response scenarios the p50/p99 wall-clock and p99 virtual latency\n"
+         << "   per exchange. With --json, prints one object per scenario instead, for comparing runs.\n";
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        bool json = false;
+        bool list = false;
+        vector<string> names;
+        for (int i = 1; i < argc; i++) {
+            const string arg = argv[i];
+            if (arg == "--json") {
+                json = true;
+            } else if (arg == "--list") {
+                list = true;
+            } else if (arg == "-h" or arg == "--help" or arg.rfind("-", 0) == 0) {
+                show_usage(argv[0]);
+                return arg[1] == 'h' or arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+            } else {
+                names.push_back(arg);
+            }
+        }
+
+        const vector<Scenario> all = default_scenarios();
+        if (list) {
+            for (const auto &scenario : all) {
+                cout << scenario.name << "\n";
+            }
+            return EXIT_SUCCESS;
+        }
+        vector<Scenario> scenarios;
+        for (const auto &scenario : all) {
+            if (names.empty() or find(names.begin(), names.end(), scenario.name) != names.end()) {
+                scenarios.push_back(scenario);
+            }
+        }
+        for (const auto &name : names) {
+            if (none_of(all.begin(), all.end(), [&](const Scenario &scenario) { return scenario.name == name; })) {
+                throw runtime_error("unknown scenario \"" + name + "\" (see --list)");
+            }
+        }
+
+        vector<pair<Scenario, Result>> results;
+        if (not json) {
+            print_table_header();
+        }
+        for (const auto &scenario : scenarios) {
+            results.emplace_back(
+                scenario, scenario.request_response() ? run_request_response(scenario) : run_bulk(scenario));
+            if (not json) {
+                print_table_row(scenario, results.back().second);
+            }
+        }
+        if (json) {
+            print_json(results);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <string>
 #include <tuple>
@@ -30,9 +31,27 @@ static void show_usage(const char *argv0, const char *msg) {
          << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
          << "\n\n"
 
+         << "   -m <mss>        Send segments of at most <mss> payload bytes    " << TCPConfig::MAX_PAYLOAD_SIZE
+         << "\n\n"
+
+         << "   -S              Offer window scaling (on if <winsz> > 65535)    (off)\n\n"
+
+         << "   -c <algo>       Congestion control: none, reno or cubic         none\n\n"
+
+         << "   -R              Adapt the RTO to measured round-trip times      (off)\n"
+         << "   -T              Offer the timestamps option                     (off)\n"
+         << "   -A              Offer selective acknowledgments (SACK)          (off)\n"
+         << "   -D              Delay ACKs (every second segment, or "
+         << TCPConfig::ACK_DELAY_DFLT << " ms)  (off)\n"
+         << "   -N              Coalesce small writes (Nagle's algorithm)       (off)\n\n"
+
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-         << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+         << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+         << "   -G              Send and receive 64 KB super-segments (GSO)     (off)\n\n"
+
+         << "   -r              Pass data to the TCP thread through in-process  (socketpair)\n"
+         << "                   rings instead of a socketpair\n\n"
 
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -52,10 +71,12 @@ static void check_argc(int argc, char **argv, int curr, const char *err) {
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char **argv) {
+static tuple<TCPConfig, FdAdapterConfig, bool, char *, bool, bool> get_config(int argc, char **argv) {
     TCPConfig c_fsm{};
     FdAdapterConfig c_filt{};
     char *tundev = nullptr;
+    bool gso = false;
+    bool rings = false;
 
     int curr = 1;
     bool listen = false;
@@ -81,8 +102,52 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
         } else if (strncmp("-w", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -w requires one argument.");
             c_fsm.recv_capacity = strtol(argv[curr + 1], nullptr, 0);
+            c_fsm.window_scaling |= c_fsm.recv_capacity > numeric_limits<uint16_t>::max();
+            curr += 2;
+
+        } else if (strncmp("-m", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -m requires one argument.");
+            c_fsm.mss = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-S", argv[curr], 3) == 0) {
+            c_fsm.window_scaling = true;
+            curr += 1;
+
+        } else if (strncmp("-c", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -c requires one argument.");
+            if (strcmp("reno", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::Reno;
+            } else if (strcmp("cubic", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::Cubic;
+            } else if (strcmp("none", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::None;
+            } else {
+                show_usage(argv[0], "ERROR: -c must be none, reno or cubic.");
+                exit(1);
+            }
+            curr += 2;
+
+        } else if (strncmp("-R", argv[curr], 3) == 0) {
+            c_fsm.adaptive_rto = true;
+            curr += 1;
+
+        } else if (strncmp("-T", argv[curr], 3) == 0) {
+            c_fsm.timestamps = true;
+            curr += 1;
+
+        } else if (strncmp("-A", argv[curr], 3) == 0) {
+            c_fsm.sack = true;
+            curr += 1;
+
+        } else if (strncmp("-D", argv[curr], 3) == 0) {
+            c_fsm.delayed_ack = true;
+            curr += 1;
+
+        } else if (strncmp("-N", argv[curr], 3) == 0) {
+            c_fsm.nagle = true;
+            curr += 1;
+
         } else if (strncmp("-t", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -t requires one argument.");
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
@@ -93,6 +158,14 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
             tundev = argv[curr + 1];
             curr += 2;
 
+        } else if (strncmp("-G", argv[curr], 3) == 0) {
+            gso = true;
+            curr += 1;
+
+        } else if (strncmp("-r", argv[curr], 3) == 0) {
+            rings = true;
+            curr += 1;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -131,7 +204,7 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
         c_filt.source = {source_address, source_port};
     }
 
-    return make_tuple(c_fsm, c_filt, listen, tundev);
+    return make_tuple(c_fsm, c_filt, listen, tundev, gso, rings);
 }
 
 int main(int argc, char **argv) {
@@ -141,9 +214,12 @@ int main(int argc, char **argv) {
             return EXIT_FAILURE;
         }
 
-        auto [c_fsm, c_filt, listen, tun_dev_name] = get_config(argc, argv);
-        LossyTCPOverIPv4SpongeSocket tcp_socket(LossyTCPOverIPv4OverTunFdAdapter(
-            TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name))));
+        auto [c_fsm, c_filt, listen, tun_dev_name, gso, rings] = get_config(argc, argv);
+        LossyTCPOverIPv4SpongeSocket tcp_socket(
+            LossyTCPOverIPv4OverTunFdAdapter(
+                TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, gso))),
+            rings ? LossyTCPOverIPv4SpongeSocket::Transport::SPSCRing
+                  : LossyTCPOverIPv4SpongeSocket::Transport::SocketPair);
 
         if (listen) {
             tcp_socket.listen_and_accept(c_fsm, c_filt);
@@ -151,7 +227,11 @@ int main(int argc, char **argv) {
             tcp_socket.connect(c_fsm, c_filt);
         }
 
-        bidirectional_stream_copy(tcp_socket);
+        if (rings) {
+            bidirectional_stream_copy(tcp_socket.outbound_ring(), tcp_socket.inbound_ring());
+        } else {
+            bidirectional_stream_copy(tcp_socket);
+        }
         tcp_socket.wait_until_closed();
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
@@ -0,0 +1,180 @@
+#include "sharded_tcp_stack.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t server_port = 80;
+
+//! Connections opened by each client thread
+constexpr size_t connections_per_client = 8;
+
+//! Longest a measurement may take
+constexpr uint64_t deadline_ms = 120000;
+
+static TCPConfig benchmark_config() {
+    TCPConfig config;
+    config.recv_capacity = config.send_capacity = 256 * 1024;
+    config.window_scaling = true;
+    config.congestion_control = TCPConfig::CongestionControl::Reno;  // the UDP socket buffers can overflow
+    config.adaptive_rto = true;
+    config.sack = true;
+    config.rt_timeout = 50;  // short linger after close
+    return config;
+}
+
+//! \details Each client thread has a TCPStack of its own, and sends `bytes_per_connection` on each of its
+//! connections and then closes them.
+static void run_client(const Address &server, const size_t bytes_per_connection, exception_ptr &error) {
+    try {
+        UDPSocket socket;
+        socket.bind(Address{"127.0.0.1", 0});
+        TCPStack stack{move(socket), benchmark_config()};
+
+        vector<TCPStack::Handle> handles;
+        vector<size_t> sent(connections_per_client, 0);
+        for (size_t i = 0; i < connections_per_client; i++) {
+            handles.push_back(stack.connect(server, server_port));
+        }
+
+        const string chunk(64 * 1024, 'x');
+        const uint64_t deadline = timestamp_ms() + deadline_ms;
+        while (any_of(handles.begin(), handles.end(), [](const auto &handle) { return handle.active(); })) {
+            if (timestamp_ms() > deadline) {
+                throw runtime_error("client timed out");
+            }
+            stack.wait_next_event(1);
+            for (size_t i = 0; i < handles.size(); i++) {
+                while (sent[i] < bytes_per_connection and handles[i].remaining_outbound_capacity() > 0) {
+                    const size_t remaining = bytes_per_connection - sent[i];
+                    sent[i] += handles[i].write(remaining >= chunk.size() ? chunk : chunk.substr(0, remaining));
+                    if (sent[i] == bytes_per_connection) {
+                        handles[i].end_input_stream();
+                    }
+                }
+                handles[i].read(handles[i].inbound_stream().buffer_size());
+            }
+        }
+
+        // once the handles are gone, the connections are forgotten after they linger
+        handles.clear();
+        while (stack.connection_count()) {
+            stack.wait_next_event(10);
+        }
+    } catch (...) {
+        error = current_exception();
+    }
+}
+
+//! \details The server has `workers` workers, and as many client threads send to it, over loopback UDP.
+//! Throughput is measured from the first connect() until the workers have received every byte.
+static void scaling_loop(const size_t workers, const size_t bytes_per_run) {
+    const size_t bytes_per_connection = bytes_per_run / (workers * connections_per_client);
+    const uint64_t total = bytes_per_connection * workers * connections_per_client;
+
+    // used by each worker's thread (and declared first, to outlive the threads)
+    struct Served {
+        TCPStack::Handle handle;
+        bool ended;
+    };
+    vector<vector<Served>> served(workers);
+    vector<atomic<uint64_t>> received(workers);
+
+    ShardedTCPStack server{Address{"127.0.0.1", 0}, workers, benchmark_config()};
+    server.listen(server_port);
+    server.start([&](TCPStack &stack, const size_t index) {
+        auto &mine = served[index];
+        while (auto handle = stack.accept()) {
+            mine.push_back({*handle, false});
+        }
+        for (auto &connection : mine) {
+            const auto &inbound = connection.handle.inbound_stream();
+            received[index].fetch_add(connection.handle.read(inbound.buffer_size()).size(), memory_order_relaxed);
+            if (inbound.eof() and not connection.ended) {
+                connection.handle.end_input_stream();
+                connection.ended = true;
+            }
+        }
+        const auto finished = [](const Served &connection) { return not connection.handle.active(); };
+        mine.erase(remove_if(mine.begin(), mine.end(), finished), mine.end());
+    });
+
+    const auto sum = [&] {
+        uint64_t ret = 0;
+        for (const auto &count : received) {
+            ret += count.load(memory_order_relaxed);
+        }
+        return ret;
+    };
+
+    const auto first_time = steady_clock::now();
+    vector<exception_ptr> errors(workers);
+    vector<thread> clients;
+    for (size_t i = 0; i < workers; i++) {
+        clients.emplace_back(run_client, server.local_address(), bytes_per_connection, ref(errors[i]));
+    }
+    const uint64_t deadline = timestamp_ms() + deadline_ms;
+    while (sum() < total and timestamp_ms() < deadline) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    const double seconds = duration<double>(steady_clock::now() - first_time).count();
+
+    for (auto &client : clients) {
+        client.join();
+    }
+    server.stop();
+    for (auto &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+    if (sum() < total) {
+        throw runtime_error("timed out: " + to_string(sum()) + " of " + to_string(total) + " bytes received");
+    }
+
+    cout << fixed << setprecision(2);
+    cout << setw(2) << workers << " workers: " << setw(6) << total * 8 / seconds / 1e9 << " Gbit/s aggregate ("
+         << total / 1000000 << " MB in " << setprecision(3) << seconds << " s); share per worker:";
+    cout << setprecision(0);
+    for (const auto &count : received) {
+        cout << " " << 100.0 * double(count) / double(total) << "%";
+    }
+    cout << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        if (argc > 2) {
+            cerr << "Usage: " << argv[0] << " [megabytes-per-run]\n\n"
+                 << "   Measures aggregate TCP throughput into a ShardedTCPStack with 1, 2, 4, and 8 workers,\n"
+                 << "   each sent to by a client thread with " << connections_per_client
+                 << " connections over loopback UDP.\n";
+            return EXIT_FAILURE;
+        }
+        const size_t bytes_per_run = (argc == 2 ? stoul(argv[1]) : 64) * 1000000;
+
+        cout << thread::hardware_concurrency() << " CPUs available\n";
+        for (const size_t workers : {1, 2, 4, 8}) {
+            scaling_loop(workers, bytes_per_run);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
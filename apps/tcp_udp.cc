@@ -26,8 +26,25 @@ static void show_usage(const char *argv0, const char *msg) {
          << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
          << "\n\n"
 
+         << "   -m <mss>        Send segments of at most <mss> payload bytes    " << TCPConfig::MAX_PAYLOAD_SIZE
+         << "\n\n"
+
+         << "   -S              Offer window scaling (on if <winsz> > 65535)    (off)\n\n"
+
+         << "   -c <algo>       Congestion control: none, reno or cubic         none\n\n"
+
+         << "   -R              Adapt the RTO to measured round-trip times      (off)\n"
+         << "   -T              Offer the timestamps option                     (off)\n"
+         << "   -A              Offer selective acknowledgments (SACK)          (off)\n"
+         << "   -D              Delay ACKs (every second segment, or "
+         << TCPConfig::ACK_DELAY_DFLT << " ms)  (off)\n"
+         << "   -N              Coalesce small writes (Nagle's algorithm)       (off)\n\n"
+
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -r              Pass data to the TCP thread through in-process  (socketpair)\n"
+         << "                   rings instead of a socketpair\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
@@ -46,12 +63,13 @@ static void check_argc(int argc, char **argv, int curr, const char *err) {
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv) {
+static tuple<TCPConfig, FdAdapterConfig, bool, bool> get_config(int argc, char **argv) {
     TCPConfig c_fsm{};
     FdAdapterConfig c_filt{};
 
     int curr = 1;
     bool listen = false;
+    bool rings = false;
 
     while (argc - curr > 2) {
         if (strncmp("-l", argv[curr], 3) == 0) {
@@ -61,13 +79,61 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
         } else if (strncmp("-w", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -w requires one argument.");
             c_fsm.recv_capacity = strtol(argv[curr + 1], nullptr, 0);
+            c_fsm.window_scaling |= c_fsm.recv_capacity > numeric_limits<uint16_t>::max();
             curr += 2;
 
+        } else if (strncmp("-m", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -m requires one argument.");
+            c_fsm.mss = strtol(argv[curr + 1], nullptr, 0);
+            curr += 2;
+
+        } else if (strncmp("-S", argv[curr], 3) == 0) {
+            c_fsm.window_scaling = true;
+            curr += 1;
+
+        } else if (strncmp("-c", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -c requires one argument.");
+            if (strcmp("reno", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::Reno;
+            } else if (strcmp("cubic", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::Cubic;
+            } else if (strcmp("none", argv[curr + 1]) == 0) {
+                c_fsm.congestion_control = TCPConfig::CongestionControl::None;
+            } else {
+                show_usage(argv[0], "ERROR: -c must be none, reno or cubic.");
+                exit(1);
+            }
+            curr += 2;
+
+        } else if (strncmp("-R", argv[curr], 3) == 0) {
+            c_fsm.adaptive_rto = true;
+            curr += 1;
+
+        } else if (strncmp("-T", argv[curr], 3) == 0) {
+            c_fsm.timestamps = true;
+            curr += 1;
+
+        } else if (strncmp("-A", argv[curr], 3) == 0) {
+            c_fsm.sack = true;
+            curr += 1;
+
+        } else if (strncmp("-D", argv[curr], 3) == 0) {
+            c_fsm.delayed_ack = true;
+            curr += 1;
+
+        } else if (strncmp("-N", argv[curr], 3) == 0) {
+            c_fsm.nagle = true;
+            curr += 1;
+
         } else if (strncmp("-t", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -t requires one argument.");
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-r", argv[curr], 3) == 0) {
+            rings = true;
+            curr += 1;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -100,7 +166,7 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
         c_filt.destination = {argv[argc - 2], argv[argc - 1]};
     }
 
-    return make_tuple(c_fsm, c_filt, listen);
+    return make_tuple(c_fsm, c_filt, listen, rings);
 }
 
 int main(int argc, char **argv) {
@@ -111,21 +177,27 @@ int main(int argc, char **argv) {
         }
 
         // handle configuration and UDP setup from cmdline arguments
-        auto [c_fsm, c_filt, listen] = get_config(argc, argv);
+        auto [c_fsm, c_filt, listen, rings] = get_config(argc, argv);
 
         // build a TCP FSM on top of the UDP socket
         UDPSocket udp_sock;
         if (listen) {
             udp_sock.bind(c_filt.source);
         }
-        LossyTCPOverUDPSpongeSocket tcp_socket(LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))));
+        LossyTCPOverUDPSpongeSocket tcp_socket(LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))),
+                                               rings ? LossyTCPOverUDPSpongeSocket::Transport::SPSCRing
+                                                     : LossyTCPOverUDPSpongeSocket::Transport::SocketPair);
         if (listen) {
             tcp_socket.listen_and_accept(c_fsm, c_filt);
         } else {
             tcp_socket.connect(c_fsm, c_filt);
         }
 
-        bidirectional_stream_copy(tcp_socket);
+        if (rings) {
+            bidirectional_stream_copy(tcp_socket.outbound_ring(), tcp_socket.inbound_ring());
+        } else {
+            bidirectional_stream_copy(tcp_socket);
+        }
         tcp_socket.wait_until_closed();
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
@@ -0,0 +1,175 @@
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Datagrams sent per measurement
+constexpr size_t datagram_count = 200000;
+
+//! How the datagrams are written and read
+enum class Path {
+    Allocating,  //!< serialize() into a BufferList and write it; read() each packet into a new string
+    Ring         //!< writev() the headers and payload; read_many() into the ring and parse in place
+};
+
+static string path_name(const Path path) { return path == Path::Allocating ? "allocating" : "ring+writev"; }
+
+//! CPU time used by the calling thread, in nanoseconds
+static uint64_t thread_cpu_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//! Does `packet` hold a TCP segment for `port`?
+static bool is_benchmark_segment(const Buffer &packet, const uint16_t port) {
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(packet) != ParseResult::NoError or ip_dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return false;
+    }
+    TCPSegment seg;
+    return seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum()) == ParseResult::NoError and
+           seg.header().dport == port;
+}
+
+struct Result {
+    size_t packets{0};
+    double seconds{0};
+    uint64_t cpu_ns{0};
+};
+
+//! Write datagram_count datagrams carrying `payload_size` bytes into `tun`
+static Result send_datagrams(TunFD &tun, TCPOverIPv4Adapter &adapter, const Path path, const size_t payload_size) {
+    TCPSegment seg;
+    seg.header().ack = true;
+    seg.header().win = 1000;
+    seg.payload() = Buffer{string(payload_size, 'x')};
+    TCPOverIPv4Adapter::SerializedHeaders headers;
+
+    const uint64_t first_cpu = thread_cpu_ns();
+    const auto first_time = steady_clock::now();
+    for (size_t i = 0; i < datagram_count; i++) {
+        seg.header().seqno = WrappingInt32{static_cast<uint32_t>(i * payload_size)};
+        if (path == Path::Allocating) {
+            tun.write(adapter.wrap_tcp_in_ip(seg).serialize());
+        } else {
+            const auto iov = adapter.wrap_tcp_in_ip_into(seg, headers);
+            tun.write(iov.data(), iov.size());
+        }
+    }
+    const auto final_time = steady_clock::now();
+    return {datagram_count, duration<double>(final_time - first_time).count(), thread_cpu_ns() - first_cpu};
+}
+
+//! Read from `tun` until `done` is set and nothing has arrived for a while; counts the benchmark's segments
+static Result receive_datagrams(TunFD &tun, const Path path, const uint16_t port, const atomic<bool> &done) {
+    TunFD::RecvBatch batch{32, tun.max_packet_size()};
+    Result result;
+    uint64_t first_cpu = 0;
+    steady_clock::time_point first_time{}, last_time{};
+
+    const auto count = [&](const Buffer &packet) {
+        if (not is_benchmark_segment(packet, port)) {
+            return;
+        }
+        if (result.packets++ == 0) {
+            first_time = steady_clock::now();
+            first_cpu = thread_cpu_ns();
+        }
+        last_time = steady_clock::now();
+    };
+
+    pollfd pfd{tun.fd_num(), POLLIN, 0};
+    while (true) {
+        const int ready = SystemCall("poll", ::poll(&pfd, 1, 200));
+        if (ready == 0) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        if (path == Path::Allocating) {
+            count(Buffer{tun.read()});
+        } else {
+            tun.read_many(batch);
+            for (size_t i = 0; i < batch.size(); i++) {
+                count(batch.packet(i));
+            }
+        }
+    }
+    result.seconds = duration<double>(last_time - first_time).count();
+    result.cpu_ns = result.packets ? thread_cpu_ns() - first_cpu : 0;
+    return result;
+}
+
+static void print(const string &what, const Path path, const size_t payload_size, const Result &result) {
+    cout << fixed << setprecision(2);
+    cout << setw(7) << left << what << " " << setw(11) << path_name(path) << " " << setw(5) << right
+         << payload_size << " bytes: " << setw(8) << (result.seconds > 0 ? result.packets / result.seconds / 1e6 : 0)
+         << " Mpps, " << setw(7) << (result.packets ? double(result.cpu_ns) / result.packets : 0)
+         << " ns CPU/packet (" << result.packets << " packets)\n";
+}
+
+//! \details Datagrams are written into the first device, forwarded by the kernel, and read from the
+//! second. The reader stops after a quiet period, so CPU time includes a final poll timeout only once.
+static void tun_pair_loop(const string &send_dev,
+                          const string &recv_dev,
+                          const Path path,
+                          const size_t payload_size) {
+    TunFD sender{send_dev};
+    TunFD receiver{recv_dev};
+    receiver.set_blocking(false);
+
+    TCPOverIPv4Adapter adapter;
+    adapter.config_mut().source = {"169.254." + send_dev.substr(3) + ".9", 1234};
+    adapter.config_mut().destination = {"169.254." + recv_dev.substr(3) + ".9", 4321};
+
+    atomic<bool> done{false};
+    Result received;
+    thread reader([&] { received = receive_datagrams(receiver, path, 4321, done); });
+    const Result sent = send_datagrams(sender, adapter, path, payload_size);
+    done = true;
+    reader.join();
+
+    print("write", path, payload_size, sent);
+    print("read", path, payload_size, received);
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        if (argc != 1 and argc != 3) {
+            cerr << "Usage: " << argv[0] << " [send-tun recv-tun]\n\n"
+                 << "   Measures datagrams per second through a pair of TUN devices (default tun144 and tun145,\n"
+                 << "   as set up by tun.sh, which also enables the IP forwarding this needs).\n";
+            return EXIT_FAILURE;
+        }
+        const string send_dev = argc == 3 ? argv[1] : "tun144";
+        const string recv_dev = argc == 3 ? argv[2] : "tun145";
+
+        for (const size_t payload_size : {0, 1000}) {
+            for (const auto path : {Path::Allocating, Path::Ring}) {
+                tun_pair_loop(send_dev, recv_dev, path, payload_size);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
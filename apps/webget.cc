@@ -26,6 +26,8 @@ void get_URL(const string &host, const string &path)
     sc.connect(addr);
 
     // 往socket中写请求（服务器会从socket中读请求）
+    // 先塞住，几次小的写合并成一个seg发出去，而不是每次写一个seg
+    sc.cork();
     sc.write("GET ");
     sc.write(path);
     sc.write(" HTTP/1.1\r\n");
@@ -33,6 +35,7 @@ void get_URL(const string &host, const string &path)
     sc.write(host);
     sc.write(" \r\n");
     sc.write("Connection: close\r\n\r\n");
+    sc.uncork();
 
     // 服务器把消息写到socket中后，client从里面读，只要没读完就会继续（end of file）
     // 并将读到的信息打印出来
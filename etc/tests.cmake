@@ -7,6 +7,28 @@ add_test(NAME t_wrapping_ints_unwrap      COMMAND wrapping_integers_unwrap)
 add_test(NAME t_wrapping_ints_wrap        COMMAND wrapping_integers_wrap)
 add_test(NAME t_wrapping_ints_roundtrip   COMMAND wrapping_integers_roundtrip)
 
+add_test(NAME t_checksum_equivalence    COMMAND checksum_equivalence)
+add_test(NAME t_tcp_serialize_into      COMMAND tcp_serialize_into)
+add_test(NAME t_buffer_pool             COMMAND buffer_pool)
+add_test(NAME t_tun_batch               COMMAND tun_batch)
+add_test(NAME t_eventloop_backends      COMMAND eventloop_backends)
+add_test(NAME t_tcp_stack               COMMAND tcp_stack)
+add_test(NAME t_timer_wheel             COMMAND timer_wheel)
+add_test(NAME t_tcp_window_scaling      COMMAND tcp_window_scaling)
+add_test(NAME t_congestion_control      COMMAND congestion_control)
+add_test(NAME t_rtt_estimation          COMMAND rtt_estimation)
+add_test(NAME t_sack                    COMMAND sack)
+add_test(NAME t_delayed_ack             COMMAND delayed_ack)
+add_test(NAME t_nagle_cork              COMMAND nagle_cork)
+add_test(NAME t_window_update           COMMAND window_update)
+add_test(NAME t_datagram_batch          COMMAND datagram_batch)
+add_test(NAME t_gso                     COMMAND gso)
+add_test(NAME t_parser_equivalence      COMMAND parser_equivalence)
+add_test(NAME t_byte_stream_fd          COMMAND byte_stream_fd)
+add_test(NAME t_sharded_tcp_stack       COMMAND sharded_tcp_stack)
+add_test(NAME t_spsc_ring               COMMAND spsc_ring)
+add_test(NAME t_link_emulator           COMMAND link_emulator)
+
 add_test(NAME t_recv_connect         COMMAND recv_connect)
 add_test(NAME t_recv_transmit        COMMAND recv_transmit)
 add_test(NAME t_recv_window          COMMAND recv_window)
@@ -30,12 +52,14 @@ add_test(NAME t_strm_reassem_many        COMMAND fsm_stream_reassembler_many)
 add_test(NAME t_strm_reassem_overlapping COMMAND fsm_stream_reassembler_overlapping)
 add_test(NAME t_strm_reassem_win         COMMAND fsm_stream_reassembler_win)
 add_test(NAME t_strm_reassem_cap         COMMAND fsm_stream_reassembler_cap)
+add_test(NAME t_strm_reassem_buffers     COMMAND fsm_stream_reassembler_buffers)
 
 add_test(NAME t_byte_stream_construction COMMAND byte_stream_construction)
 add_test(NAME t_byte_stream_one_write    COMMAND byte_stream_one_write)
 add_test(NAME t_byte_stream_two_writes   COMMAND byte_stream_two_writes)
 add_test(NAME t_byte_stream_capacity     COMMAND byte_stream_capacity)
 add_test(NAME t_byte_stream_many_writes  COMMAND byte_stream_many_writes)
+add_test(NAME t_byte_stream_buffers      COMMAND byte_stream_buffers)
 
 add_test(NAME t_webget               COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh")
 
@@ -1,5 +1,8 @@
 #include "byte_stream.hh"
 
+#include <climits>
+#include <sys/uio.h>
+
 // Dummy implementation of a flow-controlled in-memory byte stream.
 
 // For Lab 0, please replace with a real implementation that passes the
@@ -16,37 +19,138 @@ ByteStream::ByteStream(const size_t capacity)
     : _buffer(), _capacity(capacity), _size(0), _nwritten(0), _nread(0), _input_ended(false) {}
 
 size_t ByteStream::write(const string &data) {
-    // 获取管道剩余容量
-    size_t remain_capacity = remaining_capacity();
-
-    // 若data的大小大于剩余容量，将其截断
-    string data_to_write = data.substr(0, remain_capacity);
+    // 若data的大小大于剩余容量，将其截断，只拷贝能写进去的部分
+    const size_t len_to_write = min(data.size(), remaining_capacity());
+    if (len_to_write == 0) {
+        return 0;
+    }
+    return write(Buffer(data.substr(0, len_to_write)));
+}
 
-    // 将data写入管道
-    for (auto chr : data_to_write) {
-        _buffer.emplace_back(chr);
+size_t ByteStream::write(Buffer &&data) {
+    // 若data的大小大于剩余容量，丢掉超出的后缀（不拷贝）
+    const size_t len_to_write = min(data.size(), remaining_capacity());
+    if (len_to_write == 0) {
+        return 0;
     }
+    data.remove_suffix(data.size() - len_to_write);
+
+    // 整块挂到管道尾部
+    _buffer.emplace_back(move(data));
 
     // 累加管道数据量以及总的写进去的字符数
-    _nwritten += data_to_write.size();
-    _size += data_to_write.size();
+    _nwritten += len_to_write;
+    _size += len_to_write;
 
     // 返回该次写进去的字符数
-    return data_to_write.size();
+    return len_to_write;
+}
+
+//! \param[in] fd is the descriptor to read from
+//! \param[in] limit is the maximum number of bytes to read (besides the remaining capacity)
+size_t ByteStream::read_from(FileDescriptor &fd, const size_t limit) {
+    // 每块的大小；一次readv最多读IOV_MAX块
+    constexpr size_t CHUNK_SIZE = 16384;
+    // 比这还短的最后一块拷贝成一个刚好大小的string，免得几个字节占住一整块
+    constexpr size_t SHORT_CHUNK = CHUNK_SIZE / 4;
+
+    const size_t len_to_read = min(limit, remaining_capacity());
+    if (len_to_read == 0) {
+        return 0;
+    }
+
+    // 准备足够的块（优先用空闲块），最后一块只读到len_to_read为止
+    const size_t nchunks = min((len_to_read + CHUNK_SIZE - 1) / CHUNK_SIZE, size_t(IOV_MAX));
+    vector<string> chunks;
+    chunks.reserve(nchunks);
+    vector<iovec> iov;
+    iov.reserve(nchunks);
+    size_t len_left = len_to_read;
+    for (size_t i = 0; i < nchunks; i++) {
+        if (_spare_chunks.empty()) {
+            chunks.emplace_back(CHUNK_SIZE, 0);
+        } else {
+            chunks.push_back(move(_spare_chunks.back()));
+            _spare_chunks.pop_back();
+        }
+        const size_t len = min(len_left, CHUNK_SIZE);
+        iov.push_back({chunks.back().data(), len});
+        len_left -= len;
+    }
+
+    // 内核直接把数据拷贝进这些块，这是每个字节唯一的一次拷贝
+    const size_t bytes_read = fd.read(iov.data(), iov.size());
+
+    // 读到数据的块整块挂到管道尾部，没读到的块留作空闲块
+    size_t len_to_write = bytes_read;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const size_t len = min(len_to_write, iov[i].iov_len);
+        len_to_write -= len;
+        if (len == 0) {
+            _spare_chunks.push_back(move(chunks[i]));
+        } else if (len < SHORT_CHUNK) {
+            write(Buffer(chunks[i].substr(0, len)));
+            _spare_chunks.push_back(move(chunks[i]));
+        } else {
+            chunks[i].resize(len);
+            write(Buffer(move(chunks[i])));
+        }
+    }
+
+    return bytes_read;
 }
 
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    // 获取管道中len个字符（len如果大于size的话，取size个）
-    return string(_buffer.begin(), _buffer.begin() + min(_size, len));
+    // 获取管道中len个字符（len如果大于size的话，取size个），逐块拼接
+    size_t len_to_peek = min(_size, len);
+    string ret;
+    ret.reserve(len_to_peek);
+    for (auto it = _buffer.begin(); len_to_peek > 0; ++it) {
+        const auto chunk = it->str().substr(0, len_to_peek);
+        ret.append(chunk);
+        len_to_peek -= chunk.size();
+    }
+    return ret;
+}
+
+//! \param[in] len bytes will be exposed from the output side of the buffer
+BufferViewList ByteStream::peek_views(const size_t len) const {
+    // 和peek_output一样，只是返回指向每个块的string_view，而不是拷贝出来
+    // 块数不超过IOV_MAX，保证结果可以直接交给writev
+    size_t len_to_peek = min(_size, len);
+    BufferViewList ret;
+    for (auto it = _buffer.begin(); len_to_peek > 0 and ret.views().size() < IOV_MAX; ++it) {
+        const auto chunk = it->str().substr(0, len_to_peek);
+        ret.append(chunk);
+        len_to_peek -= chunk.size();
+    }
+    return ret;
+}
+
+//! \param[in] fd is the descriptor to write to
+//! \param[in] limit is the maximum number of bytes to write
+size_t ByteStream::write_to(FileDescriptor &fd, const size_t limit) {
+    // 直接把管道里的块交给writev，写出去多少就弹出多少
+    const size_t bytes_written = fd.write(peek_views(limit), false);
+    pop_output(bytes_written);
+    return bytes_written;
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
 void ByteStream::pop_output(const size_t len) {
-    // 将管道前len个字符读出，并删掉
-    size_t len_to_pop = min(_size, len);
-    for (size_t i = 0; i < len_to_pop; ++i) {
-        _buffer.pop_front();
+    // 将管道前len个字符删掉：整块读完的直接弹出，最后一块只丢掉前缀
+    const size_t len_to_pop = min(_size, len);
+    size_t remaining = len_to_pop;
+    while (remaining > 0) {
+        Buffer &front = _buffer.front();
+        if (front.size() <= remaining) {
+            remaining -= front.size();
+            _buffer.pop_front();
+        } else {
+            front.remove_prefix(remaining);
+            remaining = 0;
+        }
     }
     // 累加总的读取量
     _nread += len_to_pop;
@@ -67,6 +171,19 @@ std::string ByteStream::read(const size_t len) {
     return ret;
 }
 
+//! \param[out] out receives the bytes, appended to whatever it already holds
+//! \param[in] len bytes will be popped
+// 和read一样，只是拷贝到调用者提供的string里（比如BufferPool的槽位），不用新分配内存
+void ByteStream::read(std::string &out, const size_t len) {
+    size_t len_to_read = min(_size, len);
+    for (auto it = _buffer.begin(); len_to_read > 0; ++it) {
+        const auto chunk = it->str().substr(0, len_to_read);
+        out.append(chunk);
+        len_to_read -= chunk.size();
+    }
+    pop_output(len);
+}
+
 // 当writer已经完成输入，调用该函数
 void ByteStream::end_input() { _input_ended = true; }
 
@@ -1,8 +1,13 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
 #include <deque>
+#include <limits>
 #include <string>
+#include <vector>
 
 //! \brief An in-order byte stream.
 
@@ -20,8 +25,11 @@ class ByteStream {
     // that's a sign that you probably want to keep exploring
     // different approaches.
 
-    // 管道
-    std::deque<char> _buffer;
+    // 管道：按写入顺序排列的Buffer块，写入时整块挂到队尾（Buffer引用计数，不拷贝字节），
+    // 读出时从队头整块弹出或者只丢掉块的前缀
+    std::deque<Buffer> _buffer;
+    // read_from用的空闲块：上次readv没有读到数据的块留着下次再用，不用每次重新分配
+    std::vector<std::string> _spare_chunks{};
     // 管道容量
     size_t _capacity;
     // 目前管道的数据量
@@ -48,6 +56,16 @@ class ByteStream {
     //! \returns the number of bytes accepted into the stream
     size_t write(const std::string &data);
 
+    //! Write a Buffer into the stream without copying its contents. Write as
+    //! much as will fit, and return how many bytes were written.
+    //! \returns the number of bytes accepted into the stream
+    size_t write(Buffer &&data);
+
+    //! Read from `fd` with one readv, straight into chunks that become the stream's storage.
+    //! Read as much as will fit (and at most `limit` bytes), and return how many bytes were read.
+    //! \returns the number of bytes read into the stream (0 at EOF)
+    size_t read_from(FileDescriptor &fd, const size_t limit = std::numeric_limits<size_t>::max());
+
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
 
@@ -65,6 +83,16 @@ class ByteStream {
     //! \returns a string
     std::string peek_output(const size_t len) const;
 
+    //! Peek at next "len" bytes of the stream without copying them
+    //! \returns views onto the stream's internal storage, valid until the next call to pop_output or read
+    //! \note May cover fewer than "len" bytes if the data is spread across more than `IOV_MAX` chunks
+    BufferViewList peek_views(const size_t len) const;
+
+    //! Write the next "limit" bytes of the stream to `fd` with one writev, straight from the stream's
+    //! storage, and pop what was written.
+    //! \returns the number of bytes written, which may be fewer than "limit" (e.g. if `fd` is non-blocking)
+    size_t write_to(FileDescriptor &fd, const size_t limit = std::numeric_limits<size_t>::max());
+
     //! Remove bytes from the buffer
     void pop_output(const size_t len);
 
@@ -72,6 +100,9 @@ class ByteStream {
     //! \returns a string
     std::string read(const size_t len);
 
+    //! Read the next "len" bytes of the stream, appending them to `out` (caller can allocate storage)
+    void read(std::string &out, const size_t len);
+
     //! \returns `true` if the stream input has ended
     bool input_ended() const;
 
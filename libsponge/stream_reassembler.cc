@@ -13,73 +13,152 @@ void DUMMY_CODE(Targs &&.../* unused */) {}
 using namespace std;
 
 StreamReassembler::StreamReassembler(const size_t capacity)
-    : _output(capacity), _capacity(capacity), buffer(capacity, 0), bit_map(capacity, 0), rpos(0), _unassembled_bytes(0), eof_index(-1) {}
+    : _output(capacity), _capacity(capacity), _unassembled_bytes(0), eof_index(-1) {}
 
 //! \details This function accepts a substring (aka a segment) of bytes,
 //! possibly out-of-order, from the logical stream, and assembles any newly
 //! contiguous substrings and writes them into the output stream in order.
 void StreamReassembler::push_substring(const string &data, const size_t index, const bool eof)
 {
-    // 传过来的data可能有旧的部分（左端小于rpos）也可能有越界的一部分（右端超过滑窗右端即rpos+_capacity）
-    size_t start_index = max(rpos, index);
-    size_t end_index = min(rpos + _capacity, index + data.size());
+    // 传过来的data可能有旧的部分（左端小于窗口左端）也可能有越界的一部分（右端超过窗口右端）
+    // 只把落在窗口内的部分拷贝进Buffer，其余部分反正会被丢掉
+    const uint64_t start_index = min(max(index, _first_unassembled()), index + data.size());
+    const uint64_t end_index = max(min(index + data.size(), _first_unacceptable()), start_index);
+    if (end_index > start_index)
+    {
+        _push_buffer(Buffer(data.substr(start_index - index, end_index - start_index)), start_index);
+    }
+
+    // 这里的eof_index不能初始化为0，否则以下两者情况会出错：
+    // 1、第一组来的是一个空串，index=0，且不是eof，此时不会往output里写任何东西，但最后的判断会成立，
+    // 因为此时bytes_written()=0，等于初始化的0，然后直接结束
+    // 2、第一组来的index为非0，且不是eof，此时没有凑够从窗口左端开始的连续的一段，不会往output写任何东西
+    // bytes_written()还是0，等于eof_index，然后结束
+    // 解决方法：eof_index初始化为非0的数即可，可初始化为-1
+    if (eof)
+    {
+        // 如果当前数据为于原数据的最后一组，计算滑动窗口右端终点，或者总数据量
+        // ps:后面可能还有前面组数据到来（因为是乱序的，所以此时不能end_input()）
+        eof_index = index + data.size();
+    }
+    _check_eof();
+}
+
+void StreamReassembler::push_substring(Buffer data, const uint64_t index, const bool eof)
+{
+    // eof_index要按截断之前的data计算
+    if (eof)
+    {
+        eof_index = index + data.size();
+    }
+    _push_buffer(move(data), index);
+    _check_eof();
+}
 
-    // 将传过来的data按index放到滑动窗口buffer
-    for (size_t i = start_index; i < end_index; i++)
+void StreamReassembler::_push_buffer(Buffer data, uint64_t index)
+{
+    // 丢掉窗口左端之前（已经写进output）的部分
+    const uint64_t first_unassembled = _first_unassembled();
+    if (index < first_unassembled)
     {
-        // 由于用循环队列的形式实现滑动窗口，i对应滑动窗口的坐标为i%_capacity
-        const size_t bi = i % _capacity;
-        // 将data赋值到对应位置，buffer的某些位置可能已经被赋值过，即传来的data有重复部分
-        // 但没有关系，数组重复赋值没有影响，不过由于已经赋值过bit_map[bi] = 1，下面if判断不会
-        // 通过，不会累加_unassembled_bytes，符合逻辑
-        buffer[bi] = data[i - index];
-        if (bit_map[bi] == 0)
+        if (index + data.size() <= first_unassembled)
         {
-            bit_map[bi] = 1;
-            _unassembled_bytes++;
+            return;
         }
+        data.remove_prefix(first_unassembled - index);
+        index = first_unassembled;
+    }
+
+    // 丢掉窗口右端之后（放不下）的部分
+    const uint64_t first_unacceptable = _first_unacceptable();
+    if (index >= first_unacceptable)
+    {
+        return;
+    }
+    if (index + data.size() > first_unacceptable)
+    {
+        data.remove_suffix(index + data.size() - first_unacceptable);
+    }
+    if (data.size() == 0)
+    {
+        return;
     }
 
-    // 获取滑动窗口前面连续一段已经排好序的数据的最右端
-    size_t avail_end = rpos;
-    while (bit_map[avail_end % _capacity] && avail_end < rpos + _capacity)
-        avail_end++;
+    const uint64_t end_index = index + data.size();
 
-    // avail_end大于滑动窗口左端，说明存在紧接着的排好序的数据
-    if (avail_end > rpos)
+    // data刚好接在output后面：直接写进output（窗口内的数据一定放得下），
+    // 再把_segments中被这段数据覆盖的部分去掉
+    if (index == first_unassembled)
     {
-        // 将这段数据搞出来，长度为avail_end - rpos
-        string data_submit(avail_end - rpos, 0);
-        for (size_t i = rpos; i < avail_end; i++)
+        _output.write(move(data));
+        while (!_segments.empty() && _segments.begin()->first < end_index)
         {
-            data_submit[i - rpos] = buffer[i % _capacity];
+            auto it = _segments.begin();
+            const uint64_t seg_end = it->first + it->second.size();
+            if (seg_end <= end_index)
+            {
+                // 整段都已经写进output
+                _unassembled_bytes -= it->second.size();
+                _segments.erase(it);
+            }
+            else
+            {
+                // 只有前缀被覆盖：去掉前缀后以新的起点重新放回
+                Buffer rest = move(it->second);
+                rest.remove_prefix(end_index - it->first);
+                _unassembled_bytes -= end_index - it->first;
+                _segments.erase(it);
+                _segments.emplace(end_index, move(rest));
+            }
         }
-        // 将这段数据写到output中，注意有可能output空间不够，不能全部写进去
-        // 此时只会写一部分，并且返回写了多少字节
-        size_t written_bytes = _output.write(data_submit);
-        for (size_t i = rpos; i < rpos + written_bytes; i++)
+        _drain_segments();
+        return;
+    }
+
+    // 否则把data中还没有被已有段覆盖的空隙部分放进_segments，每一块都是data的一个切片（共享同一份存储）
+    // cursor为下一个可能需要插入的位置，先跳过起点在index之前、但覆盖到index之后的那一段
+    uint64_t cursor = index;
+    auto it = _segments.upper_bound(index);
+    if (it != _segments.begin())
+    {
+        const auto prev = std::prev(it);
+        cursor = max(cursor, prev->first + prev->second.size());
+    }
+    while (cursor < end_index)
+    {
+        // 空隙的右端为下一段的起点（或者data的末尾）
+        const uint64_t gap_end = (it == _segments.end()) ? end_index : min(it->first, end_index);
+        if (cursor < gap_end)
+        {
+            Buffer piece = data;
+            piece.remove_prefix(cursor - index);
+            piece.remove_suffix(end_index - gap_end);
+            _unassembled_bytes += piece.size();
+            _segments.emplace_hint(it, cursor, move(piece));
+        }
+        if (it == _segments.end())
         {
-            // 将滑动窗口已经输出的前面的部分标记为置0
-            bit_map[i % _capacity] = 0;
+            break;
         }
-        // 更新滑动窗口的左端
-        rpos += written_bytes;
-        _unassembled_bytes -= written_bytes;
+        cursor = max(cursor, it->first + it->second.size());
+        ++it;
     }
+}
 
-    // 这里的eof_index不能初始化为0，否则以下两者情况会出错：
-    // 1、第一组来的是一个空串，index=0，且不是eof，此时前面的语句全部不会执行，不会往output里写任何东西
-    // 下面的if(eof)不会进去，但是最后一个判断会执行，因为此时bytes_written()=0，eof_index等于初始化的0
-    // 然后直接结束
-    // 2、第一组来的index为非0，且不是eof，此时没有凑够从滑窗左端开始的连续的一段，不会往output写任何东西
-    // bytes_written()还是0，等于eof_index，然后结束
-    // 解决方法：eof_index初始化为非0的数即可，可初始化为-1
-    if (eof)
+void StreamReassembler::_drain_segments()
+{
+    // 只要_segments的第一段刚好接在output后面，就把它写进output
+    while (!_segments.empty() && _segments.begin()->first == _first_unassembled())
     {
-        // 如果当前数据为于原数据的最后一组，计算滑动窗口右端终点，或者总数据量
-        // ps:后面可能还有前面组数据到来（因为是乱序的，所以此时不能end_input()）
-        eof_index = index + data.size();
+        auto it = _segments.begin();
+        _unassembled_bytes -= it->second.size();
+        _output.write(move(it->second));
+        _segments.erase(it);
     }
+}
+
+void StreamReassembler::_check_eof()
+{
     // 当写进output的总数据量=所有的数据量，此时才结束
     if (_output.bytes_written() == eof_index)
     {
@@ -89,4 +168,37 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
 
 size_t StreamReassembler::unassembled_bytes() const { return _unassembled_bytes; }
 
+vector<pair<uint64_t, uint64_t>> StreamReassembler::held_ranges(const size_t max_ranges,
+                                                                const uint64_t first_index) const
+{
+    vector<pair<uint64_t, uint64_t>> ranges;
+    if (max_ranges == 0)
+        return ranges;
+
+    // 包含first_index的那一段（向两边把首尾相接的段合并进来）放在最前面
+    auto it = _segments.upper_bound(first_index);
+    if (it != _segments.begin() && first_index < prev(it)->first + prev(it)->second.size())
+    {
+        auto left = prev(it);
+        while (left != _segments.begin() && prev(left)->first + prev(left)->second.size() == left->first)
+            --left;
+        auto right = prev(it);
+        while (next(right) != _segments.end() && right->first + right->second.size() == next(right)->first)
+            ++right;
+        ranges.emplace_back(left->first, right->first + right->second.size());
+    }
+
+    // 其余的段从小到大，相接的合并成一段
+    for (auto seg = _segments.begin(); seg != _segments.end() && ranges.size() < max_ranges;)
+    {
+        const uint64_t first = seg->first;
+        uint64_t last = seg->first + seg->second.size();
+        for (++seg; seg != _segments.end() && seg->first == last; ++seg)
+            last = seg->first + seg->second.size();
+        if (ranges.empty() || first != ranges.front().first)
+            ranges.emplace_back(first, last);
+    }
+    return ranges;
+}
+
 bool StreamReassembler::empty() const { return unassembled_bytes() == 0; }
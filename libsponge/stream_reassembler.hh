@@ -1,10 +1,13 @@
 #ifndef SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 #define SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 
 #include <cstdint>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 //! \brief A class that assembles a series of excerpts from a byte stream (possibly out of order,
@@ -22,17 +25,27 @@ private:
   // 可以防止treamReassembler过度利用空间
   size_t _capacity; //!< The maximum number of bytes
 
-  // buffer为定长数组，长度为_capacity，用循环队列的方式来模拟滑动窗口
-  std::string buffer;
-  // 标志循环队列buffer的每个位置有没有元素占用
-  std::vector<uint8_t> bit_map;
-  // 滑动窗口左端的下标
-  size_t rpos;
+  // 还没能写进output的乱序数据：key为该段第一个字节的index，value为该段数据
+  // 各段之间互不重叠，重叠部分只保留一份（对Buffer做remove_prefix/remove_suffix，不拷贝字节）
+  // 占用的内存只和实际持有的乱序数据成正比，与_capacity无关
+  std::map<uint64_t, Buffer> _segments{};
   // 滑动窗口中乱序的字节
   size_t _unassembled_bytes;
   // 滑动窗口右端的最终位置的下一个位置，或者说是data的总字节数
   size_t eof_index;
 
+  // 把data（第一个字节的编号为index）中落在窗口内、且还没有收到过的部分放进_segments或直接写进output
+  void _push_buffer(Buffer data, uint64_t index);
+  // 把_segments中已经和output接上的段依次写进output
+  void _drain_segments();
+  // 所有数据都已写进output时，结束output的输入
+  void _check_eof();
+
+  // 窗口左端：下一个要写进output的字节编号
+  uint64_t _first_unassembled() const { return _output.bytes_written(); }
+  // 窗口右端的下一个位置：超出该位置的字节放不下，直接丢掉
+  uint64_t _first_unacceptable() const { return _output.bytes_read() + _capacity; }
+
 public:
   //! \brief Construct a `StreamReassembler` that will store up to `capacity` bytes.
   //! \note This capacity limits both the bytes that have been reassembled,
@@ -49,6 +62,10 @@ public:
   //! \param eof the last byte of `data` will be the last byte in the entire stream
   void push_substring(const std::string &data, const uint64_t index, const bool eof);
 
+  //! \brief Receive a substring held in a Buffer, keeping a reference to it rather than copying it.
+  //! \details Same semantics as the std::string overload.
+  void push_substring(Buffer data, const uint64_t index, const bool eof);
+
   //! \name Access the reassembled byte stream
   //!@{
   const ByteStream &stream_out() const { return _output; }
@@ -64,6 +81,12 @@ public:
   //! \brief Is the internal state empty (other than the output stream)?
   //! \returns `true` if no substrings are waiting to be assembled
   bool empty() const;
+
+  //! \brief Ranges [first, last) of indices that are stored but not yet reassembled, with touching
+  //! substrings merged (used for selective acknowledgments)
+  //! \param max_ranges is the most ranges to return
+  //! \param first_index if it falls in a range, that range is returned first; the others follow in order
+  std::vector<std::pair<uint64_t, uint64_t>> held_ranges(const size_t max_ranges, const uint64_t first_index) const;
 };
 
 #endif // SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
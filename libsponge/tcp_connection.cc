@@ -1,6 +1,9 @@
 #include "tcp_connection.hh"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 // Dummy implementation of a TCP connection
 
@@ -12,6 +15,23 @@ void DUMMY_CODE(Targs &&.../* unused */) {}
 
 using namespace std;
 
+// 窗口扩大选项的移位数：让容量右移之后能放进16位的window字段，最多MAX_WINDOW_SHIFT位
+static uint8_t window_shift_for(const size_t capacity)
+{
+    uint8_t shift = 0;
+    while (shift < TCPConfig::MAX_WINDOW_SHIFT && (capacity >> shift) > numeric_limits<uint16_t>::max())
+        ++shift;
+    return shift;
+}
+
+// mss不能为0（发送池按mss切槽位，sender每个seg也至少要带一个字节），也不能超过SYN里16位的MSS选项
+const TCPConfig &TCPConnection::checked_config(const TCPConfig &cfg)
+{
+    if (cfg.mss == 0 || cfg.mss > numeric_limits<uint16_t>::max())
+        throw runtime_error("TCPConnection: mss must be between 1 and 65535, not " + to_string(cfg.mss));
+    return cfg;
+}
+
 // sender的stream用来存放准备发送出去的数据，不断从stream中读数据，存到sender的发送队列_segments_out中
 size_t TCPConnection::remaining_outbound_capacity() const { return _sender.stream_in().remaining_capacity(); }
 
@@ -35,6 +55,15 @@ void TCPConnection::segment_received(const TCPSegment &seg)
     // 新来了一个seg，到该seg已过了时间0
     _time_since_last_segment_received = 0;
 
+    // 对方的第一个SYN，记下它带的选项
+    if (seg.header().syn && !_receiver.ackno().has_value())
+        syn_options_received(seg.header());
+
+    // 按序到达的seg（序号不超过我方已经确认到的位置）带的TSval，是之后要回显给对方的（RFC 7323 4.3）
+    if (_timestamps && seg.header().timestamps.has_value() && _receiver.ackno().has_value() &&
+        seg.header().seqno - _receiver.ackno().value() <= 0)
+        _ts_recent = seg.header().timestamps->value;
+
     // STATE:CLOSED（针对server）
     //  一开始两个endpoint处于closed状态
     //  1、receiver的ackno会由于isn没有赋值而返回空（isn只有当对方发送第一个seg来时，才会
@@ -92,16 +121,35 @@ void TCPConnection::segment_received(const TCPSegment &seg)
 
     // 若此时连接已经建立，发送了syn过去，也收到了对方的syn，则按下方逻辑处理seg
 
+    // 交给receiver之前先看看这个seg是不是按序到达的，以及之前有没有空洞（延迟ack要用）
+    const bool in_order = _receiver.ackno().has_value() && seg.header().seqno == _receiver.ackno().value();
+    const bool had_gap = _receiver.unassembled_bytes() > 0;
+
     _receiver.segment_received(seg); // 将seg交给receiver
 
     // 然后将ackno和对方的window_size交给sender处理（根据ackno将已经确认的seg从outstanding队列中pop出来
     // 重设计时器，然后调用fill_window，从sender的bystream中读取准备发送的消息放到out队列中）
 
-    _sender.ack_received(seg.header().ackno, seg.header().win);
+    // SYN里的窗口不扩大，其它seg的窗口要按对方的移位数左移
+    optional<uint32_t> timestamp_echo{};
+    if (_timestamps && seg.header().ack && seg.header().timestamps.has_value())
+        timestamp_echo = seg.header().timestamps->echo_reply;
+    _sender.ack_received(seg.header().ackno,
+                         static_cast<uint32_t>(seg.header().win) << (seg.header().syn ? 0 : _send_window_shift),
+                         seg.length_in_sequence_space() > 0,
+                         timestamp_echo,
+                         seg.header().sack_blocks);
+
+    // 如果对方发的seg不是空seg，而sender这次没有seg可以捎带ack，此时特殊处理发送一个空seg过去
+    // stream里没数据、被cork或者Nagle扣住了短尾巴时，fill_window都不会发送任何数据，所以要看out队列而不是stream
+    // 打开延迟ack时，能延迟的ack先不发，等下一个seg、tick或者要发的数据捎带
+    if (seg.length_in_sequence_space() && ack_now(seg, in_order, had_gap) && _sender.segments_out().empty())
+        _sender.send_empty_segment();
 
-    // 如果sender的stream里面没数据了，并且对方发的seg不是空seg，此时特殊处理发送一个空seg过去
-    // 如果stream里面没有数据,fill_window不会发送任何数据，会直接return ，所以要单独处理
-    if (_sender.stream_in().buffer_empty() && seg.length_in_sequence_space())
+    // 对方的keep-alive或零窗口探测（空seg，序号是ackno-1）也要回一个ack，对方才能知道窗口已经重新打开
+    // （RFC 793：不可接受的seg要回ack）
+    if (!seg.length_in_sequence_space() && _receiver.ackno().has_value() &&
+        seg.header().seqno == _receiver.ackno().value() - 1)
         _sender.send_empty_segment();
 
     // 如果seg的reset为true，则发送一个空seg过去，并且将连接关闭（此时是unclean关闭）
@@ -132,6 +180,30 @@ size_t TCPConnection::write(const string &data)
     return write_size;
 }
 
+size_t TCPConnection::write(Buffer &&data)
+{
+    // 和上面一样，只是data整块挂到sender的stream上，不再拷贝一次
+    if (!data.size())
+        return 0;
+    size_t write_size = _sender.stream_in().write(move(data));
+
+    _sender.fill_window();
+    send_sender_segments();
+    return write_size;
+}
+
+size_t TCPConnection::read_from(FileDescriptor &fd)
+{
+    // 和write一样，只是数据由内核直接读进sender的stream，不经过中间的string
+    const size_t read_size = _sender.stream_in().read_from(fd);
+    if (!read_size)
+        return 0;
+
+    _sender.fill_window();
+    send_sender_segments();
+    return read_size;
+}
+
 // 定时调用该函数，用于计时
 //! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
 void TCPConnection::tick(const size_t ms_since_last_tick)
@@ -145,6 +217,14 @@ void TCPConnection::tick(const size_t ms_since_last_tick)
     // 调用sender的tick，也会累加时间，超过一段时间后会重传
     _sender.tick(ms_since_last_tick);
 
+    // 延迟的ack到时间了，发出去
+    if (_ack_delayed_for.has_value())
+    {
+        *_ack_delayed_for += ms_since_last_tick;
+        if (_ack_delayed_for.value() >= _cfg.ack_delay && _sender.segments_out().empty())
+            _sender.send_empty_segment();
+    }
+
     // 如果重传次数过多，关闭连接
     if (_sender.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS)
         unclean_shutdown();
@@ -153,6 +233,33 @@ void TCPConnection::tick(const size_t ms_since_last_tick)
     send_sender_segments();
 }
 
+// 距离下一次tick需要做事还剩多久：sender的重传计时器，或者先断开的一方的等待时间（见clean_shutdown）
+optional<size_t> TCPConnection::time_until_next_timer() const
+{
+    if (!_active)
+        return {};
+
+    optional<size_t> ret = _sender.time_until_timeout();
+
+    if (_ack_delayed_for.has_value())
+    {
+        const size_t elapsed = _ack_delayed_for.value();
+        const size_t remaining = elapsed >= _cfg.ack_delay ? 0 : _cfg.ack_delay - elapsed;
+        ret = ret.has_value() ? min(ret.value(), remaining) : remaining;
+    }
+
+    // 和clean_shutdown的条件一致：此时只差等够10*rt_timeout就可以断开连接
+    if (_linger_after_streams_finish && _receiver.stream_out().input_ended() && _sender.stream_in().eof() &&
+        _sender.bytes_in_flight() == 0)
+    {
+        const size_t linger = 10 * _cfg.rt_timeout;
+        const size_t remaining =
+            _time_since_last_segment_received >= linger ? 0 : linger - _time_since_last_segment_received;
+        ret = ret.has_value() ? min(ret.value(), remaining) : remaining;
+    }
+    return ret;
+}
+
 void TCPConnection::end_input_stream()
 {
     _sender.stream_in().end_input();
@@ -160,6 +267,27 @@ void TCPConnection::end_input_stream()
     send_sender_segments();
 }
 
+// 关掉Nagle算法时，之前攒着的小数据马上发出去
+void TCPConnection::set_nodelay(const bool nodelay)
+{
+    _sender.set_nagle(!nodelay);
+    if (nodelay && _sender.next_seqno_absolute() > 0)
+    {
+        _sender.fill_window();
+        send_sender_segments();
+    }
+}
+
+void TCPConnection::uncork()
+{
+    _sender.set_corked(false);
+    if (_sender.next_seqno_absolute() > 0)
+    {
+        _sender.fill_window();
+        send_sender_segments();
+    }
+}
+
 // 收到client的syn数据包后，此时可以让server的sender发东西了（重点是从stream中获取syn数据包发过去对方从而建立连接）
 void TCPConnection::connect()
 {
@@ -167,6 +295,97 @@ void TCPConnection::connect()
     send_sender_segments();
 }
 
+void TCPConnection::syn_options_received(const TCPHeader &header)
+{
+    // 对方能接受的seg不能超过它的MSS
+    if (header.mss.has_value() && header.mss.value() > 0)
+        _sender.set_max_payload_size(min(_cfg.mss, static_cast<size_t>(header.mss.value())));
+
+    // 只有我方也打开了窗口扩大，并且对方的SYN也带了这个选项，才生效（我方作为client时，我方的SYN已经带了）
+    if (_cfg.window_scaling && header.wscale.has_value())
+    {
+        _window_scaling = true;
+        _send_window_shift = min(header.wscale.value(), TCPConfig::MAX_WINDOW_SHIFT);
+        _receive_window_shift = window_shift_for(_cfg.recv_capacity);
+    }
+
+    if (_cfg.timestamps && header.timestamps.has_value())
+    {
+        _timestamps = true;
+        _ts_recent = header.timestamps->value;
+    }
+
+    if (_cfg.sack && header.sack_permitted)
+    {
+        _sack = true;
+        _sender.enable_sack();
+    }
+}
+
+void TCPConnection::add_syn_options(TCPHeader &header) const
+{
+    if (_cfg.mss != TCPConfig::MAX_PAYLOAD_SIZE)
+        header.mss = static_cast<uint16_t>(_cfg.mss);
+
+    // client主动发的SYN总是带上；server只有在对方的SYN带了时才在SYN-ACK里带上
+    if (_cfg.window_scaling && (_window_scaling || !_receiver.ackno().has_value()))
+        header.wscale = window_shift_for(_cfg.recv_capacity);
+
+    // SACK-permitted也一样
+    if (_cfg.sack && (_sack || !_receiver.ackno().has_value()))
+        header.sack_permitted = true;
+}
+
+void TCPConnection::add_timestamps(TCPHeader &header) const
+{
+    // client主动发的SYN总是带上，之后只有双方的SYN都带了才带；TSval用sender的时钟
+    if (_timestamps || (_cfg.timestamps && header.syn && !_receiver.ackno().has_value()))
+        header.timestamps = TCPHeader::Timestamps{static_cast<uint32_t>(_sender.clock_ms()), _ts_recent};
+}
+
+bool TCPConnection::ack_now(const TCPSegment &seg, const bool in_order, const bool had_gap)
+{
+    if (!_cfg.delayed_ack)
+        return true;
+
+    // 乱序的seg、填了空洞的seg（RFC 5681 4.2）、SYN和FIN马上确认；其它的攒到两个满的seg再确认
+    _unacked_bytes += seg.payload().size();
+    if (!in_order || had_gap || _receiver.unassembled_bytes() > 0 || seg.header().syn || seg.header().fin ||
+        _unacked_bytes >= 2 * _cfg.mss)
+        return true;
+
+    if (!_ack_delayed_for.has_value())
+        _ack_delayed_for = 0;
+    return false;
+}
+
+uint16_t TCPConnection::advertised_window(const bool syn) const
+{
+    const size_t window = _receiver.window_size() >> (syn ? 0 : _receive_window_shift);
+    return static_cast<uint16_t>(min(window, static_cast<size_t>(numeric_limits<uint16_t>::max())));
+}
+
+uint64_t TCPConnection::window_edge() const
+{
+    return _receiver.stream_out().bytes_written() +
+           (static_cast<uint64_t>(advertised_window(false)) << _receive_window_shift);
+}
+
+// 应用从入站stream读走了数据，窗口变大了。对方可能因为窗口满了停下来，只会隔一段时间发零窗口探测，
+// 所以窗口打开得够多（一个MSS或者缓冲区的一半，取小的，RFC 1122 4.2.3.3）时主动发一个窗口更新；
+// 打开得太少就不发，免得对方一次只发一点点（糊涂窗口综合症）
+void TCPConnection::inbound_stream_read()
+{
+    if (!_active || !_receiver.ackno().has_value() || _receiver.stream_out().input_ended())
+        return;
+    const uint64_t edge = window_edge();
+    if (edge > _advertised_window_edge && edge - _advertised_window_edge >= min(_cfg.mss, _cfg.recv_capacity / 2))
+    {
+        _sender.send_empty_segment();
+        send_sender_segments();
+    }
+}
+
 // 析构函数
 TCPConnection::~TCPConnection()
 {
@@ -203,8 +422,19 @@ void TCPConnection::send_sender_segments()
             // 将seg添加上ackno和receiver的window_size
             seg.header().ack = true;
             seg.header().ackno = _receiver.ackno().value();
-            seg.header().win = _receiver.window_size();
+            seg.header().win = advertised_window(seg.header().syn);
+            _advertised_window_edge = window_edge();
+            // 要确认的数据都由这个seg确认了（延迟的ack捎带在数据上）
+            _unacked_bytes = 0;
+            _ack_delayed_for.reset();
         }
+        if (seg.header().syn)
+            add_syn_options(seg.header());
+        add_timestamps(seg.header());
+        // 收到的数据有空洞时，ack带上SACK块（选项空间放得下几个就带几个）
+        if (_sack && seg.header().ack && !seg.header().syn)
+            seg.header().sack_blocks = _receiver.sack_blocks(seg.header().sack_block_room());
+        seg.header().set_doff_for_options();
         // 加入connection的消息队列
         _segments_out.push(seg);
     }
@@ -228,7 +458,7 @@ void TCPConnection::unclean_shutdown()
     seg.header().ack = true;
     if (_receiver.ackno().has_value())
         seg.header().ackno = _receiver.ackno().value();
-    seg.header().win = _receiver.window_size();
+    seg.header().win = advertised_window(seg.header().syn);
     seg.header().rst = true;
 
     _segments_out.push(seg);
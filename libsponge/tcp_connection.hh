@@ -1,18 +1,28 @@
 #ifndef SPONGE_LIBSPONGE_TCP_FACTORED_HH
 #define SPONGE_LIBSPONGE_TCP_FACTORED_HH
 
+#include "buffer_pool.hh"
 #include "tcp_config.hh"
 #include "tcp_receiver.hh"
 #include "tcp_sender.hh"
 #include "tcp_state.hh"
 
+#include <optional>
+
 //! \brief A complete endpoint of a TCP connection
 class TCPConnection
 {
 private:
+  // 检查配置，不合法时抛异常；初始化_cfg时调用，这样后面的成员用到配置之前就检查过了
+  static const TCPConfig &checked_config(const TCPConfig &cfg);
+
   TCPConfig _cfg;
   TCPReceiver _receiver{_cfg.recv_capacity};
-  TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+
+  // 发送数据的payload存储池，每个槽位一个MSS，槽位数按发送缓冲区能切出的seg数量（再留一倍余量）
+  std::shared_ptr<BufferPool> _buffer_pool{
+      std::make_shared<BufferPool>(_cfg.mss, 2 * (_cfg.send_capacity / _cfg.mss + 1))};
+  TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn, _buffer_pool};
 
   //! outbound queue of segments that the TCPConnection wants sent
   std::queue<TCPSegment> _segments_out{};
@@ -25,6 +35,43 @@ private:
   size_t _time_since_last_segment_received{0};
   bool _active{true};
 
+  // 窗口扩大选项（RFC 7323）：双方的SYN都带了这个选项才生效，生效前两个移位都是0
+  // 对方的SYN带了这个选项，并且我方也打开了这个功能
+  bool _window_scaling{false};
+  // 我方通告窗口时右移的位数
+  uint8_t _receive_window_shift{0};
+  // 对方通告的窗口要左移的位数
+  uint8_t _send_window_shift{0};
+
+  // 时间戳选项（RFC 7323）：同样是双方的SYN都带了才生效，生效后每个seg都带
+  bool _timestamps{false};
+  // 要回显给对方的时间戳（TS.Recent）：对方按序到达的seg里最新的TSval
+  uint32_t _ts_recent{0};
+
+  // 选择确认（RFC 2018）：双方的SYN都带了SACK-permitted才生效，生效后我方的ack带上SACK块，对方的SACK块交给sender
+  bool _sack{false};
+
+  // 延迟ack：收到的数据还没确认的字节数，以及从第一个没确认的seg到现在过了多久（没有要确认的数据时为空）
+  size_t _unacked_bytes{0};
+  std::optional<size_t> _ack_delayed_for{};
+
+  // 最近一次通告给对方的窗口右边界（用入站stream写入的字节数计），应用读走数据后窗口打开得够多才发窗口更新
+  uint64_t _advertised_window_edge{0};
+
+  // 收到了seg（in_order：序号正好是原来的ackno），决定是马上发ack还是延迟
+  bool ack_now(const TCPSegment &seg, const bool in_order, const bool had_gap);
+
+  // 处理对方SYN里的选项（MSS、窗口扩大、时间戳和SACK-permitted）
+  void syn_options_received(const TCPHeader &header);
+  // 给我方发出的SYN加上选项
+  void add_syn_options(TCPHeader &header) const;
+  // 要填进header的窗口大小（SYN里的窗口不扩大）
+  uint16_t advertised_window(const bool syn) const;
+  // 现在通告的话，窗口的右边界
+  uint64_t window_edge() const;
+  // 给要发出的seg加上时间戳选项
+  void add_timestamps(TCPHeader &header) const;
+
   void send_sender_segments();
   void clean_shutdown();
   void unclean_shutdown();
@@ -40,11 +87,30 @@ public:
   //! \returns the number of bytes from `data` that were actually written.
   size_t write(const std::string &data);
 
+  //! \brief Write a Buffer to the outbound byte stream without copying it (as much as fits), and send it over
+  //! TCP if possible
+  //! \returns the number of bytes from `data` that were actually written.
+  size_t write(Buffer &&data);
+
+  //! \brief Read from `fd` straight into the outbound byte stream (as much as fits), and send it over TCP if possible
+  //! \returns the number of bytes read from `fd` (0 at EOF)
+  size_t read_from(FileDescriptor &fd);
+
   //! \returns the number of `bytes` that can be written right now.
   size_t remaining_outbound_capacity() const;
 
   //! \brief Shut down the outbound byte stream (still allows reading incoming data)
   void end_input_stream();
+
+  //! \brief Turn Nagle's algorithm off (true) or on (false), like the TCP_NODELAY socket option
+  void set_nodelay(const bool nodelay);
+  bool nodelay() const { return !_sender.nagle(); }
+
+  //! \brief Hold back partial segments until uncork(), like the TCP_CORK socket option
+  void cork() { _sender.set_corked(true); }
+  //! \brief Send what cork() held back
+  void uncork();
+  bool corked() const { return _sender.corked(); }
   //!@}
 
   //! \name "Output" interface for the reader
@@ -52,6 +118,11 @@ public:
 
   //! \brief The inbound byte stream received from the peer
   ByteStream &inbound_stream() { return _receiver.stream_out(); }
+  const ByteStream &inbound_stream() const { return _receiver.stream_out(); }
+
+  //! \brief Called after reading from inbound_stream(); sends a window update once the window has opened
+  //! by an MSS or half the buffer, so a peer stopped by a full window need not wait for its next probe
+  void inbound_stream_read();
   //!@}
 
   //! \name Accessors used for testing
@@ -63,6 +134,12 @@ public:
   size_t unassembled_bytes() const;
   //! \brief Number of milliseconds since the last segment was received
   size_t time_since_last_segment_received() const;
+  //! \brief allocation counters of the pool that holds outgoing payloads
+  const BufferPool::Stats &buffer_pool_stats() const { return _buffer_pool->stats(); }
+  //! \brief round-trip time measurements of the sender
+  const RTTEstimator::Stats &rtt_stats() const { return _sender.rtt_stats(); }
+  //! \brief the current retransmission timeout, in milliseconds
+  unsigned int rto() const { return _sender.rto(); }
   //!< \brief summarize the state of the sender, receiver, and the connection
   TCPState state() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
   //!@}
@@ -76,6 +153,10 @@ public:
   //! Called periodically when time elapses
   void tick(const size_t ms_since_last_tick);
 
+  //! \brief Milliseconds of tick() until the connection has something to do (a retransmission, a
+  //! delayed ACK, or the end of lingering); empty if no timer is running, so the owner need not tick at all
+  std::optional<size_t> time_until_next_timer() const;
+
   //! \brief TCPSegments that the TCPConnection has enqueued for transmission.
   //! \note The owner or operating system will dequeue these and
   //! put each one into the payload of a lower-layer datagram (usually Internet datagrams (IP),
@@ -89,7 +170,14 @@ public:
   //!@}
 
   //! Construct a new connection from a configuration
-  explicit TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {}
+  explicit TCPConnection(const TCPConfig &cfg) : _cfg{checked_config(cfg)}
+  {
+    _sender.set_congestion_controller(make_congestion_controller(_cfg.congestion_control, _cfg.mss));
+    _sender.set_max_payload_size(_cfg.mss);
+    _sender.set_nagle(_cfg.nagle);
+    if (_cfg.adaptive_rto)
+      _sender.set_adaptive_rto(_cfg.rto_min, _cfg.rto_max);
+  }
 
   //! \name construction and destruction
   //! moving is allowed; copying is disallowed; default construction not possible
@@ -0,0 +1,126 @@
+#include "congestion_controller.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] mss is the sender's maximum segment size
+CongestionController::CongestionController(const size_t mss) : _mss(mss), _cwnd(INITIAL_WINDOW_SEGMENTS * mss) {}
+
+void CongestionController::set_mss(const size_t mss) {
+    _mss = mss;
+    if (not _acked_anything) {
+        _cwnd = INITIAL_WINDOW_SEGMENTS * mss;
+    }
+}
+
+//! \details In slow start the window grows by the bytes acknowledged, but at most one MSS per ACK
+//! (appropriate byte counting with L = 1, [RFC 3465](\ref rfc::rfc3465)).
+void CongestionController::on_ack(const size_t acked, const uint64_t now_ms) {
+    _acked_anything = true;
+    if (in_slow_start()) {
+        _cwnd += min(acked, _mss);
+    } else {
+        _avoid_congestion(acked, now_ms);
+    }
+}
+
+void CongestionController::on_fast_retransmit(const size_t bytes_in_flight, const uint64_t now_ms) {
+    _ssthresh = _reduced_window(bytes_in_flight, now_ms);
+    _cwnd = _ssthresh + 3 * _mss;
+}
+
+void CongestionController::on_sack_recovery(const size_t bytes_in_flight, const uint64_t now_ms) {
+    _prior_cwnd = _cwnd;
+    _prior_ssthresh = _ssthresh;
+    _ssthresh = _reduced_window(bytes_in_flight, now_ms);
+    _cwnd = _ssthresh;
+}
+
+void CongestionController::undo_reduction() {
+    _cwnd = max(_cwnd, _prior_cwnd);
+    _ssthresh = max(_ssthresh, _prior_ssthresh);
+}
+
+void CongestionController::on_duplicate_ack() { _cwnd += _mss; }
+
+//! \details Deflate by the data that left the network, then add back one MSS for the retransmission
+//! that the partial ACK triggers ([RFC 6582](\ref rfc::rfc6582), section 3.2).
+void CongestionController::on_partial_ack(const size_t acked) {
+    _acked_anything = true;
+    _cwnd -= min(_cwnd, acked);
+    _cwnd += _mss;
+}
+
+void CongestionController::on_recovery_end() { _cwnd = _ssthresh; }
+
+void CongestionController::on_timeout(const size_t bytes_in_flight, const uint64_t now_ms) {
+    _ssthresh = _reduced_window(bytes_in_flight, now_ms);
+    _cwnd = _mss;
+}
+
+void RenoController::_avoid_congestion(const size_t acked, const uint64_t) {
+    _acked_in_window += acked;
+    if (_acked_in_window >= _cwnd) {
+        _acked_in_window -= _cwnd;
+        _cwnd += _mss;
+    }
+}
+
+size_t RenoController::_reduced_window(const size_t bytes_in_flight, const uint64_t) {
+    _acked_in_window = 0;
+    return max(bytes_in_flight / 2, 2 * _mss);
+}
+
+//! \details Each ACK moves the window toward the target W(t) (capped at 1.5 times the window), or toward
+//! the Reno-friendly estimate when that is larger.
+void CubicController::_avoid_congestion(const size_t acked, const uint64_t now_ms) {
+    const double cwnd = static_cast<double>(_cwnd) / static_cast<double>(_mss);
+
+    if (not _epoch_start.has_value()) {
+        _epoch_start = now_ms;
+        _k = cwnd < _w_max ? cbrt((_w_max - cwnd) / C) : 0;
+        _w_max = max(_w_max, cwnd);
+        _w_est = cwnd;
+    }
+
+    const double t = static_cast<double>(now_ms - _epoch_start.value()) / 1000;
+    double target = C * pow(t - _k, 3) + _w_max;
+    target = clamp(target, cwnd, 1.5 * cwnd);
+
+    constexpr double alpha = 3 * (1 - BETA) / (1 + BETA);
+    _w_est += alpha * static_cast<double>(acked) / static_cast<double>(_cwnd);
+    target = max(target, _w_est);
+
+    _increase_remainder += static_cast<double>(acked) * (target - cwnd) / cwnd;
+    const double whole = floor(_increase_remainder);
+    _cwnd += static_cast<size_t>(whole);
+    _increase_remainder -= whole;
+}
+
+//! \details With fast convergence: a loss below the previous W_max suggests the available bandwidth
+//! shrank, so W_max is lowered further to release bandwidth to other flows.
+size_t CubicController::_reduced_window(const size_t, const uint64_t) {
+    const double cwnd = static_cast<double>(_cwnd) / static_cast<double>(_mss);
+    _w_max = cwnd < _w_max ? cwnd * (1 + BETA) / 2 : cwnd;
+    _epoch_start.reset();
+    _increase_remainder = 0;
+    return max(static_cast<size_t>(static_cast<double>(_cwnd) * BETA), 2 * _mss);
+}
+
+//! \param[in] algorithm chooses the controller
+//! \param[in] mss is the sender's maximum segment size
+unique_ptr<CongestionController> make_congestion_controller(const TCPConfig::CongestionControl algorithm,
+                                                            const size_t mss) {
+    switch (algorithm) {
+        case TCPConfig::CongestionControl::None:
+            return nullptr;
+        case TCPConfig::CongestionControl::Reno:
+            return make_unique<RenoController>(mss);
+        case TCPConfig::CongestionControl::Cubic:
+            return make_unique<CubicController>(mss);
+    }
+    throw runtime_error("unknown congestion control algorithm");
+}
@@ -0,0 +1,127 @@
+#ifndef SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
+#define SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
+
+#include "tcp_config.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+
+//! \brief Decides a TCPSender's congestion window
+//! \details The TCPSender detects losses and runs fast retransmit and fast recovery
+//! ([RFC 5681](\ref rfc::rfc5681), with the partial-ACK rule of NewReno, [RFC 6582](\ref rfc::rfc6582));
+//! the controller only keeps the window. Slow start, window inflation during fast recovery, and the loss
+//! window after a timeout are the same for every algorithm; a subclass supplies growth in congestion
+//! avoidance and the multiplicative decrease. Windows are in bytes, times in milliseconds of the
+//! sender's tick() clock.
+class CongestionController {
+  protected:
+    size_t _mss;
+    size_t _cwnd;
+    size_t _ssthresh{std::numeric_limits<size_t>::max()};
+    bool _acked_anything{false};  //!< Has any ACK been counted yet?
+    size_t _prior_cwnd{0};        //!< Window before the last SACK recovery, for undo_reduction()
+    size_t _prior_ssthresh{0};    //!< Threshold before the last SACK recovery, for undo_reduction()
+
+    //! Grow the window in congestion avoidance, for `acked` newly acknowledged bytes
+    virtual void _avoid_congestion(const size_t acked, const uint64_t now_ms) = 0;
+
+    //! The slow-start threshold after a loss, with `bytes_in_flight` outstanding when it was detected
+    virtual size_t _reduced_window(const size_t bytes_in_flight, const uint64_t now_ms) = 0;
+
+  public:
+    static constexpr size_t INITIAL_WINDOW_SEGMENTS = 10;  //!< Initial window ([RFC 6928](\ref rfc::rfc6928))
+
+    //! \param[in] mss is the sender's maximum segment size
+    explicit CongestionController(const size_t mss);
+    virtual ~CongestionController() = default;
+
+    //! \brief Name of the algorithm
+    virtual std::string name() const = 0;
+
+    //! \brief Bytes the sender may have in flight
+    size_t window() const { return _cwnd; }
+
+    //! \brief The slow-start threshold
+    size_t ssthresh() const { return _ssthresh; }
+
+    //! \brief Is the window growing exponentially?
+    bool in_slow_start() const { return _cwnd < _ssthresh; }
+
+    //! \brief The sender's maximum segment size changed (e.g. to the peer's MSS option)
+    //! \note Before anything has been acknowledged, this also resets the window to the initial window.
+    void set_mss(const size_t mss);
+
+    //! \name Events reported by the TCPSender
+    //!@{
+
+    //! `acked` new bytes were acknowledged outside of loss recovery
+    void on_ack(const size_t acked, const uint64_t now_ms);
+
+    //! A third duplicate ACK: the oldest segment is being retransmitted and fast recovery begins
+    void on_fast_retransmit(const size_t bytes_in_flight, const uint64_t now_ms);
+
+    //! SACK-based loss recovery ([RFC 6675](\ref rfc::rfc6675)) begins: the window drops straight to the
+    //! new threshold and is not inflated, since the sender counts the data still in the network itself
+    void on_sack_recovery(const size_t bytes_in_flight, const uint64_t now_ms);
+
+    //! Every retransmission of the last SACK recovery turned out to be unnecessary (the segments were only
+    //! reordered): the window and threshold go back to at least what they were before it
+    void undo_reduction();
+
+    //! Another duplicate ACK during fast recovery: a segment has left the network
+    void on_duplicate_ack();
+
+    //! An ACK during fast recovery that acknowledged `acked` bytes but not everything outstanding
+    void on_partial_ack(const size_t acked);
+
+    //! Everything outstanding when fast recovery began has been acknowledged
+    void on_recovery_end();
+
+    //! The retransmission timer expired
+    void on_timeout(const size_t bytes_in_flight, const uint64_t now_ms);
+    //!@}
+};
+
+//! \brief Reno congestion avoidance ([RFC 5681](\ref rfc::rfc5681)): one MSS per window acknowledged,
+//! and halving on loss
+class RenoController final : public CongestionController {
+    size_t _acked_in_window{0};  //!< Bytes acknowledged since the window last grew
+
+    void _avoid_congestion(const size_t acked, const uint64_t now_ms) override;
+    size_t _reduced_window(const size_t bytes_in_flight, const uint64_t now_ms) override;
+
+  public:
+    using CongestionController::CongestionController;
+    std::string name() const override { return "reno"; }
+};
+
+//! \brief CUBIC congestion avoidance ([RFC 9438](\ref rfc::rfc9438))
+//! \details After a loss the window follows W(t) = C (t - K)^3 + W_max, plateauing near the window where
+//! the loss happened, but never grows more slowly than Reno would (the "Reno-friendly" estimate).
+class CubicController final : public CongestionController {
+    static constexpr double C = 0.4;     //!< Aggressiveness, in segments per second cubed
+    static constexpr double BETA = 0.7;  //!< Multiplicative decrease factor
+
+    double _w_max{0};                      //!< Window (in segments) before the last reduction
+    double _k{0};                          //!< Seconds from the epoch start until W(t) reaches _w_max
+    double _w_est{0};                      //!< Reno-friendly window estimate, in segments
+    double _increase_remainder{0};         //!< Fractional bytes of window growth not yet applied
+    std::optional<uint64_t> _epoch_start{};  //!< When the current congestion avoidance epoch began
+
+    void _avoid_congestion(const size_t acked, const uint64_t now_ms) override;
+    size_t _reduced_window(const size_t bytes_in_flight, const uint64_t now_ms) override;
+
+  public:
+    using CongestionController::CongestionController;
+    std::string name() const override { return "cubic"; }
+};
+
+//! \brief The controller for `algorithm`, or nullptr for TCPConfig::CongestionControl::None
+std::unique_ptr<CongestionController> make_congestion_controller(const TCPConfig::CongestionControl algorithm,
+                                                                 const size_t mss);
+
+#endif  // SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
@@ -1,13 +1,17 @@
 #include "fd_adapter.hh"
 
+#include <array>
 #include <iostream>
 #include <stdexcept>
+#include <sys/uio.h>
 #include <utility>
 
 using namespace std;
 
 //! \details This function first attempts to parse a TCP segment from the next UDP
-//! payload recv()d from the socket.
+//! payload received from the socket: the next one left from the last recv_many(), or else
+//! the first of a new batch. (The caller must not call read() with none pending unless the
+//! socket is readable, since recv_many() blocks.)
 //!
 //! If this succeeds, it then checks that the received segment is related to the
 //! current connection. When a TCP connection has been established, this means
@@ -19,23 +23,31 @@ using namespace std;
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    if (pending() == 0) {
+        _sock.recv_many(_received);
+        _next_received = 0;
+    }
+    const size_t index = _next_received++;
+    const Address source_address = _received.source_address(index);
 
     // is it for us?
-    if (not listening() and (datagram.source_address != config().destination)) {
+    if (not listening() and (source_address != config().destination)) {
         return {};
     }
 
     // is the payload a valid TCP segment?
+    const string_view payload = _received.payload(index);
+    auto storage = _payloads.acquire(payload.size());
+    storage->assign(payload);
     TCPSegment seg;
-    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+    if (ParseResult::NoError != seg.parse(Buffer{move(storage)}, 0)) {
         return {};
     }
 
     // should we target this source in all future replies?
     if (listening()) {
         if (seg.header().syn and not seg.header().rst) {
-            config_mutable().destination = datagram.source_address;
+            config_mutable().destination = source_address;
             set_listening(false);
         } else {
             return {};
@@ -45,12 +57,47 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
     return seg;
 }
 
-//! Serialize a TCP segment and send it as the payload of a UDP datagram.
+//! Queue a TCP segment to be sent as the payload of a UDP datagram.
+//! \details The segment is copied (its payload is shared, not duplicated), so the caller may
+//! discard it at once. A full batch is sent straight away.
 //! \param[in] seg is the TCP segment to write
 void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
+    _sending.push_back(seg);
+    if (_sending.size() == BATCH_SIZE) {
+        flush();
+    }
+}
+
+//! \details Each header is serialized into a reused array and sent together with its payload, so once
+//! the vectors have grown to a full batch no heap allocation happens per segment. The queued segments are
+//! dropped even if sending fails, so that a failed batch is not sent again with the next one.
+void TCPOverUDPSocketAdapter::flush() {
+    if (_sending.empty()) {
+        return;
+    }
+
+    // every header is serialized before any iovec points into `_headers`, which may reallocate as it grows
+    _headers.resize(_sending.size());
+    array<size_t, BATCH_SIZE> header_lengths{};
+    for (size_t i = 0; i < _sending.size(); i++) {
+        header_lengths[i] = _sending[i].serialize_header_into(_headers[i], 0);
+    }
+
+    for (size_t i = 0; i < _sending.size(); i++) {
+        const string_view payload = _sending[i].payload().str();
+        const array<iovec, 2> iov{
+            {{_headers[i].data(), header_lengths[i]}, {const_cast<char *>(payload.data()), payload.size()}}};
+        _send_batch.add(config().destination, iov.data(), iov.size());
+    }
+    try {
+        _sock.send_many(_send_batch);
+    } catch (...) {
+        _sending.clear();
+        throw;
+    }
+    _sending.clear();
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
@@ -1,6 +1,7 @@
 #ifndef SPONGE_LIBSPONGE_FD_ADAPTER_HH
 #define SPONGE_LIBSPONGE_FD_ADAPTER_HH
 
+#include "buffer_pool.hh"
 #include "file_descriptor.hh"
 #include "lossy_fd_adapter.hh"
 #include "socket.hh"
@@ -8,8 +9,10 @@
 #include "tcp_header.hh"
 #include "tcp_segment.hh"
 
+#include <cstdint>
 #include <optional>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
@@ -40,13 +43,53 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! \brief Number of segments already received that read() will return without a system call
+    //! \details Adapters that receive in batches override this; the owner calls read() until it is zero.
+    size_t pending() const { return 0; }
+
+    //! \brief Send what write() has queued
+    //! \details Adapters that send in batches override this; the owner calls it after each round of write()s.
+    void flush() {}
+
+    //! \brief Milliseconds until the adapter must be ticked, as a segment it holds back becomes due
+    //! \details Adapters that delay segments (LossyFdAdapter) override this; once it has passed, the owner
+    //! ticks the adapter and calls read() while pending().
+    std::optional<uint64_t> time_until_next_timer() const { return {}; }
+
+    //! \brief Learn the connection's MSS, before any segment is read
+    //! \details Adapters that keep storage sized for a full segment override this.
+    void set_mss(const size_t) {}
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
+//! \details Datagrams are received and sent in batches of up to BATCH_SIZE, one
+//! [recvmmsg(2)](\ref man2::recvmmsg) or [sendmmsg(2)](\ref man2::sendmmsg) per batch.
 class TCPOverUDPSocketAdapter : public FdAdapterBase {
+  public:
+    //! Most datagrams received or sent by one system call
+    static constexpr size_t BATCH_SIZE = 32;
+
+    //! Largest datagram received
+    static constexpr size_t MTU = 65536;
+
   private:
     UDPSocket _sock;
 
+    UDPSocket::RecvBatch _received{BATCH_SIZE, MTU};
+    size_t _next_received{0};  //!< Index in `_received` of the next datagram read() returns
+
+    //! Storage for received segments; a datagram is copied out of `_received` into a slot, which holds
+    //! a full-sized segment under the MSS given to set_mss()
+    BufferPool _payloads{TCPConfig::MAX_PAYLOAD_SIZE + TCPHeader::MAX_LENGTH, 4 * BATCH_SIZE};
+
+    //! \name Segments queued by write(), their serialized headers, and the datagrams that carry them
+    //!@{
+    std::vector<TCPSegment> _sending{};
+    std::vector<TCPHeader::Serialized> _headers{};
+    UDPSocket::SendBatch _send_batch{};
+    //!@}
+
   public:
     //! Construct from a UDPSocket sliced into a FileDescriptor
     explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
@@ -54,9 +97,21 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
     //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
     std::optional<TCPSegment> read();
 
-    //! Writes a TCP segment into a UDP payload
+    //! Number of datagrams received but not yet returned by read()
+    size_t pending() const { return _received.size() - _next_received; }
+
+    //! Size the slots for received segments to hold a full segment of `mss` payload bytes
+    void set_mss(const size_t mss) { _payloads = BufferPool{mss + TCPHeader::MAX_LENGTH, 4 * BATCH_SIZE}; }
+
+    //! Allocation counters of the storage for received segments
+    const BufferPool::Stats &payload_pool_stats() const { return _payloads.stats(); }
+
+    //! Queues a TCP segment to be sent in a UDP payload (sent by flush(), or once BATCH_SIZE are queued)
     void write(TCPSegment &seg);
 
+    //! Sends every queued segment with one [sendmmsg(2)](\ref man2::sendmmsg)
+    void flush();
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
@@ -2,6 +2,7 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <iomanip>
 #include <sstream>
@@ -21,30 +22,31 @@ using namespace std;
 //! - there is less data in the full datagram than the `len` field claims
 //! - the checksum is bad
 ParseResult IPv4Header::parse(NetParser &p) {
-    Buffer original_serialized_version = p.buffer();
-
     const size_t data_size = p.buffer().size();
     if (data_size < IPv4Header::LENGTH) {
         return ParseResult::PacketTooShort;
     }
 
-    const uint8_t first_byte = p.u8();
+    // the length is checked once for the whole fixed header, which is then read in place
+    const NetSpan header = p.span(IPv4Header::LENGTH);
+
+    const uint8_t first_byte = header.u8(0);
     ver = first_byte >> 4;     // version
     hlen = first_byte & 0x0f;  // header length
-    tos = p.u8();              // type of service
-    len = p.u16();             // length
-    id = p.u16();              // id
+    tos = header.u8(1);        // type of service
+    len = header.u16(2);       // length
+    id = header.u16(4);        // id
 
-    const uint16_t fo_val = p.u16();
+    const uint16_t fo_val = header.u16(6);
     df = static_cast<bool>(fo_val & 0x4000);  // don't fragment
     mf = static_cast<bool>(fo_val & 0x2000);  // more fragments
     offset = fo_val & 0x1fff;                 // offset
 
-    ttl = p.u8();     // ttl
-    proto = p.u8();   // proto
-    cksum = p.u16();  // checksum
-    src = p.u32();    // source address
-    dst = p.u32();    // destination address
+    ttl = header.u8(8);      // ttl
+    proto = header.u8(9);    // proto
+    cksum = header.u16(10);  // checksum
+    src = header.u32(12);    // source address
+    dst = header.u32(16);    // destination address
 
     if (data_size < 4 * hlen) {
         return ParseResult::PacketTooShort;
@@ -65,8 +67,9 @@ ParseResult IPv4Header::parse(NetParser &p) {
         return p.get_error();
     }
 
+    // the options follow the fixed header in the storage the span keeps alive
     InternetChecksum check;
-    check.add({original_serialized_version.str().data(), size_t(4 * hlen)});
+    check.add({header.data(), size_t(4 * hlen)});
     if (check.value()) {
         return ParseResult::BadChecksum;
     }
@@ -76,6 +79,14 @@ ParseResult IPv4Header::parse(NetParser &p) {
 
 //! Serialize the IPv4Header to a string (does not recompute the checksum)
 string IPv4Header::serialize() const {
+    Serialized out;
+    const size_t length = serialize_into(out);
+    return string(reinterpret_cast<const char *>(out.data()), length);
+}
+
+//! \param[out] out receives the header, padded with zeros to its advertised size (does not recompute the checksum)
+//! \returns the number of bytes written, `4 * hlen`
+size_t IPv4Header::serialize_into(Serialized &out) const {
     // sanity checks
     if (ver != 4) {
         throw runtime_error("wrong IP version");
@@ -83,30 +94,34 @@ string IPv4Header::serialize() const {
     if (4 * hlen < IPv4Header::LENGTH) {
         throw runtime_error("IP header too short");
     }
+    if (4 * hlen > IPv4Header::MAX_LENGTH) {
+        throw runtime_error("IP header too long");
+    }
 
-    string ret;
-    ret.reserve(4 * hlen);
+    uint8_t *p = out.data();
 
     const uint8_t first_byte = (ver << 4) | (hlen & 0xf);
-    NetUnparser::u8(ret, first_byte);  // version and header length
-    NetUnparser::u8(ret, tos);         // type of service
-    NetUnparser::u16(ret, len);        // length
-    NetUnparser::u16(ret, id);         // id
+    p = NetUnparser::u8(p, first_byte);  // version and header length
+    p = NetUnparser::u8(p, tos);         // type of service
+    p = NetUnparser::u16(p, len);        // length
+    p = NetUnparser::u16(p, id);         // id
 
     const uint16_t fo_val = (df ? 0x4000 : 0) | (mf ? 0x2000 : 0) | (offset & 0x1fff);
-    NetUnparser::u16(ret, fo_val);  // flags and offset
+    p = NetUnparser::u16(p, fo_val);  // flags and offset
 
-    NetUnparser::u8(ret, ttl);    // time to live
-    NetUnparser::u8(ret, proto);  // protocol number
+    p = NetUnparser::u8(p, ttl);    // time to live
+    p = NetUnparser::u8(p, proto);  // protocol number
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    p = NetUnparser::u16(p, cksum);  // checksum
 
-    NetUnparser::u32(ret, src);  // src address
-    NetUnparser::u32(ret, dst);  // dst address
+    p = NetUnparser::u32(p, src);  // src address
+    p = NetUnparser::u32(p, dst);  // dst address
 
-    ret.resize(4 * hlen);  // expand header to advertised size
+    // expand header to advertised size
+    const size_t length = 4 * hlen;
+    fill(p, out.data() + length, 0);
 
-    return ret;
+    return length;
 }
 
 uint16_t IPv4Header::payload_length() const { return len - 4 * hlen; }
@@ -3,12 +3,18 @@
 
 #include "parser.hh"
 
+#include <array>
+
 //! \brief [IPv4](\ref rfc::rfc791) Internet datagram header
 //! \note IP options are not supported
 struct IPv4Header {
     static constexpr size_t LENGTH = 20;         //!< [IPv4](\ref rfc::rfc791) header length, not including options
     static constexpr uint8_t DEFAULT_TTL = 128;  //!< A reasonable default TTL value
     static constexpr uint8_t PROTO_TCP = 6;      //!< Protocol number for [tcp](\ref rfc::rfc793)
+    static constexpr size_t MAX_LENGTH = 60;     //!< Largest header `hlen` can describe
+
+    //! Caller-provided storage for a serialized header
+    using Serialized = std::array<uint8_t, MAX_LENGTH>;
 
     //! \struct IPv4Header
     //! ~~~{.txt}
@@ -52,6 +58,9 @@ struct IPv4Header {
     //! Serialize the IP fields
     std::string serialize() const;
 
+    //! Serialize the IP fields into `out` without allocating; returns the header length
+    size_t serialize_into(Serialized &out) const;
+
     //! Length of the payload
     uint16_t payload_length() const;
 
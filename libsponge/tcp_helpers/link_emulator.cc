@@ -0,0 +1,143 @@
+#include "link_emulator.hh"
+
+#include "ipv4_header.hh"
+#include "tcp_header.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+static constexpr uint64_t NS_PER_MS = 1000000;
+
+LinkEmulator::LinkEmulator(const LinkConfig &config) : _config(config), _rng(config.seed) {
+    if (_config.queue_discipline == LinkConfig::QueueDiscipline::RED and
+        _config.red_min_threshold >= _config.red_max_threshold) {
+        throw runtime_error("LinkEmulator: RED needs red_min_threshold < red_max_threshold");
+    }
+}
+
+size_t LinkEmulator::wire_size(const TCPSegment &seg) {
+    return seg.payload().size() + TCPHeader::LENGTH + IPv4Header::LENGTH;
+}
+
+void LinkEmulator::_drain_queue() {
+    while (not _queue.empty() and _queue.front().first <= _now_ns) {
+        _queued_bytes -= _queue.front().second;
+        _queue.pop_front();
+    }
+}
+
+//! \details The average is taken over arrivals; while the queue was idle, it decays as if small
+//! segments had kept arriving to an empty queue, one per `size` bytes' serialization time. Between the
+//! thresholds, the drop probability rises linearly to red_max_p, and is spread out by the count of
+//! segments since the last early drop, so that drops are evenly spaced rather than clustered.
+bool LinkEmulator::_red_drop(const size_t size) {
+    const double weight = _config.red_weight;
+    if (_queued_bytes == 0 and _now_ns > _busy_until_ns) {
+        const double serialization_ns = double(size) * 8e9 / double(_config.rate_bps);
+        _red_average *= pow(1 - weight, double(_now_ns - _busy_until_ns) / serialization_ns);
+    }
+    _red_average = (1 - weight) * _red_average + weight * double(_queued_bytes);
+
+    const double min_threshold = double(_config.red_min_threshold);
+    const double max_threshold = double(_config.red_max_threshold);
+    if (_red_average < min_threshold) {
+        _red_count = 0;
+        return false;
+    }
+    if (_red_average >= max_threshold) {
+        _red_count = 0;
+        return true;
+    }
+    const double p_b = _config.red_max_p * (_red_average - min_threshold) / (max_threshold - min_threshold);
+    const double spread = 1 - double(_red_count) * p_b;
+    if (spread <= 0 or bernoulli_distribution{min(1.0, p_b / spread)}(_rng)) {
+        _red_count = 0;
+        return true;
+    }
+    _red_count++;
+    return false;
+}
+
+void LinkEmulator::_enqueue(TCPSegment &&seg) {
+    uint64_t departure_ns = _now_ns;
+    if (_config.rate_bps > 0) {
+        const size_t size = wire_size(seg);
+        _drain_queue();
+        if (_config.queue_discipline == LinkConfig::QueueDiscipline::RED and _red_drop(size)) {
+            _stats.early_drops++;
+            return;
+        }
+        if (_config.queue_limit > 0 and _queued_bytes + size > _config.queue_limit) {
+            _stats.queue_drops++;
+            return;
+        }
+        _busy_until_ns = max(_busy_until_ns, _now_ns) + size * 8000000000 / _config.rate_bps;
+        departure_ns = _busy_until_ns;
+        _queue.emplace_back(departure_ns, size);
+        _queued_bytes += size;
+    }
+
+    uint64_t arrival_ns = departure_ns + _config.delay_ms * NS_PER_MS;
+    if (_config.jitter_ms > 0) {
+        arrival_ns += uniform_int_distribution<uint64_t>{0, _config.jitter_ms * NS_PER_MS}(_rng);
+    }
+    if (_config.reorder_rate > 0 and bernoulli_distribution{_config.reorder_rate}(_rng)) {
+        arrival_ns += _config.reorder_delay_ms * NS_PER_MS;
+        _stats.reordered++;
+    } else {
+        arrival_ns = max(arrival_ns, _last_arrival_ns);
+        _last_arrival_ns = arrival_ns;
+    }
+
+    if (arrival_ns <= _now_ns) {
+        _arrived.push_back(move(seg));
+    } else {
+        _in_flight.emplace(arrival_ns, move(seg));
+    }
+}
+
+void LinkEmulator::send(TCPSegment seg) {
+    _stats.sent++;
+    if (_config.loss_rate > 0 and bernoulli_distribution{_config.loss_rate}(_rng)) {
+        _stats.random_drops++;
+        return;
+    }
+    if (_config.duplicate_rate > 0 and bernoulli_distribution{_config.duplicate_rate}(_rng)) {
+        _stats.duplicates++;
+        _enqueue(TCPSegment{seg});
+    }
+    _enqueue(move(seg));
+}
+
+//! \details Segments due at the same time arrive in the order they were sent.
+void LinkEmulator::advance(const uint64_t ms) {
+    _now_ns += ms * NS_PER_MS;
+    while (not _in_flight.empty() and _in_flight.begin()->first <= _now_ns) {
+        _arrived.push_back(move(_in_flight.begin()->second));
+        _in_flight.erase(_in_flight.begin());
+    }
+    _drain_queue();
+}
+
+optional<TCPSegment> LinkEmulator::receive() {
+    if (_arrived.empty()) {
+        return {};
+    }
+    TCPSegment ret = move(_arrived.front());
+    _arrived.pop_front();
+    _stats.delivered++;
+    return ret;
+}
+
+optional<uint64_t> LinkEmulator::time_until_next_arrival() const {
+    if (not _arrived.empty()) {
+        return 0;
+    }
+    if (_in_flight.empty()) {
+        return {};
+    }
+    return (_in_flight.begin()->first - _now_ns + NS_PER_MS - 1) / NS_PER_MS;
+}
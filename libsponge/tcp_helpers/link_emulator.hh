@@ -0,0 +1,102 @@
+#ifndef SPONGE_LIBSPONGE_LINK_EMULATOR_HH
+#define SPONGE_LIBSPONGE_LINK_EMULATOR_HH
+
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <random>
+#include <utility>
+
+//! \brief One direction of an emulated network path, driven by a virtual clock
+//! \details A segment given to send() is first lost at random or duplicated, then waits in the bottleneck
+//! queue (which drops it if it is full, or with RED, sometimes earlier), is serialized at the bottleneck
+//! rate, and arrives after the propagation delay plus jitter, and sometimes a reordering delay. Time passes
+//! only in advance(), so a run depends only on the config (including its seed) and on what is sent when:
+//! the same inputs give the same arrivals, and a simulation need not wait for them in real time.
+//!
+//! Jitter varies the delay but keeps segments in order (a segment never arrives before one sent ahead of
+//! it); only the segments picked by reorder_rate are overtaken.
+class LinkEmulator {
+  public:
+    //! What happened to the segments sent
+    struct Stats {
+        uint64_t sent{0};          //!< Segments given to send()
+        uint64_t delivered{0};     //!< Segments taken by receive()
+        uint64_t random_drops{0};  //!< Lost at random (loss_rate)
+        uint64_t queue_drops{0};   //!< Dropped because the queue was full
+        uint64_t early_drops{0};   //!< Dropped by RED before the queue was full
+        uint64_t duplicates{0};    //!< Extra copies made (duplicate_rate)
+        uint64_t reordered{0};     //!< Held back so that later segments could overtake them (reorder_rate)
+    };
+
+  private:
+    LinkConfig _config;
+    std::mt19937 _rng;
+    Stats _stats{};
+
+    uint64_t _now_ns{0};  //!< The virtual clock
+
+    //! \name The bottleneck queue
+    //!@{
+    std::deque<std::pair<uint64_t, size_t>> _queue{};  //!< Departure time and size of each queued segment
+    size_t _queued_bytes{0};
+    uint64_t _busy_until_ns{0};  //!< When the bottleneck finishes serializing what is queued
+    double _red_average{0};      //!< RED's moving average of the queue, in bytes
+    size_t _red_count{0};        //!< Segments queued since RED last dropped one early
+    //!@}
+
+    std::multimap<uint64_t, TCPSegment> _in_flight{};  //!< Segments on their way, by arrival time
+    uint64_t _last_arrival_ns{0};                      //!< Arrival time of the last segment kept in order
+    std::deque<TCPSegment> _arrived{};                 //!< Segments that have arrived, in order of arrival
+
+    //! Forget the queued segments that have left the bottleneck
+    void _drain_queue();
+
+    //! Should RED drop a segment that finds `_queued_bytes` in the queue?
+    bool _red_drop(const size_t size);
+
+    //! Put a segment through the queue and on its way
+    void _enqueue(TCPSegment &&seg);
+
+  public:
+    //! \param[in] config is the path's behavior, kept for the emulator's lifetime
+    explicit LinkEmulator(const LinkConfig &config);
+
+    //! Bytes a segment takes on the wire: its payload, and TCP and IPv4 headers without options
+    static size_t wire_size(const TCPSegment &seg);
+
+    //! The path's behavior
+    const LinkConfig &config() const { return _config; }
+
+    //! Hand a segment to the link at the current time
+    void send(TCPSegment seg);
+
+    //! Let `ms` milliseconds of virtual time pass, and collect the segments that arrive meanwhile
+    void advance(const uint64_t ms);
+
+    //! Take the first segment that has arrived, if any
+    std::optional<TCPSegment> receive();
+
+    //! Number of segments that have arrived and not been taken
+    size_t arrived() const { return _arrived.size(); }
+
+    //! \brief Milliseconds (rounded up) until the next segment arrives
+    //! \returns 0 if one has arrived already, or nothing if none is on its way
+    std::optional<uint64_t> time_until_next_arrival() const;
+
+    //! Virtual time since the link was made, in milliseconds
+    uint64_t now_ms() const { return _now_ns / 1000000; }
+
+    //! Bytes waiting in the bottleneck queue, including the segment being serialized
+    size_t queued_bytes() const { return _queued_bytes; }
+
+    //! What happened to the segments sent
+    const Stats &stats() const { return _stats; }
+};
+
+#endif  // SPONGE_LIBSPONGE_LINK_EMULATOR_HH
@@ -2,15 +2,26 @@
 #define SPONGE_LIBSPONGE_LOSSY_FD_ADAPTER_HH
 
 #include "file_descriptor.hh"
+#include "link_emulator.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "util.hh"
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
 #include <random>
 #include <utility>
 
-//! An adapter class that adds random dropping behavior to an FD adapter
+//! \brief An adapter class that adds random dropping behavior, and an emulated path, to an FD adapter
+//! \details Segments are first dropped at random (FdAdapterConfig::loss_rate_up and loss_rate_dn), then
+//! carried by a LinkEmulator for each direction (FdAdapterConfig::link_up and link_dn), whose clock is
+//! advanced by tick(). Sent segments reach the underlying adapter when they arrive at the far end of the
+//! uplink; received ones are returned by read() when they arrive at the near end of the downlink. The
+//! owner ticks the adapter when time_until_next_timer() has passed, and then calls read() while pending().
+//!
+//! Each link is set up from the config when it carries its first segment (so after connect() or
+//! listen has set the config), and keeps that config.
 template <typename AdapterT>
 class LossyFdAdapter {
   private:
@@ -20,6 +31,28 @@ class LossyFdAdapter {
     //! The underlying FD adapter
     AdapterT _adapter;
 
+    //! \name The emulated paths of sent and received segments
+    //!@{
+    std::optional<LinkEmulator> _uplink{};
+    std::optional<LinkEmulator> _downlink{};
+    //!@}
+
+    //! The emulated path in one direction, set up from the config on first use
+    LinkEmulator &_link(const bool uplink) {
+        auto &link = uplink ? _uplink : _downlink;
+        if (not link) {
+            link.emplace(uplink ? config().link_up : config().link_dn);
+        }
+        return link.value();
+    }
+
+    //! Hand the segments that have crossed the uplink to the underlying adapter
+    void _write_arrived() {
+        while (auto seg = _uplink->receive()) {
+            _adapter.write(seg.value());
+        }
+    }
+
     //! \brief Determine whether or not to drop a given read or write
     //! \param[in] uplink is `true` to use the uplink loss probability, else use the downlink loss probability
     //! \returns `true` if the segment should be dropped
@@ -36,26 +69,78 @@ class LossyFdAdapter {
     //! Construct from a FileDescriptor appropriate to the AdapterT constructor
     explicit LossyFdAdapter(AdapterT &&adapter) : _adapter(std::move(adapter)) {}
 
-    //! \brief Read from the underlying AdapterT instance, potentially dropping the read datagram
-    //! \returns std::optional<TCPSegment> that is empty if the segment was dropped or if
-    //!          the underlying AdapterT returned an empty value
+    //! \brief Read from the underlying AdapterT instance, potentially dropping or delaying the read datagram
+    //! \returns std::optional<TCPSegment> that is empty if the segment was dropped or is still on its way,
+    //!          or if the underlying AdapterT returned an empty value; or else the next segment that arrived
+    //! \note The underlying AdapterT is only read if no delayed segment has arrived yet (see pending())
     std::optional<TCPSegment> read() {
+        LinkEmulator &link = _link(false);
+        if (link.arrived() > 0) {
+            return link.receive();
+        }
         auto ret = _adapter.read();
         if (_should_drop(false)) {
             return {};
         }
-        return ret;
+        if (link.config().passthrough() or not ret.has_value()) {
+            return ret;
+        }
+        link.send(std::move(ret.value()));
+        return link.receive();
     }
 
-    //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
-    //! \param[in] seg is the packet to either write or drop
+    //! \brief Write to the underlying AdapterT instance, potentially dropping or delaying the datagram
+    //! \param[in] seg is the packet to either write, drop, or send along the uplink
     void write(TCPSegment &seg) {
         if (_should_drop(true)) {
             return;
         }
-        return _adapter.write(seg);
+        LinkEmulator &link = _link(true);
+        if (link.config().passthrough()) {
+            return _adapter.write(seg);
+        }
+        link.send(seg);
+        _write_arrived();
+    }
+
+    //! Advance both links' clocks, and send what has crossed the uplink (tick() of the underlying AdapterT too)
+    void tick(const size_t ms_since_last_tick) {
+        _adapter.tick(ms_since_last_tick);
+        if (_downlink) {
+            _downlink->advance(ms_since_last_tick);
+        }
+        if (_uplink) {
+            _uplink->advance(ms_since_last_tick);
+            if (_uplink->arrived() > 0) {
+                _write_arrived();
+                _adapter.flush();
+            }
+        }
+    }
+
+    //! Number of segments read() will return without a system call: those the underlying AdapterT holds,
+    //! and those that have arrived through the downlink
+    size_t pending() const { return _adapter.pending() + (_downlink ? _downlink->arrived() : 0); }
+
+    //! \brief Milliseconds until a segment on either link arrives (and the adapter must be ticked)
+    //! \returns nothing if no segment is on its way
+    std::optional<uint64_t> time_until_next_timer() const {
+        std::optional<uint64_t> ret{};
+        for (const auto &link : {&_uplink, &_downlink}) {
+            const auto wait = link->has_value() ? link->value().time_until_next_arrival() : std::nullopt;
+            if (wait.has_value()) {
+                ret = std::min(ret.value_or(wait.value()), wait.value());
+            }
+        }
+        return ret;
     }
 
+    //! The emulated path of sent segments (set up from FdAdapterConfig::link_up on first use)
+    const LinkEmulator &uplink() { return _link(true); }
+
+    //! The emulated path of received segments (set up from FdAdapterConfig::link_dn on first use)
+    const LinkEmulator &downlink() { return _link(false); }
+
     //! \name
     //! Passthrough functions to the underlying AdapterT instance
 
@@ -63,9 +148,8 @@ class LossyFdAdapter {
     void set_listening(const bool l) { _adapter.set_listening(l); }      //!< FdAdapterBase::set_listening passthrough
     const FdAdapterConfig &config() const { return _adapter.config(); }  //!< FdAdapterBase::config passthrough
     FdAdapterConfig &config_mut() { return _adapter.config_mut(); }      //!< FdAdapterBase::config_mut passthrough
-    void tick(const size_t ms_since_last_tick) {
-        _adapter.tick(ms_since_last_tick);
-    }  //!< FdAdapterBase::tick passthrough
+    void flush() { _adapter.flush(); }                                   //!< FdAdapterBase::flush passthrough
+    void set_mss(const size_t mss) { _adapter.set_mss(mss); }            //!< FdAdapterBase::set_mss passthrough
     //!@}
 };
 
@@ -0,0 +1,56 @@
+#include "rtt_estimator.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Gains of the smoothed round-trip time and of the variation (RFC 6298, section 2)
+static constexpr double ALPHA = 1.0 / 8;
+static constexpr double BETA = 1.0 / 4;
+
+//! The bounds are handed to std::clamp, which requires `min_rto <= max_rto`
+static void check_bounds(const uint64_t min_rto, const uint64_t max_rto) {
+    if (min_rto > max_rto) {
+        throw runtime_error("RTTEstimator: min_rto (" + to_string(min_rto) + ") exceeds max_rto (" +
+                            to_string(max_rto) + ")");
+    }
+}
+
+//! \param[in] initial_rto is the timeout before anything has been measured
+//! \param[in] min_rto is the smallest timeout computed from measurements
+//! \param[in] max_rto is the largest timeout, also after backoff
+RTTEstimator::RTTEstimator(const uint64_t initial_rto, const uint64_t min_rto, const uint64_t max_rto)
+    : _min_rto(min_rto), _max_rto(max_rto) {
+    check_bounds(min_rto, max_rto);
+    _stats.rto = initial_rto;
+}
+
+void RTTEstimator::set_bounds(const uint64_t min_rto, const uint64_t max_rto) {
+    check_bounds(min_rto, max_rto);
+    _min_rto = min_rto;
+    _max_rto = max_rto;
+}
+
+//! \param[in] rtt is the measured round-trip time
+//! \details The first measurement R sets SRTT = R and RTTVAR = R/2; later ones update RTTVAR (using the
+//! old SRTT) and then SRTT. RTO = SRTT + max(G, 4 * RTTVAR), rounded up and clamped to the bounds.
+void RTTEstimator::add_sample(const uint64_t rtt) {
+    const double r = static_cast<double>(rtt);
+    if (_stats.samples == 0) {
+        _stats.srtt = r;
+        _stats.rttvar = r / 2;
+        _stats.min_rtt = rtt;
+    } else {
+        _stats.rttvar = (1 - BETA) * _stats.rttvar + BETA * abs(_stats.srtt - r);
+        _stats.srtt = (1 - ALPHA) * _stats.srtt + ALPHA * r;
+        _stats.min_rtt = min(_stats.min_rtt, rtt);
+    }
+    _stats.samples++;
+    _stats.latest_rtt = rtt;
+
+    const double rto = _stats.srtt + max(static_cast<double>(CLOCK_GRANULARITY), 4 * _stats.rttvar);
+    _stats.rto = clamp(static_cast<uint64_t>(ceil(rto)), _min_rto, _max_rto);
+}
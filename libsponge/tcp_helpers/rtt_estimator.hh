@@ -0,0 +1,51 @@
+#ifndef SPONGE_LIBSPONGE_RTT_ESTIMATOR_HH
+#define SPONGE_LIBSPONGE_RTT_ESTIMATOR_HH
+
+#include <cstdint>
+
+//! \brief Round-trip time estimation and the retransmission timeout ([RFC 6298](\ref rfc::rfc6298))
+//! \details Times are in milliseconds of the sender's tick() clock, whose 1 ms resolution is the clock
+//! granularity G of the RFC. Until the first measurement the timeout is the initial one, unclamped.
+class RTTEstimator {
+  public:
+    static constexpr uint64_t CLOCK_GRANULARITY = 1;  //!< G, in milliseconds
+
+    //! Measurements and the estimate made from them
+    struct Stats {
+        uint64_t samples{0};     //!< Measurements taken
+        uint64_t latest_rtt{0};  //!< The most recent measurement
+        uint64_t min_rtt{0};     //!< The smallest measurement
+        double srtt{0};          //!< Smoothed round-trip time
+        double rttvar{0};        //!< Round-trip time variation
+        uint64_t rto{0};         //!< Retransmission timeout
+    };
+
+  private:
+    uint64_t _min_rto;
+    uint64_t _max_rto;
+    Stats _stats{};
+
+  public:
+    //! \param[in] initial_rto is the timeout before anything has been measured
+    //! \param[in] min_rto and max_rto bound the timeout computed from measurements
+    //! \throws std::runtime_error if `min_rto > max_rto`
+    RTTEstimator(const uint64_t initial_rto, const uint64_t min_rto, const uint64_t max_rto);
+
+    //! \brief Change the bounds on the timeout (applied from the next measurement)
+    //! \throws std::runtime_error if `min_rto > max_rto`, leaving the bounds unchanged
+    void set_bounds(const uint64_t min_rto, const uint64_t max_rto);
+
+    //! \brief Update the estimate with a round-trip time measured on an unambiguous ACK
+    void add_sample(const uint64_t rtt);
+
+    //! \brief The retransmission timeout, before any backoff
+    uint64_t rto() const { return _stats.rto; }
+
+    //! \brief The largest the timeout may become, also after backoff
+    uint64_t max_rto() const { return _max_rto; }
+
+    //! \brief Measurements and the current estimate
+    const Stats &stats() const { return _stats; }
+};
+
+#endif  // SPONGE_LIBSPONGE_RTT_ESTIMATOR_HH
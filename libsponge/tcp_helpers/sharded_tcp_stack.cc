@@ -0,0 +1,94 @@
+#include "sharded_tcp_stack.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+//! \details The first socket binds `address` and gets the steering program; the rest bind the address it
+//! ended up with, joining the SO_REUSEPORT group in order, so that socket index i is worker i.
+ShardedTCPStack::ShardedTCPStack(const Address &address, const size_t workers, const TCPConfig &config) {
+    if (workers == 0) {
+        throw runtime_error("ShardedTCPStack: no workers");
+    }
+
+    Address shared_address = address;
+    for (size_t i = 0; i < workers; i++) {
+        UDPSocket socket;
+        socket.set_reuseport();
+        socket.bind(shared_address);
+        if (i == 0) {
+            socket.attach_reuseport_cbpf(TCPStack::flow_steering_program(workers));
+            shared_address = socket.local_address();
+        }
+        _workers.push_back(make_unique<Worker>(move(socket), config));
+        _workers.back()->stack.set_shard(i, workers);
+    }
+}
+
+ShardedTCPStack::~ShardedTCPStack() {
+    try {
+        stop();
+    } catch (const exception &e) {
+        // don't throw an exception from the destructor
+        cerr << "Exception in ShardedTCPStack worker: " << e.what() << endl;
+    }
+}
+
+void ShardedTCPStack::listen(const uint16_t port) {
+    if (_started) {
+        throw runtime_error("ShardedTCPStack: listen() after start()");
+    }
+    for (auto &worker : _workers) {
+        worker->stack.listen(port);
+    }
+}
+
+TCPStack &ShardedTCPStack::stack(const size_t index) {
+    if (_started) {
+        throw runtime_error("ShardedTCPStack: a worker's stack is in use by its thread");
+    }
+    return _workers.at(index)->stack;
+}
+
+//! \param[in] service is called by each worker thread with its own stack
+void ShardedTCPStack::start(const Service &service) {
+    if (_started) {
+        throw runtime_error("ShardedTCPStack: already started");
+    }
+    _started = true;
+    _stopping = false;
+    for (size_t i = 0; i < _workers.size(); i++) {
+        Worker &worker = *_workers[i];
+        worker.thread = thread([this, &worker, i, service] { _run(worker, i, service); });
+    }
+}
+
+void ShardedTCPStack::_run(Worker &worker, const size_t index, const Service &service) {
+    try {
+        while (not _stopping.load(memory_order_relaxed)) {
+            worker.stack.wait_next_event(WAIT_MS);
+            service(worker.stack, index);
+        }
+    } catch (...) {
+        worker.error = current_exception();
+    }
+}
+
+void ShardedTCPStack::stop() {
+    if (not _started) {
+        return;
+    }
+    _stopping = true;
+    for (auto &worker : _workers) {
+        worker->thread.join();
+    }
+    _started = false;
+
+    for (auto &worker : _workers) {
+        if (worker->error) {
+            rethrow_exception(exchange(worker->error, nullptr));
+        }
+    }
+}
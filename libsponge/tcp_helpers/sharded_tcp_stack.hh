@@ -0,0 +1,87 @@
+#ifndef SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+
+#include "address.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//! \brief TCP connections spread over a fixed pool of worker threads, each owning its share outright
+//! \details Each worker has its own TCPStack (and so its own EventLoop, TimerWheel, and connections) on
+//! its own UDP socket. The sockets share one address with SO_REUSEPORT, and a classic BPF program
+//! (TCPStack::flow_steering_program) makes the kernel deliver every segment to the socket of the worker
+//! whose index is TCPStack::flow_hash() of the connection's 4-tuple, modulo the number of workers, much as
+//! a NIC's receive-side scaling picks a queue. Connections opened by a worker use a local port that hashes
+//! back to it. So every connection is only ever touched by one thread, and the workers share no locks.
+//!
+//! Set up the workers (e.g. listen()) before start(). After start(), each worker calls the service
+//! function on its own stack after every pass through its event loop; that is where the application
+//! accepts, reads, writes, and connects. stop() (or destruction) ends the workers.
+class ShardedTCPStack {
+  public:
+    //! Called by worker `index` with its stack after each TCPStack::wait_next_event
+    using Service = std::function<void(TCPStack &stack, const size_t index)>;
+
+    //! Longest a worker waits for datagrams before calling the service and checking for stop()
+    static constexpr int WAIT_MS = 10;
+
+  private:
+    //! One worker thread and what it owns
+    struct Worker {
+        TCPStack stack;
+        std::thread thread{};
+        std::exception_ptr error{};  //!< What ended the thread early, if anything
+
+        explicit Worker(UDPSocket &&socket, const TCPConfig &config) : stack(std::move(socket), config) {}
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers{};
+    std::atomic<bool> _stopping{false};
+    bool _started{false};
+
+    //! Body of each worker thread
+    void _run(Worker &worker, const size_t index, const Service &service);
+
+  public:
+    //! \brief Bind `workers` UDP sockets to `address`, and steer segments among them
+    //! \param[in] address is where peers send segments (port 0 picks one for all the workers)
+    //! \param[in] workers is the number of worker threads
+    //! \param[in] config is used for every connection
+    ShardedTCPStack(const Address &address, const size_t workers, const TCPConfig &config = {});
+
+    //! Stops the workers
+    ~ShardedTCPStack();
+
+    //! \brief Accept connections to `port` on every worker (only before start())
+    void listen(const uint16_t port);
+
+    //! \brief Worker `index`'s stack (only to be used before start() or after stop())
+    TCPStack &stack(const size_t index);
+
+    //! \brief Start a thread per worker, running the event loop and `service`
+    void start(const Service &service);
+
+    //! \brief Stop and join the worker threads; rethrows the first exception a worker ended with
+    void stop();
+
+    //! \brief Number of workers
+    size_t size() const { return _workers.size(); }
+
+    //! \brief The address shared by the workers
+    Address local_address() const { return _workers.front()->stack.local_address(); }
+
+    //! \name A ShardedTCPStack cannot be copied or moved
+    //!@{
+    ShardedTCPStack(const ShardedTCPStack &other) = delete;
+    ShardedTCPStack &operator=(const ShardedTCPStack &other) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
@@ -15,11 +15,87 @@ class TCPConfig {
     static constexpr size_t MAX_PAYLOAD_SIZE = 1000;   //!< Conservative max payload size for real Internet
     static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
     static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+    static constexpr uint8_t MAX_WINDOW_SHIFT = 14;    //!< Largest window scale shift count (RFC 7323)
+    static constexpr uint16_t RTO_MIN_DFLT = 200;      //!< Default lower bound on a measured RTO (as Linux)
+    static constexpr uint32_t RTO_MAX_DFLT = 60000;    //!< Default upper bound on the RTO (RFC 6298)
+    static constexpr uint16_t ACK_DELAY_DFLT = 40;     //!< Default delayed-ACK timeout (as Linux's minimum)
+
+    //! Congestion control algorithms for the TCPSender (see CongestionController)
+    enum class CongestionControl { None, Reno, Cubic };
 
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
     size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
     std::optional<WrappingInt32> fixed_isn{};
+
+    //! Largest payload to send (lowered to the peer's MSS option, if smaller); advertised in the SYN
+    //! if it is not MAX_PAYLOAD_SIZE
+    size_t mss = MAX_PAYLOAD_SIZE;
+
+    //! Offer window scaling in the SYN, so windows (up to recv_capacity) above 64 KiB can be advertised
+    bool window_scaling = false;
+
+    //! Congestion control; with None, the sender is limited only by the receiver's window
+    CongestionControl congestion_control = CongestionControl::None;
+
+    //! Compute the retransmission timeout from measured round-trip times (RFC 6298), within
+    //! [rto_min, rto_max]; rt_timeout is then only the timeout before the first measurement
+    bool adaptive_rto = false;
+    uint16_t rto_min = RTO_MIN_DFLT;  //!< Smallest measured RTO, in milliseconds
+    uint32_t rto_max = RTO_MAX_DFLT;  //!< Largest RTO, also after backoff, in milliseconds
+
+    //! Offer the timestamps option (RFC 7323), which lets every ACK, even of a retransmission, be timed
+    bool timestamps = false;
+
+    //! Offer selective acknowledgments (RFC 2018), so that after a loss only the missing segments are resent
+    bool sack = false;
+
+    //! Delay ACKs (RFC 1122, RFC 5681): ACK every second full segment, or ack_delay milliseconds after the
+    //! first unacknowledged one, but at once for out-of-order data, a FIN, or data that fills a gap
+    bool delayed_ack = false;
+    uint16_t ack_delay = ACK_DELAY_DFLT;  //!< Longest time an ACK is held back, in milliseconds
+
+    //! Nagle's algorithm (RFC 896): while data is unacknowledged, coalesce small writes into full segments
+    //! (TCPConnection::set_nodelay() changes it later)
+    bool nagle = false;
+};
+
+//! Config for one direction of an emulated network path (see LinkEmulator)
+class LinkConfig {
+  public:
+    //! What the bottleneck queue does with a segment that arrives while it is filling up
+    enum class QueueDiscipline {
+        DropTail,  //!< Drop it only if it does not fit
+        RED        //!< Also drop it with a probability that grows with the average queue (Random Early Detection)
+    };
+
+    uint64_t delay_ms = 0;   //!< One-way propagation delay
+    uint64_t jitter_ms = 0;  //!< Most extra delay a segment gets, uniformly at random (without reordering)
+
+    uint64_t rate_bps = 0;                                         //!< Bottleneck rate, in bit/s (0: none)
+    size_t queue_limit = 0;                                        //!< Bytes the bottleneck queue holds (0: no limit)
+    QueueDiscipline queue_discipline = QueueDiscipline::DropTail;  //!< How the queue drops
+
+    //! \name RED parameters (see Floyd and Jacobson, 1993)
+    //!@{
+    size_t red_min_threshold = 0;  //!< Average queue, in bytes, below which no segment is dropped early
+    size_t red_max_threshold = 0;  //!< Average queue, in bytes, at and above which every segment is dropped
+    double red_max_p = 0.1;        //!< Drop probability as the average queue reaches red_max_threshold
+    double red_weight = 0.002;     //!< Weight of the current queue in the moving average
+    //!@}
+
+    double loss_rate = 0;           //!< Probability that a segment is lost at random before the queue
+    double duplicate_rate = 0;      //!< Probability that a segment is delivered twice
+    double reorder_rate = 0;        //!< Probability that a segment is held back by reorder_delay_ms
+    uint64_t reorder_delay_ms = 3;  //!< Extra delay of a held-back segment, which lets later ones overtake it
+
+    unsigned int seed = 1;  //!< Seed of the link's random choices; the same seed and traffic give the same run
+
+    //! Does the link do anything to the segments it carries?
+    bool passthrough() const {
+        return delay_ms == 0 and jitter_ms == 0 and rate_bps == 0 and loss_rate == 0 and duplicate_rate == 0 and
+               reorder_rate == 0;
+    }
 };
 
 //! Config for classes derived from FdAdapter
@@ -30,6 +106,9 @@ class FdAdapterConfig {
 
     uint16_t loss_rate_dn = 0;  //!< Downlink loss rate (for LossyFdAdapter)
     uint16_t loss_rate_up = 0;  //!< Uplink loss rate (for LossyFdAdapter)
+
+    LinkConfig link_dn{};  //!< Emulated path of received segments (for LossyFdAdapter)
+    LinkConfig link_up{};  //!< Emulated path of sent segments (for LossyFdAdapter)
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_CONFIG_HH
@@ -1,9 +1,89 @@
 #include "tcp_header.hh"
 
+#include <algorithm>
+#include <string_view>
 #include <sstream>
 
 using namespace std;
 
+//! \name Option kinds
+//!@{
+static constexpr uint8_t OPT_EOL = 0;
+static constexpr uint8_t OPT_NOP = 1;
+static constexpr uint8_t OPT_MSS = 2;
+static constexpr uint8_t OPT_WSCALE = 3;
+static constexpr uint8_t OPT_SACK_PERMITTED = 4;
+static constexpr uint8_t OPT_SACK = 5;
+static constexpr uint8_t OPT_TIMESTAMPS = 8;
+//!@}
+
+static constexpr size_t MSS_LENGTH = 4;          //!< kind, length, 16-bit MSS
+static constexpr size_t WSCALE_LENGTH = 4;       //!< NOP (for alignment), kind, length, shift count
+static constexpr size_t TIMESTAMPS_LENGTH = 12;  //!< two NOPs (for alignment), kind, length, TSval, TSecr
+static constexpr size_t SACK_PERMITTED_LENGTH = 4;  //!< two NOPs (for alignment), kind, length
+static constexpr size_t SACK_HEADER_LENGTH = 4;     //!< two NOPs (for alignment), kind, length; then the blocks
+static constexpr size_t SACK_BLOCK_LENGTH = 8;      //!< left and right edges
+
+//! Length of the SACK option carrying `blocks` blocks
+static size_t sack_length(const size_t blocks) {
+    return blocks == 0 ? 0 : SACK_HEADER_LENGTH + SACK_BLOCK_LENGTH * blocks;
+}
+
+size_t TCPHeader::options_length() const {
+    return (mss.has_value() ? MSS_LENGTH : 0) + (wscale.has_value() ? WSCALE_LENGTH : 0) +
+           (timestamps.has_value() ? TIMESTAMPS_LENGTH : 0) + (sack_permitted ? SACK_PERMITTED_LENGTH : 0) +
+           sack_length(sack_blocks.size());
+}
+
+size_t TCPHeader::sack_block_room() const {
+    const size_t used = LENGTH + options_length() - sack_length(sack_blocks.size()) + SACK_HEADER_LENGTH;
+    return used >= MAX_LENGTH ? 0 : min((MAX_LENGTH - used) / SACK_BLOCK_LENGTH, MAX_SACK_BLOCKS);
+}
+
+//! \param[in] options is the part of the header after the fixed 20 bytes
+//! \details Unknown options are skipped. A malformed option (bad length) ends parsing, leaving the options
+//! before it, as many stacks do; it is not a reason to drop the segment.
+static void parse_options(TCPHeader &header, const string_view options) {
+    size_t i = 0;
+    while (i < options.size()) {
+        const uint8_t kind = options[i];
+        if (kind == OPT_EOL) {
+            break;
+        }
+        if (kind == OPT_NOP) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= options.size()) {
+            break;
+        }
+        const uint8_t length = options[i + 1];
+        if (length < 2 or i + length > options.size()) {
+            break;
+        }
+
+        const auto byte = [&](const size_t offset) { return static_cast<uint8_t>(options[i + offset]); };
+        const auto word = [&](const size_t offset) {
+            return (uint32_t{byte(offset)} << 24) | (uint32_t{byte(offset + 1)} << 16) |
+                   (uint32_t{byte(offset + 2)} << 8) | byte(offset + 3);
+        };
+        if (kind == OPT_MSS and length == MSS_LENGTH) {
+            header.mss = (byte(2) << 8) | byte(3);
+        } else if (kind == OPT_WSCALE and length == WSCALE_LENGTH - 1) {
+            header.wscale = byte(2);
+        } else if (kind == OPT_TIMESTAMPS and length == TIMESTAMPS_LENGTH - 2) {
+            header.timestamps = TCPHeader::Timestamps{word(2), word(6)};
+        } else if (kind == OPT_SACK_PERMITTED and length == 2) {
+            header.sack_permitted = true;
+        } else if (kind == OPT_SACK and (length - 2) % SACK_BLOCK_LENGTH == 0) {
+            for (size_t offset = 2; offset < length; offset += SACK_BLOCK_LENGTH) {
+                header.sack_blocks.push_back({WrappingInt32{word(offset)}, WrappingInt32{word(offset + 4)}});
+            }
+        }
+        i += length;
+    }
+}
+
 //! \param[in,out] p is a NetParser from which the TCP fields will be extracted
 //! \returns a ParseResult indicating success or the reason for failure
 //! \details It is important to check for (at least) the following potential errors
@@ -15,13 +95,23 @@ using namespace std;
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
 ParseResult TCPHeader::parse(NetParser &p) {
-    sport = p.u16();                 // source port
-    dport = p.u16();                 // destination port
-    seqno = WrappingInt32{p.u32()};  // sequence number
-    ackno = WrappingInt32{p.u32()};  // ack number
-    doff = p.u8() >> 4;              // data offset
+    // the length is checked once for the whole fixed header, which is then read in place
+    const NetSpan header = p.span(TCPHeader::LENGTH);
+    if (p.error()) {
+        // as when the fields were read one by one: the data offset is known if the header got that far
+        const string_view partial = p.buffer().str();
+        constexpr size_t doff_offset = 12;
+        doff = partial.size() > doff_offset ? static_cast<uint8_t>(partial[doff_offset]) >> 4 : 0;
+        return doff < 5 ? ParseResult::HeaderTooShort : p.get_error();
+    }
 
-    const uint8_t fl_b = p.u8();                  // byte including flags
+    sport = header.u16(0);                 // source port
+    dport = header.u16(2);                 // destination port
+    seqno = WrappingInt32{header.u32(4)};  // sequence number
+    ackno = WrappingInt32{header.u32(8)};  // ack number
+    doff = header.u8(12) >> 4;             // data offset
+
+    const uint8_t fl_b = header.u8(13);           // byte including flags
     urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
     ack = static_cast<bool>(fl_b & 0b0001'0000);
     psh = static_cast<bool>(fl_b & 0b0000'1000);
@@ -29,16 +119,25 @@ ParseResult TCPHeader::parse(NetParser &p) {
     syn = static_cast<bool>(fl_b & 0b0000'0010);
     fin = static_cast<bool>(fl_b & 0b0000'0001);
 
-    win = p.u16();    // window size
-    cksum = p.u16();  // checksum
-    uptr = p.u16();   // urgent pointer
+    win = header.u16(14);    // window size
+    cksum = header.u16(16);  // checksum
+    uptr = header.u16(18);   // urgent pointer
 
     if (doff < 5) {
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
+    // parse the options we know, and skip the rest of the header
+    const size_t options_size = doff * 4 - TCPHeader::LENGTH;
+    mss.reset();
+    wscale.reset();
+    timestamps.reset();
+    sack_permitted = false;
+    sack_blocks.clear();
+    if (not p.error() and p.buffer().size() >= options_size) {
+        parse_options(*this, p.buffer().str().substr(0, options_size));
+    }
+    p.remove_prefix(options_size);
 
     if (p.error()) {
         return p.get_error();
@@ -49,32 +148,84 @@ ParseResult TCPHeader::parse(NetParser &p) {
 
 //! Serialize the TCPHeader to a string (does not recompute the checksum)
 string TCPHeader::serialize() const {
-    // sanity check
+    Serialized out;
+    const size_t length = serialize_into(out);
+    return string(reinterpret_cast<const char *>(out.data()), length);
+}
+
+//! \param[out] out receives the header, padded with zeros to its advertised size (does not recompute the checksum)
+//! \returns the number of bytes written, `4 * doff`
+size_t TCPHeader::serialize_into(Serialized &out) const {
+    // sanity checks
     if (doff < 5) {
         throw runtime_error("TCP header too short");
     }
+    if (4 * doff > MAX_LENGTH) {
+        throw runtime_error("TCP header too long");
+    }
+    const size_t length = 4 * doff;
+    if (LENGTH + options_length() > length) {
+        throw runtime_error("TCP options do not fit in the header (see set_doff_for_options)");
+    }
 
-    string ret;
-    ret.reserve(4 * doff);
+    uint8_t *p = out.data();
 
-    NetUnparser::u16(ret, sport);              // source port
-    NetUnparser::u16(ret, dport);              // destination port
-    NetUnparser::u32(ret, seqno.raw_value());  // sequence number
-    NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
+    p = NetUnparser::u16(p, sport);              // source port
+    p = NetUnparser::u16(p, dport);              // destination port
+    p = NetUnparser::u32(p, seqno.raw_value());  // sequence number
+    p = NetUnparser::u32(p, ackno.raw_value());  // ack number
+    p = NetUnparser::u8(p, doff << 4);           // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
                          (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
-    NetUnparser::u8(ret, fl_b);  // flags
-    NetUnparser::u16(ret, win);  // window size
+    p = NetUnparser::u8(p, fl_b);  // flags
+    p = NetUnparser::u16(p, win);  // window size
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    p = NetUnparser::u16(p, cksum);  // checksum
 
-    NetUnparser::u16(ret, uptr);  // urgent pointer
+    p = NetUnparser::u16(p, uptr);  // urgent pointer
 
-    ret.resize(4 * doff);  // expand header to advertised size
+    // options
+    if (mss.has_value()) {
+        p = NetUnparser::u8(p, OPT_MSS);
+        p = NetUnparser::u8(p, MSS_LENGTH);
+        p = NetUnparser::u16(p, mss.value());
+    }
+    if (wscale.has_value()) {
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_WSCALE);
+        p = NetUnparser::u8(p, WSCALE_LENGTH - 1);
+        p = NetUnparser::u8(p, wscale.value());
+    }
+    if (timestamps.has_value()) {
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_TIMESTAMPS);
+        p = NetUnparser::u8(p, TIMESTAMPS_LENGTH - 2);
+        p = NetUnparser::u32(p, timestamps->value);
+        p = NetUnparser::u32(p, timestamps->echo_reply);
+    }
+    if (sack_permitted) {
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_SACK_PERMITTED);
+        p = NetUnparser::u8(p, 2);
+    }
+    if (not sack_blocks.empty()) {
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_NOP);
+        p = NetUnparser::u8(p, OPT_SACK);
+        p = NetUnparser::u8(p, SACK_HEADER_LENGTH - 2 + SACK_BLOCK_LENGTH * sack_blocks.size());
+        for (const auto &block : sack_blocks) {
+            p = NetUnparser::u32(p, block.left.raw_value());
+            p = NetUnparser::u32(p, block.right.raw_value());
+        }
+    }
+
+    // expand header to advertised size
+    fill(p, out.data() + length, 0);
 
-    return ret;
+    return length;
 }
 
 //! \returns A string with the header's contents
@@ -90,6 +241,21 @@ string TCPHeader::to_string() const {
        << "TCP winsize: " << +win << '\n'
        << "TCP cksum: " << +cksum << '\n'
        << "TCP uptr: " << +uptr << '\n';
+    if (mss.has_value()) {
+        ss << "TCP MSS option: " << dec << mss.value() << '\n';
+    }
+    if (wscale.has_value()) {
+        ss << "TCP window scale option: " << dec << +wscale.value() << '\n';
+    }
+    if (timestamps.has_value()) {
+        ss << "TCP timestamps option: " << dec << timestamps->value << " echo " << timestamps->echo_reply << '\n';
+    }
+    if (sack_permitted) {
+        ss << "TCP SACK-permitted option\n";
+    }
+    for (const auto &block : sack_blocks) {
+        ss << "TCP SACK block: " << dec << block.left << " to " << block.right << '\n';
+    }
     return ss.str();
 }
 
@@ -104,5 +270,6 @@ bool TCPHeader::operator==(const TCPHeader &other) const {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
     return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg && ack == other.ack &&
            psh == other.psh && rst == other.rst && syn == other.syn && fin == other.fin && win == other.win &&
-           uptr == other.uptr;
+           uptr == other.uptr && mss == other.mss && wscale == other.wscale && timestamps == other.timestamps &&
+           sack_permitted == other.sack_permitted && sack_blocks == other.sack_blocks;
 }
@@ -4,10 +4,21 @@
 #include "parser.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
+#include <optional>
+#include <vector>
+
 //! \brief [TCP](\ref rfc::rfc793) segment header
-//! \note TCP options are not supported
+//! \note Of the TCP options, only MSS ([RFC 793](\ref rfc::rfc793)), window scale and timestamps
+//! ([RFC 7323](\ref rfc::rfc7323)), and SACK ([RFC 2018](\ref rfc::rfc2018)) are understood; others are
+//! skipped when parsing.
 struct TCPHeader {
-    static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t LENGTH = 20;          //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t MAX_LENGTH = 60;      //!< Largest header `doff` can describe
+    static constexpr size_t MAX_SACK_BLOCKS = 4;  //!< Most SACK blocks that fit in the option space
+
+    //! Caller-provided storage for a serialized header
+    using Serialized = std::array<uint8_t, MAX_LENGTH>;
 
     //! \struct TCPHeader
     //! ~~~{.txt}
@@ -50,12 +61,52 @@ struct TCPHeader {
     uint16_t uptr = 0;          //!< urgent pointer
     //!@}
 
+    //! Contents of the timestamps option
+    struct Timestamps {
+        uint32_t value;       //!< TSval: the sender's clock when the segment was sent
+        uint32_t echo_reply;  //!< TSecr: the latest TSval the sender received from its peer
+
+        bool operator==(const Timestamps &other) const {
+            return value == other.value and echo_reply == other.echo_reply;
+        }
+    };
+
+    //! A block of data held by the receiver beyond the ackno, [left, right)
+    struct SackBlock {
+        WrappingInt32 left{0};   //!< first sequence number of the block
+        WrappingInt32 right{0};  //!< sequence number just past the block
+
+        bool operator==(const SackBlock &other) const { return left == other.left and right == other.right; }
+    };
+
+    //! \name TCP options (MSS, window scale and SACK-permitted only on SYN segments)
+    //!@{
+    std::optional<uint16_t> mss{};           //!< maximum segment size the sender of this header will accept
+    std::optional<uint8_t> wscale{};         //!< window scale shift count the sender of this header will apply
+    std::optional<Timestamps> timestamps{};  //!< timestamps, on every segment once both SYNs carried them
+    bool sack_permitted = false;             //!< the sender of this header understands SACK blocks
+    std::vector<SackBlock> sack_blocks{};    //!< data the sender of this header holds beyond the ackno
+    //!@}
+
+    //! Length of the options that are set, padded to a multiple of 4 bytes
+    size_t options_length() const;
+
+    //! How many SACK blocks fit beside the other options that are set
+    size_t sack_block_room() const;
+
+    //! Set `doff` to cover the fixed header and the options that are set
+    void set_doff_for_options() { doff = (LENGTH + options_length()) / 4; }
+
     //! Parse the TCP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
     //! Serialize the TCP fields
+    //! \note The header is `4 * doff` bytes long, which must leave room for the options (see set_doff_for_options)
     std::string serialize() const;
 
+    //! Serialize the TCP fields into `out` without allocating; returns the header length
+    size_t serialize_into(Serialized &out) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 
@@ -3,8 +3,10 @@
 #include "ipv4_datagram.hh"
 #include "ipv4_header.hh"
 #include "parser.hh"
+#include "util.hh"
 
 #include <arpa/inet.h>
+#include <cstring>
 #include <stdexcept>
 #include <unistd.h>
 #include <utility>
@@ -22,8 +24,11 @@ using namespace std;
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//! \param[in] ip_dgram is the datagram that may carry a segment
+//! \param[in] verify_checksum is `false` if the TCP checksum is known to be good (or left for offload)
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram) {
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                          const bool verify_checksum) {
     // is the IPv4 datagram for us?
     // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
     if (not listening() and (ip_dgram.header().dst != config().source.ipv4_numeric())) {
@@ -42,7 +47,7 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
 
     // is the payload a valid TCP segment?
     TCPSegment tcp_seg;
-    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(), verify_checksum)) {
         return {};
     }
 
@@ -70,21 +75,163 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
     return tcp_seg;
 }
 
-//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
-//! \param[in] seg is the TCP segment to convert
-InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
+//! \param[in,out] seg is the TCP segment to be carried; its port numbers are set here
+IPv4Header TCPOverIPv4Adapter::ip_header_for(TCPSegment &seg) const {
     // set the port numbers in the TCP segment
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
 
-    // create an Internet Datagram and set its addresses and length
+    // set the datagram's addresses and length
+    IPv4Header ip_header;
+    ip_header.src = config().source.ipv4_numeric();
+    ip_header.dst = config().destination.ipv4_numeric();
+    ip_header.len = ip_header.hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+
+    return ip_header;
+}
+
+//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
+//! \param[in] seg is the TCP segment to convert
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
     InternetDatagram ip_dgram;
-    ip_dgram.header().src = config().source.ipv4_numeric();
-    ip_dgram.header().dst = config().destination.ipv4_numeric();
-    ip_dgram.header().len = ip_dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    ip_dgram.header() = ip_header_for(seg);
 
     // set payload, calculating TCP checksum using information from IP header
     ip_dgram.payload() = seg.serialize(ip_dgram.header().pseudo_cksum());
 
     return ip_dgram;
 }
+
+//! \param[in] seg is the TCP segment to convert
+//! \param[out] headers receives the serialized IPv4 and TCP headers; must outlive the returned iovecs
+//! \details The iovecs point into `headers` and into the segment's payload, so the datagram can be
+//! handed to [writev(2)](\ref man2::writev) without being copied into one contiguous string.
+array<iovec, 3> TCPOverIPv4Adapter::wrap_tcp_in_ip_into(TCPSegment &seg, SerializedHeaders &headers) {
+    IPv4Header ip_header = ip_header_for(seg);
+
+    // TCP header, with its checksum computed using information from the IP header
+    const size_t tcp_length = seg.serialize_header_into(headers.tcp, ip_header.pseudo_cksum());
+
+    const size_t ip_length = serialize_ip_header_into(ip_header, headers.ip);
+
+    const string_view payload = seg.payload().str();
+    return {{{headers.ip.data(), ip_length},
+             {headers.tcp.data(), tcp_length},
+             {const_cast<char *>(payload.data()), payload.size()}}};
+}
+
+//! \param[in] ip_header is the header to serialize; its `cksum` is ignored
+//! \param[out] out receives the header, with its checksum taken over the header only
+size_t TCPOverIPv4Adapter::serialize_ip_header_into(IPv4Header ip_header, IPv4Header::Serialized &out) {
+    ip_header.cksum = 0;
+    const size_t ip_length = ip_header.serialize_into(out);
+    InternetChecksum check;
+    check.add({reinterpret_cast<const char *>(out.data()), ip_length});
+    constexpr size_t cksum_offset = 10;
+    NetUnparser::u16(out.data() + cksum_offset, check.value());
+    return ip_length;
+}
+
+//! \details The kernel splits a super-segment by copying its headers in front of each `gso_size` bytes of
+//! payload, advancing the sequence number (and clearing FIN and PSH on all but the last piece). So a run
+//! is contiguous data segments whose headers match the first one apart from the sequence number, all of
+//! them full-sized but the last. Segments with SYN, FIN, RST or URG are always sent alone.
+size_t TCPOverIPv4Adapter::gso_run_length(const vector<TCPSegment> &segments, const size_t first) {
+    const TCPHeader &head = segments.at(first).header();
+    const size_t gso_size = segments[first].payload().size();
+    if (gso_size == 0 or head.syn or head.fin or head.rst or head.urg) {
+        return 1;
+    }
+
+    size_t count = 1;
+    size_t payload_length = gso_size;
+    for (size_t i = first + 1; i < segments.size(); i++) {
+        const TCPSegment &previous = segments[i - 1];
+        const TCPSegment &next = segments[i];
+        const size_t length = next.payload().size();
+        if (previous.payload().size() != gso_size or length == 0 or length > gso_size or
+            payload_length + length > GSO_MAX_PAYLOAD or next.header().seqno != previous.header().seqno + gso_size) {
+            break;
+        }
+        TCPHeader same_seqno = next.header();
+        same_seqno.seqno = head.seqno;
+        if (not(same_seqno == head)) {
+            break;
+        }
+        payload_length += length;
+        count++;
+    }
+    return count;
+}
+
+//! \param[in,out] segments holds the run; the first segment's port numbers are set here
+//! \param[in] first is the index of the first segment of the run
+//! \param[in] count is the length of the run (see gso_run_length())
+//! \param[out] headers receives the serialized headers; must outlive the iovecs
+//! \param[out] iov receives the iovecs, which also point into the segments' payloads
+//! \details The TCP checksum is left to the kernel (VIRTIO_NET_HDR_F_NEEDS_CSUM): the header carries only
+//! the pseudo-header sum, which the kernel adjusts for each piece it cuts and completes over its bytes. So
+//! no checksum is computed over the payload here, even for a run of one segment.
+void TCPOverIPv4Adapter::wrap_tcp_run_in_ip_into(vector<TCPSegment> &segments,
+                                                 const size_t first,
+                                                 const size_t count,
+                                                 GSOHeaders &headers,
+                                                 vector<iovec> &iov) {
+    TCPSegment &head = segments.at(first);
+    IPv4Header ip_header = ip_header_for(head);
+    size_t payload_length = 0;
+    for (size_t i = first; i < first + count; i++) {
+        payload_length += segments.at(i).payload().size();
+    }
+    ip_header.len = ip_header.hlen * 4 + head.header().doff * 4 + payload_length;
+
+    // the TCP checksum field holds the (uncomplemented) pseudo-header sum
+    TCPHeader tcp_header = head.header();
+    tcp_header.cksum = static_cast<uint16_t>(~InternetChecksum(ip_header.pseudo_cksum()).value());
+    const size_t tcp_length = tcp_header.serialize_into(headers.ip_tcp.tcp);
+    const size_t ip_length = serialize_ip_header_into(ip_header, headers.ip_tcp.ip);
+
+    constexpr size_t tcp_cksum_offset = 16;
+    headers.vnet = {};
+    headers.vnet.flags = VirtioNetHeader::F_NEEDS_CSUM;
+    headers.vnet.csum_start = ip_length;
+    headers.vnet.csum_offset = tcp_cksum_offset;
+    headers.vnet.hdr_len = ip_length + tcp_length;
+    if (count > 1) {
+        headers.vnet.gso_type = VirtioNetHeader::GSO_TCPV4;
+        headers.vnet.gso_size = head.payload().size();
+    } else {
+        headers.vnet.gso_type = VirtioNetHeader::GSO_NONE;
+    }
+
+    iov.push_back({&headers.vnet, sizeof(headers.vnet)});
+    iov.push_back({headers.ip_tcp.ip.data(), ip_length});
+    iov.push_back({headers.ip_tcp.tcp.data(), tcp_length});
+    for (size_t i = first; i < first + count; i++) {
+        const string_view payload = segments[i].payload().str();
+        if (not payload.empty()) {
+            iov.push_back({const_cast<char *>(payload.data()), payload.size()});
+        }
+    }
+}
+
+//! \param[in] packet is what was read from the tun device, virtio-net header first
+//! \details A packet the host built itself (including a TSO or GRO super-segment) arrives with
+//! VIRTIO_NET_HDR_F_NEEDS_CSUM, its TCP checksum not yet computed, or with VIRTIO_NET_HDR_F_DATA_VALID
+//! once it has been checked; either way the checksum is not verified again. A super-segment is returned
+//! as one large TCPSegment, so the rest of the stack handles it once rather than once per MSS.
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_vnet(Buffer packet) {
+    VirtioNetHeader vnet{};
+    if (packet.size() < sizeof(vnet)) {
+        return {};
+    }
+    memcpy(&vnet, packet.str().data(), sizeof(vnet));
+    packet.remove_prefix(sizeof(vnet));
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(move(packet)) != ParseResult::NoError) {
+        return {};
+    }
+    return unwrap_tcp_in_ip(ip_dgram,
+                            not(vnet.flags & (VirtioNetHeader::F_NEEDS_CSUM | VirtioNetHeader::F_DATA_VALID)));
+}
@@ -6,14 +6,81 @@
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
+#include <array>
+#include <cstdint>
 #include <optional>
+#include <sys/uio.h>
+#include <vector>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase {
   public:
-    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram);
+    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram, const bool verify_checksum = true);
 
     InternetDatagram wrap_tcp_in_ip(TCPSegment &seg);
+
+    //! Storage for the headers of an outgoing datagram, filled in by wrap_tcp_in_ip_into()
+    struct SerializedHeaders {
+        IPv4Header::Serialized ip{};
+        TCPHeader::Serialized tcp{};
+    };
+
+    //! Like wrap_tcp_in_ip(), but serializes both headers into `headers` without allocating
+    //! \returns the datagram as [iovecs](\ref man2::writev): IPv4 header, TCP header, TCP payload
+    std::array<iovec, 3> wrap_tcp_in_ip_into(TCPSegment &seg, SerializedHeaders &headers);
+
+    //! \name Generic segmentation offload, for a TunFD opened with IFF_VNET_HDR
+    //!@{
+
+    //! Largest payload of a super-segment, so that its IPv4 datagram fits in 65535 bytes
+    static constexpr size_t GSO_MAX_PAYLOAD = 65535 - IPv4Header::LENGTH - TCPHeader::MAX_LENGTH;
+
+    //! \brief The header before each packet on a tun device opened with IFF_VNET_HDR, in host byte order
+    //! \details The same layout as `struct virtio_net_hdr` in linux/virtio_net.h, which is not valid C++.
+    struct VirtioNetHeader {
+        static constexpr uint8_t F_NEEDS_CSUM = 1;  //!< flags: the checksum at csum_start + csum_offset is partial
+        static constexpr uint8_t F_DATA_VALID = 2;  //!< flags: the checksum has been verified
+        static constexpr uint8_t GSO_NONE = 0;      //!< gso_type: not a super-segment
+        static constexpr uint8_t GSO_TCPV4 = 1;     //!< gso_type: a TCPv4 super-segment, cut every gso_size bytes
+
+        uint8_t flags;
+        uint8_t gso_type;
+        uint16_t hdr_len;      //!< length of the IPv4 and TCP headers
+        uint16_t gso_size;     //!< payload bytes per segment
+        uint16_t csum_start;   //!< offset of the TCP header
+        uint16_t csum_offset;  //!< offset of the checksum within the TCP header
+    };
+    static_assert(sizeof(VirtioNetHeader) == 10, "virtio-net header must be 10 bytes");
+
+    //! Storage for the headers of a super-segment, filled in by wrap_tcp_run_in_ip_into()
+    struct GSOHeaders {
+        VirtioNetHeader vnet{};
+        SerializedHeaders ip_tcp{};
+    };
+
+    //! \brief How many segments, starting with `segments[first]`, can be sent as one super-segment
+    //! \returns at least 1
+    static size_t gso_run_length(const std::vector<TCPSegment> &segments, const size_t first);
+
+    //! \brief Wrap `count` segments, starting with `segments[first]`, in one super-segment for the kernel to split
+    //! \details Appends the [iovecs](\ref man2::writev) to `iov`: virtio-net header, IPv4 header, TCP header,
+    //! then each segment's payload
+    void wrap_tcp_run_in_ip_into(std::vector<TCPSegment> &segments,
+                                 const size_t first,
+                                 const size_t count,
+                                 GSOHeaders &headers,
+                                 std::vector<iovec> &iov);
+
+    //! Like unwrap_tcp_in_ip(), for a packet read with its virtio-net header (possibly a super-segment)
+    std::optional<TCPSegment> unwrap_tcp_in_vnet(Buffer packet);
+    //!@}
+
+  private:
+    //! Set the port numbers in `seg` and build the IPv4 header that will carry it
+    IPv4Header ip_header_for(TCPSegment &seg) const;
+
+    //! Serialize `ip_header` into `out` with its header checksum; returns the header length
+    static size_t serialize_ip_header_into(IPv4Header ip_header, IPv4Header::Serialized &out);
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_OVER_IP_HH
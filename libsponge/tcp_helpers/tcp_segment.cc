@@ -9,11 +9,14 @@ using namespace std;
 
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
-ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum) {
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(buffer);
-    if (check.value()) {
-        return ParseResult::BadChecksum;
+//! \param[in] verify_checksum is whether to check the checksum at all
+ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum, const bool verify_checksum) {
+    if (verify_checksum) {
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(buffer);
+        if (check.value()) {
+            return ParseResult::BadChecksum;
+        }
     }
 
     NetParser p{buffer};
@@ -28,18 +31,30 @@ size_t TCPSegment::length_in_sequence_space() const {
 
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
 BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
-    TCPHeader header_out = _header;
-    header_out.cksum = 0;
-
-    // calculate checksum -- taken over entire segment
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
-    check.add(_payload);
-    header_out.cksum = check.value();
+    TCPHeader::Serialized header_out;
+    const size_t header_length = serialize_header_into(header_out, datagram_layer_checksum);
 
     BufferList ret;
-    ret.append(header_out.serialize());
+    ret.append(string(reinterpret_cast<const char *>(header_out.data()), header_length));
     ret.append(_payload);
 
     return ret;
 }
+
+//! \param[out] header_out receives the serialized header
+//! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+size_t TCPSegment::serialize_header_into(TCPHeader::Serialized &header_out,
+                                         const uint32_t datagram_layer_checksum) const {
+    TCPHeader header = _header;
+    header.cksum = 0;
+    const size_t header_length = header.serialize_into(header_out);
+
+    // calculate checksum -- taken over entire segment -- and patch it into place
+    InternetChecksum check(datagram_layer_checksum);
+    check.add({reinterpret_cast<const char *>(header_out.data()), header_length});
+    check.add(_payload);
+    constexpr size_t cksum_offset = 16;
+    NetUnparser::u16(header_out.data() + cksum_offset, check.value());
+
+    return header_length;
+}
@@ -14,11 +14,21 @@ class TCPSegment {
 
   public:
     //! \brief Parse the segment from a string
-    ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
+    //! \note `verify_checksum` is `false` only for segments whose checksum the kernel left for offload to
+    //! complete (see TCPOverIPv4Adapter::unwrap_tcp_in_vnet)
+    ParseResult parse(const Buffer buffer,
+                      const uint32_t datagram_layer_checksum = 0,
+                      const bool verify_checksum = true);
 
     //! \brief Serialize the segment to a string
     BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
 
+    //! \brief Serialize the header, checksum included, into caller-provided storage
+    //! \details The payload is not copied: send `header_out` followed by payload(), e.g. with
+    //! [sendmsg(2)](\ref man2::sendmsg). Does not allocate.
+    //! \returns the header length
+    size_t serialize_header_into(TCPHeader::Serialized &header_out, const uint32_t datagram_layer_checksum = 0) const;
+
     //! \name Accessors
     //!@{
     const TCPHeader &header() const { return _header; }
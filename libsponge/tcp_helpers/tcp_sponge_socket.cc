@@ -9,6 +9,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -17,45 +18,271 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! Longest the TCP thread sleeps without a timer, so that it notices `_abort`
+static constexpr int TCP_IDLE_WAKE_MS = 100;
+
+//! \details Ticks are only needed when a timer is due, but then the connection must be ticked for all
+//! the time since its last tick, and that time must not include any before the last segment arrived or
+//! data was written. So every event that reaches the TCPConnection first ticks it up to the present.
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_tick_tcp() {
+    const auto now = timestamp_ms();
+    if (now > _last_tick_ms) {
+        _tcp.value().tick(now - _last_tick_ms);
+        _datagram_adapter.tick(now - _last_tick_ms);
+        _last_tick_ms = now;
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_arm_timer(optional<TimerWheel::TimerId> &timer,
+                                         optional<uint64_t> &deadline,
+                                         const optional<uint64_t> wait,
+                                         const function<void()> &on_expiry) {
+    const optional<uint64_t> new_deadline =
+        wait.has_value() ? optional<uint64_t>{_last_tick_ms + wait.value()} : nullopt;
+    if (new_deadline == deadline) {
+        return;
+    }
+
+    if (timer.has_value()) {
+        _timers.cancel(timer.value());
+        timer.reset();
+    }
+    deadline = new_deadline;
+    if (deadline.has_value()) {
+        timer = _timers.schedule(deadline.value(), [&timer, &deadline, on_expiry] {
+            timer.reset();
+            deadline.reset();
+            on_expiry();
+        });
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_arm_tcp_timer() {
+    _arm_timer(_tcp_timer, _tcp_deadline, _tcp.value().time_until_next_timer(), [&] { _tick_tcp(); });
+}
+
+//! \details Ticking the adapter sends the segments that have crossed its uplink, and makes those that have
+//! crossed its downlink pending.
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_arm_adapter_timer() {
+    _arm_timer(_adapter_timer, _adapter_deadline, _datagram_adapter.time_until_next_timer(), [&] {
+        _tick_tcp();
+        if (_datagram_adapter.pending() > 0 and _tcp->active()) {
+            _receive_segments();
+        }
+    });
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_receive_segments() {
+    do {
+        auto seg = _datagram_adapter.read();
+        if (seg) {
+            _tick_tcp();
+            _tcp->segment_received(move(seg.value()));
+        }
+    } while (_datagram_adapter.pending() and _tcp->active());
+
+    // debugging output:
+    if (_outbound_shutdown and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
+        cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+             << " has been fully acknowledged.\n";
+        _fully_acked = true;
+    }
+}
+
+//! \details Bytes from the owner are copied once, out of the ring into the outbound stream; bytes for the
+//! owner are copied once, out of the inbound stream into the ring.
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_service_rings() {
+    // from the owner's ring into the TCPConnection
+    if (_tcp->active() and not _outbound_shutdown) {
+        bool ticked = false;
+        while (_tcp->remaining_outbound_capacity() > 0) {
+            const string_view front = _outbound_ring->peek();
+            if (front.empty()) {
+                break;
+            }
+            if (not ticked) {
+                _tick_tcp();
+                _apply_coalescing();
+                ticked = true;
+            }
+            // one copy, from the ring into the string that becomes the outbound stream's storage
+            _outbound_ring->pop(_tcp->write(Buffer{string(front.substr(0, _tcp->remaining_outbound_capacity()))}));
+        }
+
+        if (_outbound_ring->eof()) {
+            _tick_tcp();
+            _tcp->end_input_stream();
+            _outbound_shutdown = true;
+
+            // debugging output:
+            cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+                 << " finished (" << _tcp.value().bytes_in_flight() << " byte"
+                 << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
+        }
+    }
+
+    // from the inbound stream into the owner's ring
+    if (not _inbound_shutdown) {
+        ByteStream &inbound = _tcp->inbound_stream();
+        const BufferViewList views = inbound.peek_views(_inbound_ring->remaining_capacity());
+        size_t bytes_written = 0;
+        for (const auto &view : views.views()) {
+            bytes_written += _inbound_ring->write(view);
+        }
+        if (bytes_written > 0) {
+            inbound.pop_output(bytes_written);
+            _tick_tcp();
+            _tcp->inbound_stream_read();
+        }
+
+        if (inbound.buffer_empty() and (inbound.eof() or inbound.error())) {
+            _inbound_ring->close();
+            _inbound_shutdown = true;
+
+            // debugging output:
+            cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string()
+                 << " finished " << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
+            if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
+                cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
+            }
+        }
+    }
+}
+
+//! \details The TCP thread waits for the owner to fill the outbound ring only while it could take more
+//! bytes, and to drain the inbound ring only while it has bytes for it.
+template <typename AdaptT>
+bool TCPSpongeSocket<AdaptT>::_arm_ring_wakeups() {
+    if (_tcp->active() and not _outbound_shutdown and _tcp->remaining_outbound_capacity() > 0 and
+        not _outbound_ring->arm_readable_wakeup()) {
+        return false;
+    }
+    return _inbound_shutdown or _tcp->inbound_stream().buffer_empty() or _inbound_ring->arm_writable_wakeup();
+}
 
 //! \param[in] condition is a function returning true if loop should continue
+//! \details The loop sleeps until a datagram or the owner needs attention, or the next timer expires.
+//! With Transport::SPSCRing, it first moves what it can between the rings and the TCPConnection, and
+//! only sleeps if nothing more arrived while it did so.
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()> &condition) {
-    auto base_time = timestamp_ms();
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        bool idle = true;
+        if (_outbound_ring) {
+            _service_rings();
+            idle = _arm_ring_wakeups();
+        }
+        _arm_tcp_timer();
+        _arm_adapter_timer();
+        // the rules' interest follows the TCPConnection, which timers and every rule can change
+        _eventloop.notify_all();
+        const int timeout = idle ? _timers.timeout_ms(timestamp_ms()) : 0;
+        auto ret = _eventloop.wait_next_event(timeout < 0 ? TCP_IDLE_WAKE_MS : min(timeout, TCP_IDLE_WAKE_MS));
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
 
-        if (_tcp.value().active()) {
-            const auto next_time = timestamp_ms();
-            _tcp.value().tick(next_time - base_time);
-            _datagram_adapter.tick(next_time - base_time);
-            base_time = next_time;
-        }
+        _timers.advance(timestamp_ms());
     }
 }
 
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+//! \param[in] control_socket_pair is another pair, to wake the TCP thread when the owner changes settings
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
+//! \param[in] transport chooses how application data reaches the TCP thread
 template <typename AdaptT>
 TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> data_socket_pair,
-                                         AdaptT &&datagram_interface)
+                                         pair<FileDescriptor, FileDescriptor> control_socket_pair,
+                                         AdaptT &&datagram_interface,
+                                         const Transport transport)
     : LocalStreamSocket(move(data_socket_pair.first))
     , _thread_data(move(data_socket_pair.second))
+    , _control(move(control_socket_pair.first))
+    , _thread_control(move(control_socket_pair.second))
     , _datagram_adapter(move(datagram_interface)) {
     _thread_data.set_blocking(false);
+    if (transport == Transport::SPSCRing) {
+        _outbound_ring = make_unique<SPSCByteRing>(RING_CAPACITY);
+        _inbound_ring = make_unique<SPSCByteRing>(RING_CAPACITY);
+    }
+}
+
+template <typename AdaptT>
+SPSCByteRing &TCPSpongeSocket<AdaptT>::outbound_ring() {
+    if (not _outbound_ring) {
+        throw runtime_error("TCPSpongeSocket: no rings without Transport::SPSCRing");
+    }
+    return *_outbound_ring;
+}
+
+template <typename AdaptT>
+SPSCByteRing &TCPSpongeSocket<AdaptT>::inbound_ring() {
+    if (not _inbound_ring) {
+        throw runtime_error("TCPSpongeSocket: no rings without Transport::SPSCRing");
+    }
+    return *_inbound_ring;
+}
+
+//! \details The settings travel in atomics; the byte written to `_control` only wakes the TCP thread. The
+//! thread also applies them before taking data from the owner, so a write that follows cork() is held
+//! back even if the TCP thread sees the data before the wake-up.
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_notify_coalescing() {
+    _coalescing_changed.store(true);
+    _control.write("x");
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_apply_coalescing() {
+    if (not _coalescing_changed.exchange(false)) {
+        return;
+    }
+    if (_tcp->nodelay() != _nodelay_requested.load()) {
+        _tcp->set_nodelay(_nodelay_requested.load());
+    }
+    if (_tcp->corked() != _cork_requested.load()) {
+        if (_cork_requested.load()) {
+            _tcp->cork();
+        } else {
+            _tcp->uncork();
+        }
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::set_nodelay(const bool nodelay) {
+    _nodelay_requested.store(nodelay);
+    _notify_coalescing();
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::cork() {
+    _cork_requested.store(true);
+    _notify_coalescing();
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::uncork() {
+    _cork_requested.store(false);
+    _notify_coalescing();
 }
 
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _tcp.emplace(config);
+    _datagram_adapter.set_mss(config.mss);
+    _last_tick_ms = timestamp_ms();
+    _nodelay_requested.store(not config.nagle);
 
     // Set up the event loop
 
-    // There are four possible events to handle:
+    // There are five possible events to handle:
     //
     // 1) Incoming datagram received (needs to be given to
     //    TCPConnection::segment_received method)
@@ -70,84 +297,86 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     //
     // 4) Outbound segment generated by TCP (needs to be
     //    given to underlying datagram socket)
+    //
+    // 5) The owner changed the Nagle or cork setting (needs to
+    //    be applied to the TCPConnection)
 
     // rule 1: read from filtered packet stream and dump into TCPConnection
-    _eventloop.add_rule(_datagram_adapter,
-                        Direction::In,
-                        [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
-                            }
-
-                            // debugging output:
-                            if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
-                                cerr << "DEBUG: Outbound stream to "
-                                     << _datagram_adapter.config().destination.to_string()
-                                     << " has been fully acknowledged.\n";
-                                _fully_acked = true;
-                            }
-                        },
-                        [&] { return _tcp->active(); });
-
-    // rule 2: read from pipe into outbound buffer
+    //         (everything the adapter received in one batch)
     _eventloop.add_rule(
-        _thread_data,
-        Direction::In,
-        [&] {
-            const auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
-            const auto len = data.size();
-            const auto amount_written = _tcp->write(move(data));
-            if (amount_written != len) {
-                throw runtime_error("TCPConnection::write() accepted less than advertised length");
-            }
-
-            if (_thread_data.eof()) {
+        _datagram_adapter, Direction::In, [&] { _receive_segments(); }, [&] { return _tcp->active(); });
+
+    if (_outbound_ring) {
+        // rules 2 and 3 with rings: _tcp_loop moves the bytes; these only wake the thread when it was
+        // waiting for the owner to write to the outbound ring, or to make room in the inbound one
+        _eventloop.add_rule(_outbound_ring->readable_event(),
+                            Direction::In,
+                            [&] { _outbound_ring->readable_event().clear(); },
+                            [&] { return _tcp->active() and not _outbound_shutdown; });
+
+        _eventloop.add_rule(_inbound_ring->writable_event(),
+                            Direction::In,
+                            [&] { _inbound_ring->writable_event().clear(); },
+                            [&] { return not _inbound_shutdown; });
+    } else {
+        // rule 2: read from pipe into outbound buffer
+        _eventloop.add_rule(
+            _thread_data,
+            Direction::In,
+            [&] {
+                _tick_tcp();
+                _apply_coalescing();
+                _tcp->read_from(_thread_data);
+
+                if (_thread_data.eof()) {
+                    _tcp->end_input_stream();
+                    _outbound_shutdown = true;
+
+                    // debugging output:
+                    cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+                         << " finished (" << _tcp.value().bytes_in_flight() << " byte"
+                         << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
+                }
+            },
+            [&] { return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_outbound_capacity() > 0); },
+            [&] {
+                _tick_tcp();
                 _tcp->end_input_stream();
                 _outbound_shutdown = true;
+            });
+
+        // rule 3: read from inbound buffer into pipe
+        _eventloop.add_rule(
+            _thread_data,
+            Direction::Out,
+            [&] {
+                ByteStream &inbound = _tcp->inbound_stream();
+                // Write from the inbound_stream into
+                // the pipe, handling the possibility of a partial
+                // write (i.e., only pop what was actually written).
+                const auto bytes_written = inbound.write_to(_thread_data);
+                if (bytes_written > 0) {
+                    _tick_tcp();
+                    _tcp->inbound_stream_read();
+                }
 
-                // debugging output:
-                cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
-                     << " finished (" << _tcp.value().bytes_in_flight() << " byte"
-                     << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
-            }
-        },
-        [&] { return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_outbound_capacity() > 0); },
-        [&] {
-            _tcp->end_input_stream();
-            _outbound_shutdown = true;
-        });
-
-    // rule 3: read from inbound buffer into pipe
-    _eventloop.add_rule(
-        _thread_data,
-        Direction::Out,
-        [&] {
-            ByteStream &inbound = _tcp->inbound_stream();
-            // Write from the inbound_stream into
-            // the pipe, handling the possibility of a partial
-            // write (i.e., only pop what was actually written).
-            const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
-            const std::string buffer = inbound.peek_output(amount_to_write);
-            const auto bytes_written = _thread_data.write(move(buffer), false);
-            inbound.pop_output(bytes_written);
-
-            if (inbound.eof() or inbound.error()) {
-                _thread_data.shutdown(SHUT_WR);
-                _inbound_shutdown = true;
+                if (inbound.eof() or inbound.error()) {
+                    _thread_data.shutdown(SHUT_WR);
+                    _inbound_shutdown = true;
 
-                // debugging output:
-                cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string()
-                     << " finished " << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
-                if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
-                    cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
+                    // debugging output:
+                    cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string()
+                         << " finished " << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
+                    if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
+                        cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
+                    }
                 }
-            }
-        },
-        [&] {
-            return (not _tcp->inbound_stream().buffer_empty()) or
-                   ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
-        });
+            },
+            [&] {
+                return (not _tcp->inbound_stream().buffer_empty()) or
+                       ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
+            });
+    }
 
     // rule 4: read outbound segments from TCPConnection and send as datagrams
     _eventloop.add_rule(_datagram_adapter,
@@ -157,8 +386,19 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                                 _datagram_adapter.write(_tcp->segments_out().front());
                                 _tcp->segments_out().pop();
                             }
+                            _datagram_adapter.flush();
                         },
                         [&] { return not _tcp->segments_out().empty(); });
+
+    // rule 5: the owner changed the Nagle or cork setting
+    _eventloop.add_rule(_thread_control,
+                        Direction::In,
+                        [&] {
+                            _thread_control.read();
+                            _tick_tcp();
+                            _apply_coalescing();
+                        },
+                        [&] { return _tcp->active(); });
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
@@ -171,9 +411,11 @@ static inline pair<FileDescriptor, FileDescriptor> socket_pair_helper(const int
 }
 
 //! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+//! \param[in] transport chooses how application data reaches the TCP thread
 template <typename AdaptT>
-TCPSpongeSocket<AdaptT>::TCPSpongeSocket(AdaptT &&datagram_interface)
-    : TCPSpongeSocket(socket_pair_helper(SOCK_STREAM), move(datagram_interface)) {}
+TCPSpongeSocket<AdaptT>::TCPSpongeSocket(AdaptT &&datagram_interface, const Transport transport)
+    : TCPSpongeSocket(
+          socket_pair_helper(SOCK_STREAM), socket_pair_helper(SOCK_STREAM), move(datagram_interface), transport) {}
 
 template <typename AdaptT>
 TCPSpongeSocket<AdaptT>::~TCPSpongeSocket() {
@@ -192,6 +434,9 @@ TCPSpongeSocket<AdaptT>::~TCPSpongeSocket() {
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::wait_until_closed() {
     shutdown(SHUT_RDWR);
+    if (_outbound_ring) {
+        _outbound_ring->close();
+    }
     if (_tcp_thread.joinable()) {
         cerr << "DEBUG: Waiting for clean shutdown... ";
         _tcp_thread.join();
@@ -258,6 +503,10 @@ void TCPSpongeSocket<AdaptT>::_tcp_main() {
         }
         _tcp_loop([] { return true; });
         shutdown(SHUT_RDWR);
+        if (_outbound_ring) {
+            _outbound_ring->close_reader();
+            _inbound_ring->close();
+        }
         if (not _tcp.value().active()) {
             cerr << "DEBUG: TCP connection finished "
                  << (_tcp.value().state() == TCPState::State::RESET ? "uncleanly" : "cleanly.\n");
@@ -5,13 +5,17 @@
 #include "eventloop.hh"
 #include "fd_adapter.hh"
 #include "file_descriptor.hh"
+#include "spsc_ring.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
 #include "tcp_over_ip.hh"
+#include "timer_wheel.hh"
 #include "tuntap_adapter.hh"
+#include "util.hh"
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -19,10 +23,33 @@
 //! Multithreaded wrapper around TCPConnection that approximates the Unix sockets API
 template <typename AdaptT>
 class TCPSpongeSocket : public LocalStreamSocket {
+  public:
+    //! How application data travels between the owner and the TCP thread
+    enum class Transport {
+        SocketPair,  //!< The owner reads and writes this socket, whose other end the TCP thread reads and writes
+        SPSCRing     //!< The owner uses outbound_ring() and inbound_ring(), shared in memory with the TCP thread
+    };
+
+    //! Bytes each ring holds (Transport::SPSCRing)
+    static constexpr size_t RING_CAPACITY = 1 << 20;
+
   private:
     //! Stream socket for reads and writes between owner and TCP thread
     LocalStreamSocket _thread_data;
 
+    //! Owner's end of a stream socket that wakes the TCP thread when the coalescing settings change
+    LocalStreamSocket _control;
+
+    //! TCP thread's end of `_control`
+    LocalStreamSocket _thread_control;
+
+    //! \name Rings carrying the outbound and inbound streams (Transport::SPSCRing only)
+    //! The owner produces into `_outbound_ring` and consumes from `_inbound_ring`; the TCP thread does the opposite.
+    //!@{
+    std::unique_ptr<SPSCByteRing> _outbound_ring{};
+    std::unique_ptr<SPSCByteRing> _inbound_ring{};
+    //!@}
+
     //! Adapter to underlying datagram socket (e.g., UDP or IP)
     AdaptT _datagram_adapter;
 
@@ -33,7 +60,51 @@ class TCPSpongeSocket : public LocalStreamSocket {
     std::optional<TCPConnection> _tcp{};
 
     //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
-    EventLoop _eventloop{};
+    //! \note epoll: only changed interest costs a system call
+    EventLoop _eventloop{EventLoop::Backend::Epoll};
+
+    //! Timers of the TCP thread; the event loop sleeps until the next one expires
+    TimerWheel _timers{timestamp_ms()};
+
+    //! Pending timer for the TCPConnection's next deadline, if any
+    std::optional<TimerWheel::TimerId> _tcp_timer{};
+
+    //! Deadline of `_tcp_timer`
+    std::optional<uint64_t> _tcp_deadline{};
+
+    //! Pending timer for the adapter's next delayed segment, if any
+    std::optional<TimerWheel::TimerId> _adapter_timer{};
+
+    //! Deadline of `_adapter_timer`
+    std::optional<uint64_t> _adapter_deadline{};
+
+    //! When the TCPConnection and the adapter were last ticked
+    uint64_t _last_tick_ms{0};
+
+    //! Tick the TCPConnection and the adapter up to the present
+    void _tick_tcp();
+
+    //! Make `timer` (with deadline `deadline`) expire `wait` ms after the last tick, or cancel it if `wait` is empty
+    void _arm_timer(std::optional<TimerWheel::TimerId> &timer,
+                    std::optional<uint64_t> &deadline,
+                    const std::optional<uint64_t> wait,
+                    const std::function<void()> &on_expiry);
+
+    //! Make `_tcp_timer` match the TCPConnection's next deadline
+    void _arm_tcp_timer();
+
+    //! Make `_adapter_timer` match the time the adapter's next delayed segment is due
+    void _arm_adapter_timer();
+
+    //! Give the TCPConnection every segment the adapter has for it (rule 1)
+    void _receive_segments();
+
+    //! Move bytes between the rings and the TCPConnection, as far as both allow (no system calls)
+    void _service_rings();
+
+    //! After _service_rings(), arm the wake-ups for the ring work the TCP thread is waiting to do
+    //! \returns false if it need not wait, as more work arrived in the meantime
+    bool _arm_ring_wakeups();
 
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
@@ -44,11 +115,27 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Handle to the TCPConnection thread; owner thread calls join() in the destructor
     std::thread _tcp_thread{};
 
-    //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-    TCPSpongeSocket(std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT &&datagram_interface);
+    //! Construct LocalStreamSocket fds from socket pairs, initialize eventloop
+    TCPSpongeSocket(std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
+                    std::pair<FileDescriptor, FileDescriptor> control_socket_pair,
+                    AdaptT &&datagram_interface,
+                    const Transport transport);
 
     std::atomic_bool _abort{false};  //!< Flag used by the owner to force the TCPConnection thread to shut down
 
+    //! \name Coalescing settings requested by the owner, applied by the TCP thread
+    //!@{
+    std::atomic_bool _nodelay_requested{false};
+    std::atomic_bool _cork_requested{false};
+    std::atomic_bool _coalescing_changed{false};  //!< Set after either of the above is written
+    //!@}
+
+    //! Tell the TCP thread that the coalescing settings changed
+    void _notify_coalescing();
+
+    //! Bring the TCPConnection's Nagle and cork settings in line with what the owner requested
+    void _apply_coalescing();
+
     bool _inbound_shutdown{false};  //!< Has TCPSpongeSocket shut down the incoming data to the owner?
 
     bool _outbound_shutdown{false};  //!< Has the owner shut down the outbound data to the TCP connection?
@@ -57,7 +144,16 @@ class TCPSpongeSocket : public LocalStreamSocket {
 
   public:
     //! Construct from the interface that the TCPConnection thread will use to read and write datagrams
-    explicit TCPSpongeSocket(AdaptT &&datagram_interface);
+    explicit TCPSpongeSocket(AdaptT &&datagram_interface, const Transport transport = Transport::SocketPair);
+
+    //! \name The owner's ends of the in-process transport (Transport::SPSCRing only)
+    //! The owner writes the outbound stream into outbound_ring() and closes it to end the stream, and reads
+    //! the inbound stream from inbound_ring() until its eof(). Reads and writes of the socket itself are not
+    //! used with this transport.
+    //!@{
+    SPSCByteRing &outbound_ring();
+    SPSCByteRing &inbound_ring();
+    //!@}
 
     //! Close socket, and wait for TCPConnection to finish
     //! \note Calling this function is only advisable if the socket has reached EOF,
@@ -70,6 +166,20 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
     void listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
 
+    //! \name Coalescing of small writes
+    //! For a connected socket; each takes effect before the TCP thread takes any data written after the call.
+    //!@{
+
+    //! Turn Nagle's algorithm off (true) or on (false), like the TCP_NODELAY socket option
+    void set_nodelay(const bool nodelay);
+
+    //! Hold back partial segments until uncork(), like the TCP_CORK socket option
+    void cork();
+
+    //! Send what cork() held back
+    void uncork();
+    //!@}
+
     //! When a connected socket is destructed, it will send a RST
     ~TCPSpongeSocket();
 
@@ -0,0 +1,324 @@
+#include "tcp_stack.hh"
+
+#include "tcp_segment.hh"
+#include "tcp_state.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <utility>
+
+using namespace std;
+
+//! The IPv4 address and port of a UDP peer, in host byte order (without the string conversions of Address::ip_port)
+static pair<uint32_t, uint16_t> ipv4_and_port(const Address &address) {
+    if (address.size() != sizeof(sockaddr_in)) {
+        throw runtime_error("TCPStack: peer is not an IPv4 address");
+    }
+    sockaddr_in raw{};
+    memcpy(&raw, static_cast<const sockaddr *>(address), sizeof(raw));
+    return {be32toh(raw.sin_addr.s_addr), be16toh(raw.sin_port)};
+}
+
+//! \param[in] socket is a bound UDP socket, from which the stack will receive and send all datagrams
+//! \param[in] config is the TCPConfig given to every connection
+TCPStack::TCPStack(UDPSocket &&socket, const TCPConfig &config)
+    : _config(config), _socket(move(socket)), _timers(timestamp_ms()) {
+    _eventloop.add_rule(_socket, Direction::In, [&] { _receive_datagrams(); });
+}
+
+void TCPStack::listen(const uint16_t port) { _listening_ports.insert(port); }
+
+//! \details A multiplicative hash of the peer's address and ports and the local port. The high half of
+//! the product is used, as its bits depend on all of the key. flow_steering_program() computes the same.
+uint32_t TCPStack::flow_hash(const FourTuple &key) {
+    const auto &[peer_ip, peer_port, local_port, remote_port] = key;
+    const uint32_t mixed = peer_ip ^ ((uint32_t{peer_port} << 16) | remote_port) ^ local_port;
+    return (mixed * 0x9e3779b1) >> 16;
+}
+
+//! \param[in] shards is the number of sockets in the SO_REUSEPORT group
+//! \details The program sees the datagram from its UDP payload (the TCP header) onwards, and reaches the
+//! IPv4 and UDP headers at the kernel's negative "network header" offset. A datagram too short for the
+//! TCP ports ends the program with 0, i.e. goes to the first shard.
+vector<sock_filter> TCPStack::flow_steering_program(const size_t shards) {
+    if (shards == 0 or shards > numeric_limits<uint32_t>::max()) {
+        throw runtime_error("TCPStack: bad number of shards");
+    }
+    const auto statement = [](const uint16_t code, const uint32_t k) { return sock_filter{code, 0, 0, k}; };
+    constexpr uint32_t net_header = static_cast<uint32_t>(SKF_NET_OFF);
+    const uint32_t modulus = static_cast<uint32_t>(shards);
+
+    return {
+        statement(BPF_LD | BPF_W | BPF_ABS, net_header + 12),  // A = IPv4 source address
+        statement(BPF_ST, 0),                                  // M[0] = A
+        statement(BPF_LDX | BPF_B | BPF_MSH, net_header),      // X = IPv4 header length
+        statement(BPF_LD | BPF_H | BPF_IND, net_header),       // A = UDP source port (at X)
+        statement(BPF_ALU | BPF_LSH | BPF_K, 16),              // A <<= 16
+        statement(BPF_ST, 1),                                  // M[1] = A
+        statement(BPF_LD | BPF_H | BPF_ABS, 0),                // A = TCP source port
+        statement(BPF_LDX | BPF_MEM, 1),                       // X = M[1]
+        statement(BPF_ALU | BPF_OR | BPF_X, 0),                // A |= X
+        statement(BPF_LDX | BPF_MEM, 0),                       // X = M[0]
+        statement(BPF_ALU | BPF_XOR | BPF_X, 0),               // A ^= X
+        statement(BPF_ST, 0),                                  // M[0] = A
+        statement(BPF_LD | BPF_H | BPF_ABS, 2),                // A = TCP destination port
+        statement(BPF_LDX | BPF_MEM, 0),                       // X = M[0]
+        statement(BPF_ALU | BPF_XOR | BPF_X, 0),               // A ^= X
+        statement(BPF_ALU | BPF_MUL | BPF_K, 0x9e3779b1),      // A *= 0x9e3779b1
+        statement(BPF_ALU | BPF_RSH | BPF_K, 16),              // A >>= 16
+        statement(BPF_ALU | BPF_MOD | BPF_K, modulus),         // A %= shards
+        statement(BPF_RET | BPF_A, 0),                         // socket index A
+    };
+}
+
+//! \param[in] index is this stack's shard, from 0
+//! \param[in] count is the number of shards
+void TCPStack::set_shard(const size_t index, const size_t count) {
+    if (index >= count) {
+        throw runtime_error("TCPStack: shard index out of range");
+    }
+    _shard_index = index;
+    _shard_count = count;
+}
+
+optional<TCPStack::Handle> TCPStack::accept() {
+    if (_accept_queue.empty()) {
+        return {};
+    }
+    Handle ret{*this, move(_accept_queue.front())};
+    _accept_queue.pop_front();
+    return ret;
+}
+
+//! \param[in] peer is the UDP address of the remote stack or socket
+//! \param[in] remote_port is the TCP port to connect to
+TCPStack::Handle TCPStack::connect(const Address &peer, const uint16_t remote_port) {
+    const auto [peer_ip, peer_port] = ipv4_and_port(peer);
+
+    // pick an ephemeral local port not already used with this peer (and that maps the connection to this
+    // stack's shard, so that the peer's replies are steered here)
+    constexpr size_t ephemeral_ports = 65536 - 49152;
+    FourTuple key;
+    for (size_t tries = 0;; tries++) {
+        if (tries == ephemeral_ports) {
+            throw runtime_error("TCPStack: no free local port");
+        }
+        key = {peer_ip, peer_port, _next_ephemeral_port, remote_port};
+        _next_ephemeral_port = _next_ephemeral_port == 65535 ? 49152 : _next_ephemeral_port + 1;
+        if (flow_hash(key) % _shard_count == _shard_index and not _connections.count(key)) {
+            break;
+        }
+    }
+
+    auto entry = make_shared<Entry>(key, peer, _config, timestamp_ms());
+    entry->accept_queued = true;
+    _connections.emplace(key, entry);
+
+    entry->connection.connect();
+    _mark_for_flush(entry);
+
+    return {*this, move(entry)};
+}
+
+void TCPStack::_receive_datagrams() {
+    _socket.recv_many(_received);
+    for (size_t i = 0; i < _received.size(); i++) {
+        _receive_datagram(_received.source_address(i), _received.payload(i));
+    }
+}
+
+//! \details Segments with a 4-tuple the stack has not seen before are dropped, unless they are a SYN
+//! to a listening port; that creates a new connection, which is queued for accept() once its handshake
+//! completes.
+void TCPStack::_receive_datagram(const Address &source_address, const string_view payload) {
+    auto storage = _payloads.acquire(payload.size());
+    storage->assign(payload);
+    TCPSegment seg;
+    if (seg.parse(Buffer{move(storage)}, 0) != ParseResult::NoError) {
+        return;
+    }
+
+    const auto [peer_ip, peer_port] = ipv4_and_port(source_address);
+    const FourTuple key{peer_ip, peer_port, seg.header().dport, seg.header().sport};
+
+    auto it = _connections.find(key);
+    if (it == _connections.end()) {
+        if (not seg.header().syn or seg.header().rst or not _listening_ports.count(seg.header().dport)) {
+            return;
+        }
+        const auto entry = make_shared<Entry>(key, source_address, _config, timestamp_ms());
+        it = _connections.emplace(key, entry).first;
+    }
+
+    const auto entry = it->second;
+    _tick(*entry);
+    entry->connection.segment_received(seg);
+    _mark_for_flush(entry);
+
+    if (not entry->accept_queued) {
+        const auto state = entry->connection.state();
+        if (state == TCPState::State::RESET) {
+            _forget(entry);
+        } else if (not(state == TCPState::State::LISTEN or state == TCPState::State::SYN_RCVD or
+                       state == TCPState::State::SYN_SENT)) {
+            entry->accept_queued = true;
+            _accept_queue.push_back(entry);
+        }
+    }
+}
+
+void TCPStack::_mark_for_flush(const shared_ptr<Entry> &entry) {
+    if (not entry->flush_pending) {
+        entry->flush_pending = true;
+        _to_flush.push_back(entry);
+    }
+}
+
+//! \details The segments of every connection are sent together by one [sendmmsg(2)](\ref man2::sendmmsg)
+//! (as TCPOverUDPSocketAdapter::flush does), each with its header serialized into a reused array and its
+//! payload referenced in place.
+void TCPStack::_flush() {
+    for (const auto &entry : _to_flush) {
+        entry->flush_pending = false;
+        auto &segments = entry->connection.segments_out();
+        while (not segments.empty()) {
+            TCPSegment &seg = segments.front();
+            seg.header().sport = get<2>(entry->key);
+            seg.header().dport = get<3>(entry->key);
+            _sending.emplace_back(&entry->peer, move(seg));
+            segments.pop();
+        }
+
+        _arm_timer(entry);
+        if (not entry->connection.active() and not entry->finished) {
+            entry->finished = true;
+            _finished.push_back(entry);
+        }
+    }
+
+    // the entries in `_to_flush` keep the destinations alive until the batch has been sent
+    _headers.resize(_sending.size());
+    for (size_t i = 0; i < _sending.size(); i++) {
+        auto &[peer, seg] = _sending[i];
+        const size_t header_length = seg.serialize_header_into(_headers[i], 0);
+        const string_view payload = seg.payload().str();
+        const array<iovec, 2> iov{
+            {{_headers[i].data(), header_length}, {const_cast<char *>(payload.data()), payload.size()}}};
+        _send_batch.add(*peer, iov.data(), iov.size());
+    }
+    // if sending fails, the segments are lost (as they could be on the network), but not sent again
+    try {
+        if (not _send_batch.empty()) {
+            _socket.send_many(_send_batch);
+        }
+    } catch (...) {
+        _sending.clear();
+        _to_flush.clear();
+        throw;
+    }
+    _sending.clear();
+    _to_flush.clear();
+}
+
+//! \details A connection is only ticked when something happens to it, but then for all the time since
+//! its last tick, which must not include any before the last segment arrived or data was written. So
+//! every event that reaches the connection first ticks it up to the present.
+void TCPStack::_tick(Entry &entry) {
+    const auto now = timestamp_ms();
+    if (now > entry.last_tick_ms) {
+        entry.connection.tick(now - entry.last_tick_ms);
+        entry.last_tick_ms = now;
+    }
+}
+
+void TCPStack::_arm_timer(const shared_ptr<Entry> &entry) {
+    const auto wait = entry->connection.time_until_next_timer();
+    const optional<uint64_t> deadline =
+        wait.has_value() ? optional<uint64_t>{entry->last_tick_ms + wait.value()} : nullopt;
+    if (deadline == entry->deadline) {
+        return;
+    }
+
+    if (entry->timer.has_value()) {
+        _timers.cancel(entry->timer.value());
+        entry->timer.reset();
+    }
+    entry->deadline = deadline;
+    if (deadline.has_value()) {
+        entry->timer = _timers.schedule(deadline.value(), [this, weak = weak_ptr<Entry>(entry)] {
+            const auto expired = weak.lock();
+            expired->timer.reset();
+            expired->deadline.reset();
+            _tick(*expired);
+            _mark_for_flush(expired);
+        });
+    }
+}
+
+void TCPStack::_forget(const shared_ptr<Entry> &entry) {
+    if (entry->timer.has_value()) {
+        _timers.cancel(entry->timer.value());
+        entry->timer.reset();
+    }
+    _connections.erase(entry->key);
+}
+
+void TCPStack::_reap() {
+    for (auto it = _finished.begin(); it != _finished.end();) {
+        // nobody else (no Handle, accept queue, or map entry) refers to a finished connection
+        if (it->use_count() == 2 and _connections.count((*it)->key)) {
+            _forget(*it);
+        }
+        if (it->use_count() == 1) {
+            it = _finished.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+//! \param[in] timeout_ms is the longest to wait for a datagram (negative: until a timer expires)
+//! \details Segments produced by Handle calls since the last call are sent before waiting. The wait ends
+//! early when a connection's timer is due, and without datagrams or timers it only ends on `timeout_ms`.
+EventLoop::Result TCPStack::wait_next_event(const int timeout_ms) {
+    _flush();
+
+    const int timer_ms = _timers.timeout_ms(timestamp_ms());
+    const int wait_ms = timer_ms < 0 ? timeout_ms : (timeout_ms < 0 ? timer_ms : min(timeout_ms, timer_ms));
+    const auto ret = _eventloop.wait_next_event(wait_ms);
+
+    _timers.advance(timestamp_ms());
+
+    _flush();
+    _reap();
+    return ret;
+}
+
+size_t TCPStack::Handle::write(const string &data) {
+    _stack->_tick(*_entry);
+    const size_t written = _entry->connection.write(data);
+    _stack->_mark_for_flush(_entry);
+    return written;
+}
+
+string TCPStack::Handle::read(const size_t len) {
+    string data = _entry->connection.inbound_stream().read(len);
+    if (not data.empty()) {
+        _stack->_tick(*_entry);
+        _entry->connection.inbound_stream_read();
+        _stack->_mark_for_flush(_entry);
+    }
+    return data;
+}
+
+void TCPStack::Handle::end_input_stream() {
+    _stack->_tick(*_entry);
+    _entry->connection.end_input_stream();
+    _stack->_mark_for_flush(_entry);
+}
@@ -0,0 +1,212 @@
+#ifndef SPONGE_LIBSPONGE_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_STACK_HH
+
+#include "address.hh"
+#include "buffer_pool.hh"
+#include "byte_stream.hh"
+#include "eventloop.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "timer_wheel.hh"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//! \brief Many TCP connections sharing one UDP socket and one event loop
+//! \details TCPStack demultiplexes the TCP segments carried in UDP payloads (the same wire format as
+//! TCPOverUDPSocketAdapter) to one TCPConnection per 4-tuple: peer address and port, local TCP port, and
+//! peer TCP port. Each connection's next deadline is kept in one TimerWheel, so the stack sleeps until a
+//! datagram arrives or a timer expires and then ticks only the connections that are due; segments they
+//! produce are sent from the same socket.
+//!
+//! Unlike TCPSpongeSocket, a TCPStack has no thread of its own and no socketpair per connection. The owner
+//! calls wait_next_event() in a loop and, between calls, uses the Handle objects returned by connect() and
+//! accept() to read and write. Neither TCPStack nor its Handles are thread-safe, and Handles must not
+//! outlive their TCPStack.
+class TCPStack {
+  public:
+    //! Identifies a connection: peer IPv4 address, peer UDP port, local TCP port, peer TCP port
+    using FourTuple = std::tuple<uint32_t, uint16_t, uint16_t, uint16_t>;
+
+    //! Most datagrams received by one system call
+    static constexpr size_t RECV_BATCH_SIZE = 64;
+
+    //! \brief Hash of a connection's 4-tuple, which picks the shard that owns it (see ShardedTCPStack)
+    static uint32_t flow_hash(const FourTuple &key);
+
+    //! \brief Classic BPF program computing flow_hash() % `shards` for a received datagram
+    //! \details Attached to an SO_REUSEPORT group (Socket::attach_reuseport_cbpf), it steers each segment to
+    //! the socket of the shard that owns its connection.
+    static std::vector<sock_filter> flow_steering_program(const size_t shards);
+
+  private:
+    //! A connection and what the stack knows about it
+    struct Entry {
+        FourTuple key;
+        Address peer;
+        TCPConnection connection;
+        bool flush_pending = false;  //!< Listed in TCPStack::_to_flush?
+        bool accept_queued = false;  //!< Has it been queued for accept() (or returned by connect())?
+        bool finished = false;       //!< Listed in TCPStack::_finished?
+        uint64_t last_tick_ms;       //!< When the connection was last ticked
+        std::optional<TimerWheel::TimerId> timer{};  //!< Pending timer for the connection's next deadline
+        std::optional<uint64_t> deadline{};          //!< ...and its deadline
+
+        Entry(const FourTuple &k, const Address &p, const TCPConfig &config, const uint64_t now_ms)
+            : key(k), peer(p), connection(config), last_tick_ms(now_ms) {}
+    };
+
+    TCPConfig _config;
+    UDPSocket _socket;
+    EventLoop _eventloop{EventLoop::Backend::Epoll};
+
+    std::map<FourTuple, std::shared_ptr<Entry>> _connections{};
+    std::set<uint16_t> _listening_ports{};
+    std::deque<std::shared_ptr<Entry>> _accept_queue{};
+
+    //! Connections that may have segments to send
+    std::vector<std::shared_ptr<Entry>> _to_flush{};
+
+    //! Connections that are no longer active, to forget once no Handle refers to them
+    std::vector<std::shared_ptr<Entry>> _finished{};
+
+    //! Deadlines of all the connections
+    TimerWheel _timers;
+
+    uint16_t _next_ephemeral_port{49152};
+
+    //! \name This stack's shard, which connect() picks local ports for
+    //!@{
+    size_t _shard_index{0};
+    size_t _shard_count{1};
+    //!@}
+
+    //! Datagrams received by one [recvmmsg(2)](\ref man2::recvmmsg)
+    UDPSocket::RecvBatch _received{RECV_BATCH_SIZE};
+
+    //! Storage for received segments; each datagram is copied out of `_received` into a slot, which holds
+    //! a full-sized segment under the configured MSS
+    BufferPool _payloads{_config.mss + TCPHeader::MAX_LENGTH, 4 * RECV_BATCH_SIZE};
+
+    //! \name Segments being sent by _flush() with their destinations, their serialized headers, and the
+    //! datagrams that carry them
+    //!@{
+    std::vector<std::pair<const Address *, TCPSegment>> _sending{};
+    std::vector<TCPHeader::Serialized> _headers{};
+    UDPSocket::SendBatch _send_batch{};
+    //!@}
+
+    //! Read a batch of datagrams and deliver each segment to the connection it belongs to
+    void _receive_datagrams();
+
+    //! Deliver the segment in one received datagram
+    void _receive_datagram(const Address &source_address, const std::string_view payload);
+
+    //! Note that a connection may have produced segments (or changed its deadline)
+    void _mark_for_flush(const std::shared_ptr<Entry> &entry);
+
+    //! Send the segments produced by every connection marked for flushing, and update their timers
+    void _flush();
+
+    //! Tick a connection up to the present
+    void _tick(Entry &entry);
+
+    //! Make an entry's timer match its connection's next deadline
+    void _arm_timer(const std::shared_ptr<Entry> &entry);
+
+    //! Stop tracking a connection
+    void _forget(const std::shared_ptr<Entry> &entry);
+
+    //! Forget finished connections that no longer have a Handle
+    void _reap();
+
+  public:
+    //! \brief A connection owned by a TCPStack
+    class Handle {
+        friend class TCPStack;
+
+        TCPStack *_stack;
+        std::shared_ptr<Entry> _entry;
+
+        Handle(TCPStack &stack, std::shared_ptr<Entry> entry) : _stack(&stack), _entry(std::move(entry)) {}
+
+      public:
+        //! \name Handles are copyable; copies refer to the same connection
+        //!@{
+        Handle(const Handle &other) = default;
+        Handle &operator=(const Handle &other) = default;
+        //!@}
+
+        //! \brief Write data to the outbound byte stream
+        //! \returns the number of bytes accepted
+        size_t write(const std::string &data);
+
+        //! \brief Shut down the outbound byte stream
+        void end_input_stream();
+
+        //! \brief Read up to `len` bytes from the inbound byte stream
+        //! \details Lets the connection send a window update once enough of its window has opened.
+        std::string read(const size_t len);
+
+        //! \brief The inbound byte stream received from the peer (read it with Handle::read)
+        const ByteStream &inbound_stream() const { return _entry->connection.inbound_stream(); }
+
+        //! \returns the number of bytes that can be written right now
+        size_t remaining_outbound_capacity() const { return _entry->connection.remaining_outbound_capacity(); }
+
+        //! \brief Is the connection still alive in any way?
+        bool active() const { return _entry->connection.active(); }
+
+        //! \brief The underlying connection, for inspecting its state
+        const TCPConnection &connection() const { return _entry->connection; }
+
+        //! \brief The peer's UDP address
+        const Address &peer() const { return _entry->peer; }
+
+        //! \brief The connection's 4-tuple
+        const FourTuple &four_tuple() const { return _entry->key; }
+    };
+
+    //! \brief Construct from a bound UDP socket
+    //! \param[in] socket carries TCP segments in UDP payloads
+    //! \param[in] config is used for every connection
+    explicit TCPStack(UDPSocket &&socket, const TCPConfig &config = {});
+
+    //! \brief Accept connections to `port`
+    void listen(const uint16_t port);
+
+    //! \brief The next connection that finished its handshake on a listening port, if any
+    std::optional<Handle> accept();
+
+    //! \brief Open a connection to `remote_port` at `peer`, from an unused local port
+    //! \details With a shard set, the local port is one whose flow_hash() maps the connection to this shard.
+    Handle connect(const Address &peer, const uint16_t remote_port);
+
+    //! \brief Make this stack shard `index` of `count` stacks sharing one address
+    void set_shard(const size_t index, const size_t count);
+
+    //! \brief Wait up to `timeout_ms` for datagrams, process them, run expired timers, and send segments
+    //! \returns the result of the underlying EventLoop::wait_next_event
+    EventLoop::Result wait_next_event(const int timeout_ms);
+
+    //! \brief Number of connections the stack is tracking
+    size_t connection_count() const { return _connections.size(); }
+
+    //! \brief The UDP socket's local address
+    Address local_address() const { return _socket.local_address(); }
+
+    //! \brief Allocation counters of the storage for received segments
+    const BufferPool::Stats &payload_pool_stats() const { return _payloads.stats(); }
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_STACK_HH
@@ -2,5 +2,44 @@
 
 using namespace std;
 
+//! \param[in] tun is the device; reads take the packets it has waiting in batches (TunFD::read_many()),
+//! which needs it to be non-blocking
+TCPOverIPv4OverTunFdAdapter::TCPOverIPv4OverTunFdAdapter(TunFD &&tun)
+    : _tun(move(tun)), _received(BATCH_SIZE, _tun.max_packet_size()) {
+    _tun.set_blocking(false);
+}
+
+//! \details The first call after the batch is used up reads every packet waiting on the device (up to
+//! BATCH_SIZE); each call then parses one of them in place, without a copy or an allocation.
+optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::read() {
+    if (_next_received == _received.size()) {
+        _next_received = 0;
+        if (_tun.read_many(_received) == 0) {
+            return {};
+        }
+    }
+    const Buffer &packet = _received.packet(_next_received++);
+
+    if (_tun.vnet_hdr()) {
+        return unwrap_tcp_in_vnet(packet);
+    }
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(packet) != ParseResult::NoError) {
+        return {};
+    }
+    return unwrap_tcp_in_ip(ip_dgram);
+}
+
+void TCPOverIPv4OverTunFdAdapter::flush() {
+    for (size_t first = 0; first < _sending.size();) {
+        const size_t count = gso_run_length(_sending, first);
+        _iov.clear();
+        wrap_tcp_run_in_ip_into(_sending, first, count, _gso_headers, _iov);
+        _tun.write(_iov.data(), _iov.size());
+        first += count;
+    }
+    _sending.clear();
+}
+
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
 template class LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
@@ -7,27 +7,57 @@
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details Packets are read in batches into a ring of reusable, MTU-sized slots and parsed in place
+//! (TunFD::read_many()); each datagram is written with one [writev(2)](\ref man2::writev) of its headers
+//! and payload. If the TunFD was opened with a virtio-net header (TunFD::vnet_hdr()), segments are queued by
+//! write() and sent by flush(), which hands each run of contiguous segments to the kernel as one
+//! super-segment to split (generic segmentation offload); reads may return super-segments too.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
+  public:
+    //! Most packets read from the device per wakeup
+    static constexpr size_t BATCH_SIZE = 32;
+
   private:
     TunFD _tun;
 
+    //! Packets read by the last TunFD::read_many(), parsed in place by read()
+    TunFD::RecvBatch _received;
+    size_t _next_received{0};  //!< Index in `_received` of the next packet read() parses
+
+    //! \name With a virtio-net header: segments queued by write(), and storage for what flush() writes
+    //!@{
+    std::vector<TCPSegment> _sending{};
+    GSOHeaders _gso_headers{};
+    std::vector<iovec> _iov{};
+    //!@}
+
   public:
-    //! Construct from a TunFD
-    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
+    //! Construct from a TunFD, which is made non-blocking
+    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun);
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-    std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
-            return {};
+    std::optional<TCPSegment> read();
+
+    //! Number of packets read from the device but not yet returned by read()
+    size_t pending() const { return _received.size() - _next_received; }
+
+    //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device (without allocating),
+    //! or with a virtio-net header, queues the segment for flush()
+    void write(TCPSegment &seg) {
+        if (_tun.vnet_hdr()) {
+            _sending.push_back(seg);
+            return;
         }
-        return unwrap_tcp_in_ip(ip_dgram);
+        SerializedHeaders headers;
+        const auto iov = wrap_tcp_in_ip_into(seg, headers);
+        _tun.write(iov.data(), iov.size());
     }
 
-    //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    //! Writes the queued segments, one super-segment per run (see TCPOverIPv4Adapter::gso_run_length)
+    void flush();
 
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
@@ -65,6 +65,9 @@ bool TCPReceiver::segment_received(const TCPSegment &seg)
     // 一部分，此时无需重发直接返回false
     if (!(abs_seq < old_abs_ackno + old_window_size && abs_seq + seg.length_in_sequence_space() > old_abs_ackno))
     {
+        // 整个seg都是已经确认过的数据，说明对方多重传了一次，记下来用D-SACK告诉对方
+        if (seg.payload().size() && abs_seq + seg.length_in_sequence_space() <= old_abs_ackno)
+            _duplicate = make_pair(abs_seq, abs_seq + seg.payload().size());
         // 有一种情况例外，也就是ACK确认帧，流量控制要求收到的字符编号不能越界，但确认帧的编号是恰好月结的(fin的下一个位置)
         // 此时特殊处理，返回true，代表已收到确认帧
         return seg.length_in_sequence_space() == 0 && abs_seq == old_abs_ackno;
@@ -86,12 +89,22 @@ bool TCPReceiver::segment_received(const TCPSegment &seg)
     // 2、如果是第一个数据段(包含syn)则不用处理，直接用其0编号即可，符合要求。即(syn char1 char2)到达会把(char1,char2)
     // 送到reassembler，编号为0
     uint64_t stream_indices = abs_seq > 0 ? abs_seq - 1 : 0;
-    std::string payload(seg.payload().copy());
+    if (seg.payload().size())
+        _last_segment_index = stream_indices;
     // 如何判断当前数据段是否为最后一个，只需判断fin_abs_seq = abs_seq + seg.length_in_sequence_space()即可
     // stream_indices + seg.payload().size() + 2和abs_seq + seg.length_in_sequence_space()是等价的
     // 因为abs_seq=stream_indices+1，seg.length_in_sequence_space()=seg.payload().size()+1(fin的话要加1)
     // 因此abs_seq + seg.length_in_sequence_space()=stream_indices + seg.payload().size() + 2
-    _reassembler.push_substring(payload, stream_indices, stream_indices + seg.payload().size() + 2 == fin_abs_seq);
+    const bool eof = stream_indices + seg.payload().size() + 2 == fin_abs_seq;
+    // payload直接以Buffer交给reassembler（只增加引用计数，不拷贝字节），之后原样进入bytestream，
+    // 最后由writev从同一块内存写给应用。
+    // 但是存在bytestream里的引用会占住整个接收槽（UDP池的槽约1.5KB，vnet模式TUN的槽64KB），应用不读的话
+    // 几个字节就能占住一整块；所以payload不到槽的一半时拷贝成一个刚好大小的string（和ByteStream::read_from的
+    // SHORT_CHUNK一样）
+    if (seg.payload().size() * 2 >= seg.payload().storage_capacity())
+        _reassembler.push_substring(seg.payload(), stream_indices, eof);
+    else
+        _reassembler.push_substring(Buffer{seg.payload().copy()}, stream_indices, eof);
 
     return true;
 }
@@ -123,3 +136,24 @@ optional<WrappingInt32> TCPReceiver::ackno() const
 }
 
 size_t TCPReceiver::window_size() const { return _reassembler.stream_out().remaining_capacity(); }
+
+vector<TCPHeader::SackBlock> TCPReceiver::sack_blocks(const size_t max_blocks)
+{
+    vector<TCPHeader::SackBlock> blocks;
+    if (!isn.has_value() || max_blocks == 0)
+        return blocks;
+
+    // 重复的数据只报告一次，放在第一个
+    if (_duplicate.has_value())
+    {
+        blocks.push_back({wrap(_duplicate->first, isn.value()), wrap(_duplicate->second, isn.value())});
+        _duplicate.reset();
+    }
+    if (_reassembler.empty())
+        return blocks;
+
+    // reassembler里的下标比绝对序号小1（SYN占了序号0）
+    for (const auto &[first, last] : _reassembler.held_ranges(max_blocks - blocks.size(), _last_segment_index))
+        blocks.push_back({wrap(first + 1, isn.value()), wrap(last + 1, isn.value())});
+    return blocks;
+}
@@ -7,6 +7,8 @@
 #include "wrapping_integers.hh"
 
 #include <optional>
+#include <utility>
+#include <vector>
 
 //! \brief The "receiver" part of a TCP implementation.
 
@@ -26,6 +28,11 @@ class TCPReceiver
   // 所有数据右端(fin)的下一个位置的编号
   uint64_t fin_abs_seq;
 
+  // 最近收到的一个带数据的seg在流中的下标，SACK时把包含它的那一段放在最前面
+  uint64_t _last_segment_index{0};
+  // 收到的完全重复的数据（绝对序号[first, last)），下一个ack用D-SACK块报告给对方（RFC 2883）
+  std::optional<std::pair<uint64_t, uint64_t>> _duplicate{};
+
   //! ackno in Absolute Sequence Numbers form
   // 返回下一个顺位的数据段的第一个字符的abs_seqno
   uint64_t abs_ackno() const;
@@ -63,6 +70,12 @@ public:
   //! \brief number of bytes stored but not yet reassembled
   size_t unassembled_bytes() const { return _reassembler.unassembled_bytes(); }
 
+  //! \brief SACK blocks for the data held beyond the ackno ([RFC 2018](\ref rfc::rfc2018))
+  //! \details The block holding the most recently received segment comes first. If data that had already
+  //! been acknowledged arrived again, a D-SACK block reporting it ([RFC 2883](\ref rfc::rfc2883)) precedes
+  //! them, once.
+  std::vector<TCPHeader::SackBlock> sack_blocks(const size_t max_blocks);
+
   //! \brief handle an inbound segment
   //! \returns `true` if any part of the segment was inside the window
   bool segment_received(const TCPSegment &seg);
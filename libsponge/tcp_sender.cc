@@ -19,8 +19,12 @@ using namespace std;
 //! \param[in] capacity the capacity of the outgoing byte stream
 //! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment
 //! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise uses a random ISN)
-TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout, const std::optional<WrappingInt32> fixed_isn)
-    : _isn(fixed_isn.value_or(WrappingInt32{random_device()()})), _initial_retransmission_timeout{retx_timeout}, _stream(capacity), _rto{retx_timeout} {}
+//! \param[in] buffer_pool storage for segment payloads, if set (otherwise each payload is allocated separately)
+TCPSender::TCPSender(const size_t capacity,
+                     const uint16_t retx_timeout,
+                     const std::optional<WrappingInt32> fixed_isn,
+                     std::shared_ptr<BufferPool> buffer_pool)
+    : _isn(fixed_isn.value_or(WrappingInt32{random_device()()})), _initial_retransmission_timeout{retx_timeout}, _stream(capacity), _rto{retx_timeout}, _rtt_estimator{retx_timeout, TCPConfig::RTO_MIN_DFLT, TCPConfig::RTO_MAX_DFLT}, _buffer_pool(move(buffer_pool)) {}
 
 uint64_t TCPSender::bytes_in_flight() const { return _bytes_in_flight; }
 
@@ -37,7 +41,7 @@ void TCPSender::fill_window()
         return;
     }
     // 如果syn已经发送，但还没有被确认，即outstanding的队头是syn数据包，直接返回
-    if (!_segments_outstanding.empty() && _segments_outstanding.front().header().syn)
+    if (!_segments_outstanding.empty() && _segments_outstanding.front().syn)
         return;
 
     // 如果此时sender读数据的_stream已经空了，但_stream后续还有数据输入，则返回等待
@@ -50,21 +54,25 @@ void TCPSender::fill_window()
     // 如果receiver的window_size大于0，说明其bystream还有空间
     if (_receiver_window_size)
     {
-        // 只要receiver的可用空间不为0，就发seg过去
-        while (_receiver_free_space)
+        // 只要receiver的可用空间（有拥塞控制时还有拥塞窗口）不为0，就发seg过去
+        while (const size_t allowance = _send_allowance())
         {
             TCPSegment seg;
-            // 发过去的seg大小，要在sender剩下数据量，seg的最大承载量，以及receiver可用空间去取一个最小值
-            size_t payload_size = min({_stream.buffer_size(),
-                                       static_cast<size_t>(_receiver_free_space),
-                                       static_cast<size_t>(TCPConfig::MAX_PAYLOAD_SIZE)});
-            seg.payload() = _stream.read(payload_size);
+            // 发过去的seg大小，要在sender剩下数据量，seg的最大承载量，以及可发送的量去取一个最小值
+            size_t payload_size = min({_stream.buffer_size(), allowance, _max_payload_size});
+
+            // 缓存的数据凑不满一个seg时：塞住了就等，Nagle算法下有没确认的数据也等（流已经结束时剩下的数据马上和FIN一起发）
+            // 只看缓存的数据量，窗口太小造成的小seg照常发，不然窗口一直小于MSS时会卡住
+            if (_stream.buffer_size() < _max_payload_size && !_stream.input_ended() &&
+                (_corked || (_nagle && _bytes_in_flight)))
+                break;
+            seg.payload() = _read_payload(payload_size);
 
             // 如果后面不会再有数据输入到_stream，并且当前这一整段数据receiver可以全部存下,否则就算发过去
             // 也会把数据截断，后面还要重发被截断的部分，那当前段就不是fin了
-            //_receiver_free_space 要大于 payload_size，不能等于，因为fin也算一个字节
+            // 可发送的量要大于 payload_size，不能等于，因为fin也算一个字节
             // 整个seg大小为payload_size+1
-            if (_stream.eof() && static_cast<size_t>(_receiver_free_space) > payload_size)
+            if (_stream.eof() && allowance > payload_size)
             {
                 seg.header().fin = true;
                 _fin_sent = true;
@@ -76,11 +84,10 @@ void TCPSender::fill_window()
                 break;
         }
     }
-    else if (_receiver_free_space == 0)
+    else if (_bytes_in_flight == 0)
     {
-        // 会有一个测试数据用于测试window_size是否为0？，此时可用空间也为0（有可能在_send_segment中减成负的），
-        // 如果是fin的话则返回不带数据的fin即可，否则如果_stream有数据，返回一个字节回去,发送完后_receiver_free_space
-        // 减成-1
+        // 会有一个测试数据用于测试window_size是否为0？，此时没有在途的数据（探测用的字节还没被确认时不再发新的），
+        // 如果是fin的话则返回不带数据的fin即可，否则如果_stream有数据，返回一个字节回去
         TCPSegment seg;
         if (_stream.eof())
         {
@@ -90,7 +97,7 @@ void TCPSender::fill_window()
         }
         else if (!_stream.buffer_empty())
         {
-            seg.payload() = _stream.read(1);
+            seg.payload() = _read_payload(1);
             _send_segment(seg);
         }
     }
@@ -98,7 +105,14 @@ void TCPSender::fill_window()
 
 //! \param ackno The remote receiver's ackno (acknowledgment number)
 //! \param window_size The remote receiver's advertised window size
-void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size)
+//! \param carries_data Whether the segment carrying the ack occupied sequence space
+//! \param timestamp_echo The segment's TSecr, if timestamps are in use
+//! \param sack_blocks The segment's SACK blocks
+void TCPSender::ack_received(const WrappingInt32 ackno,
+                             const uint32_t window_size,
+                             const bool carries_data,
+                             const optional<uint32_t> timestamp_echo,
+                             const vector<TCPHeader::SackBlock> &sack_blocks)
 {
 
     // sender收到receiver返回的ack和window_size
@@ -110,37 +124,54 @@ void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_si
         return;
     }
 
+    // 重复ack（RFC 5681）：没有确认新数据，还有数据在途，不带数据，窗口也没变
+    const uint64_t lowest_unacked = _next_seqno - _bytes_in_flight;
+    const bool duplicate = abs_ackno == lowest_unacked && _bytes_in_flight > 0 && !carries_data &&
+                           window_size == _receiver_window_size;
+    // 新确认的字节数（SYN不算，不让它撑大拥塞窗口）
+    const uint64_t acked_from = max<uint64_t>(lowest_unacked, 1);
+    const size_t newly_acked = abs_ackno > acked_from ? abs_ackno - acked_from : 0;
+
+    // 窗口从0打开了吗（零窗口时发出去的探测字节对方没有收，见下面）
+    const bool window_opened = !_receiver_window_size && window_size;
+
     // 将receiver的window_size记下来
     _receiver_window_size = window_size;
     // 可用空间先初始化为window_size
     _receiver_free_space = window_size;
 
-    // 只要存在已经发送出去但没有收到确认的字符
-    while (!_segments_outstanding.empty())
+    // 如果一个seg对应的最后一个字符的编号<=ack，说明该seg已经被全部接受（ack是receiver接受到的所有字符的最后
+    // 一个编号）。outstanding里的seg编号是递增的，所以被确认的seg是队头的一段，二分找到这一段的末尾，一次弹出
+    const auto first_unacked =
+        partition_point(_segments_outstanding.begin(),
+                        _segments_outstanding.end(),
+                        [abs_ackno](const OutstandingSegment &seg) { return seg.end() <= abs_ackno; });
+    if (first_unacked != _segments_outstanding.begin())
     {
-        // 每次获取队头seg
-        TCPSegment seg = _segments_outstanding.front();
+        // 测一次RTT：有时间戳时直接用回显的时间（32位时钟，相减时回绕也对）；否则用这次确认的最后一个seg的
+        // 发送时间，但确认的seg里有重传过的就不测（Karn算法）
+        if (timestamp_echo.has_value())
+            _rtt_estimator.add_sample(static_cast<uint32_t>(static_cast<uint32_t>(_clock_ms) - timestamp_echo.value()));
+        else if (none_of(_segments_outstanding.begin(),
+                         first_unacked,
+                         [](const OutstandingSegment &seg) { return seg.retransmitted; }))
+            _rtt_estimator.add_sample(_clock_ms - prev(first_unacked)->sent_at_ms);
 
-        // 如果这个seg对应的最后一个字符的编号<=ack，说明该seg已经被全部接受（ack是receiver接受到的所有字符的最后
-        // 一个编号）
-        if (unwrap(seg.header().seqno, _isn, _next_seqno) + seg.length_in_sequence_space() <= abs_ackno)
-        {
-            // 此时未确认的数据减少了一个seg
-            _bytes_in_flight -= seg.length_in_sequence_space();
-            // 将seg弹出
-            _segments_outstanding.pop();
-
-            // ps:重传计时是针对outstanding队列的队头seg的，即已经发送出去但未收到确认的最老数据
-            // 如果队头已确认并且弹出，此时计时器重置
-            _time_elapsed = 0;                      // 时间从0开始累加
-            _rto = _initial_retransmission_timeout; // rto回到初始值（对于同一个seg，每重传一次就要翻倍）
-            _consecutive_retransmissions = 0;       // 下个seg的连续重传次数归0
-        }
-        // 如果队头seg没有被确认，则break（后面的seg也不会被确认，编号是递增的）
-        else
+        // 此时未确认的数据减少到从第一个未确认的seg开始（全部确认时为0）
+        _bytes_in_flight = first_unacked == _segments_outstanding.end() ? 0 : _next_seqno - first_unacked->abs_seqno;
+        for (auto it = _segments_outstanding.begin(); it != first_unacked; ++it)
         {
-            break;
+            _sacked_bytes -= it->sacked ? it->length() : 0;
+            _lost_bytes -= it->lost ? it->length() : 0;
         }
+        _segments_outstanding.erase(_segments_outstanding.begin(), first_unacked);
+
+        // ps:重传计时是针对outstanding队列的队头seg的，即已经发送出去但未收到确认的最老数据
+        // 如果队头已确认并且弹出，此时计时器重置
+        _time_elapsed = 0;                      // 时间从0开始累加
+        // rto回到初始值（对于同一个seg，每重传一次就要翻倍），打开自适应rto时回到按RTT算出来的值
+        _rto = _adaptive_rto ? _rtt_estimator.rto() : _initial_retransmission_timeout;
+        _consecutive_retransmissions = 0;       // 下个seg的连续重传次数归0
     }
 
     // 若收到ack后，处理完所有已被确认的seg，还有剩下的未确认的seg
@@ -152,23 +183,251 @@ void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_si
 
         // abs_ackno+window_size=receiver的bytestream的右边界
         // outstanding的队头seg的编号+已发送但没有收到确认的字节数=receiver的bytestream中的数据最大可能右边界
-        // 相减为最小可用空间
-        _receiver_free_space = static_cast<uint16_t>(
-            abs_ackno + static_cast<uint64_t>(window_size) -
-            unwrap(_segments_outstanding.front().header().seqno, _isn, _next_seqno) - _bytes_in_flight);
+        // 相减为最小可用空间（发出去的数据可能已经超出了右边界，比如探测0窗口的那个字节，此时可用空间为0）
+        const uint64_t right_edge = abs_ackno + static_cast<uint64_t>(window_size);
+        const uint64_t sent_edge = _segments_outstanding.front().abs_seqno + _bytes_in_flight;
+        _receiver_free_space = right_edge > sent_edge ? static_cast<uint32_t>(right_edge - sent_edge) : 0;
     }
 
     // 若全部字符都已经被确认，则关闭重传计时器
     if (!_bytes_in_flight)
         _timer_running = false;
 
+    // D-SACK（RFC 2883）：第一个块在ackno之前，说明对方收到了重复的数据
+    if (_sack && !sack_blocks.empty() && unwrap(sack_blocks.front().right, _isn, abs_ackno) <= abs_ackno)
+        _spurious_retransmission_reported();
+
+    // SACK块里有新被确认的seg，看看因此能不能判断出哪些seg丢了
+    if (_sack && _mark_sacked(sack_blocks, abs_ackno))
+        _detect_losses();
+
+    if (_congestion_controller && _sack)
+        _sack_recovery_on_ack(abs_ackno, newly_acked, duplicate);
+    else if (_congestion_controller)
+        _congestion_control_on_ack(abs_ackno, newly_acked, duplicate);
+    else if (_sack)
+        _retransmit_lost();
+
+    // 零窗口时发出去的seg（探测窗口的那个字节）都在窗口外，对方不会收；窗口打开后接着发的新数据又都排在它后面，
+    // 所以马上重传它，不然要等重传计时器到期才能继续
+    if (window_opened && !_segments_outstanding.empty() && !_segments_outstanding.front().syn &&
+        _segments_outstanding.front().abs_seqno == abs_ackno)
+    {
+        _retransmit_oldest();
+        _time_elapsed = 0;
+    }
+
     fill_window();
 }
 
+bool TCPSender::_mark_sacked(const vector<TCPHeader::SackBlock> &sack_blocks, const uint64_t abs_ackno)
+{
+    bool marked = false;
+    for (const TCPHeader::SackBlock &block : sack_blocks)
+    {
+        const uint64_t left = unwrap(block.left, _isn, abs_ackno);
+        const uint64_t right = unwrap(block.right, _isn, abs_ackno);
+        // 不在ackno和已发送的数据之间的块不合法，不管
+        if (left < abs_ackno || right > _next_seqno || left >= right)
+            continue;
+
+        // 整个落在块里的seg才算被SACK
+        auto it = partition_point(_segments_outstanding.begin(),
+                                  _segments_outstanding.end(),
+                                  [left](const OutstandingSegment &seg) { return seg.abs_seqno < left; });
+        for (; it != _segments_outstanding.end() && it->end() <= right; ++it)
+        {
+            if (it->sacked)
+                continue;
+            it->sacked = true;
+            _sacked_bytes += it->length();
+            if (it->lost)
+            {
+                it->lost = false;
+                _lost_bytes -= it->length();
+            }
+            marked = true;
+        }
+    }
+    return marked;
+}
+
+void TCPSender::_mark_lost(OutstandingSegment &outstanding)
+{
+    if (outstanding.sacked || outstanding.lost)
+        return;
+    outstanding.lost = true;
+    _lost_bytes += outstanding.length();
+}
+
+// RFC 6675的IsLost：从后往前数被SACK的seg，一个没被SACK的seg之后有_dup_thresh个，就说明它丢了（不是乱序）
+// 重传过的seg不再这样判断（分不清新的SACK是针对哪一次发送的），再丢了的话只能等超时
+void TCPSender::_detect_losses()
+{
+    size_t sacked_after = 0;
+    for (auto it = _segments_outstanding.rbegin(); it != _segments_outstanding.rend(); ++it)
+    {
+        if (it->sacked)
+            ++sacked_after;
+        else if (sacked_after >= _dup_thresh && !it->retransmitted)
+            _mark_lost(*it);
+    }
+}
+
+// 这次快速恢复重传的seg全都是多余的：其实没有丢包，只是乱序，撤销窗口的缩减，并且加倍判断丢包的门限，
+// 以后同样程度的乱序不再被当成丢包
+void TCPSender::_spurious_retransmission_reported()
+{
+    if (!_congestion_controller || _undo_retransmissions == 0 || --_undo_retransmissions > 0)
+        return;
+    _congestion_controller->undo_reduction();
+    _dup_thresh = min(2 * _dup_thresh, MAX_DUP_THRESH);
+    if (_recovery == Recovery::Fast)
+        _recovery = Recovery::None;
+}
+
+void TCPSender::_retransmit_lost()
+{
+    for (auto it = _segments_outstanding.begin(); it != _segments_outstanding.end() && _lost_bytes; ++it)
+    {
+        if (!it->lost)
+            continue;
+        // 有拥塞控制时，网络里的数据已经占满拥塞窗口就先不重传，等之后的ack
+        if (_congestion_controller && _pipe() >= _congestion_controller->window())
+            return;
+        _retransmit(*it);
+    }
+}
+
+// 快速重传/快速恢复（RFC 5681），部分确认时按NewReno（RFC 6582）马上重传下一个丢失的seg
+void TCPSender::_congestion_control_on_ack(const uint64_t abs_ackno, const size_t newly_acked, const bool duplicate)
+{
+    if (newly_acked)
+    {
+        _duplicate_acks = 0;
+        if (_recovery == Recovery::None)
+        {
+            _congestion_controller->on_ack(newly_acked, _clock_ms);
+            return;
+        }
+
+        // 超时之后的恢复中，窗口照常慢启动；快速恢复中，窗口先收缩掉已经离开网络的数据
+        if (_recovery == Recovery::Fast && abs_ackno >= _recover)
+            _congestion_controller->on_recovery_end();
+        else if (_recovery == Recovery::Fast)
+            _congestion_controller->on_partial_ack(newly_acked);
+        else
+            _congestion_controller->on_ack(newly_acked, _clock_ms);
+
+        // 进入恢复时发出去的数据全部确认了，恢复结束；否则是部分确认，下一个空洞也丢了，马上重传
+        if (abs_ackno >= _recover)
+            _recovery = Recovery::None;
+        else
+            _retransmit_oldest();
+        return;
+    }
+
+    if (!duplicate)
+        return;
+
+    ++_duplicate_acks;
+    if (_recovery == Recovery::Fast)
+    {
+        // 每个重复ack说明又有一个seg离开了网络，窗口膨胀一个MSS
+        _congestion_controller->on_duplicate_ack();
+    }
+    else if (_recovery == Recovery::None && _duplicate_acks == 3)
+    {
+        // 三个重复ack：不等超时，马上重传最老的seg，进入快速恢复
+        _congestion_controller->on_fast_retransmit(_bytes_in_flight, _clock_ms);
+        _recovery = Recovery::Fast;
+        _recover = _next_seqno;
+        _retransmit_oldest();
+    }
+}
+
+// 用SACK时的丢包恢复（RFC 6675）：丢了哪些seg由记分板判断，恢复中窗口固定在ssthresh，网络里的数据（pipe）
+// 不满一个窗口时先重传丢了的seg，再发新数据
+void TCPSender::_sack_recovery_on_ack(const uint64_t abs_ackno, const size_t newly_acked, const bool duplicate)
+{
+    if (newly_acked)
+        _duplicate_acks = 0;
+    else if (duplicate)
+        ++_duplicate_acks;
+
+    // 进入恢复时发出去的数据全部确认了，恢复结束
+    if (_recovery != Recovery::None && abs_ackno >= _recover)
+    {
+        if (_recovery == Recovery::Fast)
+            _congestion_controller->on_recovery_end();
+        _recovery = Recovery::None;
+    }
+
+    // 快速恢复中窗口不增长；超时之后的恢复中照常慢启动
+    if (newly_acked && _recovery != Recovery::Fast)
+        _congestion_controller->on_ack(newly_acked, _clock_ms);
+
+    if (!_segments_outstanding.empty())
+    {
+        OutstandingSegment &oldest = _segments_outstanding.front();
+        // 三个重复ack，或者记分板判断最老的seg丢了：进入快速恢复，不管窗口先重传最老的seg
+        if (_recovery == Recovery::None && (_duplicate_acks >= _dup_thresh || oldest.lost))
+        {
+            _congestion_controller->on_sack_recovery(_bytes_in_flight, _clock_ms);
+            _recovery = Recovery::Fast;
+            _recover = _next_seqno;
+            _undo_retransmissions = 0;
+            if (!oldest.sacked)
+                _retransmit(oldest);
+        }
+        // 快速恢复中的部分确认：和NewReno一样，把最老的seg也当作丢了（它之后被SACK的seg可能不够_dup_thresh个）
+        else if (_recovery == Recovery::Fast && newly_acked && !oldest.retransmitted)
+            _mark_lost(oldest);
+    }
+
+    _retransmit_lost();
+}
+
+size_t TCPSender::_send_allowance() const
+{
+    size_t allowance = _receiver_free_space;
+    if (_congestion_controller)
+    {
+        // 用SACK时按还在网络里的数据算，不用SACK时就是在途的字节数
+        const size_t cwnd = _congestion_controller->window();
+        const size_t room = cwnd > _pipe() ? cwnd - _pipe() : 0;
+        // 拥塞窗口剩下的不够一个满的seg时先不发（除非没有在途的数据），免得切出很多小seg
+        if (_pipe() && room < min(_max_payload_size, _stream.buffer_size()))
+            return 0;
+        allowance = min(allowance, room);
+    }
+    return allowance;
+}
+
+void TCPSender::set_max_payload_size(const size_t size)
+{
+    _max_payload_size = size;
+    if (_congestion_controller)
+        _congestion_controller->set_mss(size);
+}
+
+void TCPSender::set_congestion_controller(unique_ptr<CongestionController> controller)
+{
+    _congestion_controller = move(controller);
+}
+
+void TCPSender::set_adaptive_rto(const uint64_t min_rto, const uint64_t max_rto)
+{
+    _rtt_estimator.set_bounds(min_rto, max_rto);
+    _adaptive_rto = true;
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 // sender会定期调用该函数，累加 _time_elapsed，若超过了重传时间，则重传消息
 void TCPSender::tick(const size_t ms_since_last_tick)
 {
+    _clock_ms += ms_since_last_tick;
+
     // 如果重传计时器没有开启，则不管
     if (!_timer_running)
         return;
@@ -180,15 +439,32 @@ void TCPSender::tick(const size_t ms_since_last_tick)
     if (_time_elapsed >= _rto)
     {
         // 重传最老的没有收到确认的消息
-        _segments_out.push(_segments_outstanding.front());
+        _retransmit_oldest();
 
         // 重传时保证receiver的window_size>0即有位置存放消息，或者重传第一个消息（一开始window_size初始化为0）
-        if (_receiver_window_size || _segments_outstanding.front().header().syn)
+        if (_receiver_window_size || _segments_outstanding.front().syn)
         {
             // 累计连续重传次数
             ++_consecutive_retransmissions;
-            // 每连续重传一次,rto翻倍，防止重传的太频繁，导致网络拥塞
+            // 每连续重传一次,rto翻倍，防止重传的太频繁，导致网络拥塞（自适应rto时不超过上限）
             _rto <<= 1;
+            if (_adaptive_rto)
+                _rto = min(_rto, static_cast<unsigned int>(_rtt_estimator.max_rto()));
+
+            // 超时说明丢包了：拥塞窗口降到一个MSS重新慢启动，之后每个部分确认都马上重传下一个seg
+            if (_congestion_controller)
+            {
+                _congestion_controller->on_timeout(_bytes_in_flight, _clock_ms);
+                _recovery = Recovery::AfterTimeout;
+                _recover = _next_seqno;
+                _duplicate_acks = 0;
+                _undo_retransmissions = 0;
+
+                // 用SACK时，没被SACK的seg都当作丢了，之后随着窗口增长只重传这些，不重传已经被SACK的
+                if (_sack)
+                    for (auto it = next(_segments_outstanding.begin()); it != _segments_outstanding.end(); ++it)
+                        _mark_lost(*it);
+            }
         }
         // 重传后，时间归0，重新累加
         _time_elapsed = 0;
@@ -197,6 +473,35 @@ void TCPSender::tick(const size_t ms_since_last_tick)
 
 unsigned int TCPSender::consecutive_retransmissions() const { return _consecutive_retransmissions; }
 
+// 重传计时器还剩多久到期，计时器没开启时为空（此时tick什么都不做）
+optional<size_t> TCPSender::time_until_timeout() const
+{
+    if (!_timer_running)
+        return {};
+    return _time_elapsed >= _rto ? 0 : _rto - _time_elapsed;
+}
+
+// 按记下的序号和标志位重新组seg，payload不拷贝
+void TCPSender::_retransmit(OutstandingSegment &outstanding)
+{
+    outstanding.retransmitted = true;
+    if (_recovery == Recovery::Fast)
+        ++_undo_retransmissions;
+    if (outstanding.lost)
+    {
+        outstanding.lost = false;
+        _lost_bytes -= outstanding.length();
+    }
+    TCPSegment seg;
+    seg.header().seqno = wrap(outstanding.abs_seqno, _isn);
+    seg.header().syn = outstanding.syn;
+    seg.header().fin = outstanding.fin;
+    seg.payload() = outstanding.payload;
+    _segments_out.push(move(seg));
+}
+
+void TCPSender::_retransmit_oldest() { _retransmit(_segments_outstanding.front()); }
+
 // 发送一个空的seg
 void TCPSender::send_empty_segment()
 {
@@ -210,8 +515,19 @@ bool TCPSender::_ack_valid(uint64_t abs_ackno)
 {
     // ack不能太大，不能超过还没发送的字节的编号
     // 不能太小，不能小于已经发送的还没有确认的字节的最小编号，因为该编号之前的编号一定已经被确认过了，
-    return abs_ackno <= _next_seqno &&
-           abs_ackno >= unwrap(_segments_outstanding.front().header().seqno, _isn, _next_seqno);
+    // 这个编号就是_next_seqno - _bytes_in_flight（没有未确认的字节时就是_next_seqno）
+    return abs_ackno <= _next_seqno && abs_ackno >= _next_seqno - _bytes_in_flight;
+}
+
+// 从_stream读出payload：有池子的话拷贝到池子的槽位里，槽位在所有引用它的seg都释放后会被回收复用
+Buffer TCPSender::_read_payload(const size_t len)
+{
+    if (!_buffer_pool || len == 0)
+        return Buffer{_stream.read(len)};
+
+    auto storage = _buffer_pool->acquire(len);
+    _stream.read(*storage, len);
+    return Buffer{move(storage)};
 }
 
 // 发送seg
@@ -223,12 +539,19 @@ void TCPSender::_send_segment(TCPSegment &seg)
     _next_seqno += seg.length_in_sequence_space();
     // 累加已经发送但还没有收到确认的字节
     _bytes_in_flight += seg.length_in_sequence_space();
-    // 更新receiver的可用空间
+    // 更新receiver的可用空间（探测0窗口的字节会超出可用空间，此时减到0为止）
     if (_syn_sent)
-        _receiver_free_space -= seg.length_in_sequence_space();
-    // 将seg加到out和outstanding里面
+        _receiver_free_space -= min(_receiver_free_space, static_cast<uint32_t>(seg.length_in_sequence_space()));
+    // 将seg加到out和outstanding里面（outstanding只记序号、标志位和payload的引用）
+    _segments_outstanding.push_back({_next_seqno - seg.length_in_sequence_space(),
+                                     seg.payload(),
+                                     seg.header().syn,
+                                     seg.header().fin,
+                                     _clock_ms,
+                                     false,
+                                     false,
+                                     false});
     _segments_out.push(seg);
-    _segments_outstanding.push(seg);
     // 如果重传计时器没有开启（没有被某个seg占用），开启该seg对应的重传计时器
     if (!_timer_running)
     {
@@ -1,13 +1,20 @@
 #ifndef SPONGE_LIBSPONGE_TCP_SENDER_HH
 #define SPONGE_LIBSPONGE_TCP_SENDER_HH
 
+#include "buffer_pool.hh"
 #include "byte_stream.hh"
+#include "congestion_controller.hh"
+#include "rtt_estimator.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "wrapping_integers.hh"
 
+#include <deque>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <vector>
 
 //! \brief The "sender" part of a TCP implementation.
 
@@ -43,8 +50,8 @@ private:
   bool _fin_sent = false;
   // 已经发送出去但还没有收到ack的字符数
   uint64_t _bytes_in_flight = 0;
-  // receiver的windown_size（reciver的bytestream的cap-remain_cap）
-  uint16_t _receiver_window_size = 0;
+  // receiver的windown_size（reciver的bytestream的cap-remain_cap），已经按窗口扩大选项左移过，所以是32位
+  uint32_t _receiver_window_size = 0;
 
   // receiver的最小可用空间，当收到receiver的ack和window_size时有以下几种情况：
   // 1、该ack确认了所有发送过去的数据段，此时可用空间就是receiver的bytestream的剩余空间，即window_size
@@ -54,29 +61,117 @@ private:
   // （3）sender发过去的数据没有接受到了receiver的bytestream
   // 这三种情况中(1)的receiver剩余空间最小，由于sender不知道是哪种情况，所有要按照最坏情况考虑，此时最小空用空间
   // 为(1)的剩余空间
-  uint16_t _receiver_free_space = 0;
+  uint32_t _receiver_free_space = 0;
+
+  // 一个seg最多带多少字节的payload（协商后的MSS）
+  size_t _max_payload_size = TCPConfig::MAX_PAYLOAD_SIZE;
+
+  // 小数据合并：Nagle算法（RFC 896）下，有没确认的数据时不发不满一个seg的小数据；塞住(cork)时一直不发，
+  // 直到拔开或者凑满一个seg
+  bool _nagle = false;
+  bool _corked = false;
+
+  // 拥塞控制算法，为空时不做拥塞控制（只受receiver窗口限制，也不做快速重传）
+  std::unique_ptr<CongestionController> _congestion_controller{};
+  // 由tick累加出来的时钟（毫秒），给拥塞控制算法、RTT测量和时间戳选项用
+  uint64_t _clock_ms = 0;
+  // 连续收到的重复ack个数
+  unsigned int _duplicate_acks = 0;
+  // 丢包恢复的状态：没有在恢复、快速恢复（三个重复ack触发）、超时重传之后的恢复
+  enum class Recovery
+  {
+    None,
+    Fast,
+    AfterTimeout
+  };
+  Recovery _recovery = Recovery::None;
+  // 进入恢复时已经发出去的最大序号，ack越过它才算恢复完成（NewReno的recover）
+  uint64_t _recover = 0;
 
   // 连续的重传次数
   uint16_t _consecutive_retransmissions = 0;
   // 超过多少时间没收到ack重传
   unsigned int _rto = 0;
+  // RTT估计（RFC 6298），总是在测量，打开_adaptive_rto后rto才按它来算
+  RTTEstimator _rtt_estimator;
+  bool _adaptive_rto = false;
+
+  // 选择确认（RFC 2018）：对方的ack里带着它已经收到的、ackno之后的数据段，据此只重传真正丢了的seg（RFC 6675）
+  bool _sack = false;
+  // 之后有这么多个被SACK的seg，还没被SACK的seg就当作丢了（RFC 6675的DupThresh），发现乱序时加倍，不超过上限
+  static constexpr size_t MAX_DUP_THRESH = 64;
+  size_t _dup_thresh = 3;
+  // 这次快速恢复中重传的seg里，还有几个没被D-SACK报告为多余的（都报告了就说明其实没丢包，只是乱序）
+  size_t _undo_retransmissions = 0;
+  // 在途的数据中被SACK的字节数，以及判断为丢了但还没重传的字节数，这两部分都不在网络里
+  uint64_t _sacked_bytes = 0;
+  uint64_t _lost_bytes = 0;
   // 自上次重传完后，过了多久
   unsigned int _time_elapsed = 0;
   // 重传计时器是否运作
   bool _timer_running = false;
-  // 用于存放已经发出去的，但没有收到确认的数据
-  std::queue<TCPSegment> _segments_outstanding{};
+  // 一个已经发出去但还没有收到确认的seg：只记下绝对序号和标志位，payload和发出去的seg共享同一块存储，
+  // 不拷贝数据，重传时据此重新组一个seg
+  struct OutstandingSegment
+  {
+    uint64_t abs_seqno;
+    Buffer payload;
+    bool syn;
+    bool fin;
+    // 第一次发出去的时间，以及有没有被重传过（Karn算法：重传过的seg的ack分不清对应哪一次发送，不能用来测RTT）
+    uint64_t sent_at_ms;
+    bool retransmitted;
+    // 已经被对方SACK了（不用再重传）；判断为丢了，等着重传
+    bool sacked;
+    bool lost;
+
+    // 这个seg之后下一个序号（seg占用[abs_seqno, end())）
+    uint64_t end() const { return abs_seqno + payload.size() + syn + fin; }
+    uint64_t length() const { return end() - abs_seqno; }
+  };
+
+  // 用于存放已经发出去的，但没有收到确认的数据，按序号递增排列
+  std::deque<OutstandingSegment> _segments_outstanding{};
+
+  // payload的存储从这个池子里取（由TCPConnection持有），为空时每个payload单独分配
+  std::shared_ptr<BufferPool> _buffer_pool;
+
+  // 从_stream读出len个字节作为seg的payload
+  Buffer _read_payload(const size_t len);
 
   // 判断收到的ack编号是否合法
   bool _ack_valid(uint64_t abs_ackno);
   // 将seg发出去
   void _send_segment(TCPSegment &seg);
+  // 重传一个seg
+  void _retransmit(OutstandingSegment &outstanding);
+  // 重传最老的没有收到确认的seg
+  void _retransmit_oldest();
+  // 按ack里的SACK块标记已被SACK的seg，返回有没有新标记的
+  bool _mark_sacked(const std::vector<TCPHeader::SackBlock> &sack_blocks, const uint64_t abs_ackno);
+  // 标记seg是丢了的
+  void _mark_lost(OutstandingSegment &outstanding);
+  // 之后有_dup_thresh个被SACK的seg的，标记为丢了
+  void _detect_losses();
+  // 对方用D-SACK报告了一次多余的重传
+  void _spurious_retransmission_reported();
+  // 重传标记为丢了的seg（有拥塞控制时，受拥塞窗口限制）
+  void _retransmit_lost();
+  // 还在网络里的字节数（RFC 6675的pipe）：在途的，除去被SACK的和丢了还没重传的
+  uint64_t _pipe() const { return _bytes_in_flight - _sacked_bytes - _lost_bytes; }
+  // 现在最多还能发多少字节（receiver的可用空间，有拥塞控制时还要受拥塞窗口限制）
+  size_t _send_allowance() const;
+  // 收到ack后更新拥塞控制的状态：新确认了newly_acked个字节，或者是一个重复ack
+  void _congestion_control_on_ack(const uint64_t abs_ackno, const size_t newly_acked, const bool duplicate);
+  // 同上，用SACK时的丢包恢复（RFC 6675）：窗口不膨胀，按pipe发送，只重传丢了的seg
+  void _sack_recovery_on_ack(const uint64_t abs_ackno, const size_t newly_acked, const bool duplicate);
 
 public:
   //! Initialize a TCPSender
   TCPSender(const size_t capacity = TCPConfig::DEFAULT_CAPACITY,
             const uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
-            const std::optional<WrappingInt32> fixed_isn = {});
+            const std::optional<WrappingInt32> fixed_isn = {},
+            std::shared_ptr<BufferPool> buffer_pool = {});
 
   //! \name "Input" interface for the writer
   //!@{
@@ -88,7 +183,16 @@ public:
   //!@{
 
   //! \brief A new acknowledgment was received
-  void ack_received(const WrappingInt32 ackno, const uint16_t window_size);
+  //! \param window_size is the advertised window, already scaled (so it can exceed 65535)
+  //! \param carries_data is true if the segment occupied sequence space (then it is never a duplicate ACK)
+  //! \param timestamp_echo is the segment's TSecr, if timestamps are in use (it times the ACK even after
+  //! a retransmission)
+  //! \param sack_blocks are the segment's SACK blocks (ignored unless enable_sack() was called)
+  void ack_received(const WrappingInt32 ackno,
+                    const uint32_t window_size,
+                    const bool carries_data = false,
+                    const std::optional<uint32_t> timestamp_echo = {},
+                    const std::vector<TCPHeader::SackBlock> &sack_blocks = {});
 
   //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
   void send_empty_segment();
@@ -111,6 +215,49 @@ public:
   //! \brief Number of consecutive retransmissions that have occurred in a row
   unsigned int consecutive_retransmissions() const;
 
+  //! \brief Largest payload put in a segment
+  size_t max_payload_size() const { return _max_payload_size; }
+
+  //! \brief Change the largest payload put in a segment (e.g. to the negotiated MSS)
+  void set_max_payload_size(const size_t size);
+
+  //! \brief Nagle's algorithm ([RFC 896](\ref rfc::rfc896)): while data is unacknowledged, hold back a
+  //! segment smaller than the maximum payload until more data fills it
+  void set_nagle(const bool enabled) { _nagle = enabled; }
+  bool nagle() const { return _nagle; }
+
+  //! \brief While corked, send only full segments (and the last one, once the stream has ended)
+  void set_corked(const bool corked) { _corked = corked; }
+  bool corked() const { return _corked; }
+
+  //! \brief Use a congestion controller (nullptr: none, limited only by the receiver's window)
+  void set_congestion_controller(std::unique_ptr<CongestionController> controller);
+
+  //! \brief The congestion controller, if any
+  const CongestionController *congestion_controller() const { return _congestion_controller.get(); }
+
+  //! \brief Milliseconds of tick() until the retransmission timer expires (empty if it is not running)
+  std::optional<size_t> time_until_timeout() const;
+
+  //! \brief Take the retransmission timeout from RTT measurements, within [min_rto, max_rto]
+  void set_adaptive_rto(const uint64_t min_rto, const uint64_t max_rto);
+
+  //! \brief Use the SACK blocks of ACKs to find and resend only the missing segments
+  //! ([RFC 6675](\ref rfc::rfc6675))
+  void enable_sack() { _sack = true; }
+
+  //! \brief Bytes in flight that the peer has selectively acknowledged
+  uint64_t sacked_bytes() const { return _sacked_bytes; }
+
+  //! \brief Round-trip time measurements (taken whether or not the RTO is adaptive)
+  const RTTEstimator::Stats &rtt_stats() const { return _rtt_estimator.stats(); }
+
+  //! \brief The current retransmission timeout, including backoff
+  unsigned int rto() const { return _rto; }
+
+  //! \brief Milliseconds of tick() since the sender was created (the clock of RTT measurements)
+  uint64_t clock_ms() const { return _clock_ms; }
+
   //! \brief TCPSegments that the TCPSender has enqueued for transmission.
   //! \note These must be dequeued and sent by the TCPConnection,
   //! which will need to fill in the fields that are set by the TCPReceiver
@@ -16,6 +16,7 @@ class Buffer {
   private:
     std::shared_ptr<std::string> _storage{};
     size_t _starting_offset{};
+    size_t _ending_offset{};  //!< Number of bytes discarded from the back of the string
 
   public:
     Buffer() = default;
@@ -23,13 +24,16 @@ class Buffer {
     //! \brief Construct by taking ownership of a string
     Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
 
+    //! \brief Construct by sharing existing storage (e.g. a slot from a BufferPool)
+    explicit Buffer(std::shared_ptr<std::string> storage) noexcept : _storage(std::move(storage)) {}
+
     //! \name Expose contents as a std::string_view
     //!@{
     std::string_view str() const {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset - _ending_offset};
     }
 
     operator std::string_view() const { return str(); }
@@ -41,12 +45,19 @@ class Buffer {
     //! \brief Size of the string
     size_t size() const { return str().size(); }
 
+    //! \brief Bytes allocated for the underlying storage, all of which stay allocated while any copy is alive
+    size_t storage_capacity() const { return _storage ? _storage->capacity() : 0; }
+
     //! \brief Make a copy to a new std::string
     std::string copy() const { return std::string(str()); }
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
+    void remove_suffix(const size_t n);
 };
 
 //! \brief A reference-counted discontiguous string that can discard bytes from the front
@@ -102,6 +113,8 @@ class BufferViewList {
     //! \name Constructors
     //!@{
 
+    BufferViewList() = default;
+
     //! \brief Construct from a std::string
     BufferViewList(const std::string &str) : BufferViewList(std::string_view(str)) {}
 
@@ -115,6 +128,12 @@ class BufferViewList {
     BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
     //!@}
 
+    //! \brief Append a view onto the end of the list
+    void append(std::string_view str) { _views.push_back(str); }
+
+    //! \brief Access the underlying queue of views
+    const std::deque<std::string_view> &views() const { return _views; }
+
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     void remove_prefix(size_t n);
 
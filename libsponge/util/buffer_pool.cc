@@ -0,0 +1,61 @@
+#include "buffer_pool.hh"
+
+using namespace std;
+
+BufferPool::BufferPool(const size_t slot_capacity, const size_t max_slots)
+    : _slot_capacity(slot_capacity), _max_slots(max_slots) {
+    _slots.reserve(_max_slots);
+}
+
+//! \details Buffers are usually released in the order they were acquired (segments are
+//! acknowledged oldest first), so the search resumes just past the last slot handed out and
+//! normally finds a free one at once.
+shared_ptr<string> BufferPool::_acquire_slot(const size_t size) {
+    ++_stats.acquired;
+
+    if (size > _slot_capacity) {
+        ++_stats.unpooled;
+        return {};
+    }
+
+    for (size_t i = 0; i < _slots.size(); i++) {
+        const size_t index = (_next_slot + i) % _slots.size();
+        auto &slot = _slots[index];
+        if (slot.use_count() == 1) {
+            _next_slot = index + 1;
+            ++_stats.reused;
+            return slot;
+        }
+    }
+
+    if (_slots.size() == _max_slots) {
+        ++_stats.unpooled;
+        return {};
+    }
+
+    ++_stats.allocated;
+    auto &slot = _slots.emplace_back(make_shared<string>());
+    slot->reserve(_slot_capacity);
+    _next_slot = _slots.size();
+    return slot;
+}
+
+//! \param[in] size bytes the caller is about to write into the storage
+shared_ptr<string> BufferPool::acquire(const size_t size) {
+    auto slot = _acquire_slot(size);
+    if (not slot) {
+        return make_shared<string>();
+    }
+    slot->clear();
+    return slot;
+}
+
+//! \param[in] size bytes the storage must hold
+shared_ptr<string> BufferPool::acquire_sized(const size_t size) {
+    auto slot = _acquire_slot(size);
+    if (not slot) {
+        return make_shared<string>(size, 0);
+    }
+    slot->resize(size);
+    return slot;
+}
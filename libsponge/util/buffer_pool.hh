@@ -0,0 +1,60 @@
+#ifndef SPONGE_LIBSPONGE_BUFFER_POOL_HH
+#define SPONGE_LIBSPONGE_BUFFER_POOL_HH
+
+#include "buffer.hh"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! \brief A slab of reusable string storage for Buffers
+//! \details Each slot is a std::shared_ptr<std::string> whose capacity is reserved once, up front.
+//! A Buffer made from a slot shares it like any other Buffer; when every such Buffer has been
+//! destroyed (the pool's reference is the only one left), the slot is handed out again instead of
+//! being returned to malloc. Not thread-safe: a pool belongs to one TCPConnection.
+class BufferPool {
+  public:
+    //! Counters for checking that a steady state allocates nothing
+    struct Stats {
+        uint64_t acquired{0};   //!< Calls to acquire()
+        uint64_t reused{0};     //!< ...satisfied by recycling a free slot
+        uint64_t allocated{0};  //!< ...that had to allocate a new slot
+        uint64_t unpooled{0};   //!< ...that allocated outside the pool (pool full, or request too large)
+    };
+
+  private:
+    size_t _slot_capacity;
+    size_t _max_slots;
+    std::vector<std::shared_ptr<std::string>> _slots{};
+    size_t _next_slot{0};  //!< Where the search for a free slot starts
+    Stats _stats{};
+
+    //! Find or make a free slot with room for `size` bytes, or nothing if there is none; leaves its contents
+    std::shared_ptr<std::string> _acquire_slot(const size_t size);
+
+  public:
+    //! \param[in] slot_capacity bytes reserved in each slot
+    //! \param[in] max_slots the most slots the pool will ever hold
+    BufferPool(const size_t slot_capacity, const size_t max_slots);
+
+    //! \brief Get empty storage with room for at least `size` bytes
+    //! \note Returns a fresh, unpooled string if `size` exceeds the slot capacity or no slot is free
+    std::shared_ptr<std::string> acquire(const size_t size);
+
+    //! \brief Get storage that is exactly `size` bytes long, with unspecified contents
+    //! \details A recycled slot is not cleared first, so a caller that always asks for the same size
+    //! (and then writes over the storage) does not pay for filling it with zeros each time.
+    std::shared_ptr<std::string> acquire_sized(const size_t size);
+
+    //! \brief Bytes reserved in each slot
+    size_t slot_capacity() const { return _slot_capacity; }
+
+    //! \brief Number of slots currently held
+    size_t slots() const { return _slots.size(); }
+
+    //! \brief Allocation counters
+    const Stats &stats() const { return _stats; }
+};
+
+#endif  // SPONGE_LIBSPONGE_BUFFER_POOL_HH
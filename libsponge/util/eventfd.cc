@@ -0,0 +1,25 @@
+#include "eventfd.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor(SystemCall("eventfd", ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))) {}
+
+void EventFD::signal() {
+    const uint64_t increment = 1;
+    SystemCall("write", ::write(fd_num(), &increment, sizeof(increment)));
+    register_write();
+}
+
+bool EventFD::clear() {
+    uint64_t count = 0;
+    const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), &count, sizeof(count)), EAGAIN);
+    register_read();
+    return bytes_read > 0;
+}
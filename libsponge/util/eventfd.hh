@@ -0,0 +1,22 @@
+#ifndef SPONGE_LIBSPONGE_EVENTFD_HH
+#define SPONGE_LIBSPONGE_EVENTFD_HH
+
+#include "file_descriptor.hh"
+
+//! \brief A non-blocking [eventfd(2)](\ref man2::eventfd), for one thread to wake another
+//! \details It is readable while signaled; an EventLoop rule can watch it for Direction::In, and must
+//! clear() it in its callback.
+class EventFD : public FileDescriptor {
+  public:
+    //! Create an eventfd that is not signaled
+    EventFD();
+
+    //! Make the eventfd readable (any thread)
+    void signal();
+
+    //! Make it no longer readable; counts as a read for EventLoop's busy-wait detection
+    //! \returns whether it was signaled
+    bool clear();
+};
+
+#endif  // SPONGE_LIBSPONGE_EVENTFD_HH
@@ -14,11 +14,24 @@ unsigned int EventLoop::Rule::service_count() const {
     return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+//! \param[in] backend selects [poll(2)](\ref man2::poll) or [epoll(7)](\ref man7::epoll)
+EventLoop::EventLoop(const Backend backend) : _backend(backend) {
+    if (_backend == Backend::Epoll) {
+        _epoll_fd.emplace(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC)));
+    }
+}
+
+//! The epoll event bit corresponding to a Direction
+static uint32_t epoll_events_for(const EventLoop::Direction direction) {
+    return direction == EventLoop::Direction::In ? EPOLLIN : EPOLLOUT;
+}
+
 //! \param[in] fd is the FileDescriptor to be polled
 //! \param[in] direction indicates whether to poll for reading (Direction::In) or writing (Direction::Out)
 //! \param[in] callback is called when `fd` is ready.
 //! \param[in] interest is called by EventLoop::wait_next_event. If it returns `true`, `fd` will
 //!                     be polled, otherwise `fd` will be ignored only for this execution of `wait_next_event.
+//!                     With Backend::Epoll, the answer is kept until `fd` is ready or EventLoop::notify is called.
 //! \param[in] cancel is called when the rule is cancelled (e.g. on hangup, EOF, or closure).
 void EventLoop::add_rule(const FileDescriptor &fd,
                          const Direction direction,
@@ -26,6 +39,37 @@ void EventLoop::add_rule(const FileDescriptor &fd,
                          const InterestT &interest,
                          const CallbackT &cancel) {
     _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+
+    if (_backend == Backend::Epoll) {
+        // registered with the kernel at the next wait, once the rule's interest is known
+        auto &registration = _registrations[fd.fd_num()];
+        registration.rules.push_back(prev(_rules.end()));
+        _mark_stale(fd.fd_num(), registration);
+    }
+}
+
+//! \param[in] fd is the FileDescriptor whose rules should be asked for their interest again
+void EventLoop::notify(const FileDescriptor &fd) {
+    if (_backend != Backend::Epoll) {
+        return;
+    }
+    const auto reg_it = _registrations.find(fd.fd_num());
+    if (reg_it != _registrations.end()) {
+        _mark_stale(reg_it->first, reg_it->second);
+    }
+}
+
+void EventLoop::notify_all() {
+    for (auto &[fd_num, registration] : _registrations) {
+        _mark_stale(fd_num, registration);
+    }
+}
+
+void EventLoop::_mark_stale(const int fd_num, EpollRegistration &registration) {
+    if (not registration.stale) {
+        registration.stale = true;
+        _stale.push_back(fd_num);
+    }
 }
 
 //! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll); `wait_next_event`
@@ -59,6 +103,10 @@ void EventLoop::add_rule(const FileDescriptor &fd,
 //! will result in a busy loop (poll returns on a ready file descriptor; file descriptor is not read or
 //! written, so it is still ready; the next call to poll will immediately return).
 EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
+    return _backend == Backend::Epoll ? _wait_next_event_epoll(timeout_ms) : _wait_next_event_poll(timeout_ms);
+}
+
+EventLoop::Result EventLoop::_wait_next_event_poll(const int timeout_ms) {
     vector<pollfd> pollfds{};
     pollfds.reserve(_rules.size());
     bool something_to_poll = false;
@@ -143,3 +191,158 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
 
     return Result::Success;
 }
+
+//! \param[in] fd_num is the fd whose registration to refresh
+//! \param[in,out] registration holds the rules on `fd_num`
+bool EventLoop::_refresh_registration(const int fd_num, EpollRegistration &registration) {
+    registration.stale = false;
+
+    uint32_t events = 0;
+    for (size_t i = 0; i < registration.rules.size();) {
+        const auto rule = registration.rules[i];
+        if (rule->fd.closed()) {
+            // closing the fd removed it from the epoll set, and its number may since have been reused
+            if (registration.added) {
+                registration.added = false;
+                --_added_count;
+            }
+        }
+        if ((rule->direction == Direction::In && rule->fd.eof()) or rule->fd.closed()) {
+            // no more reading or writing on this rule
+            rule->cancel();
+            _rules.erase(rule);
+            registration.rules.erase(registration.rules.begin() + i);
+            continue;
+        }
+        rule->polled = rule->interest();
+        if (rule->polled) {
+            events |= epoll_events_for(rule->direction);
+        }
+        ++i;
+    }
+
+    if (events == 0) {
+        // nobody is interested: leave the epoll set, since epoll reports EPOLLHUP and EPOLLERR even for an fd
+        // registered with no events, and a hung-up fd would then wake every wait.
+        // Errors are expected here: the fd may already be closed, which removed it from the epoll set
+        if (registration.added) {
+            ::epoll_ctl(_epoll_fd->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr);
+            registration.added = false;
+            --_added_count;
+        }
+    } else if (not registration.added or events != registration.events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd_num;
+        // ENOENT: the fd number was closed (which left the epoll set) and has been reused by a new fd
+        const bool modified =
+            registration.added and
+            SystemCall("epoll_ctl", ::epoll_ctl(_epoll_fd->fd_num(), EPOLL_CTL_MOD, fd_num, &ev), ENOENT) == 0;
+        if (not modified) {
+            SystemCall("epoll_ctl", ::epoll_ctl(_epoll_fd->fd_num(), EPOLL_CTL_ADD, fd_num, &ev));
+        }
+        if (not registration.added) {
+            registration.added = true;
+            ++_added_count;
+        }
+    }
+    registration.events = events;
+
+    return not registration.rules.empty();
+}
+
+//! \details Behaves like the poll(2) backend (see EventLoop::wait_next_event), except that:
+//!
+//! - all rules on an fd share one epoll registration, which is only changed with
+//!   [epoll_ctl(2)](\ref man2::epoll_ctl) when the rules' combined interest changes;
+//! - Rule::interest is only asked, and finished rules only canceled, on fds that were ready in the last
+//!   wait or that the owner notified (see EventLoop::notify);
+//! - after waiting, only the fds that [epoll_wait(2)](\ref man2::epoll_wait) reported ready are examined.
+EventLoop::Result EventLoop::_wait_next_event_epoll(const int timeout_ms) {
+    // refresh the stale registrations only.
+    // NOTE: cancel and interest callbacks may add rules, which appends to _stale, so index rather than iterate
+    for (size_t n = 0; n < _stale.size(); ++n) {
+        const auto reg_it = _registrations.find(_stale[n]);
+        if (reg_it == _registrations.end()) {
+            continue;
+        }
+        if (not _refresh_registration(reg_it->first, reg_it->second)) {
+            _registrations.erase(reg_it);
+        }
+    }
+    _stale.clear();
+
+    // quit if there is nothing left to poll
+    if (_added_count == 0) {
+        return Result::Exit;
+    }
+
+    // wait until one of the fds satisfies one of the rules (writeable/readable)
+    _epoll_events.resize(_registrations.size());
+    int ready_count = 0;
+    try {
+        ready_count = SystemCall(
+            "epoll_wait", ::epoll_wait(_epoll_fd->fd_num(), _epoll_events.data(), _epoll_events.size(), timeout_ms));
+        if (ready_count == 0) {
+            return Result::Timeout;
+        }
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            return Result::Exit;
+        }
+        throw;
+    }
+
+    // go through the ready fds only
+    for (int n = 0; n < ready_count; ++n) {
+        const auto &event = _epoll_events[n];
+
+        if (event.events & EPOLLERR) {
+            throw runtime_error("EventLoop: error on polled file descriptor");
+        }
+
+        const auto reg_it = _registrations.find(event.data.fd);
+        if (reg_it == _registrations.end()) {
+            continue;
+        }
+        auto &registration = reg_it->second;
+        _mark_stale(reg_it->first, registration);
+
+        // NOTE: callbacks may add rules to this fd, so index rather than iterate
+        for (size_t i = 0; i < registration.rules.size();) {
+            const auto rule = registration.rules[i];
+            if (not rule->polled) {
+                ++i;
+                continue;
+            }
+
+            const auto poll_ready = static_cast<bool>(event.events & epoll_events_for(rule->direction));
+            const auto poll_hup = static_cast<bool>(event.events & EPOLLHUP);
+            if (poll_hup && !poll_ready) {
+                // we asked for this direction and the _only_ condition was a hangup: this FD is defunct
+                rule->cancel();
+                _rules.erase(rule);
+                registration.rules.erase(registration.rules.begin() + i);
+                continue;
+            }
+
+            if (poll_ready) {
+                // we only want to call callback if the event includes the direction we asked for
+                const auto count_before = rule->service_count();
+                rule->callback();
+
+                // only check for busy wait if we're not canceling or exiting
+                if (count_before == rule->service_count() and rule->interest()) {
+                    throw runtime_error(
+                        "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+                }
+            }
+            ++i;
+        }
+
+        // the rules' interest is asked again, and an fd whose rules were all canceled is unregistered,
+        // at the start of the next wait
+    }
+
+    return Result::Success;
+}
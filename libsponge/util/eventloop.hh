@@ -3,10 +3,15 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <map>
+#include <optional>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
@@ -17,6 +22,19 @@ class EventLoop {
         Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    //! The system call an EventLoop waits with, chosen at construction.
+    enum class Backend {
+        Poll,  //!< [poll(2)](\ref man2::poll), with the set of fds rebuilt on every wait.
+        Epoll  //!< [epoll(7)](\ref man7::epoll), with each fd registered once and updated only when interest changes.
+    };
+
+    //! Returned by each call to EventLoop::wait_next_event.
+    enum class Result {
+        Success,  //!< At least one Rule was triggered.
+        Timeout,  //!< No rules were triggered before timeout.
+        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    };
+
   private:
     using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
     using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
@@ -30,6 +48,7 @@ class EventLoop {
         CallbackT callback;   //!< A callback that reads or writes fd.
         InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
         CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        bool polled = false;  //!< What Rule::interest returned when last asked (Backend::Epoll only)
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
@@ -38,14 +57,39 @@ class EventLoop {
 
     std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
 
-  public:
-    //! Returned by each call to EventLoop::wait_next_event.
-    enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
-        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    //! \brief The rules watching one fd, which share a single epoll registration (Backend::Epoll only)
+    struct EpollRegistration {
+        std::vector<std::list<Rule>::iterator> rules{};  //!< Rules on this fd, in the order they were added
+        uint32_t events = 0;                             //!< Events currently registered with the kernel
+        bool added = false;                              //!< Whether the fd is in the epoll instance
+        bool stale = false;                              //!< Whether the rules' interest must be asked again
     };
 
+    Backend _backend;                                     //!< The system call used to wait
+    std::optional<FileDescriptor> _epoll_fd{};            //!< The epoll instance (Backend::Epoll only)
+    std::map<int, EpollRegistration> _registrations{};  //!< Registrations by fd number (Backend::Epoll only)
+    std::vector<epoll_event> _epoll_events{};           //!< Storage for results of epoll_wait, reused across waits
+    std::vector<int> _stale{};                          //!< Fds whose registrations are stale (Backend::Epoll only)
+    size_t _added_count{0};                             //!< Registrations in the epoll instance (Backend::Epoll only)
+
+    //! EventLoop::wait_next_event for Backend::Poll
+    Result _wait_next_event_poll(const int timeout_ms);
+
+    //! EventLoop::wait_next_event for Backend::Epoll
+    Result _wait_next_event_epoll(const int timeout_ms);
+
+    //! Mark the registration for `fd_num` so that its rules are asked for their interest before the next wait
+    void _mark_stale(const int fd_num, EpollRegistration &registration);
+
+    //! Cancel finished rules on a stale registration, ask the others for their interest, and bring the
+    //! kernel's registration in line with it
+    //! \returns `false` if no rules were left, so that the registration should be erased
+    bool _refresh_registration(const int fd_num, EpollRegistration &registration);
+
+  public:
+    //! Construct an EventLoop that waits with the given backend.
+    explicit EventLoop(const Backend backend = Backend::Poll);
+
     //! Add a rule whose callback will be called when `fd` is ready in the specified Direction.
     void add_rule(const FileDescriptor &fd,
                   const Direction direction,
@@ -53,8 +97,20 @@ class EventLoop {
                   const InterestT &interest = [] { return true; },
                   const CallbackT &cancel = [] {});
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! Calls [poll(2)](\ref man2::poll) or [epoll_wait(2)](\ref man2::epoll_wait) and then executes callback
+    //! for each ready fd.
     Result wait_next_event(const int timeout_ms);
+
+    //! \brief Ask the rules on `fd` for their interest again before the next wait
+    //! \details Also needed after closing `fd`, so that its rules are canceled. Does nothing with Backend::Poll,
+    //! which asks every rule before every wait.
+    void notify(const FileDescriptor &fd);
+
+    //! Ask every rule for its interest again before the next wait (see EventLoop::notify)
+    void notify_all();
+
+    //! The backend chosen at construction.
+    Backend backend() const { return _backend; }
 };
 
 using Direction = EventLoop::Direction;
@@ -72,5 +128,16 @@ using Direction = EventLoop::Direction;
 //! A Rule installed using EventLoop::add_cancelable_rule will be polled and canceled under the
 //! same conditions, with the additional condition that if Rule::callback returns `true`, the
 //! Rule will be canceled.
+//!
+//! With Backend::Epoll, each fd is added to an [epoll(7)](\ref man7::epoll) instance once, however many
+//! rules watch it, and [epoll_ctl(2)](\ref man2::epoll_ctl) is called again only when the combined interest
+//! of those rules changes. The answer of Rule::interest is kept, and asked again only when the rule is
+//! added, after its fd was ready, or after the owner called EventLoop::notify (or EventLoop::notify_all)
+//! because something the answer depends on changed. A wait therefore costs time in proportion to the
+//! number of ready and notified fds rather than the number of rules. An owner that closes an fd must
+//! notify the loop too, so that the fd's rules are canceled. Otherwise cancellation and busy-wait
+//! detection behave as with Backend::Poll, except that an fd none of whose rules is interested leaves the
+//! epoll instance until one is again, so errors and hangups on it are not reported meanwhile. Regular
+//! files cannot be used with this backend (epoll rejects them).
 
 #endif  // SPONGE_LIBSPONGE_EVENTLOOP_HH
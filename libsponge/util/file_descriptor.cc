@@ -73,6 +73,43 @@ string FileDescriptor::read(const size_t limit) {
     return ret;
 }
 
+//! \param[in] iov is the storage to read into, which the caller has sized
+//! \param[in] iovcnt is the number of iovecs
+size_t FileDescriptor::read(const iovec *iov, const size_t iovcnt) {
+    size_t total_size = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        total_size += iov[i].iov_len;
+    }
+
+    const ssize_t bytes_read = SystemCall("readv", ::readv(fd_num(), iov, iovcnt));
+    if (total_size > 0 && bytes_read == 0) {
+        _internal_fd->_eof = true;
+    }
+    if (size_t(bytes_read) > total_size) {
+        throw runtime_error("readv() read more than requested");
+    }
+
+    register_read();
+
+    return bytes_read;
+}
+
+size_t FileDescriptor::write(const iovec *iov, const size_t iovcnt) {
+    const ssize_t bytes_written = SystemCall("writev", ::writev(fd_num(), iov, iovcnt));
+
+    size_t total_size = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        total_size += iov[i].iov_len;
+    }
+    if (size_t(bytes_written) != total_size) {
+        throw runtime_error("writev wrote only part of a datagram");
+    }
+
+    register_write();
+
+    return bytes_written;
+}
+
 size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     size_t total_bytes_written = 0;
 
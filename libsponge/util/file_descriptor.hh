@@ -61,6 +61,10 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read into `iovcnt` iovecs with a single [readv(2)](\ref man2::readv), filling them in order
+    //! \returns the number of bytes read
+    size_t read(const iovec *iov, const size_t iovcnt);
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
@@ -70,6 +74,10 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write `iovcnt` iovecs with a single [writev(2)](\ref man2::writev), without allocating
+    //! \note For datagram-oriented descriptors (e.g. TUN devices), where each write is one packet
+    size_t write(const iovec *iov, const size_t iovcnt);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
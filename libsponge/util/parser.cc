@@ -31,12 +31,7 @@ T NetParser::_parse_int() {
         return 0;
     }
 
-    T ret = 0;
-    for (size_t i = 0; i < len; i++) {
-        ret <<= 8;
-        ret += uint8_t(_buffer.at(i));
-    }
-
+    const T ret = NetSpan::load<T>(_buffer.str().data());
     _buffer.remove_prefix(len);
 
     return ret;
@@ -50,6 +45,19 @@ void NetParser::remove_prefix(const size_t n) {
     _buffer.remove_prefix(n);
 }
 
+//! \param[in] size is the length of the fixed part of a header
+NetSpan NetParser::span(const size_t size) {
+    _check_size(size);
+    if (error()) {
+        return {};
+    }
+
+    Buffer ret = _buffer;  // shares the storage, which removing the whole buffer below would otherwise release
+    ret.remove_suffix(ret.size() - size);
+    _buffer.remove_prefix(size);
+    return NetSpan{std::move(ret)};
+}
+
 template <typename T>
 void NetUnparser::_unparse_int(string &s, T val) {
     constexpr size_t len = sizeof(T);
@@ -59,6 +67,15 @@ void NetUnparser::_unparse_int(string &s, T val) {
     }
 }
 
+template <typename T>
+uint8_t *NetUnparser::_unparse_int(uint8_t *out, T val) {
+    constexpr size_t len = sizeof(T);
+    for (size_t i = 0; i < len; ++i) {
+        out[i] = (val >> ((len - i - 1) * 8)) & 0xff;
+    }
+    return out + len;
+}
+
 uint32_t NetParser::u32() { return _parse_int<uint32_t>(); }
 
 uint16_t NetParser::u16() { return _parse_int<uint16_t>(); }
@@ -70,3 +87,9 @@ void NetUnparser::u32(string &s, const uint32_t val) { return _unparse_int<uint3
 void NetUnparser::u16(string &s, const uint16_t val) { return _unparse_int<uint16_t>(s, val); }
 
 void NetUnparser::u8(string &s, const uint8_t val) { return _unparse_int<uint8_t>(s, val); }
+
+uint8_t *NetUnparser::u32(uint8_t *out, const uint32_t val) { return _unparse_int<uint32_t>(out, val); }
+
+uint8_t *NetUnparser::u16(uint8_t *out, const uint16_t val) { return _unparse_int<uint16_t>(out, val); }
+
+uint8_t *NetUnparser::u8(uint8_t *out, const uint8_t val) { return _unparse_int<uint8_t>(out, val); }
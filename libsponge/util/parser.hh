@@ -5,6 +5,8 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <endian.h>
 #include <string>
 #include <utility>
 
@@ -22,6 +24,50 @@ enum class ParseResult {
 //! Output a string representation of a ParseResult
 std::string as_string(const ParseResult r);
 
+//! \brief Bytes whose length has already been checked, read by offset
+//! \details For the fixed part of a header: NetParser::span() checks the length once, and then each field is
+//! a single unaligned big-endian load (a memcpy and a byte swap, which compile to one or two instructions),
+//! with no bounds check of its own. The span shares the parser's storage, so it stays valid after the
+//! parser has moved past it.
+class NetSpan {
+  private:
+    Buffer _buffer{};
+
+  public:
+    NetSpan() = default;
+
+    //! \param[in] buffer is the bytes to read
+    explicit NetSpan(Buffer buffer) : _buffer(std::move(buffer)) {}
+
+    //! The first byte
+    const char *data() const { return _buffer.str().data(); }
+
+    //! Number of bytes
+    size_t size() const { return _buffer.size(); }
+
+    //! \brief The integer in network byte order at `bytes`
+    //! \note Not bounds-checked: `sizeof(T)` bytes must be readable
+    template <typename T>
+    static T load(const char *bytes) {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        if constexpr (sizeof(T) == 4) {
+            return be32toh(value);
+        } else if constexpr (sizeof(T) == 2) {
+            return be16toh(value);
+        } else {
+            return value;
+        }
+    }
+
+    //! \name Fields at a byte offset, in network byte order (not bounds-checked)
+    //!@{
+    uint8_t u8(const size_t offset) const { return load<uint8_t>(data() + offset); }
+    uint16_t u16(const size_t offset) const { return load<uint16_t>(data() + offset); }
+    uint32_t u32(const size_t offset) const { return load<uint32_t>(data() + offset); }
+    //!@}
+};
+
 class NetParser {
   private:
     Buffer _buffer;
@@ -35,9 +81,9 @@ class NetParser {
     T _parse_int();
 
   public:
-    NetParser(Buffer buffer) : _buffer(buffer) {}
+    NetParser(Buffer buffer) : _buffer(std::move(buffer)) {}
 
-    Buffer buffer() const { return _buffer; }
+    const Buffer &buffer() const { return _buffer; }
 
     //! Get the current value stored in BaseParser::_error
     ParseResult get_error() const { return _error; }
@@ -60,6 +106,10 @@ class NetParser {
 
     //! Remove n bytes from the buffer
     void remove_prefix(const size_t n);
+
+    //! \brief Take the next `size` bytes, to read their fields through the NetSpan
+    //! \returns the span, or an empty one (with PacketTooShort set and nothing removed) if fewer bytes remain
+    NetSpan span(const size_t size);
 };
 
 struct NetUnparser {
@@ -74,6 +124,17 @@ struct NetUnparser {
 
     //! Write an 8-bit integer into the data stream in network byte order
     static void u8(std::string &s, const uint8_t val);
+
+    //! \name Write into caller-provided memory
+    //! Each writes the integer in network byte order at `out` and returns the position just past it.
+    //!@{
+    template <typename T>
+    static uint8_t *_unparse_int(uint8_t *out, T val);
+
+    static uint8_t *u32(uint8_t *out, const uint32_t val);
+    static uint8_t *u16(uint8_t *out, const uint16_t val);
+    static uint8_t *u8(uint8_t *out, const uint8_t val);
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_PARSER_HH
@@ -115,22 +115,33 @@ UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
 void sendmsg_helper(const int fd_num,
                     const sockaddr *destination_address,
                     const socklen_t destination_address_len,
-                    const BufferViewList &payload) {
-    auto iovecs = payload.as_iovecs();
-
+                    const iovec *iov,
+                    const size_t iovcnt) {
     msghdr message{};
     message.msg_name = const_cast<sockaddr *>(destination_address);
     message.msg_namelen = destination_address_len;
-    message.msg_iov = iovecs.data();
-    message.msg_iovlen = iovecs.size();
+    message.msg_iov = const_cast<iovec *>(iov);
+    message.msg_iovlen = iovcnt;
 
     const ssize_t bytes_sent = SystemCall("sendmsg", ::sendmsg(fd_num, &message, 0));
 
-    if (size_t(bytes_sent) != payload.size()) {
+    size_t payload_size = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        payload_size += iov[i].iov_len;
+    }
+    if (size_t(bytes_sent) != payload_size) {
         throw runtime_error("datagram payload too big for sendmsg()");
     }
 }
 
+void sendmsg_helper(const int fd_num,
+                    const sockaddr *destination_address,
+                    const socklen_t destination_address_len,
+                    const BufferViewList &payload) {
+    const auto iovecs = payload.as_iovecs();
+    sendmsg_helper(fd_num, destination_address, destination_address_len, iovecs.data(), iovecs.size());
+}
+
 void UDPSocket::sendto(const Address &destination, const BufferViewList &payload) {
     sendmsg_helper(fd_num(), destination, destination.size(), payload);
     register_write();
@@ -141,6 +152,109 @@ void UDPSocket::send(const BufferViewList &payload) {
     register_write();
 }
 
+void UDPSocket::sendto(const Address &destination, const iovec *iov, const size_t iovcnt) {
+    sendmsg_helper(fd_num(), destination, destination.size(), iov, iovcnt);
+    register_write();
+}
+
+void UDPSocket::send(const iovec *iov, const size_t iovcnt) {
+    sendmsg_helper(fd_num(), nullptr, 0, iov, iovcnt);
+    register_write();
+}
+
+//! \details The storage for all the payloads is one string of `capacity * mtu` bytes.
+UDPSocket::RecvBatch::RecvBatch(const size_t capacity, const size_t mtu)
+    : _mtu(mtu), _storage(capacity * mtu, 0), _addresses(capacity), _iovecs(capacity), _headers(capacity) {}
+
+string_view UDPSocket::RecvBatch::payload(const size_t i) const {
+    if (i >= _count) {
+        throw out_of_range("RecvBatch::payload");
+    }
+    return {_storage.data() + i * _mtu, _headers[i].msg_len};
+}
+
+Address UDPSocket::RecvBatch::source_address(const size_t i) const {
+    if (i >= _count) {
+        throw out_of_range("RecvBatch::source_address");
+    }
+    return {_addresses[i], _headers[i].msg_hdr.msg_namelen};
+}
+
+void UDPSocket::SendBatch::add(const Address &destination, const iovec *iov, const size_t iovcnt) {
+    _datagrams.push_back({&destination, {_iovecs.size(), iovcnt}});
+    _iovecs.insert(_iovecs.end(), iov, iov + iovcnt);
+}
+
+void UDPSocket::SendBatch::clear() {
+    _iovecs.clear();
+    _datagrams.clear();
+}
+
+//! \details Blocks until at least one datagram is available (`MSG_WAITFORONE`), then takes whatever else
+//! is already queued, up to the batch's capacity.
+//! \note If a datagram is larger than the batch's `mtu`, this method throws a std::runtime_error
+size_t UDPSocket::recv_many(RecvBatch &batch) {
+    // the headers point into the batch's own storage; they are set up on each call so a batch can be moved
+    for (size_t i = 0; i < batch.capacity(); i++) {
+        batch._iovecs[i] = {batch._storage.data() + i * batch._mtu, batch._mtu};
+        batch._headers[i] = {};
+        batch._headers[i].msg_hdr.msg_name = static_cast<sockaddr *>(batch._addresses[i]);
+        batch._headers[i].msg_hdr.msg_namelen = sizeof(batch._addresses[i].storage);
+        batch._headers[i].msg_hdr.msg_iov = &batch._iovecs[i];
+        batch._headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    batch._count = 0;
+    const int received = SystemCall(
+        "recvmmsg", ::recvmmsg(fd_num(), batch._headers.data(), batch.capacity(), MSG_WAITFORONE, nullptr));
+    register_read();
+
+    for (int i = 0; i < received; i++) {
+        if (batch._headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            throw runtime_error("recvmmsg (oversized datagram)");
+        }
+    }
+    batch._count = received;
+    return batch._count;
+}
+
+//! \details sendmmsg(2) may send fewer datagrams than it was given; the rest are sent by further calls.
+//! The batch is cleared even if sending fails, as its iovecs point into storage the caller will reuse.
+void UDPSocket::send_many(SendBatch &batch) {
+    batch._headers.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        const auto &[destination, iovecs] = batch._datagrams[i];
+        batch._headers[i] = {};
+        batch._headers[i].msg_hdr.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(*destination));
+        batch._headers[i].msg_hdr.msg_namelen = destination->size();
+        batch._headers[i].msg_hdr.msg_iov = &batch._iovecs[iovecs.first];
+        batch._headers[i].msg_hdr.msg_iovlen = iovecs.second;
+    }
+
+    try {
+        for (size_t sent = 0; sent < batch.size();) {
+            const int count =
+                SystemCall("sendmmsg", ::sendmmsg(fd_num(), &batch._headers[sent], batch.size() - sent, 0));
+            register_write();
+            for (int i = 0; i < count; i++) {
+                const auto &iovecs = batch._datagrams[sent + i].second;
+                size_t payload_size = 0;
+                for (size_t j = 0; j < iovecs.second; j++) {
+                    payload_size += batch._iovecs[iovecs.first + j].iov_len;
+                }
+                if (batch._headers[sent + i].msg_len != payload_size) {
+                    throw runtime_error("datagram payload too big for sendmmsg()");
+                }
+            }
+            sent += count;
+        }
+    } catch (...) {
+        batch.clear();
+        throw;
+    }
+    batch.clear();
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen(const int backlog) { SystemCall("listen", ::listen(fd_num(), backlog)); }
@@ -166,3 +280,11 @@ void Socket::setsockopt(const int level, const int option, const option_type &op
 // allow local address to be reused sooner, at the cost of some robustness
 //! \note Using `SO_REUSEADDR` may reduce the robustness of your application
 void Socket::set_reuseaddr() { setsockopt(SOL_SOCKET, SO_REUSEADDR, int(true)); }
+
+void Socket::set_reuseport() { setsockopt(SOL_SOCKET, SO_REUSEPORT, int(true)); }
+
+//! \param[in] program is a classic BPF program returning a socket index
+void Socket::attach_reuseport_cbpf(const vector<sock_filter> &program) {
+    const sock_fprog fprog{static_cast<unsigned short>(program.size()), const_cast<sock_filter *>(program.data())};
+    setsockopt(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, fprog);
+}
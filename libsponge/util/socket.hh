@@ -6,8 +6,12 @@
 
 #include <cstdint>
 #include <functional>
+#include <linux/filter.h>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
+#include <utility>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -45,6 +49,16 @@ class Socket : public FileDescriptor {
 
     //! Allow local address to be reused sooner via [SO_REUSEADDR](\ref man7::socket)
     void set_reuseaddr();
+
+    //! Let several sockets bind the same address via [SO_REUSEPORT](\ref man7::socket) (before bind())
+    void set_reuseport();
+
+    //! \brief Choose which socket of an SO_REUSEPORT group receives each packet
+    //! \details Attaches `program` with [SO_ATTACH_REUSEPORT_CBPF](\ref man7::socket). For each packet, the
+    //! classic BPF program returns the index of a socket in the group, in the order they were bound; an
+    //! index past the end falls back to the kernel's own hash. For UDP, the program's packet offsets start
+    //! at the UDP payload.
+    void attach_reuseport_cbpf(const std::vector<sock_filter> &program);
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
@@ -75,6 +89,77 @@ class UDPSocket : public Socket {
 
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
+
+    //! \name Send a datagram gathered from `iovcnt` iovecs, without allocating
+    //!@{
+    void sendto(const Address &destination, const iovec *iov, const size_t iovcnt);
+    void send(const iovec *iov, const size_t iovcnt);
+    //!@}
+
+    //! \brief Storage for recv_many(): a ring of `capacity` datagrams of up to `mtu` bytes each
+    //! \details Everything is allocated by the constructor and reused by every recv_many(); the payloads
+    //! and addresses of one batch stay valid until the next.
+    class RecvBatch {
+        friend class UDPSocket;
+
+        size_t _mtu;
+        std::string _storage;
+        std::vector<Address::Raw> _addresses;
+        std::vector<iovec> _iovecs;
+        std::vector<mmsghdr> _headers;
+        size_t _count{0};
+
+      public:
+        //! \param[in] capacity is the most datagrams one recv_many() receives
+        //! \param[in] mtu is the largest datagram accepted
+        explicit RecvBatch(const size_t capacity, const size_t mtu = 65536);
+
+        //! Number of datagrams received by the last recv_many()
+        size_t size() const { return _count; }
+
+        //! Most datagrams one recv_many() can receive
+        size_t capacity() const { return _headers.size(); }
+
+        //! Payload of the `i`th datagram of the batch
+        std::string_view payload(const size_t i) const;
+
+        //! Sender of the `i`th datagram of the batch
+        Address source_address(const size_t i) const;
+    };
+
+    //! \brief Datagrams for send_many(), each gathered from iovecs and sent to its own destination
+    //! \details The iovecs and destinations are referenced, not copied: what they point to must stay
+    //! valid until send_many(). clear() keeps the allocated capacity, so a batch that is reused stops
+    //! allocating once it has held its largest number of datagrams.
+    class SendBatch {
+        friend class UDPSocket;
+
+        std::vector<iovec> _iovecs{};
+        //! For each datagram: its destination, and its first iovec and iovec count in `_iovecs`
+        std::vector<std::pair<const Address *, std::pair<size_t, size_t>>> _datagrams{};
+        std::vector<mmsghdr> _headers{};
+
+      public:
+        //! Add a datagram to the batch
+        void add(const Address &destination, const iovec *iov, const size_t iovcnt);
+
+        //! Number of datagrams in the batch
+        size_t size() const { return _datagrams.size(); }
+
+        //! Is the batch empty?
+        bool empty() const { return _datagrams.empty(); }
+
+        //! Remove all the datagrams
+        void clear();
+    };
+
+    //! \brief Receive up to `batch.capacity()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg)
+    //! \returns the number received, which is also `batch.size()`
+    size_t recv_many(RecvBatch &batch);
+
+    //! \brief Send every datagram of the batch with [sendmmsg(2)](\ref man2::sendmmsg), then clear it
+    //! (also if an exception is thrown)
+    void send_many(SendBatch &batch);
 };
 
 //! \class UDPSocket
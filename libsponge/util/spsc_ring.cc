@@ -0,0 +1,125 @@
+#include "spsc_ring.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+static size_t round_up_to_power_of_two(const size_t size) {
+    size_t ret = 1;
+    while (ret < size) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+SPSCByteRing::SPSCByteRing(const size_t capacity)
+    : _capacity(round_up_to_power_of_two(capacity)), _storage(make_unique<char[]>(_capacity)) {
+    if (capacity == 0) {
+        throw runtime_error("SPSCByteRing: zero capacity");
+    }
+}
+
+//! \details The waiting flag and the positions are accessed with sequentially consistent operations: a
+//! side stores its flag and then loads the other's position, and the other stores its position and then
+//! loads the flag, so at least one of them sees the other's store, and a wake-up cannot be lost.
+void SPSCByteRing::_wake(atomic<bool> &waiting, EventFD &event) {
+    if (waiting.load() and waiting.exchange(false)) {
+        event.signal();
+    }
+}
+
+size_t SPSCByteRing::write(const string_view data) {
+    const uint64_t write_position = _write_position.load(memory_order_relaxed);
+    if (_capacity - (write_position - _cached_read_position) < data.size()) {
+        _cached_read_position = _read_position.load(memory_order_acquire);
+    }
+    const size_t size = min(data.size(), size_t(_capacity - (write_position - _cached_read_position)));
+    if (size == 0) {
+        return 0;
+    }
+
+    const size_t offset = write_position & (_capacity - 1);
+    const size_t first = min(size, _capacity - offset);
+    memcpy(&_storage[offset], data.data(), first);
+    memcpy(&_storage[0], data.data() + first, size - first);
+
+    _write_position.store(write_position + size);
+    _wake(_consumer_waiting, _readable);
+    return size;
+}
+
+size_t SPSCByteRing::remaining_capacity() const {
+    return _capacity - (_write_position.load(memory_order_relaxed) - _read_position.load(memory_order_acquire));
+}
+
+void SPSCByteRing::close() {
+    _closed.store(true);
+    _wake(_consumer_waiting, _readable);
+}
+
+bool SPSCByteRing::arm_writable_wakeup() {
+    _producer_waiting.store(true);
+    if (_write_position.load(memory_order_relaxed) - _read_position.load() < _capacity or _reader_closed.load()) {
+        _producer_waiting.store(false);
+        return false;
+    }
+    return true;
+}
+
+string_view SPSCByteRing::peek() {
+    const uint64_t read_position = _read_position.load(memory_order_relaxed);
+    if (_cached_write_position == read_position) {
+        _cached_write_position = _write_position.load(memory_order_acquire);
+    }
+    const size_t offset = read_position & (_capacity - 1);
+    return {&_storage[offset], min(size_t(_cached_write_position - read_position), _capacity - offset)};
+}
+
+void SPSCByteRing::pop(const size_t size) {
+    const uint64_t read_position = _read_position.load(memory_order_relaxed);
+    if (size > _cached_write_position - read_position) {
+        throw runtime_error("SPSCByteRing: pop() past what was peeked");
+    }
+    _read_position.store(read_position + size);
+    _wake(_producer_waiting, _writable);
+}
+
+string SPSCByteRing::read(const size_t limit) {
+    string ret;
+    while (ret.size() < limit) {
+        const string_view front = peek();
+        if (front.empty()) {
+            break;
+        }
+        const size_t size = min(front.size(), limit - ret.size());
+        ret.append(front.substr(0, size));
+        pop(size);
+    }
+    return ret;
+}
+
+size_t SPSCByteRing::buffer_size() const {
+    return _write_position.load(memory_order_acquire) - _read_position.load(memory_order_relaxed);
+}
+
+//! \details The close is stored after the last write, so once it is seen, the write position read
+//! afterwards is final.
+bool SPSCByteRing::eof() const {
+    return _closed.load(memory_order_acquire) and buffer_size() == 0;
+}
+
+void SPSCByteRing::close_reader() {
+    _reader_closed.store(true);
+    _wake(_producer_waiting, _writable);
+}
+
+bool SPSCByteRing::arm_readable_wakeup() {
+    _consumer_waiting.store(true);
+    if (_write_position.load() != _read_position.load(memory_order_relaxed) or _closed.load()) {
+        _consumer_waiting.store(false);
+        return false;
+    }
+    return true;
+}
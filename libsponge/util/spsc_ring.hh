@@ -0,0 +1,116 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_RING_HH
+#define SPONGE_LIBSPONGE_SPSC_RING_HH
+
+#include "eventfd.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+//! \brief A lock-free byte ring from one producer thread to one consumer thread
+//! \details The producer copies bytes in with write() and ends the stream with close(); the consumer
+//! takes them with peek() and pop() (or read()). Neither call makes a system call, except to wake the
+//! other side when it has said it is about to sleep: a consumer that finds the ring empty calls
+//! arm_readable_wakeup() and, if that returns true, waits for readable_event(); a producer that finds it
+//! full does the same with arm_writable_wakeup() and writable_event().
+//!
+//! The read and write positions are counts of bytes ever read and written, each on its own cache line
+//! and written by only one side. Each side also keeps a cached copy of the other's position, and reloads
+//! it only when the cached one says the ring is empty (or full), so the cache line moves between cores
+//! once per batch rather than once per call.
+class SPSCByteRing {
+  public:
+    //! Size of the cache lines that the producer's and consumer's state are kept apart on
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  private:
+    size_t _capacity;
+    std::unique_ptr<char[]> _storage;
+
+    EventFD _readable{};  //!< Signaled by the producer for a consumer that is waiting
+    EventFD _writable{};  //!< Signaled by the consumer for a producer that is waiting
+
+    //! \name Written by the producer
+    //!@{
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _write_position{0};
+    std::atomic<bool> _closed{false};
+    std::atomic<bool> _consumer_waiting{false};  //!< Set by the consumer; cleared by whichever side sees it
+    uint64_t _cached_read_position{0};           //!< The producer's last look at _read_position
+    //!@}
+
+    //! \name Written by the consumer
+    //!@{
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _read_position{0};
+    std::atomic<bool> _reader_closed{false};
+    std::atomic<bool> _producer_waiting{false};  //!< Set by the producer; cleared by whichever side sees it
+    uint64_t _cached_write_position{0};          //!< The consumer's last look at _write_position
+    //!@}
+
+    //! Signal `event` if the other side was waiting for it
+    static void _wake(std::atomic<bool> &waiting, EventFD &event);
+
+  public:
+    //! \param[in] capacity is the most bytes the ring holds (rounded up to a power of two)
+    explicit SPSCByteRing(const size_t capacity);
+
+    //! Most bytes the ring holds
+    size_t capacity() const { return _capacity; }
+
+    //! \name Producer
+    //!@{
+
+    //! Copy in as much of `data` as fits
+    //! \returns the number of bytes written
+    size_t write(const std::string_view data);
+
+    //! Room for more bytes
+    size_t remaining_capacity() const;
+
+    //! Has the consumer stopped taking bytes (so that there will never be more room)?
+    bool reader_closed() const { return _reader_closed.load(); }
+
+    //! End the stream; the consumer sees eof() once it has taken every byte
+    void close();
+
+    //! \brief Ask for writable_event() to be signaled once there is room
+    //! \returns false, without asking, if there is room already (or the consumer has stopped)
+    bool arm_writable_wakeup();
+
+    //! Signaled for a producer that armed it; to be cleared before the next arm_writable_wakeup()
+    EventFD &writable_event() { return _writable; }
+    //!@}
+
+    //! \name Consumer
+    //!@{
+
+    //! The contiguous bytes at the front of the ring (possibly not all of them, where the ring wraps)
+    std::string_view peek();
+
+    //! Give `size` bytes from the front of the ring back to the producer
+    void pop(const size_t size);
+
+    //! Take up to `limit` bytes
+    std::string read(const size_t limit);
+
+    //! Bytes ready to be read
+    size_t buffer_size() const;
+
+    //! Has the producer closed the stream, and has every byte been taken?
+    bool eof() const;
+
+    //! Stop taking bytes; a waiting producer is woken, and sees reader_closed()
+    void close_reader();
+
+    //! \brief Ask for readable_event() to be signaled once there are bytes, or the stream is closed
+    //! \returns false, without asking, if there are bytes (or the stream is closed) already
+    bool arm_readable_wakeup();
+
+    //! Signaled for a consumer that armed it; to be cleared before the next arm_readable_wakeup()
+    EventFD &readable_event() { return _readable; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_SPSC_RING_HH
@@ -0,0 +1,152 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+using namespace std;
+
+static constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+
+//! Bits of a time below the slot index of `level`
+static constexpr unsigned int level_shift(const size_t level) {
+    return TimerWheel::SLOT_BITS * static_cast<unsigned int>(level);
+}
+
+TimerWheel::TimerWheel(const uint64_t now_ms) : _now(now_ms) {}
+
+//! \details Level `l` holds deadlines less than SLOTS^(l+1) ms away, in the slot given by bits
+//! [l * SLOT_BITS, (l + 1) * SLOT_BITS) of the deadline. That slot comes round (and is cascaded) when the
+//! time is the deadline with its lower bits cleared, which is always after _now and no later than the
+//! deadline. A deadline beyond the top level is filed as if it were as far out as the top level reaches.
+void TimerWheel::_file(const TimerId id, Timer &timer) {
+    const uint64_t delta = timer.deadline - _now;
+
+    size_t level = 0;
+    while (level < LEVELS - 1 and delta >> level_shift(level + 1) != 0) {
+        level++;
+    }
+    const uint64_t filed_at =
+        delta >> level_shift(LEVELS) == 0 ? timer.deadline : _now + (uint64_t{1} << level_shift(LEVELS)) - 1;
+
+    Slot &slot = _wheel[level][(filed_at >> level_shift(level)) & SLOT_MASK];
+    timer.slot = &slot;
+    timer.entry = slot.insert(slot.end(), id);
+}
+
+void TimerWheel::_cascade(const size_t level, const size_t slot) {
+    Slot &from = _wheel[level][slot];
+    while (not from.empty()) {
+        const TimerId id = from.front();
+        from.pop_front();
+        _file(id, _timers.at(id));
+    }
+}
+
+//! \details Each timer is removed before its callback runs, so a callback may safely cancel itself or
+//! schedule new timers (which land in other slots, or in `_due`, which is also fired this way).
+size_t TimerWheel::_fire(Slot &slot) {
+    size_t fired = 0;
+    while (not slot.empty()) {
+        const auto it = _timers.find(slot.front());
+        slot.pop_front();
+
+        const Callback callback = move(it->second.callback);
+        _timers.erase(it);
+        callback();
+        fired++;
+    }
+    return fired;
+}
+
+//! \details For level 0 this is the exact deadline of the earliest timer there; for higher levels it
+//! is when the earliest non-empty slot is cascaded.
+optional<uint64_t> TimerWheel::_next_slot_time() const {
+    optional<uint64_t> ret;
+    for (size_t level = 0; level < LEVELS; level++) {
+        const uint64_t base = _now >> level_shift(level);
+        for (uint64_t i = 1; i <= SLOTS; i++) {
+            const uint64_t when = (base + i) << level_shift(level);
+            if (ret.has_value() and when >= ret.value()) {
+                break;
+            }
+            if (not _wheel[level][(base + i) & SLOT_MASK].empty()) {
+                ret = when;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+//! \param[in] deadline_ms is when the timer expires
+//! \param[in] callback is run (once) by the advance() that reaches the deadline
+TimerWheel::TimerId TimerWheel::schedule(const uint64_t deadline_ms, Callback callback) {
+    const TimerId id = _next_id++;
+    Timer &timer = _timers.emplace(id, Timer{deadline_ms, move(callback), nullptr, {}}).first->second;
+
+    if (deadline_ms <= _now) {
+        timer.slot = &_due;
+        timer.entry = _due.insert(_due.end(), id);
+    } else {
+        _file(id, timer);
+    }
+    return id;
+}
+
+bool TimerWheel::cancel(const TimerId id) {
+    const auto it = _timers.find(id);
+    if (it == _timers.end()) {
+        return false;
+    }
+    it->second.slot->erase(it->second.entry);
+    _timers.erase(it);
+    return true;
+}
+
+//! \param[in] now_ms is the current time (if earlier than the wheel's time, only overdue timers run)
+//! \details The wheel jumps straight from one non-empty slot to the next, so a long sleep costs no more
+//! than the timers that expired during it. When the time reaches a multiple of a level's slot span, that
+//! level's slot is cascaded (highest level first, since its timers may land in the slot cascaded next)
+//! before level 0's timers for that millisecond are fired.
+size_t TimerWheel::advance(const uint64_t now_ms) {
+    size_t fired = _fire(_due);
+
+    while (true) {
+        const auto next = _next_slot_time();
+        if (not next.has_value() or next.value() > now_ms) {
+            break;
+        }
+
+        _now = next.value();
+        for (size_t level = LEVELS - 1; level > 0; level--) {
+            if ((_now & ((uint64_t{1} << level_shift(level)) - 1)) == 0) {
+                _cascade(level, (_now >> level_shift(level)) & SLOT_MASK);
+            }
+        }
+        fired += _fire(_wheel[0][_now & SLOT_MASK]);
+        fired += _fire(_due);
+    }
+
+    _now = max(_now, now_ms);
+    return fired;
+}
+
+optional<uint64_t> TimerWheel::next_deadline() const {
+    if (not _due.empty()) {
+        return _now;
+    }
+    return _next_slot_time();
+}
+
+//! \param[in] now_ms is the current time
+int TimerWheel::timeout_ms(const uint64_t now_ms) const {
+    const auto next = next_deadline();
+    if (not next.has_value()) {
+        return -1;
+    }
+    if (next.value() <= now_ms) {
+        return 0;
+    }
+    return static_cast<int>(min(next.value() - now_ms, uint64_t{INT_MAX}));
+}
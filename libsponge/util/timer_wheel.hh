@@ -0,0 +1,90 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+//! \brief A hierarchical timing wheel of one-shot millisecond timers
+//! \details Level 0 has one slot per millisecond for the next SLOTS ms; each higher level has one slot
+//! per SLOTS slots of the level below. A timer is filed in the lowest level that can hold its deadline
+//! and moves down ("cascades") as the wheel turns, so scheduling and cancelling are O(1) and advancing
+//! touches only slots that are due. Deadlines further out than the top level are re-filed each time the
+//! top level comes round. Not thread-safe.
+//!
+//! An event loop calls next_deadline() to find out how long it may sleep, then advance() with the
+//! current time to run the callbacks of every timer that has expired.
+class TimerWheel {
+  public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    static constexpr unsigned int SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;  //!< Slots per level
+    static constexpr size_t LEVELS = 4;                      //!< Levels (4 levels of 64 ms^n span ~4.6 hours)
+
+  private:
+    using Slot = std::list<TimerId>;
+
+    struct Timer {
+        uint64_t deadline;
+        Callback callback;
+        Slot *slot;            //!< The list this timer is filed in
+        Slot::iterator entry;  //!< Its position there
+    };
+
+    uint64_t _now;  //!< Every timer with a deadline up to and including _now has fired
+    TimerId _next_id{1};
+    std::unordered_map<TimerId, Timer> _timers{};
+    std::array<std::array<Slot, SLOTS>, LEVELS> _wheel{};
+    Slot _due{};  //!< Timers scheduled for _now or earlier, to fire on the next advance()
+
+    //! File a timer whose deadline is after _now (or equal to it, while cascading) in its wheel slot
+    void _file(const TimerId id, Timer &timer);
+
+    //! Move the timers of a level's slot down to the lower levels
+    void _cascade(const size_t level, const size_t slot);
+
+    //! Run, and forget, every timer in `slot`
+    size_t _fire(Slot &slot);
+
+    //! The first time after _now at which a non-empty slot of the wheel is reached
+    std::optional<uint64_t> _next_slot_time() const;
+
+  public:
+    //! \param[in] now_ms is the current time; timers are scheduled relative to the same clock
+    explicit TimerWheel(const uint64_t now_ms);
+
+    //! \brief Run `callback` from the first advance() to a time at or after `deadline_ms`
+    //! \returns an id for cancel()
+    TimerId schedule(const uint64_t deadline_ms, Callback callback);
+
+    //! \brief Forget a timer that has not fired yet
+    //! \returns true if the timer was pending
+    bool cancel(const TimerId id);
+
+    //! \brief Move the wheel to `now_ms`, running the callbacks of timers that expire on the way
+    //! \details Callbacks may schedule and cancel timers; ones scheduled at or before `now_ms` also run.
+    //! \returns the number of callbacks run
+    size_t advance(const uint64_t now_ms);
+
+    //! \brief When advance() next has work to do, or empty if no timer is pending
+    //! \note This can be earlier than any deadline, when far-off timers are due to move down a level.
+    std::optional<uint64_t> next_deadline() const;
+
+    //! \brief Milliseconds from `now_ms` until next_deadline(), suitable for a poll timeout
+    //! \returns -1 if no timer is pending, 0 if advance() has work to do now
+    int timeout_ms(const uint64_t now_ms) const;
+
+    //! \brief Number of pending timers
+    size_t size() const { return _timers.size(); }
+
+    //! \brief The time the wheel was last advanced to
+    uint64_t now() const { return _now; }
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH
@@ -1,19 +1,28 @@
 #include "tun.hh"
 
+#include "socket.hh"
 #include "util.hh"
 
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
+#include <linux/if_ether.h>
 #include <linux/if_tun.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 
 static constexpr const char *CLONEDEV = "/dev/net/tun";
 
+//! Size of `struct virtio_net_hdr` (linux/virtio_net.h, which is not valid C++)
+static constexpr size_t VNET_HDR_LENGTH = 10;
+
 using namespace std;
 
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects Ethernet frames)
+//! \param[in] vnet_hdr is `true` to prefix each packet with a virtio-net header (IFF_VNET_HDR) and turn on
+//! checksum and TCPv4 segmentation offload, so that packets may be TCP super-segments of up to 64 KB
 //!
 //! To create a TUN device, you should already have run
 //!
@@ -21,11 +30,14 @@ using namespace std;
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD(const string &devname, const bool is_tun)
-    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))) {
+TunTapFD::TunTapFD(const string &devname, const bool is_tun, const bool vnet_hdr)
+    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))), _vnet_hdr(vnet_hdr) {
     struct ifreq tun_req {};
 
     tun_req.ifr_flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI;  // tun device with no packetinfo
+    if (vnet_hdr) {
+        tun_req.ifr_flags |= IFF_VNET_HDR;
+    }
 
     // copy devname to ifr_name, making sure to null terminate
 
@@ -33,4 +45,46 @@ TunTapFD::TunTapFD(const string &devname, const bool is_tun)
     tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
     SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)));
+
+    // with a virtio-net header we can take (and send) TCPv4 super-segments whose checksums are still to be
+    // completed; without one, offloads are turned off, since they outlast the descriptor that set them
+    SystemCall("ioctl", ioctl(fd_num(), TUNSETOFFLOAD, vnet_hdr ? TUN_F_CSUM | TUN_F_TSO4 : 0));
+
+    // the MTU bounds what a read returns, so reads can go into storage of that size
+    UDPSocket sock;
+    SystemCall("ioctl", ioctl(sock.fd_num(), SIOCGIFMTU, static_cast<void *>(&tun_req)));
+    if (vnet_hdr) {
+        _max_packet_size = VNET_HDR_LENGTH + (is_tun ? 0 : ETH_HLEN) + 65535;
+    } else {
+        _max_packet_size = (is_tun ? 0 : ETH_HLEN) + tun_req.ifr_mtu;
+    }
+}
+
+//! \param[in] capacity is the most packets one read_many() reads
+//! \param[in] mtu is the largest packet accepted; a larger one would be cut short
+//! \details Packets are usually parsed and dropped before the next read_many(), but segments held
+//! out of order keep their slots, so the ring may grow to a few times the batch capacity.
+TunTapFD::RecvBatch::RecvBatch(const size_t capacity, const size_t mtu)
+    : _capacity(capacity), _mtu(mtu), _ring(mtu, 4 * capacity) {
+    _packets.reserve(capacity);
+}
+
+//! \details A read from a TUN or TAP device returns one packet, so a batch takes one read per packet
+//! plus the one that finds the queue empty; what it saves is the wakeups in between, and an
+//! allocation and a copy per packet.
+size_t TunTapFD::read_many(RecvBatch &batch) {
+    batch._packets.clear();
+    while (batch._packets.size() < batch._capacity) {
+        // the slot stays a full MTU long, so that reusing it costs nothing; the packet is a view of its start
+        auto slot = batch._ring.acquire_sized(batch._mtu);
+        const ssize_t bytes_read = ::read(fd_num(), slot->data(), slot->size());
+        register_read();
+        if (bytes_read < 0 and (errno == EAGAIN or errno == EWOULDBLOCK)) {
+            break;
+        }
+        SystemCall("read", bytes_read);
+        Buffer &packet = batch._packets.emplace_back(move(slot));
+        packet.remove_suffix(batch._mtu - bytes_read);
+    }
+    return batch._packets.size();
 }
@@ -1,22 +1,84 @@
 #ifndef SPONGE_LIBSPONGE_TUN_HH
 #define SPONGE_LIBSPONGE_TUN_HH
 
+#include "buffer.hh"
+#include "buffer_pool.hh"
 #include "file_descriptor.hh"
 
 #include <string>
+#include <utility>
+#include <vector>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor {
+  private:
+    bool _vnet_hdr;              //!< Opened with IFF_VNET_HDR?
+    size_t _max_packet_size{0};  //!< See max_packet_size()
+
   public:
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunTapFD(const std::string &devname, const bool is_tun);
+    explicit TunTapFD(const std::string &devname, const bool is_tun, const bool vnet_hdr = false);
+
+    //! \brief Use a descriptor that, like a TUN or TAP device, returns one packet per read (for tests, one end
+    //! of a SOCK_SEQPACKET socket pair)
+    //! \param[in] fd is the descriptor
+    //! \param[in] max_packet_size is the largest packet it returns
+    //! \param[in] vnet_hdr says whether its packets begin with a virtio-net header
+    TunTapFD(FileDescriptor &&fd, const size_t max_packet_size, const bool vnet_hdr = false)
+        : FileDescriptor(std::move(fd)), _vnet_hdr(vnet_hdr), _max_packet_size(max_packet_size) {}
+
+    //! \brief Packets read by read_many(), each into its own slot of a ring of MTU-sized storage
+    //! \details A packet is handed out as a Buffer that shares its slot, so it can be parsed in place (the
+    //! payload of a segment parsed from it still points into the slot). A slot is read into again once
+    //! every Buffer made from it is gone; once the ring has grown to the number of packets held at a
+    //! time, reading allocates nothing.
+    class RecvBatch {
+        friend class TunTapFD;
+
+        size_t _capacity;
+        size_t _mtu;
+        BufferPool _ring;
+        std::vector<Buffer> _packets{};
+
+      public:
+        //! \param[in] capacity is the most packets one read_many() reads
+        //! \param[in] mtu is the largest packet accepted (see TunTapFD::max_packet_size())
+        RecvBatch(const size_t capacity, const size_t mtu);
+
+        //! Number of packets read by the last read_many()
+        size_t size() const { return _packets.size(); }
+
+        //! Most packets one read_many() can read
+        size_t capacity() const { return _capacity; }
+
+        //! The `i`th packet of the batch
+        const Buffer &packet(const size_t i) const { return _packets.at(i); }
+
+        //! Allocation counters of the ring
+        const BufferPool::Stats &stats() const { return _ring.stats(); }
+    };
+
+    //! \brief Read the packets waiting on the device, up to the batch's capacity, replacing its contents
+    //! \pre The descriptor is non-blocking (FileDescriptor::set_blocking()), so that the read after the
+    //! last waiting packet returns at once
+    //! \returns the number of packets read, 0 if none was waiting
+    size_t read_many(RecvBatch &batch);
+
+    //! \brief Largest packet the device delivers: its MTU when it was opened (plus the Ethernet header on
+    //! a TAP device), or with a virtio-net header, that header and a 64 KB super-segment
+    size_t max_packet_size() const { return _max_packet_size; }
+
+    //! \brief Does every packet read or written begin with a `struct virtio_net_hdr`?
+    //! \details If so, the kernel accepts TCP super-segments to split (GSO) and may deliver coalesced
+    //! ones (GRO, or TSO from the host's own TCP), with the TCP checksum left for offload to complete.
+    bool vnet_hdr() const { return _vnet_hdr; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD {
   public:
     //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunFD(const std::string &devname) : TunTapFD(devname, true) {}
+    explicit TunFD(const std::string &devname, const bool vnet_hdr = false) : TunTapFD(devname, true, vnet_hdr) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
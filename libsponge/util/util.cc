@@ -1,13 +1,21 @@
 #include "util.hh"
 
 #include <array>
+#include <atomic>
 #include <cctype>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <sys/socket.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define SPONGE_CKSUM_X86 1
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 //! \returns the number of milliseconds since the program started
@@ -86,15 +94,185 @@ mt19937 get_random_generator() {
 //! on the Internet checksum, and consult the [IP](\ref rfc::rfc791) and [TCP](\ref rfc::rfc793) RFCs.
 InternetChecksum::InternetChecksum(const uint32_t initial_sum) : _sum(initial_sum) {}
 
-void InternetChecksum::add(std::string_view data) {
-    for (size_t i = 0; i < data.size(); i++) {
-        uint16_t val = uint8_t(data[i]);
-        if (not _parity) {
-            val <<= 8;
+// The kernels below add up `len` bytes (`len` even) as 32-bit words in the CPU's native byte order,
+// into a 64-bit accumulator. Because 2^16 = 1 (mod 2^16 - 1), the one's complement sum of 16-bit words
+// can be recovered by folding this accumulator, and summing in native order and byte-swapping the
+// folded result gives the same answer as summing big-endian words (RFC 1071, section 2(B)).
+namespace {
+
+using ChecksumKernelT = uint64_t (*)(const uint8_t *data, size_t len);
+
+uint64_t cksum_tail(const uint8_t *data, size_t len) {
+    uint64_t sum = 0;
+    for (; len >= 2; data += 2, len -= 2) {
+        uint16_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+uint64_t cksum_portable(const uint8_t *data, size_t len) {
+    uint64_t sum_a = 0, sum_b = 0;
+    for (; len >= 16; data += 16, len -= 16) {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, data, sizeof(word_a));
+        memcpy(&word_b, data + 8, sizeof(word_b));
+        sum_a += (word_a & 0xffff'ffff) + (word_a >> 32);
+        sum_b += (word_b & 0xffff'ffff) + (word_b >> 32);
+    }
+    return sum_a + sum_b + cksum_tail(data, len);
+}
+
+#ifdef SPONGE_CKSUM_X86
+__attribute__((target("sse2"))) uint64_t cksum_sse2(const uint8_t *data, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc_a = zero, acc_b = zero;
+    for (; len >= 32; data += 32, len -= 32) {
+        const __m128i v_a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i v_b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+        acc_a = _mm_add_epi64(acc_a, _mm_unpacklo_epi32(v_a, zero));
+        acc_a = _mm_add_epi64(acc_a, _mm_unpackhi_epi32(v_a, zero));
+        acc_b = _mm_add_epi64(acc_b, _mm_unpacklo_epi32(v_b, zero));
+        acc_b = _mm_add_epi64(acc_b, _mm_unpackhi_epi32(v_b, zero));
+    }
+    std::array<uint64_t, 2> lanes{};
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data()), _mm_add_epi64(acc_a, acc_b));
+    return lanes[0] + lanes[1] + cksum_portable(data, len);
+}
+
+__attribute__((target("avx2"))) uint64_t cksum_avx2(const uint8_t *data, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc_a = zero, acc_b = zero;
+    for (; len >= 64; data += 64, len -= 64) {
+        const __m256i v_a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        const __m256i v_b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32));
+        acc_a = _mm256_add_epi64(acc_a, _mm256_unpacklo_epi32(v_a, zero));
+        acc_a = _mm256_add_epi64(acc_a, _mm256_unpackhi_epi32(v_a, zero));
+        acc_b = _mm256_add_epi64(acc_b, _mm256_unpacklo_epi32(v_b, zero));
+        acc_b = _mm256_add_epi64(acc_b, _mm256_unpackhi_epi32(v_b, zero));
+    }
+    std::array<uint64_t, 4> lanes{};
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.data()), _mm256_add_epi64(acc_a, acc_b));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + cksum_portable(data, len);
+}
+#endif
+
+ChecksumKernelT kernel_function(const InternetChecksum::Kernel k) {
+    switch (k) {
+        case InternetChecksum::Kernel::Portable:
+            return cksum_portable;
+#ifdef SPONGE_CKSUM_X86
+        case InternetChecksum::Kernel::SSE2:
+            return cksum_sse2;
+        case InternetChecksum::Kernel::AVX2:
+            return cksum_avx2;
+#endif
+        default:
+            throw runtime_error("InternetChecksum: kernel not supported on this platform");
+    }
+}
+
+InternetChecksum::Kernel best_kernel() {
+    for (const auto k : {InternetChecksum::Kernel::AVX2, InternetChecksum::Kernel::SSE2}) {
+        if (InternetChecksum::kernel_supported(k)) {
+            return k;
         }
-        _sum += val;
-        _parity = !_parity;
     }
+    return InternetChecksum::Kernel::Portable;
+}
+
+//! The kernel used by add() and its function. Both are atomic because add() runs concurrently on
+//! ShardedTCPStack's workers while a test or benchmark may call set_kernel().
+struct ActiveKernel {
+    std::atomic<InternetChecksum::Kernel> kernel;
+    std::atomic<ChecksumKernelT> function;
+};
+
+//! The active kernel, resolved on first use (so also from other translation units' static initializers)
+ActiveKernel &active_kernel() {
+    static ActiveKernel active{best_kernel(), kernel_function(best_kernel())};
+    return active;
+}
+
+//! Fold a 64-bit sum to 16 bits with end-around carry, preserving its value mod 2^16 - 1 (and whether it is zero)
+uint16_t fold_to_16(uint64_t sum) {
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+
+}  // namespace
+
+bool InternetChecksum::kernel_supported(const Kernel k) {
+    switch (k) {
+        case Kernel::Portable:
+            return true;
+#ifdef SPONGE_CKSUM_X86
+        case Kernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+InternetChecksum::Kernel InternetChecksum::kernel() { return active_kernel().kernel; }
+
+void InternetChecksum::set_kernel(const Kernel k) {
+    if (not kernel_supported(k)) {
+        throw runtime_error("InternetChecksum: kernel " + kernel_name(k) + " not supported by this CPU");
+    }
+    active_kernel().function = kernel_function(k);
+    active_kernel().kernel = k;
+}
+
+string InternetChecksum::kernel_name(const Kernel k) {
+    switch (k) {
+        case Kernel::Portable:
+            return "portable";
+        case Kernel::SSE2:
+            return "sse2";
+        case Kernel::AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+void InternetChecksum::add(std::string_view data) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.data());
+    size_t len = data.size();
+    if (len == 0) {
+        return;
+    }
+
+    // an odd number of bytes came before: the first byte is the low half of a word
+    if (_parity) {
+        _sum += bytes[0];
+        _parity = false;
+        ++bytes;
+        --len;
+    }
+
+    const uint16_t native_sum = fold_to_16(active_kernel().function.load()(bytes, len & ~size_t(1)));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    _sum += static_cast<uint16_t>((native_sum >> 8) | (native_sum << 8));
+#else
+    _sum += native_sum;
+#endif
+
+    // odd length: the last byte is the high half of a word
+    if (len & 1) {
+        _sum += uint16_t(bytes[len - 1]) << 8;
+        _parity = true;
+    }
+
+    // keep the running sum well away from overflow
+    _sum = (_sum >> 16) + (_sum & 0xffff);
 }
 
 uint16_t InternetChecksum::value() const {
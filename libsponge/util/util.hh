@@ -53,6 +53,14 @@ uint64_t timestamp_ms();
 
 //! The internet checksum algorithm
 class InternetChecksum {
+  public:
+    //! Implementations of the inner summing loop; the fastest one the CPU supports is chosen at startup
+    enum class Kernel {
+        Portable,  //!< 64-bit words, any CPU
+        SSE2,      //!< 128-bit vectors (x86)
+        AVX2       //!< 256-bit vectors (x86)
+    };
+
   private:
     uint32_t _sum;
     bool _parity{};
@@ -61,6 +69,18 @@ class InternetChecksum {
     InternetChecksum(const uint32_t initial_sum = 0);
     void add(std::string_view data);
     uint16_t value() const;
+
+    //! The kernel currently used by add()
+    static Kernel kernel();
+
+    //! Can `k` run on this CPU?
+    static bool kernel_supported(const Kernel k);
+
+    //! Replace the kernel chosen at startup (used by tests and benchmarks); other threads may be checksumming
+    static void set_kernel(const Kernel k);
+
+    //! Name of a kernel, for reporting
+    static std::string kernel_name(const Kernel k);
 };
 
 //! Hexdump the contents of a packet (or any other sequence of bytes)
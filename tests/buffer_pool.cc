@@ -0,0 +1,135 @@
+#include "buffer_pool.hh"
+#include "connection_pair_harness.hh"
+#include "tcp_connection.hh"
+#include "test_err_if.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        // slots are recycled once every Buffer referring to them is gone
+        {
+            BufferPool pool{16, 2};
+
+            auto first = pool.acquire(10);
+            first->append("0123456789");
+            Buffer a{move(first)};
+            Buffer a_copy = a;
+            test_err_if(not(pool.slots() == 1 and pool.stats().allocated == 1), "first acquire should allocate a slot");
+
+            auto second = pool.acquire(16);
+            test_err_if(second->capacity() < 16, "slots should be reserved up front");
+            Buffer b{move(second)};
+            test_err_if(not(pool.slots() == 2 and pool.stats().allocated == 2),
+                        "second acquire should allocate a slot");
+
+            // pool is full and both slots are in use
+            Buffer c{pool.acquire(4)};
+            test_err_if(not(pool.stats().unpooled == 1 and pool.slots() == 2), "full pool should fall back to malloc");
+
+            // oversize requests never use a slot
+            Buffer d{pool.acquire(17)};
+            test_err_if(pool.stats().unpooled != 2, "oversize request should fall back to malloc");
+
+            // the first slot is still shared by a copy
+            a = Buffer{};
+            Buffer e{pool.acquire(1)};
+            test_err_if(not(pool.stats().reused == 0 and pool.stats().unpooled == 3), "slot still in use was recycled");
+            a_copy = Buffer{};
+
+            auto recycled = pool.acquire(8);
+            test_err_if(not(pool.stats().reused == 1 and pool.stats().allocated == 2), "freed slot should be reused");
+            test_err_if(not(recycled->empty() and recycled->capacity() >= 16),
+                        "recycled slot should be empty but keep capacity");
+            test_err_if(pool.stats().acquired != 6, "every acquire should be counted");
+        }
+
+        // acquire_sized hands a recycled slot back at full size, without clearing it
+        {
+            BufferPool pool{16, 1};
+
+            auto slot = pool.acquire_sized(16);
+            test_err_if(slot->size() != 16, "sized slot has the wrong size");
+            slot->replace(0, 5, "hello");
+            Buffer packet{move(slot)};
+            packet.remove_suffix(11);
+            test_err_if(packet.str() != "hello", "view of the start of a slot");
+            packet = Buffer{};
+
+            auto recycled = pool.acquire_sized(16);
+            test_err_if(pool.stats().reused != 1, "freed slot should be reused");
+            test_err_if(not(recycled->size() == 16 and recycled->substr(0, 5) == "hello"), "recycled slot was cleared");
+            const auto unpooled = pool.acquire_sized(8);
+            test_err_if(not(unpooled->size() == 8 and pool.stats().unpooled == 1),
+                        "unpooled storage has the wrong size");
+        }
+
+        // a connection in steady state allocates no new payload storage
+        {
+            TCPConfig cfg;
+            TCPConnection x{cfg}, y{cfg};
+
+            x.connect();
+            move_segments(x, y);
+            move_segments(y, x);
+
+            const string chunk(TCPConfig::MAX_PAYLOAD_SIZE * 7 + 123, 'x');
+            size_t bytes_received = 0;
+            uint64_t allocated_after_warmup = 0;
+
+            for (unsigned int round = 0; round < 2000; round++) {
+                x.write(chunk);
+                move_segments(x, y);
+                move_segments(y, x);
+                bytes_received += y.inbound_stream().read(y.inbound_stream().buffer_size()).size();
+                x.tick(1);
+                y.tick(1);
+
+                if (round == 100) {
+                    allocated_after_warmup = x.buffer_pool_stats().allocated;
+                }
+            }
+
+            // close cleanly
+            x.end_input_stream();
+            y.end_input_stream();
+            for (unsigned int i = 0; i < 100 and (x.active() or y.active()); i++) {
+                move_segments(x, y);
+                move_segments(y, x);
+                x.tick(cfg.rt_timeout);
+                y.tick(cfg.rt_timeout);
+            }
+
+            const auto &stats = x.buffer_pool_stats();
+            test_err_if(bytes_received != 2000 * chunk.size(), "not all data arrived");
+            test_err_if(stats.allocated != allocated_after_warmup, "pool kept allocating after warmup");
+            test_err_if(stats.unpooled != 0, "payloads were allocated outside the pool");
+            test_err_if(not(stats.reused > 0 and stats.acquired == stats.reused + stats.allocated),
+                        "every payload should come from the pool");
+        }
+
+        // the pool is cut into MSS-sized slots, so a connection refuses an MSS of 0 (or one no SYN can carry)
+        for (const size_t mss : {size_t{0}, size_t{65536}}) {
+            TCPConfig cfg;
+            cfg.mss = mss;
+            bool threw = false;
+            try {
+                TCPConnection connection{cfg};
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "connection accepted an MSS of " + to_string(mss));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main() {
+    try {
+        {
+            ByteStreamTestHarness test{"write-buffer-peek-views", 15};
+
+            test.execute(WriteBuffer{"cat"}.with_bytes_written(3));
+            test.execute(Write{"dog"}.with_bytes_written(3));
+            test.execute(WriteBuffer{"bird"}.with_bytes_written(4));
+
+            test.execute(BufferSize{10});
+            test.execute(BytesWritten{10});
+            test.execute(Peek{"catdogbird"});
+            test.execute(PeekViews{"catdogbird"}.with_num_views(3));
+            test.execute(PeekViews{"catd"}.with_num_views(2));
+            test.execute(PeekViews{"ca"}.with_num_views(1));
+        }
+
+        {
+            ByteStreamTestHarness test{"write-buffer-truncated", 5};
+
+            test.execute(WriteBuffer{"cat"}.with_bytes_written(3));
+            test.execute(WriteBuffer{"elephant"}.with_bytes_written(2));
+            test.execute(WriteBuffer{"fish"}.with_bytes_written(0));
+
+            test.execute(RemainingCapacity{0});
+            test.execute(BufferSize{5});
+            test.execute(PeekViews{"catel"}.with_num_views(2));
+
+            test.execute(Pop{4});
+            test.execute(BytesRead{4});
+            test.execute(RemainingCapacity{4});
+            test.execute(PeekViews{"l"}.with_num_views(1));
+
+            test.execute(WriteBuffer{"fish"}.with_bytes_written(4));
+            test.execute(Peek{"lfish"});
+        }
+
+        {
+            ByteStreamTestHarness test{"pop-across-buffers", 20};
+
+            test.execute(WriteBuffer{"abc"});
+            test.execute(WriteBuffer{"defg"});
+            test.execute(Write{"hij"});
+
+            test.execute(Pop{2});
+            test.execute(PeekViews{"cdefghij"}.with_num_views(3));
+            test.execute(Pop{5});
+            test.execute(BytesRead{7});
+            test.execute(PeekViews{"hij"}.with_num_views(1));
+            test.execute(Pop{3});
+
+            test.execute(BufferEmpty{true});
+            test.execute(PeekViews{""}.with_num_views(0));
+            test.execute(EndInput{});
+            test.execute(Eof{true});
+        }
+
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "byte_stream.hh"
+#include "file_descriptor.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+pair<FileDescriptor, FileDescriptor> make_pipe() {
+    int fds[2];
+    SystemCall("pipe2", ::pipe2(fds, O_CLOEXEC));
+    return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+string random_string(const size_t size) {
+    auto rd = get_random_generator();
+    string ret(size, 0);
+    for (auto &ch : ret) {
+        ch = static_cast<char>(rd());
+    }
+    return ret;
+}
+
+int main() {
+    try {
+        // read_from: one readv fills whole chunks, which become the stream's storage as they are
+        {
+            auto [rd, wr] = make_pipe();
+            ByteStream stream{1 << 20};
+            const string data = random_string(50000);
+            wr.write(data);
+
+            test_err_if(stream.read_from(rd) != data.size(), "read_from did not read everything available");
+            test_err_if(rd.read_count() != 1, "read_from took more than one read");
+            test_err_if(not(stream.buffer_size() == data.size() and stream.bytes_written() == data.size()),
+                        "accounting");
+            test_err_if(stream.peek_views(data.size()).views().size() != 4, "not read into 16 KiB chunks");
+            test_err_if(stream.peek_output(data.size()) != data, "contents");
+        }
+
+        // read_from: reads no more than the remaining capacity, or the limit
+        {
+            auto [rd, wr] = make_pipe();
+            ByteStream stream{1000};
+            const string data = random_string(5000);
+            wr.write(data);
+
+            test_err_if(stream.read_from(rd, 300) != 300, "limit not respected");
+            test_err_if(stream.read_from(rd) != 700, "capacity not respected");
+            test_err_if(not(stream.remaining_capacity() == 0 and stream.read_from(rd) == 0), "read past the capacity");
+            test_err_if(stream.read(1000) != data.substr(0, 1000), "contents up to the capacity");
+            test_err_if(stream.read_from(rd) != 1000, "read after making room");
+            test_err_if(stream.read(1000) != data.substr(1000, 1000), "contents after making room");
+
+            wr.close();
+            string rest;
+            while (stream.read_from(rd) > 0) {
+                rest += stream.read(1000);
+            }
+            test_err_if(not(rd.eof() and rest == data.substr(2000)), "rest of the contents, up to EOF");
+        }
+
+        // write_to: the stream's chunks go out with one writev; only what was written is popped
+        {
+            auto [rd, wr] = make_pipe();
+            ByteStream stream{1 << 20};
+            const string first = random_string(1000);
+            const string second = random_string(2000);
+            stream.write(first);
+            stream.write(Buffer{string(second)});
+
+            test_err_if(stream.write_to(wr, 2500) != 2500, "write_to did not write up to the limit");
+            test_err_if(wr.write_count() != 1, "write_to took more than one write");
+            test_err_if(not(stream.bytes_read() == 2500 and stream.buffer_size() == 500), "not popped");
+            test_err_if(not(stream.write_to(wr) == 500 and stream.buffer_empty()), "rest not written");
+            test_err_if(rd.read(3000) != first + second, "contents");
+
+            // a non-blocking descriptor takes only part; the rest stays in the stream
+            wr.set_blocking(false);
+            const string big = random_string(1 << 20);
+            stream.write(big);
+            const size_t written = stream.write_to(wr);
+            test_err_if(not(written > 0 and written < big.size()), "expected a partial write into a full pipe");
+            test_err_if(stream.buffer_size() != big.size() - written, "partial write popped too much");
+            test_err_if(stream.peek_output(10) != big.substr(written, 10), "partial write popped the wrong bytes");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -97,6 +97,20 @@ void Write::execute(ByteStream &bs) const {
     }
 }
 
+// WriteBuffer
+WriteBuffer::WriteBuffer(const std::string &data) : _data(data) {}
+WriteBuffer &WriteBuffer::with_bytes_written(const size_t bytes_written) {
+    _bytes_written = bytes_written;
+    return *this;
+}
+std::string WriteBuffer::description() const { return "write Buffer \"" + _data + "\" to the stream"; }
+void WriteBuffer::execute(ByteStream &bs) const {
+    auto bytes_written = bs.write(Buffer{std::string(_data)});
+    if (_bytes_written and bytes_written != _bytes_written.value()) {
+        throw ByteStreamExpectationViolation::property("bytes_written", _bytes_written.value(), bytes_written);
+    }
+}
+
 // Pop
 Pop::Pop(const size_t len) : _len(len) {}
 std::string Pop::description() const { return "pop " + to_string(_len); }
@@ -182,3 +196,25 @@ void Peek::execute(ByteStream &bs) const {
                                              output + "\"");
     }
 }
+
+// PeekViews
+PeekViews::PeekViews(const std::string &output) : _output(output) {}
+PeekViews &PeekViews::with_num_views(const size_t num_views) {
+    _num_views = num_views;
+    return *this;
+}
+std::string PeekViews::description() const { return "\"" + _output + "\" viewed at the front of the stream"; }
+void PeekViews::execute(ByteStream &bs) const {
+    const auto views = bs.peek_views(_output.size());
+    std::string output;
+    for (const auto &view : views.views()) {
+        output.append(view);
+    }
+    if (output != _output) {
+        throw ByteStreamExpectationViolation("Expected \"" + _output +
+                                             "\" viewed at the front of the stream, but found \"" + output + "\"");
+    }
+    if (_num_views and views.views().size() != _num_views.value()) {
+        throw ByteStreamExpectationViolation::property("number of views", _num_views.value(), views.views().size());
+    }
+}
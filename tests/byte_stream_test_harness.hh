@@ -56,6 +56,16 @@ struct Write : public ByteStreamAction {
     void execute(ByteStream &) const override;
 };
 
+struct WriteBuffer : public ByteStreamAction {
+    std::string _data;
+    std::optional<size_t> _bytes_written{};
+
+    WriteBuffer(const std::string &data);
+    WriteBuffer &with_bytes_written(const size_t bytes_written);
+    std::string description() const override;
+    void execute(ByteStream &) const override;
+};
+
 struct Pop : public ByteStreamAction {
     size_t _len;
 
@@ -128,6 +138,16 @@ struct Peek : public ByteStreamExpectation {
     void execute(ByteStream &) const override;
 };
 
+struct PeekViews : public ByteStreamExpectation {
+    std::string _output;
+    std::optional<size_t> _num_views{};
+
+    PeekViews(const std::string &output);
+    PeekViews &with_num_views(const size_t num_views);
+    std::string description() const override;
+    void execute(ByteStream &) const override;
+};
+
 class ByteStreamTestHarness {
     std::string _test_name;
     ByteStream _byte_stream;
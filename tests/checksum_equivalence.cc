@@ -0,0 +1,133 @@
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! The byte-at-a-time algorithm that InternetChecksum::add used before it had kernels
+class ReferenceChecksum {
+  private:
+    uint32_t _sum;
+    bool _parity{};
+
+  public:
+    ReferenceChecksum(const uint32_t initial_sum = 0) : _sum(initial_sum) {}
+
+    void add(string_view data) {
+        for (size_t i = 0; i < data.size(); i++) {
+            uint16_t val = uint8_t(data[i]);
+            if (not _parity) {
+                val <<= 8;
+            }
+            _sum += val;
+            _parity = !_parity;
+        }
+    }
+
+    uint16_t value() const {
+        uint32_t ret = _sum;
+        while (ret > 0xffff) {
+            ret = (ret >> 16) + (ret & 0xffff);
+        }
+        return ~ret;
+    }
+};
+
+void check(const string &what, const InternetChecksum::Kernel k, const uint16_t expected, const uint16_t actual) {
+    if (expected != actual) {
+        ostringstream ss;
+        ss << "Checksum mismatch with the " << InternetChecksum::kernel_name(k) << " kernel (" << what
+           << "): expected " << expected << ", got " << actual;
+        throw runtime_error(ss.str());
+    }
+}
+
+void check_range(const string &buf, const size_t offset, const size_t len, const uint32_t initial_sum) {
+    const string_view data{buf.data() + offset, len};
+
+    ReferenceChecksum ref{initial_sum};
+    ref.add(data);
+    const uint16_t expected = ref.value();
+
+    using Kernel = InternetChecksum::Kernel;
+    for (const auto k : {Kernel::Portable, Kernel::SSE2, Kernel::AVX2}) {
+        if (not InternetChecksum::kernel_supported(k)) {
+            continue;
+        }
+        InternetChecksum::set_kernel(k);
+        const string where = "offset " + to_string(offset) + ", length " + to_string(len);
+
+        InternetChecksum whole{initial_sum};
+        whole.add(data);
+        check(where, k, expected, whole.value());
+
+        // the same bytes split across several calls, at odd and even boundaries
+        for (const size_t split : {size_t{1}, size_t{3}, len / 2, len > 0 ? len - 1 : 0}) {
+            if (split > len) {
+                continue;
+            }
+            InternetChecksum parts{initial_sum};
+            parts.add(data.substr(0, split));
+            parts.add(data.substr(split));
+            check(where + ", split at " + to_string(split), k, expected, parts.value());
+        }
+
+        // one byte at a time exercises the parity path on every call
+        if (len <= 256) {
+            InternetChecksum bytewise{initial_sum};
+            for (size_t i = 0; i < len; i++) {
+                bytewise.add(data.substr(i, 1));
+            }
+            check(where + ", bytewise", k, expected, bytewise.value());
+        }
+    }
+}
+
+int main() {
+    try {
+        const auto original_kernel = InternetChecksum::kernel();
+        auto rd = get_random_generator();
+        uniform_int_distribution<unsigned int> byte_dist{0, 255};
+
+        constexpr size_t max_len = 65536;
+        constexpr size_t max_offset = 64;
+
+        string random_bytes(max_len + max_offset, 0);
+        for (auto &ch : random_bytes) {
+            ch = static_cast<char>(byte_dist(rd));
+        }
+        // all-ones words produce the most end-around carries
+        const string ones(max_len + max_offset, char(0xff));
+        const string zeros(max_len + max_offset, 0);
+
+        const vector<const string *> inputs{&random_bytes, &ones, &zeros};
+        for (const auto *buf : inputs) {
+            // every short length at every alignment within a cache line
+            for (size_t len = 0; len <= 300; len++) {
+                for (size_t offset = 0; offset < max_offset; offset++) {
+                    check_range(*buf, offset, len, 0);
+                }
+            }
+            // longer inputs, including the largest datagram
+            for (const size_t len : {511ul, 1000ul, 1460ul, 1500ul, 4095ul, 9000ul, 65535ul, 65536ul}) {
+                for (const size_t offset : {0ul, 1ul, 2ul, 7ul, 31ul}) {
+                    check_range(*buf, offset, len, 0);
+                    check_range(*buf, offset, len, 0x1234abcd);
+                }
+            }
+        }
+
+        InternetChecksum::set_kernel(original_kernel);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "congestion_controller.hh"
+#include "connection_pair_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = 1000;
+static constexpr uint32_t BIG_WINDOW = 1 << 20;
+
+//! A sender with a controller, past the handshake, with `bytes` written and the initial window sent
+TCPSender connected_sender(const TCPConfig::CongestionControl algorithm, const WrappingInt32 isn, const size_t bytes) {
+    TCPSender sender{1 << 20, 1000, isn};
+    sender.set_congestion_controller(make_congestion_controller(algorithm, MSS));
+    sender.set_max_payload_size(MSS);
+    sender.fill_window();
+    drain(sender, isn);
+    sender.ack_received(isn + 1, BIG_WINDOW);
+    sender.stream_in().write(string(bytes, 'x'));
+    sender.fill_window();
+    return sender;
+}
+
+int main() {
+    try {
+        const WrappingInt32 isn{12345};
+
+        // without a controller nothing changes: the whole window is sent and duplicate ACKs are ignored
+        {
+            TCPSender sender{1 << 20, 1000, isn};
+            sender.set_max_payload_size(MSS);
+            sender.fill_window();
+            drain(sender, isn);
+            sender.ack_received(isn + 1, 50 * MSS);
+            sender.stream_in().write(string(100 * MSS, 'x'));
+            sender.fill_window();
+            test_err_if(drain(sender, isn).size() != 50, "window-limited send");
+            for (int i = 0; i < 5; i++) {
+                sender.ack_received(isn + 1, 50 * MSS);
+            }
+            test_err_if(not drain(sender, isn).empty(), "duplicate ACKs retransmitted without a controller");
+        }
+
+        // slow start: the initial window, then each ACK frees what it acknowledged and grows the window by
+        // at most one segment
+        {
+            auto sender = connected_sender(TCPConfig::CongestionControl::Reno, isn, 100 * MSS);
+            test_err_if(drain(sender, isn).size() != CongestionController::INITIAL_WINDOW_SEGMENTS, "initial window");
+            test_err_if(sender.bytes_in_flight() != CongestionController::INITIAL_WINDOW_SEGMENTS * MSS, "in flight");
+
+            sender.ack_received(isn + 1 + 2 * MSS, BIG_WINDOW);
+            test_err_if(drain(sender, isn).size() != 3, "slow start send");
+            test_err_if(sender.congestion_controller()->window() != 11 * MSS, "slow start window");
+        }
+
+        // fast retransmit on the third duplicate ACK, NewReno partial ACK, then the end of recovery
+        {
+            auto sender = connected_sender(TCPConfig::CongestionControl::Reno, isn, 100 * MSS);
+            drain(sender, isn);
+            const uint64_t first = 1;
+
+            sender.ack_received(isn + 1, BIG_WINDOW);
+            sender.ack_received(isn + 1, BIG_WINDOW);
+            test_err_if(not drain(sender, isn).empty(), "retransmitted before the third duplicate ACK");
+            sender.ack_received(isn + 1, BIG_WINDOW, true);
+            test_err_if(not drain(sender, isn).empty(), "a segment carrying data counted as a duplicate ACK");
+            sender.ack_received(isn + 1, BIG_WINDOW);
+            const auto retransmitted = drain(sender, isn);
+            test_err_if(not(retransmitted.size() == 1 and retransmitted.front() == first), "fast retransmit");
+
+            const CongestionController &cc = *sender.congestion_controller();
+            test_err_if(cc.ssthresh() != 5 * MSS, "Reno halves the flight");
+            test_err_if(cc.window() != 8 * MSS, "window is ssthresh + 3 MSS");
+
+            // the duplicates for the seven other segments inflate the window until new data can go
+            for (int i = 0; i < 6; i++) {
+                sender.ack_received(isn + 1, BIG_WINDOW);
+            }
+            test_err_if(cc.window() != 14 * MSS, "window inflation");
+            test_err_if(drain(sender, isn).size() != 4, "new data sent during fast recovery");
+
+            // a partial ACK: the segment after the hole was lost too and goes at once, without a timeout
+            sender.ack_received(isn + 1 + 3 * MSS, BIG_WINDOW);
+            const auto partial = drain(sender, isn);
+            test_err_if(not(not partial.empty() and partial.front() == first + 3 * MSS), "partial ACK retransmission");
+
+            // everything outstanding at the loss is acknowledged: the window deflates to ssthresh
+            sender.ack_received(isn + 1 + 10 * MSS, BIG_WINDOW);
+            test_err_if(not(cc.window() == 5 * MSS and not cc.in_slow_start()), "recovery ends at ssthresh");
+        }
+
+        // a timeout collapses the window to one segment
+        {
+            auto sender = connected_sender(TCPConfig::CongestionControl::Reno, isn, 100 * MSS);
+            drain(sender, isn);
+            sender.tick(1000);
+            test_err_if(drain(sender, isn).size() != 1, "timeout retransmission");
+            test_err_if(sender.congestion_controller()->window() != MSS, "loss window");
+            test_err_if(sender.congestion_controller()->ssthresh() != 5 * MSS, "ssthresh after a timeout");
+
+            // partial ACKs after a timeout retransmit the next segment and grow the window in slow start
+            sender.ack_received(isn + 1 + MSS, BIG_WINDOW);
+            const auto next = drain(sender, isn);
+            test_err_if(not(next.size() == 1 and next.front() == 1 + MSS), "go-back after a timeout");
+            test_err_if(sender.congestion_controller()->window() != 2 * MSS, "slow start after a timeout");
+        }
+
+        // CUBIC: a smaller reduction, then concave growth back to the window where the loss happened
+        {
+            // a window of 1000 segments, large enough that the cubic curve rather than the Reno-friendly
+            // estimate sets the pace
+            CubicController cubic{MSS};
+            RenoController reno{MSS};
+            while (cubic.window() < 1000 * MSS) {
+                cubic.on_ack(MSS, 0);
+                reno.on_ack(MSS, 0);
+            }
+            cubic.on_fast_retransmit(cubic.window(), 0);
+            cubic.on_recovery_end();
+            reno.on_fast_retransmit(reno.window(), 0);
+            reno.on_recovery_end();
+            test_err_if(cubic.window() != 700 * MSS, "CUBIC reduces by beta = 0.7");
+            test_err_if(reno.window() != 500 * MSS, "Reno halves");
+
+            // one window of ACKs every 100 ms for 3 seconds
+            uint64_t now = 0;
+            size_t last = cubic.window();
+            size_t first_step = 0;
+            size_t last_step = 0;
+            for (int rtt = 0; rtt < 30; rtt++, now += 100) {
+                for (size_t acked = 0; acked < cubic.window(); acked += MSS) {
+                    cubic.on_ack(MSS, now);
+                }
+                for (size_t acked = 0; acked < reno.window(); acked += MSS) {
+                    reno.on_ack(MSS, now);
+                }
+                const size_t step = cubic.window() - last;
+                first_step = rtt == 5 ? step : first_step;
+                last_step = step;
+                last = cubic.window();
+            }
+            test_err_if(first_step <= last_step, "CUBIC grows fastest far from W_max");
+            test_err_if(cubic.window() < reno.window(), "CUBIC is at least as fast as Reno");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
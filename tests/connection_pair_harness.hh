@@ -0,0 +1,77 @@
+#ifndef SPONGE_CONNECTION_PAIR_HARNESS_HH
+#define SPONGE_CONNECTION_PAIR_HARNESS_HH
+
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \file
+//! Helpers for tests that drive two TCPConnections (or a lone TCPSender) by hand, handing segments from
+//! one to the other directly
+
+//! The segments `from` has queued, which are removed from its queue
+inline std::vector<TCPSegment> take(TCPConnection &from) {
+    std::vector<TCPSegment> segments;
+    while (not from.segments_out().empty()) {
+        segments.push_back(from.segments_out().front());
+        from.segments_out().pop();
+    }
+    return segments;
+}
+
+//! The segments `sender` has queued, which are removed from its queue
+inline std::vector<TCPSegment> take(TCPSender &sender) {
+    std::vector<TCPSegment> segments;
+    while (not sender.segments_out().empty()) {
+        segments.push_back(sender.segments_out().front());
+        sender.segments_out().pop();
+    }
+    return segments;
+}
+
+//! Absolute sequence numbers of the segments `sender` has queued, which are removed from its queue
+inline std::vector<uint64_t> drain(TCPSender &sender, const WrappingInt32 isn) {
+    std::vector<uint64_t> seqnos;
+    for (const auto &seg : take(sender)) {
+        seqnos.push_back(unwrap(seg.header().seqno, isn, sender.next_seqno_absolute()));
+    }
+    return seqnos;
+}
+
+//! Deliver `from`'s segments to `to`; returns how many there were
+inline size_t move_segments(TCPConnection &from, TCPConnection &to) {
+    const auto segments = take(from);
+    for (const auto &seg : segments) {
+        to.segment_received(seg);
+    }
+    return segments.size();
+}
+
+//! A client and server past the handshake
+inline void handshake(TCPConnection &client, TCPConnection &server) {
+    client.connect();
+    move_segments(client, server);
+    move_segments(server, client);
+    move_segments(client, server);
+}
+
+//! Close both connections, exchanging segments until neither is active
+inline void close(TCPConnection &client, TCPConnection &server) {
+    client.end_input_stream();
+    server.end_input_stream();
+    for (unsigned int round = 0; client.active() or server.active(); round++) {
+        test_err_if(round >= 100, "connections did not close");
+        move_segments(client, server);
+        move_segments(server, client);
+        client.tick(1000);
+        server.tick(1000);
+    }
+}
+
+#endif  // SPONGE_CONNECTION_PAIR_HARNESS_HH
@@ -0,0 +1,183 @@
+#include "address.hh"
+#include "fd_adapter.hh"
+#include "socket.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+using namespace std;
+
+//! A UDP socket bound to an ephemeral port on the loopback interface
+UDPSocket bound_socket() {
+    UDPSocket sock;
+    sock.bind(Address("127.0.0.1", 0));
+    return sock;
+}
+
+//! An iovec over a string
+iovec view(const string &str) { return {const_cast<char *>(str.data()), str.size()}; }
+
+int main() {
+    try {
+        // datagrams gathered from several iovecs go out in one call and arrive whole, in order
+        {
+            UDPSocket sender = bound_socket();
+            UDPSocket receiver = bound_socket();
+            const Address destination = receiver.local_address();
+
+            vector<string> payloads;
+            for (size_t i = 0; i < 10; i++) {
+                payloads.push_back(string(i * 100 + 1, char('a' + i)));
+            }
+            const string prefix = "hdr:";
+            UDPSocket::SendBatch batch;
+            for (const auto &payload : payloads) {
+                const array<iovec, 2> iov{{view(prefix), view(payload)}};
+                batch.add(destination, iov.data(), iov.size());
+            }
+            test_err_if(batch.size() != payloads.size(), "batch size");
+            sender.send_many(batch);
+            test_err_if(not batch.empty(), "batch not cleared after sending");
+
+            // a batch smaller than what is queued takes the rest on the next call
+            UDPSocket::RecvBatch received{4, 2048};
+            vector<string> arrived;
+            while (arrived.size() < payloads.size()) {
+                const size_t count = receiver.recv_many(received);
+                test_err_if(not(count >= 1 and count <= received.capacity()), "batch count");
+                for (size_t i = 0; i < count; i++) {
+                    test_err_if(received.source_address(i) != sender.local_address(), "source address");
+                    arrived.emplace_back(received.payload(i));
+                }
+            }
+            for (size_t i = 0; i < payloads.size(); i++) {
+                test_err_if(arrived[i] != prefix + payloads[i], "payload " + to_string(i));
+            }
+        }
+
+        // a datagram larger than the batch's MTU is an error, not a silent truncation
+        {
+            UDPSocket sender = bound_socket();
+            UDPSocket receiver = bound_socket();
+            const string big(200, 'x');
+            const iovec iov = view(big);
+            sender.sendto(receiver.local_address(), &iov, 1);
+            UDPSocket::RecvBatch received{2, 100};
+            bool threw = false;
+            try {
+                receiver.recv_many(received);
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "oversized datagram accepted");
+        }
+
+        // the adapter queues segments until flush() and reads a whole batch from one wakeup
+        {
+            UDPSocket client_sock = bound_socket();
+            UDPSocket server_sock = bound_socket();
+            const Address client_address = client_sock.local_address();
+            const Address server_address = server_sock.local_address();
+            TCPOverUDPSocketAdapter client{move(client_sock)};
+            TCPOverUDPSocketAdapter server{move(server_sock)};
+            client.config_mut().source = client_address;
+            client.config_mut().destination = server_address;
+            server.config_mut().source = server_address;
+            server.config_mut().destination = client_address;
+
+            for (size_t i = 0; i < 5; i++) {
+                TCPSegment seg;
+                seg.header().seqno = WrappingInt32(i);
+                seg.payload() = Buffer{string(i + 1, 'z')};
+                client.write(seg);
+            }
+            client.flush();
+
+            vector<TCPSegment> segments;
+            do {
+                const auto seg = server.read();
+                test_err_if(not seg.has_value(), "segment dropped");
+                segments.push_back(seg.value());
+            } while (segments.size() < 5);
+            test_err_if(server.pending() != 0, "datagrams left over");
+            for (size_t i = 0; i < segments.size(); i++) {
+                test_err_if(segments[i].header().seqno != WrappingInt32(i), "segment order");
+                test_err_if(segments[i].payload().str() != string(i + 1, 'z'), "segment payload");
+                test_err_if(segments[i].header().sport != client_address.port(), "source port");
+            }
+        }
+
+        // a batch that fails to send is dropped, not sent again (through dangling iovecs) with the next one
+        {
+            UDPSocket client_sock = bound_socket();
+            UDPSocket server_sock = bound_socket();
+            const Address server_address = server_sock.local_address();
+            TCPOverUDPSocketAdapter client{move(client_sock)};
+            TCPOverUDPSocketAdapter server{move(server_sock)};
+            client.config_mut().destination = server_address;
+            server.set_listening(true);
+
+            TCPSegment too_big;
+            too_big.payload() = Buffer{string(70000, 'b')};
+            client.write(too_big);
+            bool threw = false;
+            try {
+                client.flush();
+            } catch (const exception &) {
+                threw = true;
+            }
+            test_err_if(not threw, "a datagram larger than UDP allows was sent");
+
+            TCPSegment syn;
+            syn.header().syn = true;
+            syn.payload() = Buffer{string("after")};
+            client.write(syn);
+            client.flush();
+            const auto received = server.read();
+            test_err_if(not(received.has_value() and received->payload().str() == "after"),
+                        "segment after a failed send");
+            test_err_if(server.pending() != 0, "the failed datagram was sent after all");
+        }
+
+        // received segments are stored in slots that hold a full segment under the MSS given to set_mss()
+        {
+            UDPSocket client_sock = bound_socket();
+            UDPSocket server_sock = bound_socket();
+            const Address client_address = client_sock.local_address();
+            const Address server_address = server_sock.local_address();
+            TCPOverUDPSocketAdapter client{move(client_sock)};
+            TCPOverUDPSocketAdapter server{move(server_sock)};
+            client.config_mut().destination = server_address;
+            server.config_mut().destination = client_address;
+
+            constexpr size_t mss = 1400;
+            TCPSegment seg;
+            seg.payload() = Buffer{string(mss, 'm')};
+            client.write(seg);
+            client.flush();
+            test_err_if(not(server.read().has_value() and server.payload_pool_stats().unpooled == 1),
+                        "a segment larger than the default MSS fit in a slot");
+
+            server.set_mss(mss);
+            client.write(seg);
+            client.flush();
+            const auto received = server.read();
+            test_err_if(not(received.has_value() and received->payload().size() == mss), "full-sized segment dropped");
+            test_err_if(not(server.payload_pool_stats().unpooled == 0 and server.payload_pool_stats().allocated == 1),
+                        "full-sized segment did not fit in a slot after set_mss");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include "connection_pair_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+int main() {
+    try {
+        TCPConfig config;
+        config.delayed_ack = true;
+
+        // every second full segment is acknowledged; a single one only when the delay runs out
+        {
+            TCPConnection client{TCPConfig{}};
+            TCPConnection server{config};
+            client.connect();
+            move_segments(client, server);
+            test_err_if(move_segments(server, client) != 1, "SYN-ACK delayed");
+            move_segments(client, server);
+
+            client.write(string(4 * MSS, 'x'));
+            test_err_if(move_segments(client, server) != 4, "client did not send four segments");
+            test_err_if(move_segments(server, client) != 2, "not one ACK per two segments");
+
+            client.write(string(MSS, 'x'));
+            move_segments(client, server);
+            test_err_if(not server.segments_out().empty(), "a single segment acknowledged at once");
+            test_err_if(server.time_until_next_timer() != config.ack_delay, "delayed-ACK timer not reported");
+            server.tick(config.ack_delay - 1);
+            test_err_if(not server.segments_out().empty(), "ACK sent before the delay");
+            server.tick(1);
+            const auto ack = take(server);
+            test_err_if(not(ack.size() == 1 and ack.front().header().ack), "no ACK after the delay");
+            test_err_if(server.time_until_next_timer().has_value(), "delayed-ACK timer still running");
+            client.segment_received(ack.front());
+
+            close(client, server);
+        }
+
+        // out-of-order data and a FIN are acknowledged at once, as is the segment that fills the gap
+        {
+            TCPConnection client{TCPConfig{}};
+            TCPConnection server{config};
+            client.connect();
+            move_segments(client, server);
+            move_segments(server, client);
+            move_segments(client, server);
+
+            client.write(string(3 * MSS, 'x'));
+            const auto segments = take(client);
+            server.segment_received(segments.at(1));
+            test_err_if(take(server).size() != 1, "out-of-order segment not acknowledged at once");
+            server.segment_received(segments.at(0));
+            test_err_if(take(server).size() != 1, "segment filling the gap not acknowledged at once");
+            server.segment_received(segments.at(2));
+            test_err_if(not server.segments_out().empty(), "in-order segment acknowledged at once");
+
+            client.end_input_stream();
+            const auto fin = take(client);
+            test_err_if(not(fin.size() == 1 and fin.front().header().fin), "no FIN");
+            server.segment_received(fin.front());
+            test_err_if(take(server).size() != 1, "FIN not acknowledged at once");
+            move_segments(server, client);
+
+            close(client, server);
+        }
+
+        // a pending ACK rides on outgoing data instead of being sent alone
+        {
+            TCPConnection client{TCPConfig{}};
+            TCPConnection server{config};
+            client.connect();
+            move_segments(client, server);
+            move_segments(server, client);
+            move_segments(client, server);
+
+            client.write(string(MSS, 'x'));
+            move_segments(client, server);
+            test_err_if(not server.segments_out().empty(), "ACK not delayed");
+            server.write("reply");
+            const auto reply = take(server);
+            test_err_if(not(reply.size() == 1 and reply.front().payload().size() == 5 and reply.front().header().ack),
+                        "reply does not carry the ACK");
+            server.tick(config.ack_delay);
+            test_err_if(not server.segments_out().empty(), "ACK sent again after it rode on data");
+            client.segment_received(reply.front());
+
+            close(client, server);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+pair<FileDescriptor, FileDescriptor> make_pipe() {
+    int fds[2];
+    SystemCall("pipe2", ::pipe2(fds, O_CLOEXEC));
+    return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+pair<FileDescriptor, FileDescriptor> make_socketpair() {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+void test_backend(const EventLoop::Backend backend, const string &name) {
+    // readable fds trigger callbacks; idle ones time out; uninterested rules make the loop exit
+    {
+        EventLoop loop{backend};
+        auto [rd, wr] = make_pipe();
+        string received;
+        bool interested = true;
+        loop.add_rule(
+            rd, Direction::In, [&] { received += rd.read(); }, [&] { return interested; });
+
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipe should time out");
+        wr.write("hello");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": readable pipe should succeed");
+        test_err_if(received != "hello", name + ": callback should have read the data");
+
+        wr.write("ignored");
+        interested = false;
+        loop.notify(rd);
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Exit, name + ": no interest should exit");
+        interested = true;
+        loop.notify(rd);
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success,
+                    name + ": renewed interest should poll again");
+        test_err_if(received != "helloignored", name + ": data should wait until interest returns");
+    }
+
+    // EOF cancels an In rule
+    {
+        EventLoop loop{backend};
+        auto [a, b] = make_socketpair();
+        bool canceled = false;
+        loop.add_rule(
+            a, Direction::In, [&] { a.read(); }, [] { return true; }, [&] { canceled = true; });
+
+        b.close();
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": EOF should be readable");
+        test_err_if(not a.eof(), name + ": read should have seen EOF");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Exit, name + ": rule at EOF should be canceled");
+        test_err_if(not canceled, name + ": cancel callback should run");
+    }
+
+    // a hangup with nothing to read cancels an In rule without calling back
+    {
+        EventLoop loop{backend};
+        auto [rd, wr] = make_pipe();
+        bool called = false, canceled = false;
+        loop.add_rule(
+            rd,
+            Direction::In,
+            [&] {
+                rd.read();
+                called = true;
+            },
+            [] { return true; },
+            [&] { canceled = true; });
+
+        wr.close();
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": hangup should wake the loop");
+        test_err_if(not(canceled and not called), name + ": hangup should cancel the rule");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Exit, name + ": no rules should be left");
+    }
+
+    // a closed fd cancels its rule
+    {
+        EventLoop loop{backend};
+        auto [rd, wr] = make_pipe();
+        bool canceled = false;
+        loop.add_rule(
+            rd, Direction::In, [&] { rd.read(); }, [] { return true; }, [&] { canceled = true; });
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipe should time out");
+        rd.close();
+        loop.notify(rd);
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Exit, name + ": closed fd should be canceled");
+        test_err_if(not canceled, name + ": cancel callback should run for closed fd");
+    }
+
+    // with epoll, a hung-up fd that no rule is interested in does not wake the loop
+    if (backend == EventLoop::Backend::Epoll) {
+        EventLoop loop{backend};
+        auto [a, b] = make_socketpair();
+        auto [rd, wr] = make_pipe();
+        bool interested = true;
+        loop.add_rule(
+            a, Direction::In, [&] { a.read(); }, [&] { return interested; });
+        loop.add_rule(rd, Direction::In, [&] { rd.read(); });
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle fds should time out");
+        interested = false;
+        loop.notify(a);
+        b.close();
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout,
+                    name + ": uninterested hangup woke the loop");
+        interested = true;
+        loop.notify(a);
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": renewed interest should see EOF");
+        test_err_if(not a.eof(), name + ": read should have seen EOF");
+    }
+
+    // with epoll, interest is asked again only after the fd was ready or the owner notified the loop
+    if (backend == EventLoop::Backend::Epoll) {
+        EventLoop loop{backend};
+        auto [rd, wr] = make_pipe();
+        auto [idle_rd, idle_wr] = make_pipe();
+        unsigned int asked = 0, idle_asked = 0;
+        loop.add_rule(
+            rd,
+            Direction::In,
+            [&] { rd.read(); },
+            [&] {
+                ++asked;
+                return true;
+            });
+        loop.add_rule(
+            idle_rd,
+            Direction::In,
+            [&] { idle_rd.read(); },
+            [&] {
+                ++idle_asked;
+                return true;
+            });
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipes should time out");
+        test_err_if(not(asked == 1 and idle_asked == 1), name + ": new rules should be asked once");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipes should time out");
+        test_err_if(not(asked == 1 and idle_asked == 1), name + ": interest asked again without a reason");
+        wr.write("x");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": readable pipe should succeed");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipes should time out");
+        test_err_if(not(asked == 2 and idle_asked == 1), name + ": only the ready fd's rule should be asked again");
+        loop.notify(idle_rd);
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipes should time out");
+        test_err_if(not(asked == 2 and idle_asked == 2), name + ": only the notified fd's rule should be asked again");
+        loop.notify_all();
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": idle pipes should time out");
+        test_err_if(not(asked == 3 and idle_asked == 3), name + ": notify_all should ask every rule again");
+    }
+
+    // In and Out rules on the same fd
+    {
+        EventLoop loop{backend};
+        auto [a, b] = make_socketpair();
+        string received;
+        string to_send = "ping";
+        loop.add_rule(a, Direction::In, [&] { received += a.read(); });
+        loop.add_rule(
+            a,
+            Direction::Out,
+            [&] {
+                a.write(to_send);
+                to_send.clear();
+            },
+            [&] { return not to_send.empty(); });
+
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": writable socket should succeed");
+        test_err_if(b.read() != "ping", name + ": Out callback should have written");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name + ": nothing left to do");
+        b.write("pong");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": readable socket should succeed");
+        test_err_if(received != "pong", name + ": In callback should have read");
+    }
+
+    // a callback that neither reads nor loses interest is a busy wait
+    {
+        EventLoop loop{backend};
+        auto [rd, wr] = make_pipe();
+        loop.add_rule(rd, Direction::In, [] {});
+        wr.write("x");
+        bool threw = false;
+        try {
+            loop.wait_next_event(0);
+        } catch (const runtime_error &) {
+            threw = true;
+        }
+        test_err_if(not threw, name + ": busy wait should be detected");
+    }
+
+    // many fds, one ready
+    {
+        EventLoop loop{backend};
+        vector<pair<FileDescriptor, FileDescriptor>> pipes;
+        vector<unsigned int> fired(300, 0);
+        pipes.reserve(fired.size());
+        for (size_t i = 0; i < fired.size(); i++) {
+            pipes.push_back(make_pipe());
+            auto &rd = pipes.back().first;
+            loop.add_rule(rd, Direction::In, [&fired, &rd, i] {
+                rd.read();
+                ++fired[i];
+            });
+        }
+        for (const size_t i : {size_t{0}, size_t{137}, fired.size() - 1}) {
+            pipes[i].second.write("x");
+            test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success, name + ": one pipe should be ready");
+            for (size_t j = 0; j < fired.size(); j++) {
+                test_err_if(fired[j] != (j == i ? 1u : 0u), name + ": only the ready pipe's callback should run");
+            }
+            fired[i] = 0;
+        }
+    }
+}
+
+int main() {
+    try {
+        test_backend(EventLoop::Backend::Poll, "poll");
+        test_backend(EventLoop::Backend::Epoll, "epoll");
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
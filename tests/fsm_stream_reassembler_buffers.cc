@@ -0,0 +1,98 @@
+#include "byte_stream.hh"
+#include "fsm_stream_reassembler_harness.hh"
+#include "stream_reassembler.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+static constexpr unsigned NREPS = 32;
+static constexpr unsigned NSEGS = 256;
+static constexpr unsigned MAX_SEG_LEN = 2048;
+
+int main() {
+    try {
+        {
+            // Buffers that overlap held data on both sides
+            ReassemblerTestHarness test{1000};
+
+            test.execute(SubmitSegment{"b", 1}.as_buffer());
+            test.execute(SubmitSegment{"d", 3}.as_buffer());
+            test.execute(UnassembledBytes{2});
+
+            test.execute(SubmitSegment{"bcdef", 1}.as_buffer());
+            test.execute(UnassembledBytes{5});
+            test.execute(BytesAvailable(""));
+
+            test.execute(SubmitSegment{"abc", 0}.as_buffer());
+            test.execute(UnassembledBytes{0});
+            test.execute(BytesAssembled(6));
+            test.execute(BytesAvailable("abcdef"));
+        }
+
+        {
+            // Buffer that is partly beyond the capacity, then eof in a hole
+            ReassemblerTestHarness test{4};
+
+            test.execute(SubmitSegment{"cdef", 2}.as_buffer());
+            test.execute(UnassembledBytes{2});
+
+            test.execute(SubmitSegment{"ab", 0}.as_buffer());
+            test.execute(BytesAvailable("abcd"));
+
+            test.execute(SubmitSegment{"efg", 4}.as_buffer().with_eof(true));
+            test.execute(NotAtEof{});
+            test.execute(BytesAvailable("efg"));
+            test.execute(AtEof{});
+        }
+
+        // random, possibly overlapping Buffers, mixed with std::string submissions
+        auto rd = get_random_generator();
+        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+            const size_t total = NSEGS * MAX_SEG_LEN / 2;
+            StreamReassembler buf{total};
+
+            string d(total, 0);
+            generate(d.begin(), d.end(), [&] { return rd(); });
+
+            vector<tuple<size_t, size_t>> seq_size;
+            for (unsigned i = 0; i < NSEGS; ++i) {
+                const size_t off = rd() % total;
+                const size_t size = min(total - off, size_t(1 + rd() % MAX_SEG_LEN));
+                seq_size.emplace_back(off, size);
+            }
+            // make sure every byte is covered at least once
+            for (size_t off = 0; off < total; off += MAX_SEG_LEN) {
+                seq_size.emplace_back(off, min(total - off, size_t(MAX_SEG_LEN)));
+            }
+            shuffle(seq_size.begin(), seq_size.end(), rd);
+
+            for (auto [off, sz] : seq_size) {
+                if (rd() % 2) {
+                    buf.push_substring(Buffer{d.substr(off, sz)}, off, off + sz == total);
+                } else {
+                    buf.push_substring(d.substr(off, sz), off, off + sz == total);
+                }
+            }
+
+            if (not buf.empty() or buf.stream_out().bytes_written() != total or not buf.stream_out().input_ended()) {
+                throw runtime_error("random buffers - stream was not fully reassembled");
+            }
+            if (buf.stream_out().read(total) != d) {
+                throw runtime_error("random buffers - content of RX bytes is incorrect");
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
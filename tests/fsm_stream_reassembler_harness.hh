@@ -141,6 +141,7 @@ struct SubmitSegment : public ReassemblerAction {
     std::string _data;
     size_t _index;
     bool _eof{false};
+    bool _as_buffer{false};
 
     SubmitSegment(std::string data, size_t index) : _data(data), _index(index) {}
 
@@ -149,14 +150,25 @@ struct SubmitSegment : public ReassemblerAction {
         return *this;
     }
 
+    SubmitSegment &as_buffer() {
+        _as_buffer = true;
+        return *this;
+    }
+
     std::string description() const {
         std::ostringstream ss;
-        ss << "substring submitted with data \"" << _data << "\", index `" << _index << "`, eof `"
-           << std::to_string(_eof) << "`";
+        ss << (_as_buffer ? "Buffer" : "substring") << " submitted with data \"" << _data << "\", index `" << _index
+           << "`, eof `" << std::to_string(_eof) << "`";
         return ss.str();
     }
 
-    void execute(StreamReassembler &reassembler) const { reassembler.push_substring(_data, _index, _eof); }
+    void execute(StreamReassembler &reassembler) const {
+        if (_as_buffer) {
+            reassembler.push_substring(Buffer{std::string(_data)}, _index, _eof);
+        } else {
+            reassembler.push_substring(_data, _index, _eof);
+        }
+    }
 };
 
 class ReassemblerTestHarness {
@@ -0,0 +1,201 @@
+#include "connection_pair_harness.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using VirtioNetHeader = TCPOverIPv4Adapter::VirtioNetHeader;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+//! A data segment at `seqno` with `length` bytes of `fill`
+TCPSegment data_segment(const WrappingInt32 seqno, const size_t length, const char fill) {
+    TCPSegment seg;
+    seg.header().ack = true;
+    seg.header().ackno = WrappingInt32{777};
+    seg.header().win = 5000;
+    seg.header().seqno = seqno;
+    seg.payload() = Buffer{string(length, fill)};
+    return seg;
+}
+
+//! `count` contiguous segments of `length` bytes starting at `seqno`
+vector<TCPSegment> contiguous(const WrappingInt32 seqno, const size_t count, const size_t length) {
+    vector<TCPSegment> segments;
+    for (size_t i = 0; i < count; i++) {
+        segments.push_back(data_segment(seqno + i * length, length, static_cast<char>('a' + i)));
+    }
+    return segments;
+}
+
+string concatenate(const vector<iovec> &iov) {
+    string ret;
+    for (const auto &x : iov) {
+        ret.append(static_cast<const char *>(x.iov_base), x.iov_len);
+    }
+    return ret;
+}
+
+//! A packet as the kernel would hand it over with a virtio-net header of `flags`
+string vnet_packet(const uint8_t flags, const string &ip_datagram) {
+    VirtioNetHeader vnet{};
+    vnet.flags = flags;
+    return string(reinterpret_cast<const char *>(&vnet), sizeof(vnet)) + ip_datagram;
+}
+
+int main() {
+    try {
+        const WrappingInt32 isn{4000000000};
+
+        // runs: contiguous segments with matching headers, all full but the last
+        {
+            auto segments = contiguous(isn, 5, MSS);
+            segments.push_back(data_segment(isn + 5 * MSS, 10, 'z'));
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != 6, "whole run");
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 3) != 3, "run from the middle");
+
+            segments.push_back(data_segment(isn + 5 * MSS + 10, MSS, 'y'));
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != 6, "run continued past a short segment");
+
+            segments = contiguous(isn, 4, MSS);
+            segments[2].header().seqno = segments[2].header().seqno + 1;
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != 2, "run continued past a gap");
+
+            segments = contiguous(isn, 4, MSS);
+            segments[1].header().ackno = segments[1].header().ackno + 1;
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != 1, "run continued past a new ackno");
+
+            segments = contiguous(isn, 4, MSS);
+            segments[3].header().fin = true;
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != 3, "FIN joined a run");
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 3) != 1, "FIN not sent alone");
+
+            segments = contiguous(isn, 100, MSS);
+            test_err_if(TCPOverIPv4Adapter::gso_run_length(segments, 0) != TCPOverIPv4Adapter::GSO_MAX_PAYLOAD / MSS,
+                        "run longer than a datagram");
+        }
+
+        TCPOverIPv4Adapter sender;
+        sender.config_mut().source = {"10.0.0.1", 1234};
+        sender.config_mut().destination = {"169.254.10.1", 4321};
+        TCPOverIPv4Adapter receiver;
+        receiver.config_mut().source = sender.config().destination;
+        receiver.config_mut().destination = sender.config().source;
+
+        // a super-segment: completing its partial checksum as the kernel does gives a valid datagram
+        {
+            auto segments = contiguous(isn, 3, MSS);
+            segments.push_back(data_segment(isn + 3 * MSS, 123, 'z'));
+            TCPOverIPv4Adapter::GSOHeaders headers;
+            vector<iovec> iov;
+            sender.wrap_tcp_run_in_ip_into(segments, 0, segments.size(), headers, iov);
+            test_err_if(headers.vnet.flags != VirtioNetHeader::F_NEEDS_CSUM, "checksum not left to the kernel");
+            test_err_if(not(headers.vnet.gso_type == VirtioNetHeader::GSO_TCPV4 and headers.vnet.gso_size == MSS),
+                        "not a TCPv4 super-segment of MSS pieces");
+            test_err_if(not(headers.vnet.csum_start == IPv4Header::LENGTH and
+                            headers.vnet.hdr_len == IPv4Header::LENGTH + TCPHeader::LENGTH),
+                        "header lengths");
+
+            string packet = concatenate(iov).substr(sizeof(VirtioNetHeader));
+            InternetChecksum tcp_cksum;
+            tcp_cksum.add(string_view(packet).substr(headers.vnet.csum_start));
+            const uint16_t cksum = tcp_cksum.value();
+            packet[headers.vnet.csum_start + headers.vnet.csum_offset] = static_cast<char>(cksum >> 8);
+            packet[headers.vnet.csum_start + headers.vnet.csum_offset + 1] = static_cast<char>(cksum & 0xff);
+
+            InternetDatagram ip_dgram;
+            test_err_if(ip_dgram.parse(Buffer{string(packet)}) != ParseResult::NoError, "datagram did not parse");
+            const auto seg = receiver.unwrap_tcp_in_ip(ip_dgram);
+            test_err_if(not seg.has_value(), "completed checksum did not verify");
+            test_err_if(seg->payload().copy() !=
+                            string(MSS, 'a') + string(MSS, 'b') + string(MSS, 'c') + string(123, 'z'),
+                        "payload");
+
+            // a run of one is not a super-segment, but still leaves the checksum to the kernel
+            iov.clear();
+            sender.wrap_tcp_run_in_ip_into(segments, 3, 1, headers, iov);
+            test_err_if(not(headers.vnet.gso_type == VirtioNetHeader::GSO_NONE and headers.vnet.gso_size == 0),
+                        "single segment marked for segmentation");
+            test_err_if(headers.vnet.flags != VirtioNetHeader::F_NEEDS_CSUM, "single segment checksummed");
+        }
+
+        // reading: the checksum is trusted when the kernel says it is partial or verified, and only then
+        {
+            TCPSegment seg = data_segment(isn, 100, 'x');
+            const string good = sender.wrap_tcp_in_ip(seg).serialize().concatenate();
+            string bad = good;
+            bad.back() ^= 1;
+
+            test_err_if(not receiver.unwrap_tcp_in_vnet(Buffer{vnet_packet(0, good)}).has_value(),
+                        "good packet dropped");
+            test_err_if(receiver.unwrap_tcp_in_vnet(Buffer{vnet_packet(0, bad)}).has_value(), "bad checksum accepted");
+            test_err_if(
+                not receiver.unwrap_tcp_in_vnet(Buffer{vnet_packet(VirtioNetHeader::F_NEEDS_CSUM, bad)}).has_value(),
+                "partial checksum verified");
+            test_err_if(
+                not receiver.unwrap_tcp_in_vnet(Buffer{vnet_packet(VirtioNetHeader::F_DATA_VALID, bad)}).has_value(),
+                "verified checksum checked again");
+            test_err_if(receiver.unwrap_tcp_in_vnet(Buffer{string(5, 0)}).has_value(), "truncated header accepted");
+        }
+
+        // a window filled at once by a super-segment: the zero-window probe is answered, and the window
+        // reopening is announced once the application has read an MSS
+        {
+            TCPConfig config;
+            config.recv_capacity = 4 * MSS;
+            TCPConnection client{TCPConfig{}};
+            TCPConnection server{config};
+            client.connect();
+            move_segments(client, server);
+            move_segments(server, client);
+            move_segments(client, server);
+
+            client.write(string(4 * MSS, 'x'));
+            move_segments(client, server);
+            const auto acks = take(server);
+            test_err_if(not(not acks.empty() and acks.back().header().win == 0), "window not full");
+
+            TCPSegment probe;
+            probe.header().ack = true;
+            probe.header().ackno = acks.back().header().seqno;
+            probe.header().seqno = acks.back().header().ackno - 1;
+            server.segment_received(probe);
+            const auto reply = take(server);
+            test_err_if(not(reply.size() == 1 and reply.front().header().ackno == acks.back().header().ackno),
+                        "zero-window probe not answered");
+
+            server.inbound_stream().pop_output(MSS - 1);
+            server.inbound_stream_read();
+            test_err_if(not server.segments_out().empty(), "window update for less than an MSS");
+            server.inbound_stream().pop_output(1);
+            server.inbound_stream_read();
+            const auto update = take(server);
+            test_err_if(not(update.size() == 1 and update.front().header().win == MSS), "no window update");
+            server.inbound_stream_read();
+            test_err_if(not server.segments_out().empty(), "window update repeated");
+            client.segment_received(update.front());
+
+            server.inbound_stream().pop_output(server.inbound_stream().buffer_size());
+            close(client, server);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+#include "link_emulator.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! A segment numbered `n` (its seqno) whose wire size is `wire_size` bytes
+TCPSegment numbered_segment(const uint32_t n, const size_t wire_size = 1000) {
+    TCPSegment seg;
+    seg.header().seqno = WrappingInt32{n};
+    seg.payload() = Buffer{string(wire_size - TCPHeader::LENGTH - IPv4Header::LENGTH, 'x')};
+    return seg;
+}
+
+//! Send `count` numbered segments one per millisecond, then run the link until it is empty
+//! \returns the number and arrival time of each segment that arrived, in order of arrival
+vector<pair<uint32_t, uint64_t>> run(LinkEmulator &link, const uint32_t count) {
+    vector<pair<uint32_t, uint64_t>> arrivals;
+    for (uint32_t n = 0; n < count or link.time_until_next_arrival().has_value(); n++) {
+        if (n < count) {
+            link.send(numbered_segment(n));
+        }
+        while (auto seg = link.receive()) {
+            arrivals.emplace_back(seg->header().seqno.raw_value(), link.now_ms());
+        }
+        link.advance(1);
+    }
+    return arrivals;
+}
+
+int main() {
+    try {
+        // propagation delay
+        {
+            LinkConfig config;
+            config.delay_ms = 30;
+            LinkEmulator link{config};
+            test_err_if(link.time_until_next_arrival().has_value(), "arrival expected on an empty link");
+            link.send(numbered_segment(1));
+            test_err_if(link.time_until_next_arrival() != 30, "arrival not one delay away");
+            link.advance(29);
+            test_err_if(link.receive().has_value(), "segment arrived early");
+            link.advance(1);
+            test_err_if(not link.receive().has_value(), "segment did not arrive after the delay");
+        }
+
+        // bottleneck rate: 1000-byte segments at 1 Mbit/s take 8 ms each; a drop-tail queue of 2500 bytes
+        // holds two of them
+        {
+            LinkConfig config;
+            config.rate_bps = 1000000;
+            config.queue_limit = 2500;
+            LinkEmulator link{config};
+            for (uint32_t n = 0; n < 3; n++) {
+                link.send(numbered_segment(n));
+            }
+            test_err_if(not(link.stats().queue_drops == 1 and link.queued_bytes() == 2000), "drop-tail queue limit");
+            test_err_if(link.time_until_next_arrival() != 8, "first segment not serialized at the bottleneck rate");
+            link.advance(8);
+            test_err_if(not(link.receive().has_value() and link.queued_bytes() == 1000), "first segment did not leave");
+            link.send(numbered_segment(3));
+            test_err_if(link.time_until_next_arrival() != 8, "second segment not serialized after the first");
+            link.advance(16);
+            test_err_if(not(link.arrived() == 2 and link.queued_bytes() == 0),
+                        "queue did not drain at the bottleneck rate");
+        }
+
+        // RED drops some segments early, and every segment once the average passes the maximum threshold
+        {
+            LinkConfig config;
+            config.rate_bps = 1000000;
+            config.queue_discipline = LinkConfig::QueueDiscipline::RED;
+            config.red_min_threshold = 4000;
+            config.red_max_threshold = 20000;
+            config.red_weight = 0.5;
+            LinkEmulator link{config};
+            for (uint32_t n = 0; n < 60; n++) {
+                link.send(numbered_segment(n));
+            }
+            test_err_if(not(link.stats().early_drops > 0 and link.stats().queue_drops == 0), "RED did not drop early");
+            test_err_if(link.queued_bytes() >= 30000, "RED let the queue grow far past its maximum threshold");
+            test_err_if(link.queued_bytes() <= 4000, "RED dropped below its minimum threshold");
+        }
+
+        // jitter varies the delay without reordering
+        {
+            LinkConfig config;
+            config.delay_ms = 10;
+            config.jitter_ms = 40;
+            LinkEmulator link{config};
+            const auto arrivals = run(link, 200);
+            test_err_if(arrivals.size() != 200, "segments lost to jitter");
+            bool varied = false;
+            for (uint32_t i = 0; i < arrivals.size(); i++) {
+                test_err_if(arrivals[i].first != i, "jitter reordered segments");
+                test_err_if(arrivals[i].second < i + 10, "segment arrived before the propagation delay");
+                varied |= arrivals[i].second > i + 10;
+            }
+            test_err_if(not varied, "jitter did not delay any segment");
+        }
+
+        // reordering, duplication, and random loss; the same seed gives the same run, another one a different run
+        {
+            LinkConfig config;
+            config.delay_ms = 5;
+            config.reorder_rate = 0.1;
+            config.duplicate_rate = 0.1;
+            config.loss_rate = 0.1;
+            LinkEmulator link{config};
+            const auto arrivals = run(link, 1000);
+            const auto &stats = link.stats();
+            test_err_if(not(stats.sent == 1000 and stats.reordered > 0 and stats.duplicates > 0 and
+                            stats.random_drops > 0),
+                        "impairments not applied");
+            test_err_if(not(arrivals.size() == stats.delivered and
+                            stats.delivered == stats.sent - stats.random_drops + stats.duplicates),
+                        "segments unaccounted for");
+            bool reordered = false;
+            for (size_t i = 1; i < arrivals.size(); i++) {
+                reordered |= arrivals[i].first < arrivals[i - 1].first;
+            }
+            test_err_if(not reordered, "no segment was overtaken");
+
+            LinkEmulator same{config};
+            test_err_if(run(same, 1000) != arrivals, "the same seed gave a different run");
+            config.seed = 2;
+            LinkEmulator other{config};
+            test_err_if(run(other, 1000) == arrivals, "another seed gave the same run");
+        }
+
+        // LossyTCPOverUDPSpongeSocket with emulated links: the handshake takes a round trip, and data arrives
+        {
+            UDPSocket server_udp;
+            server_udp.bind(Address{"127.0.0.1", 0});
+            const Address server_address = server_udp.local_address();
+            const string request = string(256 * 1024, 'q');
+            const string reply = "got " + to_string(request.size()) + " bytes";
+
+            TCPConfig config;
+            config.rt_timeout = 100;
+            LinkConfig path;
+            path.delay_ms = 20;
+            path.rate_bps = 50 * 1000 * 1000;
+            path.queue_limit = 256 * 1024;
+
+            LossyTCPOverUDPSpongeSocket server{LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(server_udp)))};
+            string received;
+            thread server_thread([&] {
+                FdAdapterConfig server_config;
+                server_config.source = server_address;
+                server_config.link_up = path;
+                server.listen_and_accept(config, server_config);
+                while (not server.eof()) {
+                    received += server.read();
+                }
+                server.write(reply);
+                server.wait_until_closed();
+            });
+
+            LossyTCPOverUDPSpongeSocket client{LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(UDPSocket{}))};
+            FdAdapterConfig client_config;
+            client_config.destination = server_address;
+            client_config.link_up = path;
+            const uint64_t start = timestamp_ms();
+            client.connect(config, client_config);
+            test_err_if(timestamp_ms() - start < 2 * path.delay_ms, "handshake took less than the emulated round trip");
+            client.write(request);
+            client.shutdown(SHUT_WR);
+            string client_received;
+            while (not client.eof()) {
+                client_received += client.read();
+            }
+            client.wait_until_closed();
+            server_thread.join();
+
+            test_err_if(received != request, "request not delivered over the emulated path");
+            test_err_if(client_received != reply, "reply not delivered over the emulated path");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include "connection_pair_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+//! Payload sizes of the segments the sender has queued, which are then dropped
+vector<size_t> payload_sizes(TCPSender &sender) {
+    vector<size_t> sizes;
+    for (const auto &seg : take(sender)) {
+        sizes.push_back(seg.payload().size());
+    }
+    return sizes;
+}
+
+int main() {
+    try {
+        const WrappingInt32 isn{12345};
+
+        // Nagle: one small segment may be unacknowledged; further small writes wait for its ACK and then go
+        // together, while a full segment goes at once
+        {
+            TCPSender sender{1 << 20, 1000, isn};
+            sender.set_nagle(true);
+            sender.fill_window();
+            take(sender);
+            sender.ack_received(isn + 1, 1 << 16);
+
+            sender.stream_in().write("a");
+            sender.fill_window();
+            test_err_if(payload_sizes(sender) != vector<size_t>{1}, "first small write held back");
+            sender.stream_in().write("bc");
+            sender.fill_window();
+            sender.stream_in().write("def");
+            sender.fill_window();
+            test_err_if(not payload_sizes(sender).empty(), "small write sent with data unacknowledged");
+
+            sender.ack_received(isn + 2, 1 << 16);
+            test_err_if(payload_sizes(sender) != vector<size_t>{5}, "held writes not coalesced on the ACK");
+
+            sender.stream_in().write(string(MSS + 10, 'x'));
+            sender.fill_window();
+            test_err_if(payload_sizes(sender) != vector<size_t>{MSS}, "full segment held back");
+
+            // the end of the stream sends the tail along with the FIN
+            sender.stream_in().end_input();
+            sender.fill_window();
+            test_err_if(payload_sizes(sender) != vector<size_t>{10}, "tail held back at the end of the stream");
+        }
+
+        // cork: nothing short of a full segment goes, even with nothing in flight, until uncorked
+        {
+            TCPConfig config;
+            TCPConnection client{config};
+            TCPConnection server{config};
+            handshake(client, server);
+
+            client.cork();
+            test_err_if(not client.corked(), "not corked");
+            for (const string piece : {"GET ", "/ ", "HTTP/1.1\r\n", "\r\n"}) {
+                client.write(piece);
+            }
+            test_err_if(not client.segments_out().empty(), "corked data sent");
+            client.write(string(MSS, 'y'));
+            const auto full = take(client);
+            test_err_if(not(full.size() == 1 and full.front().payload().size() == MSS),
+                        "full segment held by the cork");
+            client.uncork();
+            const auto rest = take(client);
+            test_err_if(not(rest.size() == 1 and rest.front().payload().size() == 18),
+                        "uncork did not flush the remainder");
+            test_err_if(client.corked(), "still corked");
+            server.segment_received(full.front());
+            server.segment_received(rest.front());
+            test_err_if(server.inbound_stream().buffer_size() != MSS + 18, "corked data not delivered");
+
+            close(client, server);
+        }
+
+        // data received while corked is still acknowledged, though there is nothing to carry the ACK
+        {
+            TCPConfig config;
+            TCPConnection client{config};
+            TCPConnection server{config};
+            handshake(client, server);
+
+            client.cork();
+            client.write("GET ");
+            test_err_if(not client.segments_out().empty(), "corked data sent");
+            server.write("hello");
+            const auto data = take(server);
+            test_err_if(data.size() != 1, "server data not sent");
+            client.segment_received(data.front());
+            const auto ack = take(client);
+            test_err_if(not(ack.size() == 1 and ack.front().payload().size() == 0 and ack.front().header().ack and
+                            ack.front().header().ackno == data.front().header().seqno + 5),
+                        "data received while corked not acknowledged");
+            client.uncork();
+            move_segments(client, server);
+
+            close(client, server);
+        }
+
+        // likewise while Nagle holds back a short tail
+        {
+            TCPConfig config;
+            config.nagle = true;
+            TCPConnection client{config};
+            TCPConnection server{TCPConfig{}};
+            handshake(client, server);
+
+            client.write("one");
+            const auto first = take(client);
+            client.write("two");
+            test_err_if(not client.segments_out().empty(), "second small write not held by Nagle");
+            server.write("hello");
+            const auto data = take(server);
+            client.segment_received(data.front());
+            const auto ack = take(client);
+            test_err_if(not(ack.size() == 1 and ack.front().payload().size() == 0 and
+                            ack.front().header().ackno == data.front().header().seqno + 5),
+                        "data received while Nagle held a tail not acknowledged");
+            server.segment_received(first.front());
+            move_segments(server, client);
+            move_segments(client, server);
+            test_err_if(server.inbound_stream().buffer_size() != 6, "held tail not delivered");
+
+            close(client, server);
+        }
+
+        // the configuration turns Nagle on; set_nodelay() turns it off and flushes what it held
+        {
+            TCPConfig config;
+            config.nagle = true;
+            TCPConnection client{config};
+            TCPConnection server{TCPConfig{}};
+            handshake(client, server);
+            test_err_if(client.nodelay(), "Nagle not on from the configuration");
+
+            client.write("one");
+            client.write("two");
+            test_err_if(take(client).size() != 1, "second small write not held by Nagle");
+            client.set_nodelay(true);
+            const auto flushed = take(client);
+            test_err_if(not(flushed.size() == 1 and flushed.front().payload().size() == 3),
+                        "set_nodelay did not flush");
+            client.write("three");
+            test_err_if(take(client).size() != 1, "small write held with nodelay");
+
+            close(client, server);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_header.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! The result, fields, and leftover data of a parse (after an error, only the result has to match:
+//! the fields were half-read before, and are mostly not read now)
+struct Parsed {
+    ParseResult result{};
+    string fields{};
+    size_t remaining{};
+
+    bool operator==(const Parsed &other) const {
+        return result == other.result and
+               (result != ParseResult::NoError or (fields == other.fields and remaining == other.remaining));
+    }
+};
+
+//! The field-by-field algorithm that IPv4Header::parse used before it read the header through a NetSpan
+Parsed reference_ipv4(const string &data) {
+    NetParser p{string(data)};
+    IPv4Header h;
+    const auto finish = [&](const ParseResult result) { return Parsed{result, h.to_string(), p.buffer().size()}; };
+
+    const size_t data_size = p.buffer().size();
+    if (data_size < IPv4Header::LENGTH) {
+        return finish(ParseResult::PacketTooShort);
+    }
+    const uint8_t first_byte = p.u8();
+    h.ver = first_byte >> 4;
+    h.hlen = first_byte & 0x0f;
+    h.tos = p.u8();
+    h.len = p.u16();
+    h.id = p.u16();
+    const uint16_t fo_val = p.u16();
+    h.df = fo_val & 0x4000;
+    h.mf = fo_val & 0x2000;
+    h.offset = fo_val & 0x1fff;
+    h.ttl = p.u8();
+    h.proto = p.u8();
+    h.cksum = p.u16();
+    h.src = p.u32();
+    h.dst = p.u32();
+
+    if (data_size < 4 * h.hlen) {
+        return finish(ParseResult::PacketTooShort);
+    }
+    if (h.ver != 4) {
+        return finish(ParseResult::WrongIPVersion);
+    }
+    if (h.hlen < 5) {
+        return finish(ParseResult::HeaderTooShort);
+    }
+    if (data_size != h.len) {
+        return finish(ParseResult::TruncatedPacket);
+    }
+    p.remove_prefix(h.hlen * 4 - IPv4Header::LENGTH);
+    if (p.error()) {
+        return finish(p.get_error());
+    }
+    InternetChecksum check;
+    check.add({data.data(), size_t(4 * h.hlen)});
+    return finish(check.value() ? ParseResult::BadChecksum : ParseResult::NoError);
+}
+
+//! The field-by-field algorithm that TCPHeader::parse used before it read the header through a NetSpan
+//! (options are left out: they are still parsed the same way)
+Parsed reference_tcp(const string &data) {
+    NetParser p{string(data)};
+    TCPHeader h;
+    const auto finish = [&](const ParseResult result) {
+        return Parsed{result, h.summary() + " " + to_string(h.win) + " " + to_string(h.cksum), p.buffer().size()};
+    };
+
+    h.sport = p.u16();
+    h.dport = p.u16();
+    h.seqno = WrappingInt32{p.u32()};
+    h.ackno = WrappingInt32{p.u32()};
+    h.doff = p.u8() >> 4;
+    const uint8_t fl_b = p.u8();
+    h.urg = fl_b & 0b0010'0000;
+    h.ack = fl_b & 0b0001'0000;
+    h.psh = fl_b & 0b0000'1000;
+    h.rst = fl_b & 0b0000'0100;
+    h.syn = fl_b & 0b0000'0010;
+    h.fin = fl_b & 0b0000'0001;
+    h.win = p.u16();
+    h.cksum = p.u16();
+    h.uptr = p.u16();
+
+    if (h.doff < 5) {
+        return finish(ParseResult::HeaderTooShort);
+    }
+    p.remove_prefix(h.doff * 4 - TCPHeader::LENGTH);
+    return finish(p.get_error());
+}
+
+Parsed actual_ipv4(const string &data) {
+    NetParser p{string(data)};
+    IPv4Header h;
+    const ParseResult result = h.parse(p);
+    return {result, h.to_string(), p.buffer().size()};
+}
+
+Parsed actual_tcp(const string &data) {
+    NetParser p{string(data)};
+    TCPHeader h;
+    const ParseResult result = h.parse(p);
+    return {result, h.summary() + " " + to_string(h.win) + " " + to_string(h.cksum), p.buffer().size()};
+}
+
+void check(const bool condition, const string &what, const string &data) {
+    if (not condition) {
+        throw runtime_error(what + " differs for a " + to_string(data.size()) + "-byte input");
+    }
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        uniform_int_distribution<size_t> length_dist{0, 80};
+
+        for (unsigned int i = 0; i < 100000; i++) {
+            string data(length_dist(rd), 0);
+            for (auto &ch : data) {
+                ch = static_cast<char>(rd());
+            }
+
+            // make most inputs plausible, so that parses get past the first checks
+            if (data.size() >= IPv4Header::LENGTH and rd() % 4) {
+                data[0] = static_cast<char>(0x45 + (rd() % 4 == 0 ? rd() % 3 : 0));
+                if (rd() % 4) {
+                    data[2] = static_cast<char>(data.size() >> 8);
+                    data[3] = static_cast<char>(data.size() & 0xff);
+                }
+                const size_t header_length = min(data.size(), size_t(4 * (data[0] & 0x0f)));
+                data[10] = data[11] = 0;
+                InternetChecksum check_sum;
+                check_sum.add({data.data(), header_length});
+                if (rd() % 8) {
+                    data[10] = static_cast<char>(check_sum.value() >> 8);
+                    data[11] = static_cast<char>(check_sum.value() & 0xff);
+                }
+            }
+            check(actual_ipv4(data) == reference_ipv4(data), "IPv4 header parse", data);
+
+            if (data.size() > 12 and rd() % 4) {
+                data[12] = static_cast<char>((5 + rd() % 11) << 4);
+            }
+            check(actual_tcp(data) == reference_tcp(data), "TCP header parse", data);
+        }
+
+        // every truncation of a valid header
+        string ipv4(IPv4Header::LENGTH + 8, 'x');
+        ipv4[0] = 0x45;
+        for (size_t length = 0; length <= ipv4.size(); length++) {
+            const string data = ipv4.substr(0, length);
+            check(actual_ipv4(data) == reference_ipv4(data), "truncated IPv4 header parse", data);
+            check(actual_tcp(data) == reference_tcp(data), "truncated TCP header parse", data);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include "connection_pair_harness.hh"
+#include "rtt_estimator.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Deliver `from`'s segments to `to` through the wire format; returns whether all of them carried timestamps
+bool move_over_wire(TCPConnection &from, TCPConnection &to) {
+    bool all_stamped = true;
+    while (not from.segments_out().empty()) {
+        TCPSegment parsed;
+        test_err_if(parsed.parse(from.segments_out().front().serialize().concatenate()) != ParseResult::NoError,
+                    "segment did not re-parse");
+        all_stamped &= parsed.header().timestamps.has_value();
+        to.segment_received(parsed);
+        from.segments_out().pop();
+    }
+    return all_stamped;
+}
+
+int main() {
+    try {
+        // RFC 6298 arithmetic: RTO = SRTT + max(G, 4 * RTTVAR), clamped
+        {
+            RTTEstimator estimator{1000, 200, 60000};
+            test_err_if(estimator.rto() != 1000, "initial RTO");
+            estimator.add_sample(100);
+            test_err_if(not(estimator.stats().srtt == 100 and estimator.stats().rttvar == 50), "first sample");
+            test_err_if(estimator.rto() != 300, "RTO after the first sample");
+            estimator.add_sample(60);
+            test_err_if(not(estimator.stats().rttvar == 47.5 and estimator.stats().srtt == 95), "second sample");
+            test_err_if(estimator.rto() != 285, "RTO after the second sample");
+            test_err_if(not(estimator.stats().min_rtt == 60 and estimator.stats().samples == 2), "sample counters");
+
+            for (int i = 0; i < 100; i++) {
+                estimator.add_sample(1);
+            }
+            test_err_if(estimator.rto() != 200, "RTO clamped to the minimum");
+            estimator.add_sample(100000);
+            test_err_if(estimator.rto() != 60000, "RTO clamped to the maximum");
+        }
+
+        // inverted bounds are refused rather than handed to std::clamp
+        {
+            bool threw = false;
+            try {
+                RTTEstimator inverted{1000, 500, 400};
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "constructor accepted min_rto > max_rto");
+
+            RTTEstimator estimator{1000, 200, 60000};
+            threw = false;
+            try {
+                estimator.set_bounds(500, 400);
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "set_bounds accepted min_rto > max_rto");
+            estimator.add_sample(1);
+            test_err_if(estimator.rto() != 200, "refused bounds were applied");
+        }
+
+        const WrappingInt32 isn{1000};
+
+        // the sender times segments and its retransmission timer follows the measurements
+        {
+            TCPSender sender{64000, 1000, isn};
+            sender.set_adaptive_rto(10, 60000);
+            sender.fill_window();
+            take(sender);
+            sender.tick(40);
+            sender.ack_received(isn + 1, 64000);
+            test_err_if(not(sender.rtt_stats().samples == 1 and sender.rtt_stats().latest_rtt == 40), "SYN timed");
+            test_err_if(sender.rto() != 120, "RTO from the measurement");
+
+            sender.stream_in().write("hello");
+            sender.fill_window();
+            take(sender);
+            sender.tick(119);
+            test_err_if(take(sender).size() != 0, "retransmitted before the measured RTO");
+            sender.tick(1);
+            test_err_if(take(sender).size() != 1, "no retransmission at the measured RTO");
+            test_err_if(sender.rto() != 240, "backoff");
+
+            // Karn's rule: the ACK of a retransmitted segment is not a measurement
+            sender.tick(5);
+            sender.ack_received(isn + 6, 64000);
+            test_err_if(sender.rtt_stats().samples != 1, "retransmitted segment timed");
+            test_err_if(sender.rto() != 120, "RTO not back to the estimate after an ACK");
+        }
+
+        // without adaptive RTO the timeout stays fixed, but measurements are still taken
+        {
+            TCPSender sender{64000, 1000, isn};
+            sender.fill_window();
+            take(sender);
+            sender.tick(40);
+            sender.ack_received(isn + 1, 64000);
+            test_err_if(sender.rtt_stats().samples != 1, "not measured without adaptive RTO");
+            test_err_if(sender.rto() != 1000, "RTO changed without adaptive RTO");
+        }
+
+        // timestamps: negotiated in the SYNs, then on every segment, timing even retransmissions
+        {
+            TCPConfig config;
+            config.timestamps = true;
+            config.adaptive_rto = true;
+            config.rto_min = 1;
+            TCPConnection client{config};
+            TCPConnection server{config};
+
+            client.connect();
+            client.tick(7);
+            test_err_if(not move_over_wire(client, server), "SYN without timestamps");
+            test_err_if(not move_over_wire(server, client), "SYN-ACK without timestamps");
+            test_err_if(not(client.rtt_stats().samples == 1 and client.rtt_stats().latest_rtt == 7),
+                        "handshake timing");
+
+            // the data segment (and the ACK before it) is lost and retransmitted; its ACK still gives a measurement
+            client.write("data");
+            while (not client.segments_out().empty()) {
+                client.segments_out().pop();
+            }
+            client.tick(client.rto());
+            client.tick(3);
+            test_err_if(not move_over_wire(client, server), "data without timestamps");
+            test_err_if(not move_over_wire(server, client), "ACK without timestamps");
+            test_err_if(not(client.rtt_stats().samples == 2 and client.rtt_stats().latest_rtt == 3),
+                        "retransmission timing");
+            test_err_if(server.inbound_stream().read(4) != "data", "data delivered");
+
+            close(client, server);
+        }
+
+        // a peer that does not offer timestamps: none are sent after the SYN
+        {
+            TCPConfig with;
+            with.timestamps = true;
+            TCPConnection client{with};
+            TCPConnection server{TCPConfig{}};
+
+            client.connect();
+            test_err_if(not move_over_wire(client, server), "SYN without timestamps");
+            test_err_if(server.segments_out().front().header().timestamps.has_value(), "SYN-ACK with timestamps");
+            move_over_wire(server, client);
+            client.write("data");
+            test_err_if(client.segments_out().back().header().timestamps.has_value(), "timestamps not negotiated");
+
+            close(client, server);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
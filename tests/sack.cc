@@ -0,0 +1,216 @@
+#include "congestion_controller.hh"
+#include "connection_pair_harness.hh"
+#include "stream_reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_header.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = 1000;
+
+//! A SACK block covering absolute seqnos [left, right)
+TCPHeader::SackBlock block(const WrappingInt32 isn, const uint64_t left, const uint64_t right) {
+    return {wrap(left, isn), wrap(right, isn)};
+}
+
+//! A segment carrying `data` at absolute seqno `abs_seqno`
+TCPSegment data_segment(const WrappingInt32 isn, const uint64_t abs_seqno, const string &data) {
+    TCPSegment seg;
+    seg.header().seqno = wrap(abs_seqno, isn);
+    seg.payload() = Buffer{string(data)};
+    return seg;
+}
+
+//! Deliver `from`'s segments to `to` through the wire format, except those for which `drop` returns true
+template <typename Drop>
+void move_segments(TCPConnection &from, TCPConnection &to, const Drop &drop) {
+    while (not from.segments_out().empty()) {
+        TCPSegment parsed;
+        test_err_if(parsed.parse(from.segments_out().front().serialize().concatenate()) != ParseResult::NoError,
+                    "segment did not re-parse");
+        from.segments_out().pop();
+        if (not drop(parsed)) {
+            to.segment_received(parsed);
+        }
+    }
+}
+
+int main() {
+    try {
+        const WrappingInt32 isn{12345};
+
+        // the options survive serialization, and as many blocks are sent as fit beside timestamps
+        {
+            TCPSegment seg;
+            seg.header().syn = true;
+            seg.header().sack_permitted = true;
+            seg.header().set_doff_for_options();
+            TCPSegment parsed;
+            test_err_if(parsed.parse(seg.serialize().concatenate()) != ParseResult::NoError, "SYN did not parse");
+            test_err_if(not parsed.header().sack_permitted, "SACK-permitted lost");
+
+            TCPHeader header;
+            test_err_if(header.sack_block_room() != TCPHeader::MAX_SACK_BLOCKS, "room without other options");
+            header.timestamps = TCPHeader::Timestamps{1, 2};
+            test_err_if(header.sack_block_room() != 3, "room beside timestamps");
+            header.sack_blocks = {block(isn, 1001, 2001), block(isn, 3001, 4001), block(isn, 5001, 6001)};
+            header.set_doff_for_options();
+            seg.header() = header;
+            test_err_if(parsed.parse(seg.serialize().concatenate()) != ParseResult::NoError, "blocks did not parse");
+            test_err_if(parsed.header().sack_blocks != header.sack_blocks, "blocks changed");
+            test_err_if(parsed.header().doff != TCPHeader::MAX_LENGTH / 4, "option space not full");
+        }
+
+        // the reassembler reports held ranges, touching ones merged, the most recent first
+        {
+            StreamReassembler reassembler{10000};
+            reassembler.push_substring("b", 10, false);
+            reassembler.push_substring("c", 11, false);
+            reassembler.push_substring("dd", 20, false);
+            reassembler.push_substring("e", 30, false);
+            using Ranges = vector<pair<uint64_t, uint64_t>>;
+            test_err_if(not(reassembler.held_ranges(4, 20) == Ranges{{20, 22}, {10, 12}, {30, 31}}),
+                        "most recent first");
+            test_err_if(not(reassembler.held_ranges(4, 11) == Ranges{{10, 12}, {20, 22}, {30, 31}}), "merged range");
+            test_err_if(not(reassembler.held_ranges(2, 30) == Ranges{{30, 31}, {10, 12}}), "range limit");
+        }
+
+        // the receiver describes its holes in sequence numbers
+        {
+            TCPReceiver receiver{10000};
+            TCPSegment syn;
+            syn.header().syn = true;
+            syn.header().seqno = isn;
+            receiver.segment_received(syn);
+            test_err_if(not receiver.sack_blocks(4).empty(), "blocks without a hole");
+            receiver.segment_received(data_segment(isn, 101, string(100, 'x')));
+            receiver.segment_received(data_segment(isn, 301, string(100, 'x')));
+            const auto blocks = receiver.sack_blocks(4);
+            test_err_if(not(blocks.size() == 2 and blocks[0] == block(isn, 301, 401) and
+                            blocks[1] == block(isn, 101, 201)),
+                        "receiver blocks");
+        }
+
+        // the sender resends only the holes, once three segments above them are selectively acknowledged
+        {
+            // the receiver's window stops new data from being sent beside the retransmissions
+            constexpr uint32_t WINDOW = 10 * MSS;
+            TCPSender sender{1 << 20, 1000, isn};
+            sender.set_congestion_controller(make_congestion_controller(TCPConfig::CongestionControl::Reno, MSS));
+            sender.set_max_payload_size(MSS);
+            sender.enable_sack();
+            sender.fill_window();
+            drain(sender, isn);
+            sender.ack_received(isn + 1, WINDOW);
+            sender.stream_in().write(string(100 * MSS, 'x'));
+            sender.fill_window();
+            test_err_if(drain(sender, isn).size() != CongestionController::INITIAL_WINDOW_SEGMENTS, "initial window");
+
+            // segments 0 and 2 are lost; 1, 3 and 4 arrive
+            const uint64_t first = 1;
+            sender.ack_received(isn + 1, WINDOW, false, {}, {block(isn, first + MSS, first + 2 * MSS)});
+            sender.ack_received(isn + 1,
+                                WINDOW,
+                                false,
+                                {},
+                                {block(isn, first + 3 * MSS, first + 4 * MSS), block(isn, first + MSS, first + 2 * MSS)});
+            test_err_if(not drain(sender, isn).empty(),
+                        "retransmitted before three segments were selectively acknowledged");
+            sender.ack_received(isn + 1,
+                                WINDOW,
+                                false,
+                                {},
+                                {block(isn, first + 3 * MSS, first + 5 * MSS), block(isn, first + MSS, first + 2 * MSS)});
+            test_err_if(drain(sender, isn) != vector<uint64_t>{first}, "fast retransmit");
+            test_err_if(sender.sacked_bytes() != 3 * MSS, "scoreboard");
+
+            // recovery holds the window at ssthresh, without inflation
+            const CongestionController &cc = *sender.congestion_controller();
+            test_err_if(not(cc.ssthresh() == 5 * MSS and cc.window() == 5 * MSS), "SACK recovery window");
+
+            // segment 2 now has three selectively acknowledged segments above it, but is resent only when the
+            // data in the network falls below the window
+            sender.ack_received(isn + 1,
+                                WINDOW,
+                                false,
+                                {},
+                                {block(isn, first + 3 * MSS, first + 6 * MSS), block(isn, first + MSS, first + 2 * MSS)});
+            test_err_if(not drain(sender, isn).empty(), "retransmitted beyond the window");
+            sender.ack_received(isn + 1,
+                                WINDOW,
+                                false,
+                                {},
+                                {block(isn, first + 3 * MSS, first + 7 * MSS), block(isn, first + MSS, first + 2 * MSS)});
+            test_err_if(drain(sender, isn) != vector<uint64_t>{first + 2 * MSS}, "only the holes resent");
+
+            // the retransmissions arrive: everything up to segment 6 is acknowledged, and the scoreboard empties
+            sender.ack_received(isn + 1 + 7 * MSS, WINDOW);
+            test_err_if(sender.sacked_bytes() != 0, "scoreboard not cleared by the cumulative ACK");
+        }
+
+        // end to end: a connection that loses every tenth data segment still delivers the stream, and no
+        // segment is sent more than twice
+        {
+            TCPConfig config;
+            config.sack = true;
+            config.congestion_control = TCPConfig::CongestionControl::Reno;
+            config.recv_capacity = config.send_capacity = 100 * MSS;
+            TCPConnection client{config};
+            TCPConnection server{config};
+
+            const string data(50 * MSS, 'y');
+            size_t written = 0;
+            size_t data_segments = 0;
+            size_t sacks_seen = 0;
+            client.connect();
+            string received;
+            for (unsigned int round = 0; received.size() < data.size(); round++) {
+                test_err_if(round >= 1000, "stream not delivered");
+                written += client.write(data.substr(written));
+                move_segments(client, server, [&](const TCPSegment &seg) {
+                    return seg.payload().size() > 0 and ++data_segments % 10 == 0;
+                });
+                move_segments(server, client, [&](const TCPSegment &seg) {
+                    sacks_seen += not seg.header().sack_blocks.empty();
+                    return false;
+                });
+                received += server.inbound_stream().read(server.inbound_stream().buffer_size());
+                client.tick(1);
+                server.tick(1);
+            }
+            test_err_if(received != data, "stream corrupted");
+            test_err_if(sacks_seen <= 0, "no SACK blocks sent");
+            test_err_if(data_segments > 2 * data.size() / MSS, "too many segments sent");
+
+            client.end_input_stream();
+            server.end_input_stream();
+            const auto keep = [](const TCPSegment &) { return false; };
+            for (unsigned int round = 0; client.active() or server.active(); round++) {
+                test_err_if(round >= 100, "connections did not close");
+                move_segments(client, server, keep);
+                move_segments(server, client, keep);
+                client.tick(1000);
+                server.tick(1000);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -132,6 +132,64 @@ int main() {
             test.execute(ExpectSegment{}.with_fin(true).with_data("4567"));
             test.execute(ExpectNoSegment{});
         }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            const size_t rto = cfg.rt_timeout;
+
+            TCPSenderTestHarness test{"Zero-window probe is resent as soon as the window opens", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(0));
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_no_flags().with_data("a"));  // the probe
+            test.execute(Tick{rto - 1});
+            test.execute(ExpectNoSegment{});
+            // the receiver refused the probe; it must come first, ahead of the data the window now lets through
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(5));
+            test.execute(ExpectSegment{}.with_no_flags().with_data("a"));
+            test.execute(ExpectSegment{}.with_no_flags().with_data("bc"));
+            test.execute(ExpectNoSegment{});
+            // the timer restarted with the resend, and the RTO was not backed off
+            test.execute(Tick{rto - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_no_flags().with_data("a"));
+            // a timeout with the window open does back off
+            test.execute(Tick{2 * rto - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_no_flags().with_data("a"));
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"Window opening before the SYN is acknowledged does not resend the SYN", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn}}.with_win(4));
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"Window opening after the probe was acknowledged resends nothing", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(0));
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_no_flags().with_data("a"));
+            test.execute(AckReceived{WrappingInt32{isn + 2}}.with_win(0));
+            test.execute(ExpectSegment{}.with_no_flags().with_data("b"));  // the next probe
+            test.execute(AckReceived{WrappingInt32{isn + 3}}.with_win(5));
+            test.execute(ExpectSegment{}.with_no_flags().with_data("c"));
+            test.execute(ExpectNoSegment{});
+        }
     } catch (const exception &e) {
         cerr << e.what() << endl;
         return 1;
@@ -0,0 +1,249 @@
+#include "sharded_tcp_stack.hh"
+#include "tcp_stack.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <array>
+#include <atomic>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+UDPSocket bound_udp_socket() {
+    UDPSocket sock;
+    sock.bind(Address{"127.0.0.1", 0});
+    return sock;
+}
+
+//! The 4-tuple a stack bound to some address would see for a datagram from `source` carrying these ports
+TCPStack::FourTuple four_tuple(const Address &source, const uint16_t sport, const uint16_t dport) {
+    const auto [ip, port] = source.ip_port();
+    return {be32toh(inet_addr(ip.c_str())), port, dport, sport};
+}
+
+int main() {
+    try {
+        constexpr size_t shards = 4;
+
+        // the kernel, running the steering program, delivers each datagram to the socket flow_hash() picks
+        {
+            vector<UDPSocket> group(shards);
+            for (size_t i = 0; i < shards; i++) {
+                group[i].set_reuseport();
+                group[i].bind(i == 0 ? Address{"127.0.0.1", 0} : group[0].local_address());
+                group[i].set_blocking(false);
+                if (i == 0) {
+                    group[i].attach_reuseport_cbpf(TCPStack::flow_steering_program(shards));
+                }
+            }
+
+            auto rd = get_random_generator();
+            map<string, size_t> expected;
+            array<size_t, shards> per_shard{};
+            for (unsigned int i = 0; i < 200; i++) {
+                UDPSocket sender = bound_udp_socket();
+                const uint16_t sport = rd();
+                const uint16_t dport = rd();
+                string header(20, 0);
+                header[0] = static_cast<char>(sport >> 8);
+                header[1] = static_cast<char>(sport & 0xff);
+                header[2] = static_cast<char>(dport >> 8);
+                header[3] = static_cast<char>(dport & 0xff);
+                header += to_string(i);
+                sender.sendto(group[0].local_address(), header);
+                expected[to_string(i)] =
+                    TCPStack::flow_hash(four_tuple(sender.local_address(), sport, dport)) % shards;
+                per_shard[expected[to_string(i)]]++;
+            }
+            for (size_t i = 0; i < shards; i++) {
+                test_err_if(per_shard[i] <= 0, "flow_hash left a shard empty");
+            }
+
+            size_t received = 0;
+            for (size_t i = 0; i < shards; i++) {
+                while (true) {
+                    UDPSocket::received_datagram datagram{Address{"0", 0}, {}};
+                    try {
+                        group[i].recv(datagram);
+                    } catch (const unix_error &) {
+                        break;  // EAGAIN: this socket has nothing more
+                    }
+                    test_err_if(expected.at(datagram.payload.substr(20)) != i, "datagram steered to the wrong socket");
+                    received++;
+                }
+            }
+            test_err_if(received != expected.size(), "datagrams lost");
+        }
+
+        // connect() from a shard picks a local port that maps the connection back to it
+        {
+            TCPConfig config;
+            config.rt_timeout = 20;  // short linger after close
+
+            TCPStack stack{bound_udp_socket(), config};
+            TCPStack peer{bound_udp_socket(), config};
+            stack.set_shard(3, shards);
+            peer.listen(80);
+            vector<TCPStack::Handle> handles;
+            for (unsigned int i = 0; i < 20; i++) {
+                handles.push_back(stack.connect(peer.local_address(), 80));
+                test_err_if(TCPStack::flow_hash(handles.back().four_tuple()) % shards != 3,
+                            "connection from the wrong shard");
+                handles.back().end_input_stream();
+            }
+            handles.clear();
+
+            const auto deadline = timestamp_ms() + 10000;
+            while (stack.connection_count() or peer.connection_count()) {
+                test_err_if(timestamp_ms() >= deadline, "timed out closing the shard's connections");
+                stack.wait_next_event(0);
+                peer.wait_next_event(0);
+                while (auto handle = peer.accept()) {
+                    handle->end_input_stream();
+                }
+            }
+        }
+
+        // a sharded server: every connection is served by the worker it hashes to, and a connection a worker
+        // opens gets its replies on that worker
+        {
+            constexpr unsigned int num_connections = 100;
+            constexpr uint16_t server_port = 80;
+            constexpr uint16_t client_port = 90;
+
+            TCPConfig config;
+            config.rt_timeout = 20;  // short linger after close
+
+            // owned by each worker's thread; read after stop() (and declared first, to outlive the threads)
+            struct WorkerState {
+                vector<TCPStack::Handle> accepted{};
+                vector<string> requests{};
+                vector<bool> replied{};
+                size_t misrouted{0};
+                optional<TCPStack::Handle> outgoing{};
+                bool connected{false};
+                size_t accepted_count{0};
+            };
+            vector<WorkerState> workers(shards);
+            atomic<bool> finishing{false};
+            vector<atomic<size_t>> remaining(shards);
+            ShardedTCPStack server{Address{"127.0.0.1", 0}, shards, config};
+            TCPStack client{bound_udp_socket(), config};
+            server.listen(server_port);
+            client.listen(client_port);
+
+            const Address client_address = client.local_address();
+
+            server.start([&](TCPStack &stack, const size_t index) {
+                WorkerState &state = workers[index];
+                if (index == 2 and not state.connected) {
+                    state.connected = true;
+                    state.outgoing = stack.connect(client_address, client_port);
+                    state.outgoing->write("from worker 2");
+                    state.outgoing->end_input_stream();
+                }
+                while (auto handle = stack.accept()) {
+                    state.misrouted += TCPStack::flow_hash(handle->four_tuple()) % shards != index;
+                    state.accepted.push_back(*handle);
+                    state.accepted_count++;
+                    state.requests.emplace_back();
+                    state.replied.push_back(false);
+                }
+                for (size_t i = 0; i < state.accepted.size(); i++) {
+                    const auto &inbound = state.accepted[i].inbound_stream();
+                    state.requests[i] += state.accepted[i].read(inbound.buffer_size());
+                    if (inbound.eof() and not state.replied[i]) {
+                        state.accepted[i].write(string(state.requests[i].rbegin(), state.requests[i].rend()));
+                        state.accepted[i].end_input_stream();
+                        state.replied[i] = true;
+                    }
+                }
+                // once the client has everything, the worker lets go of its handles and reports what is left
+                if (finishing) {
+                    state.accepted.clear();
+                    state.outgoing.reset();
+                }
+                remaining[index] = stack.connection_count();
+            });
+
+            vector<TCPStack::Handle> clients;
+            vector<string> replies(num_connections);
+            for (unsigned int i = 0; i < num_connections; i++) {
+                clients.push_back(client.connect(server.local_address(), server_port));
+                clients.back().write("message " + to_string(i));
+                clients.back().end_input_stream();
+            }
+
+            optional<TCPStack::Handle> from_worker;
+            string from_worker_data;
+            const auto deadline = timestamp_ms() + 20000;
+            auto all_done = [&] {
+                for (unsigned int i = 0; i < num_connections; i++) {
+                    if (not clients[i].inbound_stream().eof()) {
+                        return false;
+                    }
+                }
+                return from_worker.has_value() and from_worker->inbound_stream().eof();
+            };
+            while (not all_done()) {
+                test_err_if(timestamp_ms() >= deadline, "timed out exchanging data");
+                client.wait_next_event(1);
+                if (auto handle = client.accept()) {
+                    from_worker = handle;
+                    from_worker->end_input_stream();
+                }
+                if (from_worker.has_value()) {
+                    from_worker_data += from_worker->read(from_worker->inbound_stream().buffer_size());
+                }
+                for (unsigned int i = 0; i < num_connections; i++) {
+                    replies[i] += clients[i].read(clients[i].inbound_stream().buffer_size());
+                }
+            }
+
+            // once the handles are gone, finished connections are forgotten
+            clients.clear();
+            from_worker.reset();
+            finishing = true;
+            auto all_closed = [&] {
+                for (const auto &count : remaining) {
+                    if (count) {
+                        return false;
+                    }
+                }
+                return client.connection_count() == 0;
+            };
+            while (not all_closed()) {
+                test_err_if(timestamp_ms() >= deadline, "timed out waiting for connections to finish");
+                client.wait_next_event(1);
+            }
+            server.stop();
+
+            size_t accepted = 0;
+            for (size_t i = 0; i < shards; i++) {
+                test_err_if(workers[i].misrouted != 0, "worker " + to_string(i) + " got another worker's connection");
+                test_err_if(workers[i].accepted_count <= 0, "worker " + to_string(i) + " got no connections");
+                accepted += workers[i].accepted_count;
+            }
+            test_err_if(accepted != num_connections, "server should accept every connection");
+            for (unsigned int i = 0; i < num_connections; i++) {
+                const string sent = "message " + to_string(i);
+                test_err_if(replies[i] != string(sent.rbegin(), sent.rend()),
+                            "wrong reply on connection " + to_string(i));
+            }
+            test_err_if(from_worker_data != "from worker 2", "data from the worker's own connection");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
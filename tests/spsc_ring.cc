@@ -0,0 +1,158 @@
+#include "socket.hh"
+#include "spsc_ring.hh"
+#include "tcp_config.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace std;
+
+string random_string(const size_t size) {
+    auto rd = get_random_generator();
+    string ret(size, 0);
+    for (auto &ch : ret) {
+        ch = static_cast<char>(rd());
+    }
+    return ret;
+}
+
+//! Sleep until `event` is signaled
+void wait_for(EventFD &event) {
+    pollfd pfd{event.fd_num(), POLLIN, 0};
+    SystemCall("poll", ::poll(&pfd, 1, -1));
+    event.clear();
+}
+
+//! Write all of `data` into `ring`, sleeping whenever it is full, then close it
+void produce(SPSCByteRing &ring, const string &data, const size_t chunk_size) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const size_t size = ring.write(string_view(data).substr(written, chunk_size));
+        written += size;
+        if (size == 0 and ring.arm_writable_wakeup()) {
+            wait_for(ring.writable_event());
+        }
+    }
+    ring.close();
+}
+
+//! Read `ring` until its end, sleeping whenever it is empty
+string consume(SPSCByteRing &ring) {
+    string ret;
+    while (not ring.eof()) {
+        const string_view front = ring.peek();
+        ret.append(front);
+        ring.pop(front.size());
+        if (front.empty() and ring.arm_readable_wakeup()) {
+            wait_for(ring.readable_event());
+        }
+    }
+    return ret;
+}
+
+int main() {
+    try {
+        // one thread: capacity, wrapping, and end of stream
+        {
+            SPSCByteRing ring{1000};
+            test_err_if(ring.capacity() != 1024, "capacity not rounded up to a power of two");
+            test_err_if(ring.write(string(700, 'a')) != 700, "write into an empty ring");
+            test_err_if(ring.write(string(700, 'b')) != 324, "write should stop when the ring is full");
+            test_err_if(not(ring.remaining_capacity() == 0 and ring.buffer_size() == 1024), "accounting when full");
+            test_err_if(ring.read(600) != string(600, 'a'), "read");
+            test_err_if(ring.write(string(500, 'c')) != 500, "write after making room");
+
+            // the front now runs to the end of the storage; the rest wraps around
+            test_err_if(ring.peek() != string(100, 'a') + string(324, 'b'), "peek stops at the end of the storage");
+            ring.pop(424);
+            test_err_if(ring.peek() != string(500, 'c'), "peek after wrapping");
+            test_err_if(ring.eof(), "eof before close");
+            ring.close();
+            test_err_if(ring.eof(), "eof with bytes left");
+            test_err_if(not(ring.read(1000) == string(500, 'c') and ring.eof()), "eof once the bytes are taken");
+        }
+
+        // wake-ups: only a side that armed one is signaled
+        {
+            SPSCByteRing ring{64};
+            ring.write("x");
+            test_err_if(ring.readable_event().clear(), "signaled without a waiting consumer");
+            test_err_if(ring.arm_readable_wakeup(), "armed with bytes to read");
+            ring.read(1);
+            test_err_if(not ring.arm_readable_wakeup(), "not armed when empty");
+            ring.write("y");
+            test_err_if(not ring.readable_event().clear(), "waiting consumer not signaled");
+            ring.write("z");
+            test_err_if(ring.readable_event().clear(), "signaled again without re-arming");
+
+            ring.write(string(62, 'w'));
+            test_err_if(not ring.arm_writable_wakeup(), "not armed when full");
+            ring.read(1);
+            test_err_if(not ring.writable_event().clear(), "waiting producer not signaled");
+
+            ring.read(63);
+            test_err_if(not ring.arm_readable_wakeup(), "not armed when empty");
+            ring.close();
+            test_err_if(not(ring.readable_event().clear() and ring.eof()), "close did not wake the consumer");
+        }
+
+        // two threads: every byte arrives in order, through a ring much smaller than the data
+        {
+            SPSCByteRing ring{4096};
+            const string data = random_string(8 << 20);
+            thread producer([&] { produce(ring, data, 1500); });
+            const string received = consume(ring);
+            producer.join();
+            test_err_if(received != data, "bytes lost or reordered between threads");
+        }
+
+        // TCPSpongeSocket with Transport::SPSCRing: a request and a reply over loopback UDP
+        {
+            UDPSocket server_udp;
+            server_udp.bind(Address{"127.0.0.1", 0});
+            const Address server_address = server_udp.local_address();
+            const string request = random_string(1 << 20);
+            const string reply = "got " + to_string(request.size()) + " bytes";
+
+            TCPConfig config;
+            config.rt_timeout = 100;
+            LossyTCPOverUDPSpongeSocket server{LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(server_udp))),
+                                               LossyTCPOverUDPSpongeSocket::Transport::SPSCRing};
+            string received;
+            thread server_thread([&] {
+                FdAdapterConfig server_config;
+                server_config.source = server_address;
+                server.listen_and_accept(config, server_config);
+                received = consume(server.inbound_ring());
+                produce(server.outbound_ring(), reply, 1000);
+                server.wait_until_closed();
+            });
+
+            LossyTCPOverUDPSpongeSocket client{LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(UDPSocket{})),
+                                               LossyTCPOverUDPSpongeSocket::Transport::SPSCRing};
+            FdAdapterConfig client_config;
+            client_config.destination = server_address;
+            client.connect(config, client_config);
+            produce(client.outbound_ring(), request, 10000);
+            const string client_received = consume(client.inbound_ring());
+            client.wait_until_closed();
+            server_thread.join();
+
+            test_err_if(received != request, "request not delivered through the rings");
+            test_err_if(client_received != reply, "reply not delivered through the rings");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -191,13 +191,13 @@ int main(int argc, char **argv) {
             TCPSegment tcp_seg_copy;
             tcp_seg_copy.payload() = tcp_seg.payload();
 
-            // set headers in new segment, and fix up to remove extensions
+            // set headers in new segment, and fix up the length to hold only the options that were parsed
             {
                 auto &tcp_hdr_orig = tcp_seg.header();
                 TCPHeader &tcp_hdr_copy = tcp_seg_copy.header();
                 tcp_hdr_copy = tcp_hdr_orig;
-                // fix up segment to remove IPv4 and TCP header extensions
-                tcp_hdr_copy.doff = 5;
+                // fix up segment to remove IPv4 extensions and unparsed TCP options
+                tcp_hdr_copy.set_doff_for_options();
             }  // tcp_hdr_{orig,copy} go out of scope
 
             if (!compare_tcp_headers_nolen(tcp_seg.header(), tcp_seg_copy.header())) {
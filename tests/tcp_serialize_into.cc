@@ -0,0 +1,126 @@
+#include "ipv4_datagram.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Number of heap allocations made by the program so far
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    void *ret = malloc(size);
+    if (not ret) {
+        throw bad_alloc();
+    }
+    return ret;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+string concatenate(const array<iovec, 3> &iov) {
+    string ret;
+    for (const auto &x : iov) {
+        ret.append(static_cast<const char *>(x.iov_base), x.iov_len);
+    }
+    return ret;
+}
+
+TCPSegment random_segment(mt19937 &rd) {
+    uniform_int_distribution<uint32_t> dist32{0, numeric_limits<uint32_t>::max()};
+    uniform_int_distribution<uint16_t> dist16{0, numeric_limits<uint16_t>::max()};
+    uniform_int_distribution<size_t> len_dist{0, 1460};
+
+    TCPSegment seg;
+    auto &h = seg.header();
+    h.seqno = WrappingInt32{dist32(rd)};
+    h.ackno = WrappingInt32{dist32(rd)};
+    h.win = dist16(rd);
+    h.uptr = dist16(rd);
+    h.doff = 5 + rd() % 11;
+    const uint32_t flags = rd();
+    h.urg = flags & 1;
+    h.ack = flags & 2;
+    h.psh = flags & 4;
+    h.rst = flags & 8;
+    h.syn = flags & 16;
+    h.fin = flags & 32;
+
+    string payload(len_dist(rd), 0);
+    for (auto &ch : payload) {
+        ch = static_cast<char>(rd());
+    }
+    seg.payload() = Buffer{move(payload)};
+    return seg;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        TCPOverIPv4Adapter adapter;
+        adapter.config_mut().source = {"10.0.0.1", 1234};
+        adapter.config_mut().destination = {"169.254.10.1", 4321};
+
+        for (unsigned int i = 0; i < 10000; i++) {
+            TCPSegment seg = random_segment(rd);
+            const uint32_t pseudo_cksum = rd() & 0xfffff;
+
+            // header serialized in place matches the allocating path, checksum included
+            const size_t before_tcp = allocations;
+            TCPHeader::Serialized header;
+            const size_t header_length = seg.serialize_header_into(header, pseudo_cksum);
+            if (allocations != before_tcp) {
+                throw runtime_error("TCPSegment::serialize_header_into allocated");
+            }
+
+            const string expected_tcp = seg.serialize(pseudo_cksum).concatenate();
+            const string actual_tcp =
+                string(reinterpret_cast<const char *>(header.data()), header_length) + seg.payload().copy();
+            if (expected_tcp != actual_tcp) {
+                throw runtime_error("TCPSegment::serialize_header_into disagrees with serialize()");
+            }
+
+            // whole datagram, as the TUN adapter writes it
+            const size_t before_ip = allocations;
+            TCPOverIPv4Adapter::SerializedHeaders headers;
+            const auto iov = adapter.wrap_tcp_in_ip_into(seg, headers);
+            if (allocations != before_ip) {
+                throw runtime_error("TCPOverIPv4Adapter::wrap_tcp_in_ip_into allocated");
+            }
+
+            const string actual_ip = concatenate(iov);
+            if (adapter.wrap_tcp_in_ip(seg).serialize().concatenate() != actual_ip) {
+                throw runtime_error("TCPOverIPv4Adapter::wrap_tcp_in_ip_into disagrees with wrap_tcp_in_ip()");
+            }
+
+            // and it parses back to the same segment
+            InternetDatagram dgram;
+            if (dgram.parse(Buffer{string(actual_ip)}) != ParseResult::NoError) {
+                throw runtime_error("datagram from wrap_tcp_in_ip_into failed to parse");
+            }
+            TCPSegment parsed;
+            if (parsed.parse(dgram.payload(), dgram.header().pseudo_cksum()) != ParseResult::NoError) {
+                throw runtime_error("segment from wrap_tcp_in_ip_into failed to parse");
+            }
+            if (not(parsed.header() == seg.header()) or parsed.payload().str() != seg.payload().str()) {
+                throw runtime_error("segment from wrap_tcp_in_ip_into parsed to something else");
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
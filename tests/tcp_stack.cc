@@ -0,0 +1,208 @@
+#include "tcp_stack.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+UDPSocket bound_udp_socket() {
+    UDPSocket sock;
+    sock.bind(Address{"127.0.0.1", 0});
+    return sock;
+}
+
+int main() {
+    try {
+        constexpr unsigned int num_connections = 200;
+        constexpr uint16_t server_port = 80;
+
+        TCPConfig config;
+        config.rt_timeout = 20;  // short linger after close
+
+        TCPStack server{bound_udp_socket(), config};
+        TCPStack client{bound_udp_socket(), config};
+        server.listen(server_port);
+
+        // every client connection sends its own message and closes
+        vector<TCPStack::Handle> clients;
+        vector<string> replies(num_connections);
+        for (unsigned int i = 0; i < num_connections; i++) {
+            clients.push_back(client.connect(server.local_address(), server_port));
+            clients.back().write("message " + to_string(i));
+            clients.back().end_input_stream();
+        }
+        test_err_if(client.connection_count() != num_connections, "client should track every connection");
+
+        // the server echoes each message back, reversed, once it has all of it
+        vector<TCPStack::Handle> accepted;
+        map<size_t, string> requests;
+        vector<bool> replied;
+
+        const auto deadline = timestamp_ms() + 20000;
+        auto all_done = [&] {
+            for (unsigned int i = 0; i < num_connections; i++) {
+                if (not clients[i].inbound_stream().eof()) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        while (not all_done()) {
+            test_err_if(timestamp_ms() >= deadline, "timed out exchanging data");
+
+            server.wait_next_event(0);
+            client.wait_next_event(0);
+
+            while (auto handle = server.accept()) {
+                accepted.push_back(*handle);
+                replied.push_back(false);
+            }
+
+            for (size_t i = 0; i < accepted.size(); i++) {
+                const auto &inbound = accepted[i].inbound_stream();
+                requests[i] += accepted[i].read(inbound.buffer_size());
+                if (inbound.eof() and not replied[i]) {
+                    accepted[i].write(string(requests[i].rbegin(), requests[i].rend()));
+                    accepted[i].end_input_stream();
+                    replied[i] = true;
+                }
+            }
+
+            for (unsigned int i = 0; i < num_connections; i++) {
+                replies[i] += clients[i].read(clients[i].inbound_stream().buffer_size());
+            }
+        }
+
+        test_err_if(accepted.size() != num_connections, "server should accept every connection");
+        for (unsigned int i = 0; i < num_connections; i++) {
+            const string sent = "message " + to_string(i);
+            test_err_if(replies[i] != string(sent.rbegin(), sent.rend()), "wrong reply on connection " + to_string(i));
+        }
+
+        // once the handles are gone, finished connections are forgotten
+        clients.clear();
+        accepted.clear();
+        while (server.connection_count() or client.connection_count()) {
+            test_err_if(timestamp_ms() >= deadline, "timed out waiting for connections to finish");
+            server.wait_next_event(0);
+            client.wait_next_event(0);
+        }
+
+        // a receiver reading through Handle::read reopens its window at once, rather than leaving the
+        // sender to find out with a probe of the closed window a retransmission timeout later
+        {
+            TCPConfig receiver_config;
+            receiver_config.rt_timeout = 20;
+            receiver_config.recv_capacity = 4000;
+            TCPConfig sender_config;
+            sender_config.rt_timeout = 1000;
+            TCPStack receiver{bound_udp_socket(), receiver_config};
+            TCPStack sender{bound_udp_socket(), sender_config};
+            receiver.listen(server_port);
+
+            const string data(10 * receiver_config.recv_capacity, 'b');
+            optional<TCPStack::Handle> outbound = sender.connect(receiver.local_address(), server_port);
+            optional<TCPStack::Handle> inbound;
+            string received;
+            size_t written = 0;
+            uint64_t full_since = 0;
+            const auto transfer_deadline = timestamp_ms() + 5000;
+            while (not inbound.has_value() or not inbound->inbound_stream().eof()) {
+                test_err_if(timestamp_ms() >= transfer_deadline, "bulk transfer stalled on a closed window");
+                receiver.wait_next_event(0);
+                sender.wait_next_event(0);
+                if (auto handle = receiver.accept()) {
+                    inbound = handle;
+                    inbound->end_input_stream();
+                }
+                if (written < data.size()) {
+                    written += outbound->write(data.substr(written));
+                    if (written == data.size()) {
+                        outbound->end_input_stream();
+                    }
+                }
+                // read only once the window has been closed long enough for the sender's probe to be refused
+                if (not inbound.has_value()) {
+                    continue;
+                }
+                if (inbound->inbound_stream().buffer_size() < receiver_config.recv_capacity and
+                    not inbound->inbound_stream().input_ended()) {
+                    full_since = 0;
+                } else if (full_since == 0) {
+                    full_since = timestamp_ms();
+                } else if (timestamp_ms() - full_since >= 50) {
+                    received += inbound->read(inbound->inbound_stream().buffer_size());
+                }
+            }
+            test_err_if(received != data, "bulk transfer corrupted");
+
+            outbound.reset();
+            inbound.reset();
+            while (receiver.connection_count() or sender.connection_count()) {
+                test_err_if(timestamp_ms() >= transfer_deadline, "timed out waiting for the connections to finish");
+                receiver.wait_next_event(0);
+                sender.wait_next_event(0);
+            }
+        }
+
+        // received segments are stored in the pool even when the MSS is larger than the default
+        {
+            TCPConfig large_mss;
+            large_mss.rt_timeout = 20;
+            large_mss.mss = 1400;
+            TCPStack receiver{bound_udp_socket(), large_mss};
+            TCPStack sender{bound_udp_socket(), large_mss};
+            receiver.listen(server_port);
+
+            const string data(100 * large_mss.mss, 'm');
+            optional<TCPStack::Handle> outbound = sender.connect(receiver.local_address(), server_port);
+            optional<TCPStack::Handle> inbound;
+            string received;
+            size_t written = 0;
+            const auto transfer_deadline = timestamp_ms() + 5000;
+            while (not inbound.has_value() or not inbound->inbound_stream().eof()) {
+                test_err_if(timestamp_ms() >= transfer_deadline, "transfer with a large MSS stalled");
+                receiver.wait_next_event(0);
+                sender.wait_next_event(0);
+                if (auto handle = receiver.accept()) {
+                    inbound = handle;
+                    inbound->end_input_stream();
+                }
+                if (written < data.size()) {
+                    written += outbound->write(data.substr(written));
+                    if (written == data.size()) {
+                        outbound->end_input_stream();
+                    }
+                }
+                if (inbound.has_value()) {
+                    received += inbound->read(inbound->inbound_stream().buffer_size());
+                }
+            }
+            test_err_if(received != data, "transfer with a large MSS corrupted");
+            test_err_if(not(receiver.payload_pool_stats().allocated > 0 and
+                            receiver.payload_pool_stats().unpooled == 0),
+                        "full-sized segments did not fit in the pool's slots");
+
+            outbound.reset();
+            inbound.reset();
+            while (receiver.connection_count() or sender.connection_count()) {
+                test_err_if(timestamp_ms() >= transfer_deadline, "timed out waiting for the connections to finish");
+                receiver.wait_next_event(0);
+                sender.wait_next_event(0);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
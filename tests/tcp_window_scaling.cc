@@ -0,0 +1,172 @@
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "tcp_state.hh"
+#include "test_err_if.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Largest payload and largest bytes_in_flight seen from one side of a transfer
+struct Observed {
+    size_t max_payload{0};
+    size_t max_in_flight{0};
+};
+
+//! Deliver `from`'s segments to `to`, serializing and re-parsing each so options cross the wire format
+void move_segments(TCPConnection &from, TCPConnection &to, Observed &observed) {
+    observed.max_in_flight = max(observed.max_in_flight, from.bytes_in_flight());
+    while (not from.segments_out().empty()) {
+        const TCPSegment &seg = from.segments_out().front();
+        observed.max_payload = max(observed.max_payload, seg.payload().size());
+
+        TCPSegment parsed;
+        test_err_if(parsed.parse(seg.serialize().concatenate()) != ParseResult::NoError, "segment did not re-parse");
+        test_err_if(not(parsed.header() == seg.header()), "header changed on the wire");
+        to.segment_received(parsed);
+        from.segments_out().pop();
+    }
+}
+
+//! Send `size` bytes from a client to a server; the server reads everything as it arrives
+Observed transfer(const TCPConfig &client_config, const TCPConfig &server_config, const size_t size) {
+    TCPConnection client{client_config};
+    TCPConnection server{server_config};
+    Observed observed;
+    Observed ignored;
+
+    client.connect();
+    const string data(size, 'x');
+    size_t written = 0;
+    size_t read = 0;
+    for (unsigned int round = 0; read < size; round++) {
+        test_err_if(round >= 100000, "transfer did not finish");
+        if (written < size) {
+            written += client.write(data.substr(written, client.remaining_outbound_capacity()));
+        }
+        move_segments(client, server, observed);
+        read += server.inbound_stream().read(server.inbound_stream().buffer_size()).size();
+        move_segments(server, client, ignored);
+    }
+
+    client.end_input_stream();
+    server.end_input_stream();
+    for (unsigned int round = 0; client.active() or server.active(); round++) {
+        test_err_if(round >= 100, "connections did not close");
+        move_segments(client, server, ignored);
+        move_segments(server, client, ignored);
+        client.tick(10 * client_config.rt_timeout);
+        server.tick(10 * server_config.rt_timeout);
+    }
+    return observed;
+}
+
+int main() {
+    try {
+        // options survive serialization when doff leaves room for them
+        {
+            TCPHeader header;
+            header.syn = true;
+            header.mss = 1460;
+            header.wscale = 7;
+            header.set_doff_for_options();
+            test_err_if(header.doff != 7, "MSS and window scale should take 8 bytes of options");
+
+            const string wire = header.serialize();
+            test_err_if(wire.size() != 28, "serialized header has the wrong length");
+            TCPHeader parsed;
+            NetParser p{Buffer{string(wire)}};
+            test_err_if(parsed.parse(p) != ParseResult::NoError, "header with options did not parse");
+            test_err_if(not(parsed == header), "options did not round-trip");
+
+            // a header that is not long enough for its options, or longer than doff can describe, is refused
+            header.doff = 5;
+            bool threw = false;
+            try {
+                header.serialize();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "options that do not fit should not be dropped silently");
+            header.doff = 16;
+            threw = false;
+            try {
+                header.serialize();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "header longer than doff can describe should be refused");
+        }
+
+        // unknown options are skipped, and a malformed one ends option parsing
+        {
+            TCPHeader header;
+            header.doff = 11;
+            string wire = header.serialize();
+            const string options{
+                4, 2,                                 // SACK permitted
+                8, 10, 0, 0, 0, 1, 0, 0, 0, 0,        // timestamps
+                2, 4, 0x05, static_cast<char>(0xb4),  // MSS 1460
+                1,                                    // NOP
+                3, 3, 9,                              // window scale 9
+                1, 0, 0, 0};                          // NOP, end of options, padding
+            test_err_if(options.size() != 4 * header.doff - TCPHeader::LENGTH, "test options have the wrong length");
+            wire.replace(TCPHeader::LENGTH, options.size(), options);
+
+            TCPHeader parsed;
+            NetParser p{Buffer{string(wire)}};
+            test_err_if(parsed.parse(p) != ParseResult::NoError, "header with unknown options did not parse");
+            test_err_if(not(parsed.mss == 1460 and parsed.wscale == 9), "known options were not found");
+
+            wire[TCPHeader::LENGTH + 1] = 40;  // SACK permitted with a length running off the end
+            NetParser p2{Buffer{string(wire)}};
+            test_err_if(parsed.parse(p2) != ParseResult::NoError, "malformed options should not fail the parse");
+            test_err_if(not(not parsed.mss.has_value() and not parsed.wscale.has_value()),
+                        "options after a bad one were used");
+        }
+
+        TCPConfig big;
+        big.recv_capacity = 4 * 1024 * 1024;
+        big.send_capacity = 4 * 1024 * 1024;
+        big.mss = 1460;
+        big.window_scaling = true;
+
+        // both sides scale: the window is no longer limited to 64 KiB
+        {
+            const auto observed = transfer(big, big, 3 * 1024 * 1024);
+            test_err_if(observed.max_payload != 1460, "segments should use the configured MSS");
+            test_err_if(observed.max_in_flight <= 1024 * 1024, "scaled window was not used");
+        }
+
+        // only one side offers scaling: neither side scales, and both still work
+        {
+            TCPConfig plain = big;
+            plain.window_scaling = false;
+            const auto observed = transfer(big, plain, 1024 * 1024);
+            test_err_if(observed.max_in_flight > 65535, "window was scaled without both sides agreeing");
+            const auto reverse = transfer(plain, big, 1024 * 1024);
+            test_err_if(reverse.max_in_flight > 65535, "window was scaled without both sides agreeing");
+        }
+
+        // the sender never exceeds the peer's MSS
+        {
+            TCPConfig small = big;
+            small.mss = 536;
+            const auto observed = transfer(big, small, 256 * 1024);
+            test_err_if(observed.max_payload != 536, "sender should use the smaller of the two MSS values");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
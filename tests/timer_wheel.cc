@@ -0,0 +1,133 @@
+#include "test_err_if.hh"
+#include "timer_wheel.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+
+using namespace std;
+
+//! A delay of any span the wheel's levels cover, including ones past the top level
+uint64_t random_delay(mt19937 &rd) {
+    const unsigned int bits = uniform_int_distribution<unsigned int>{0, 26}(rd);
+    return uniform_int_distribution<uint64_t>{0, (uint64_t{1} << bits) - 1}(rd);
+}
+
+//! Schedule and cancel random timers, advancing in random steps: every timer must fire exactly once, in
+//! the advance() that first reaches its deadline, unless it was cancelled first.
+void random_schedule_and_cancel(mt19937 &rd) {
+    uint64_t now = uniform_int_distribution<uint64_t>{0, uint64_t{1} << 40}(rd);
+    TimerWheel wheel{now};
+
+    map<TimerWheel::TimerId, uint64_t> pending;  // id -> deadline
+    set<TimerWheel::TimerId> fired;
+
+    for (unsigned int round = 0; round < 3000; round++) {
+        for (unsigned int i = uniform_int_distribution<unsigned int>{0, 5}(rd); i > 0; i--) {
+            const uint64_t deadline = now + random_delay(rd);
+            auto id = make_shared<TimerWheel::TimerId>();
+            *id = wheel.schedule(deadline,
+                                 [&fired, id] { test_err_if(not fired.insert(*id).second, "timer fired twice"); });
+            pending[*id] = deadline;
+        }
+
+        if (not pending.empty() and uniform_int_distribution<int>{0, 2}(rd) == 0) {
+            auto victim = pending.begin();
+            advance(victim, uniform_int_distribution<size_t>{0, pending.size() - 1}(rd));
+            test_err_if(not wheel.cancel(victim->first), "cancel of a pending timer should succeed");
+            test_err_if(wheel.cancel(victim->first), "second cancel should fail");
+            pending.erase(victim);
+        }
+        test_err_if(wheel.size() != pending.size(), "size() should count pending timers");
+
+        // the wheel never asks to be woken later than the earliest deadline
+        if (pending.empty()) {
+            test_err_if(wheel.next_deadline().has_value(), "next_deadline() should be empty without timers");
+            test_err_if(wheel.timeout_ms(now) != -1, "timeout_ms() should be -1 without timers");
+        } else {
+            uint64_t earliest = UINT64_MAX;
+            for (const auto &[id, deadline] : pending) {
+                earliest = min(earliest, deadline);
+            }
+            test_err_if(not wheel.next_deadline().has_value(),
+                        "next_deadline() should be set while timers are pending");
+            test_err_if(wheel.next_deadline().value() > earliest, "next_deadline() is after a deadline");
+        }
+
+        now += random_delay(rd) >> uniform_int_distribution<unsigned int>{0, 20}(rd);
+        fired.clear();
+        const size_t ran = wheel.advance(now);
+        test_err_if(ran != fired.size(), "advance() should return the number of callbacks run");
+        for (auto it = pending.begin(); it != pending.end();) {
+            const bool due = it->second <= now;
+            test_err_if(due != (fired.count(it->first) > 0),
+                        due ? "a due timer did not fire" : "a timer fired before its deadline");
+            it = due ? pending.erase(it) : next(it);
+        }
+        test_err_if(wheel.size() != pending.size(), "expired timers should be gone");
+    }
+}
+
+//! Callbacks can cancel other timers, and schedule new ones that are already due
+void callbacks_change_the_wheel() {
+    TimerWheel wheel{1000};
+    unsigned int chain = 0;
+    bool cancelled_ran = false;
+
+    TimerWheel::TimerId victim = wheel.schedule(1500, [&] { cancelled_ran = true; });
+    wheel.schedule(1200, [&] {
+        wheel.cancel(victim);
+        wheel.schedule(wheel.now(), [&] {
+            chain++;
+            wheel.schedule(wheel.now() + 10, [&] { chain++; });
+        });
+    });
+
+    test_err_if(wheel.advance(1199) != 0, "nothing is due before 1200");
+    test_err_if(wheel.advance(1205) != 2, "the timer at 1200 and the one it scheduled should run");
+    test_err_if(chain != 1, "immediate timer should have run");
+    test_err_if(wheel.next_deadline() != 1210, "the chained timer is next");
+    test_err_if(wheel.timeout_ms(1205) != 5, "timeout_ms() counts from the given time");
+    test_err_if(not(wheel.advance(2000) == 1 and chain == 2), "the chained timer should run");
+    test_err_if(cancelled_ran, "a cancelled timer must not run");
+    test_err_if(not(wheel.size() == 0 and wheel.now() == 2000), "wheel should be empty at 2000");
+}
+
+//! A far-off timer costs a handful of wakeups, not one per millisecond
+void few_wakeups_for_distant_timers() {
+    TimerWheel wheel{0};
+    bool ran = false;
+    wheel.schedule(10'000'000, [&] { ran = true; });
+
+    unsigned int wakeups = 0;
+    while (not ran) {
+        wheel.advance(wheel.next_deadline().value());
+        wakeups++;
+    }
+    test_err_if(wheel.now() != 10'000'000, "timer ran at the wrong time");
+    test_err_if(wakeups > TimerWheel::LEVELS, "too many wakeups: " + to_string(wakeups));
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        for (unsigned int i = 0; i < 20; i++) {
+            random_schedule_and_cancel(rd);
+        }
+        callbacks_change_the_wheel();
+        few_wakeups_for_distant_timers();
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "test_err_if.hh"
+#include "tun.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! A TunTapFD over one end of a SOCK_SEQPACKET socket pair, and the other end to write its packets into
+pair<TunTapFD, FileDescriptor> packet_pair(const size_t max_packet_size) {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+    TunTapFD tun{FileDescriptor{fds[0]}, max_packet_size};
+    tun.set_blocking(false);
+    return {move(tun), FileDescriptor{fds[1]}};
+}
+
+//! The `n`th packet written: distinct contents, and sizes that vary up to the MTU
+string packet(const size_t n, const size_t mtu) { return string(1 + n * 37 % mtu, static_cast<char>('a' + n % 26)); }
+
+int main() {
+    try {
+        constexpr size_t mtu = 200;
+
+        // one read_many takes the waiting packets, up to the batch's capacity, each whole and in order
+        {
+            auto [tun, peer] = packet_pair(mtu);
+            test_err_if(tun.max_packet_size() != mtu, "max_packet_size");
+            TunTapFD::RecvBatch batch{4, tun.max_packet_size()};
+
+            test_err_if(tun.read_many(batch) != 0 or batch.size() != 0, "packets read from an empty device");
+            for (size_t n = 0; n < 6; n++) {
+                peer.write(packet(n, mtu));
+            }
+            peer.write(string(mtu, 'M'));
+
+            test_err_if(tun.read_many(batch) != 4, "batch not filled to its capacity");
+            for (size_t i = 0; i < 4; i++) {
+                test_err_if(batch.packet(i).str() != packet(i, mtu), "packet " + to_string(i) + " read wrong");
+            }
+            test_err_if(tun.read_many(batch) != 3, "the rest not read by the next batch");
+            test_err_if(batch.packet(1).str() != packet(5, mtu), "packet 5 read wrong");
+            test_err_if(batch.packet(2).str() != string(mtu, 'M'), "a packet of the full MTU was cut short");
+            test_err_if(tun.read_many(batch) != 0, "packets read twice");
+        }
+
+        // once the packets of a batch are released, their slots are read into again without allocating
+        {
+            auto [tun, peer] = packet_pair(mtu);
+            TunTapFD::RecvBatch batch{4, mtu};
+            for (size_t round = 0; round < 10; round++) {
+                for (size_t n = 0; n < 4; n++) {
+                    peer.write(packet(round * 4 + n, mtu));
+                }
+                test_err_if(tun.read_many(batch) != 4, "round " + to_string(round) + ": batch not read");
+                for (size_t n = 0; n < 4; n++) {
+                    test_err_if(batch.packet(n).str() != packet(round * 4 + n, mtu),
+                                "round " + to_string(round) + ": packet read wrong");
+                }
+            }
+            // a full batch stops reading without trying a fifth slot, and releases its 4 at the next read_many
+            test_err_if(batch.stats().allocated != 4, "steady state allocated " + to_string(batch.stats().allocated));
+            test_err_if(batch.stats().unpooled != 0, "steady state fell back to unpooled storage");
+        }
+
+        // packets held out of order pin their slots; once every slot is pinned, reads fall back to unpooled
+        // storage, and neither the held packets nor the new ones are overwritten
+        {
+            auto [tun, peer] = packet_pair(mtu);
+            constexpr size_t capacity = 2;
+            TunTapFD::RecvBatch batch{capacity, mtu};
+            vector<pair<size_t, Buffer>> held;
+            size_t next = 0;
+            for (size_t round = 0; round < 12; round++) {
+                for (size_t i = 0; i < capacity; i++) {
+                    peer.write(packet(next + i, mtu));
+                }
+                test_err_if(tun.read_many(batch) != capacity, "round " + to_string(round) + ": batch not read");
+                // keep every other packet, as a reassembler keeps segments that arrived ahead of a gap
+                held.emplace_back(next + 1, batch.packet(1));
+                next += capacity;
+                for (const auto &[n, buffer] : held) {
+                    test_err_if(buffer.str() != packet(n, mtu), "held packet " + to_string(n) + " overwritten");
+                }
+            }
+            test_err_if(batch.stats().unpooled == 0, "reads did not fall back to unpooled storage");
+            test_err_if(batch.stats().allocated > 4 * capacity, "the ring grew past its limit");
+
+            // releasing the held packets lets the ring be reused
+            held.clear();
+            const auto unpooled = batch.stats().unpooled;
+            for (size_t round = 0; round < 4; round++) {
+                for (size_t i = 0; i < capacity; i++) {
+                    peer.write(packet(next + i, mtu));
+                }
+                test_err_if(tun.read_many(batch) != capacity, "batch not read after the release");
+                for (size_t i = 0; i < capacity; i++) {
+                    test_err_if(batch.packet(i).str() != packet(next + i, mtu), "packet read wrong after the release");
+                }
+                next += capacity;
+            }
+            test_err_if(batch.stats().unpooled != unpooled, "released slots were not reused");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
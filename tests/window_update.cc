@@ -0,0 +1,148 @@
+#include "connection_pair_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const WrappingInt32 CLIENT_ISN{1000};
+static const WrappingInt32 SERVER_ISN{5000};
+
+//! A segment from the client, acknowledging the server's SYN, at `client_offset` bytes into the client's stream
+TCPSegment from_client(const uint64_t client_offset, const string &payload = "") {
+    TCPSegment seg;
+    seg.header().seqno = CLIENT_ISN + 1 + client_offset;
+    seg.header().ack = true;
+    seg.header().ackno = SERVER_ISN + 1;
+    seg.header().win = 1000;
+    seg.payload() = Buffer{string(payload)};
+    return seg;
+}
+
+//! The connections' configs: fixed ISNs, and `server_capacity` bytes of receive buffer on the server
+pair<TCPConfig, TCPConfig> configs(const size_t server_capacity) {
+    TCPConfig client_config;
+    client_config.fixed_isn = CLIENT_ISN;
+    TCPConfig server_config;
+    server_config.fixed_isn = SERVER_ISN;
+    server_config.recv_capacity = server_capacity;
+    return {client_config, server_config};
+}
+
+//! Check that `segments` is a single empty ACK of `ackno` advertising a window of `win`
+void check_ack(const vector<TCPSegment> &segments, const WrappingInt32 ackno, const uint16_t win, const string &what) {
+    test_err_if(segments.size() != 1, what + ": expected one segment, got " + to_string(segments.size()));
+    const TCPSegment &seg = segments.front();
+    test_err_if(not(seg.length_in_sequence_space() == 0 and seg.header().ack), what + ": not an empty ACK");
+    test_err_if(seg.header().seqno != SERVER_ISN + 1, what + ": wrong seqno");
+    test_err_if(seg.header().ackno != ackno, what + ": wrong ackno");
+    test_err_if(seg.header().win != win, what + ": wrong window " + to_string(seg.header().win));
+}
+
+int main() {
+    try {
+        // a keep-alive (an empty segment one before the ackno) is answered with an ACK, a plain ACK is not
+        {
+            const auto [client_config, server_config] = configs(4000);
+            TCPConnection client{client_config};
+            TCPConnection server{server_config};
+            handshake(client, server);
+
+            server.segment_received(from_client(0));
+            test_err_if(not take(server).empty(), "a plain ACK was acknowledged");
+
+            TCPSegment keep_alive = from_client(0);
+            keep_alive.header().seqno = CLIENT_ISN;
+            server.segment_received(keep_alive);
+            check_ack(take(server), CLIENT_ISN + 1, 4000, "keep-alive");
+
+            close(client, server);
+        }
+
+        // a probe of a closed window is refused but acknowledged, so the prober keeps learning the window; a
+        // read that opens the window then sends an update without waiting for the next probe
+        {
+            const auto [client_config, server_config] = configs(2000);
+            TCPConnection client{client_config};
+            TCPConnection server{server_config};
+            handshake(client, server);
+
+            test_err_if(client.write(string(2000, 'w')) != 2000, "write");
+            move_segments(client, server);
+            check_ack({take(server).back()}, CLIENT_ISN + 2001, 0, "ACK closing the window");
+
+            server.segment_received(from_client(2000, "p"));
+            check_ack(take(server), CLIENT_ISN + 2001, 0, "zero-window probe");
+            test_err_if(server.inbound_stream().buffer_size() != 2000, "probe byte accepted into a closed window");
+
+            test_err_if(server.inbound_stream().read(2000) != string(2000, 'w'), "read");
+            server.inbound_stream_read();
+            check_ack(take(server), CLIENT_ISN + 2001, 2000, "window update");
+
+            close(client, server);
+        }
+
+        // the window update waits until the window has opened by an MSS, or by half the buffer if that is
+        // smaller (RFC 1122 4.2.3.3), so the sender is not drawn into sending small segments
+        for (const auto &[capacity, threshold] : vector<pair<size_t, size_t>>{{4000, 1000}, {1000, 500}}) {
+            const auto [client_config, server_config] = configs(capacity);
+            TCPConnection client{client_config};
+            TCPConnection server{server_config};
+            handshake(client, server);
+            const string what = "capacity " + to_string(capacity);
+
+            test_err_if(client.write(string(capacity, 'w')) != capacity, what + ": write");
+            move_segments(client, server);
+            take(server);
+
+            server.inbound_stream().read(threshold - 1);
+            server.inbound_stream_read();
+            test_err_if(not take(server).empty(), what + ": update sent before the window opened by the threshold");
+            server.inbound_stream().read(1);
+            server.inbound_stream_read();
+            check_ack(take(server), CLIENT_ISN + 1 + capacity, threshold, what + ": window update");
+
+            // the threshold counts from the window last advertised
+            server.inbound_stream().read(threshold - 1);
+            server.inbound_stream_read();
+            test_err_if(not take(server).empty(),
+                        what + ": update sent for less than the threshold since the last one");
+
+            close(client, server);
+        }
+
+        // once the peer has finished sending, reads send no window updates
+        {
+            const auto [client_config, server_config] = configs(4000);
+            TCPConnection client{client_config};
+            TCPConnection server{server_config};
+            handshake(client, server);
+
+            client.write(string(3000, 'w'));
+            client.end_input_stream();
+            move_segments(client, server);
+            take(server);
+            test_err_if(not server.inbound_stream().input_ended(), "FIN not received");
+
+            server.inbound_stream().read(3000);
+            server.inbound_stream_read();
+            test_err_if(not take(server).empty(), "window update sent after the peer's FIN");
+
+            close(client, server);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}